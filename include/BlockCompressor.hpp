@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+enum class BlockFormat
+{
+	BC1,	// RGB, 4 bpp.
+	BC3,	// RGBA, BC1 colour plus a BC4 alpha block, 8 bpp.
+	BC5,	// RG, two BC4 blocks, 8 bpp. Normal maps.
+	BC7,	// RGBA, 8 bpp. Mode 6 only, single subset with 4-bit indices.
+};
+
+enum class BlockQuality
+{
+	Fast,	// Bounding box endpoints, one index pass. Meant for load time.
+	High,	// PCA endpoints, least squares refinement and wider search. Meant for offline cooking.
+};
+
+struct BlockCompressOptions
+{
+	BlockFormat format = BlockFormat::BC7;
+	BlockQuality quality = BlockQuality::Fast;
+
+	// Turn off to get the scalar reference path.
+	bool useSimd = true;
+};
+
+// CPU encoder for the BC formats, RGBA8 in, 4x4 blocks out in the layout D3D12 expects.
+// Block rows are spread over the thread pool when one is given.
+class BlockCompressor
+{
+public:
+	static size_t GetBlockBytes( BlockFormat format );
+	static size_t GetRowPitch( BlockFormat format, uint32_t width );
+	static size_t GetCompressedSize( BlockFormat format, uint32_t width, uint32_t height );
+
+	// Texels past the right / bottom edge of partial blocks repeat the last row and column.
+	static void Compress( const uint8_t* pSource, uint32_t width, uint32_t height, size_t rowPitch,
+						  const BlockCompressOptions& kOptions, uint8_t* pDestination, size_t destinationRowPitch,
+						  ThreadPool* pPool = nullptr );
+
+	// Decodes back to RGBA8 (BC5 writes blue 0 and alpha 255), used to measure the encoder.
+	// BC7 decoding only understands mode 6, which is all Compress produces.
+	static void Decompress( const uint8_t* pSource, size_t sourceRowPitch, BlockFormat format, uint32_t width, uint32_t height,
+							uint8_t* pDestination, size_t destinationRowPitch );
+
+	// PSNR in dB over the first `channelCount` channels of two RGBA8 images.
+	static double ComputePsnr( const uint8_t* pA, const uint8_t* pB, uint32_t width, uint32_t height, size_t rowPitch, uint32_t channelCount );
+
+};
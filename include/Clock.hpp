@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <exception>
+#include <memory>
+
+#if defined( _WIN32 )
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+// The tools and the portable sources use std::min / std::max, which the min / max macros would break.
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+// Source of raw timestamps for StepTimer. Counter values are in clock-specific units,
+// GetFrequency tells how many of those units make up one second.
+class IClock
+{
+public:
+	virtual ~IClock() {}
+
+	virtual uint64_t GetFrequency() const = 0;
+	virtual uint64_t GetCounter() const = 0;
+
+};
+typedef std::shared_ptr< IClock > ClockPtr;
+
+// QueryPerformanceCounter on Windows, CLOCK_MONOTONIC_RAW on Linux.
+class HighResolutionClock : public IClock
+{
+public:
+	HighResolutionClock() noexcept( false )
+	{
+#if defined( _WIN32 )
+		LARGE_INTEGER frequency;
+		if ( !QueryPerformanceFrequency( &frequency ) )
+		{
+			throw std::exception();
+		}
+		m_frequency = static_cast< uint64_t >( frequency.QuadPart );
+#else
+		m_frequency = 1000000000ull;
+#endif
+	}
+
+	uint64_t GetFrequency() const override { return m_frequency; }
+
+	uint64_t GetCounter() const override
+	{
+#if defined( _WIN32 )
+		LARGE_INTEGER counter;
+		if ( !QueryPerformanceCounter( &counter ) )
+		{
+			throw std::exception();
+		}
+		return static_cast< uint64_t >( counter.QuadPart );
+#else
+		// RAW is not slewed by NTP, so frame deltas are not stretched or squeezed while the clock is adjusted.
+		timespec ts = {};
+#if defined( CLOCK_MONOTONIC_RAW )
+		if ( clock_gettime( CLOCK_MONOTONIC_RAW, &ts ) != 0 )
+#else
+		if ( clock_gettime( CLOCK_MONOTONIC, &ts ) != 0 )
+#endif
+		{
+			throw std::exception();
+		}
+		return static_cast< uint64_t >( ts.tv_sec ) * 1000000000ull + static_cast< uint64_t >( ts.tv_nsec );
+#endif
+	}
+
+private:
+	uint64_t m_frequency;
+
+};
+
+// Manually driven clock for deterministic timing, time only moves when Advance is called.
+class FakeClock : public IClock
+{
+public:
+	explicit FakeClock( uint64_t frequency = 10000000 ) : m_frequency( frequency ), m_counter( 0 ) {}
+
+	uint64_t GetFrequency() const override { return m_frequency; }
+	uint64_t GetCounter() const override { return m_counter; }
+
+	void Advance( uint64_t counts ) { m_counter += counts; }
+	void AdvanceSeconds( double seconds ) { m_counter += static_cast< uint64_t >( seconds * static_cast< double >( m_frequency ) ); }
+
+private:
+	uint64_t m_frequency;
+	uint64_t m_counter;
+
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "CommandRecorder.hpp"
+
+struct CommandAllocatorPoolOptions
+{
+	uint32_t maxAllocators = 0;		// 0 grows as needed, otherwise Acquire waits for the oldest one instead of creating more.
+};
+
+struct CommandAllocatorPoolStats
+{
+	uint32_t live = 0;				// created so far, the pool never frees them.
+	uint32_t idle = 0;				// returned and already past their fence value, Acquire takes these first.
+	uint32_t inFlight = 0;			// returned, the GPU may still be reading them.
+	uint32_t stalls = 0;			// Acquire calls that had to wait for the GPU.
+};
+
+// Command allocators keyed by fence value instead of by back buffer. Acquire hands out a reset allocator,
+// Release takes it back with the fence value signaled after the lists recorded into it were executed,
+// and it is only handed out again once the fence has passed that value. Not thread safe, allocators are
+// acquired and released on the thread that submits.
+class CommandAllocatorPool
+{
+public:
+	explicit CommandAllocatorPool( ICommandBackend& kBackend, const CommandAllocatorPoolOptions& kOptions = {} );
+
+	// An idle allocator when there is one, a new one otherwise. Only waits when maxAllocators are all in flight.
+	ICommandAllocator& Acquire();
+
+	// fenceValue may be lower than a previous one, e.g. an allocator that was acquired but never used can go back with 0.
+	void Release( ICommandAllocator& kAllocator, uint64_t fenceValue );
+
+	CommandAllocatorPoolStats GetStats() const;
+
+private:
+	struct Returned
+	{
+		uint64_t fenceValue;
+		ICommandAllocator* pAllocator;
+	};
+
+	ICommandBackend& m_kBackend;
+	CommandAllocatorPoolOptions m_kOptions;
+	std::vector< std::unique_ptr< ICommandAllocator > > m_allocators;
+	std::deque< Returned > m_returned;		// ascending fence values, so only the front has to be checked.
+	uint32_t m_stalls = 0;
+
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+// The recorder only needs to create, reset, close and execute command lists, so it works against these
+// instead of D3D12 directly. D3D12CommandBackend is the real one, NullCommandBackend runs without a GPU.
+class ICommandAllocator
+{
+public:
+	virtual ~ICommandAllocator() = default;
+	virtual void Reset() = 0;
+};
+
+class ICommandList
+{
+public:
+	virtual ~ICommandList() = default;
+	virtual void Reset( ICommandAllocator& kAllocator ) = 0;
+	virtual void Close() = 0;
+};
+
+class ICommandBackend
+{
+public:
+	virtual ~ICommandBackend() = default;
+
+	virtual std::unique_ptr< ICommandAllocator > CreateAllocator() = 0;
+	// Created closed.
+	virtual std::unique_ptr< ICommandList > CreateCommandList( ICommandAllocator& kAllocator ) = 0;
+
+	// One ExecuteCommandLists. fenceValue is what the caller signals right after, only used for bookkeeping.
+	virtual void Execute( ICommandList* const* ppLists, uint32_t count, uint64_t fenceValue ) = 0;
+
+	virtual uint64_t GetCompletedValue() = 0;
+	virtual void WaitForFence( uint64_t fenceValue ) = 0;
+};
+
+struct CommandRecorderStats
+{
+	uint32_t listsRecorded = 0;		// last frame.
+	uint32_t listCount = 0;			// created so far, over every frame.
+	uint32_t fixupLists = 0;		// last frame, recorded by Submit's fixup function.
+};
+
+class CommandAllocatorPool;
+
+// Records a frame's command lists in parallel, every list with its own allocator so no two threads ever share one.
+// Allocators come from a CommandAllocatorPool and go back to it with the frame's fence value. The lists themselves
+// can be reset as soon as they were executed, so one set grows to the most lists a frame has used and is reused.
+class CommandRecorder
+{
+public:
+	// `record( index, list )` fills list `index` of the frame, the list is already reset and is closed afterwards.
+	using RecordFunction = std::function< void( uint32_t, ICommandList& ) >;
+	// `fixup( index, getList )` runs on the submitting thread in index order, once every list of the frame is recorded,
+	// for what a list needs but could not record itself, e.g. barriers that depend on the lists before it.
+	// getList() hands out an open list executed right before list `index`, only call it when there is something to record.
+	using FixupFunction = std::function< void( uint32_t, const std::function< ICommandList&() >& ) >;
+
+	CommandRecorder( ICommandBackend& kBackend, CommandAllocatorPool& kAllocatorPool );
+
+	// Records `count` more lists, on the pool when there is one. Can be called more than once per frame,
+	// the indices carry on from the previous call.
+	void Record( uint32_t count, const RecordFunction& record, ThreadPool* pPool = nullptr );
+
+	// Executes every list recorded since the last Submit in index order with a single call, whichever thread recorded it.
+	// Their allocators go back to the pool until fenceValue has completed.
+	void Submit( uint64_t fenceValue, const FixupFunction& fixup = {} );
+
+	// Lists recorded since the last Submit, the index the next Record starts at.
+	uint32_t GetPendingListCount() const { return static_cast< uint32_t >( m_frameAllocators.size() ); }
+
+	const CommandRecorderStats& GetStats() const { return m_kStats; }
+
+private:
+	ICommandBackend& m_kBackend;
+	CommandAllocatorPool& m_kAllocatorPool;
+	std::vector< std::unique_ptr< ICommandList > > m_lists;
+	std::vector< ICommandAllocator* > m_frameAllocators;	// one per list recorded since the last Submit.
+	std::vector< std::unique_ptr< ICommandList > > m_fixupLists;
+	std::vector< ICommandAllocator* > m_fixupAllocators;	// one per fixup list of the current Submit.
+	std::vector< ICommandList* > m_submitLists;
+	CommandRecorderStats m_kStats;
+
+};
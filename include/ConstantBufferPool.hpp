@@ -0,0 +1,64 @@
+#pragma once
+#include <cstring>
+#include <vector>
+#include "stdafx.hpp"
+
+struct ConstantBufferAllocation
+{
+	uint8_t* pCpuAddress = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+	uint64_t size = 0;
+};
+
+struct ConstantBufferStats
+{
+	uint64_t bytesWritten = 0;
+	uint32_t allocationCount = 0;
+};
+
+// Per-frame constant buffer memory for root CBVs. One persistently mapped upload buffer is split
+// into a region per frame in flight, each region is a bump allocator that is rewound in BeginFrame.
+// A region is only reused once its frame index comes around again, by then the GPU is done with it.
+class ConstantBufferPool
+{
+public:
+	ConstantBufferPool() = default;
+	~ConstantBufferPool();
+
+	void Create( ID3D12Device* pDevice, uint32_t frameCount, uint64_t bytesPerFrame );
+	void Destroy();
+
+	// Must only be called after the GPU has finished the last frame that used this index.
+	void BeginFrame( uint32_t frameIndex );
+
+	// Returns a 256-byte aligned slice of the current frame's region. Throws when the region is full.
+	ConstantBufferAllocation Allocate( uint64_t size );
+
+	// Copy `data` into a fresh slice and return its GPU address, ready for SetGraphicsRootConstantBufferView.
+	template< typename T >
+	D3D12_GPU_VIRTUAL_ADDRESS Push( const T& data )
+	{
+		const ConstantBufferAllocation kAllocation = Allocate( sizeof( T ) );
+		memcpy( kAllocation.pCpuAddress, &data, sizeof( T ) );
+		return kAllocation.gpuAddress;
+	}
+
+	const ConstantBufferStats& GetFrameStats() const { return m_kFrameStats; }
+	const ConstantBufferStats& GetLastFrameStats() const { return m_kLastFrameStats; }
+	uint64_t GetPeakBytesPerFrame() const { return m_peakBytesPerFrame; }
+	uint64_t GetBytesPerFrame() const { return m_bytesPerFrame; }
+
+private:
+	Microsoft::WRL::ComPtr< ID3D12Resource > m_spBuffer;
+	uint8_t* m_pMappedData = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS m_gpuAddress = 0;
+
+	uint64_t m_bytesPerFrame = 0;
+	uint64_t m_regionBegin = 0;
+	uint64_t m_offset = 0;
+
+	ConstantBufferStats m_kFrameStats;
+	ConstantBufferStats m_kLastFrameStats;
+	uint64_t m_peakBytesPerFrame = 0;
+
+};
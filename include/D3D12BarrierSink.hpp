@@ -0,0 +1,17 @@
+#pragma once
+#include "stdafx.hpp"
+#include "ResourceStateTracker.hpp"
+
+// Issues each batch from a ResourceStateTracker as a single ResourceBarrier call on one command list.
+class D3D12BarrierSink : public IBarrierSink
+{
+public:
+	explicit D3D12BarrierSink( ID3D12GraphicsCommandList* pCommandList ) : m_pCommandList( pCommandList ) {}
+
+	void ResourceBarriers( const ResourceBarrierDesc* pBarriers, uint32_t count ) override;
+
+private:
+	ID3D12GraphicsCommandList* m_pCommandList;
+	std::vector< D3D12_RESOURCE_BARRIER > m_barriers;
+
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include "stdafx.hpp"
+#include "CommandRecorder.hpp"
+#include "D3D12WatchedFence.hpp"
+
+// CommandRecorder backend on a real queue. The fence is the caller's, it is never signaled from here.
+// Waits on it go through kWaiter's thread instead of an event of our own, kWaiter has to outlive the backend.
+class D3D12CommandBackend : public ICommandBackend
+{
+public:
+	D3D12CommandBackend( ID3D12Device* pDevice, ID3D12CommandQueue* pQueue, ID3D12Fence* pFence, FenceWaiter& kWaiter,
+						 D3D12_COMMAND_LIST_TYPE type = D3D12_COMMAND_LIST_TYPE_DIRECT );
+	~D3D12CommandBackend();
+
+	// The list to record into, kList must come from this backend.
+	static ID3D12GraphicsCommandList* GetNative( ICommandList& kList );
+	// For lists that are not recorded through CommandRecorder, kAllocator must come from this backend.
+	static ID3D12CommandAllocator* GetNative( ICommandAllocator& kAllocator );
+
+	std::unique_ptr< ICommandAllocator > CreateAllocator() override;
+	std::unique_ptr< ICommandList > CreateCommandList( ICommandAllocator& kAllocator ) override;
+	void Execute( ICommandList* const* ppLists, uint32_t count, uint64_t fenceValue ) override;
+	uint64_t GetCompletedValue() override { return m_spFence->GetCompletedValue(); }
+	void WaitForFence( uint64_t fenceValue ) override;
+
+private:
+	Microsoft::WRL::ComPtr< ID3D12Device > m_spDevice;
+	Microsoft::WRL::ComPtr< ID3D12CommandQueue > m_spQueue;
+	Microsoft::WRL::ComPtr< ID3D12Fence > m_spFence;
+	FenceWaiter& m_kWaiter;
+	D3D12WatchedFence m_kWatchedFence;
+	D3D12_COMMAND_LIST_TYPE m_type;
+	std::vector< ID3D12CommandList* > m_nativeLists;
+
+};
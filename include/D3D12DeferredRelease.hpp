@@ -0,0 +1,8 @@
+#pragma once
+#include "stdafx.hpp"
+#include "DeferredReleaseQueue.hpp"
+
+// Hand a D3D12 object over to the queue instead of releasing it, spObject is empty afterwards.
+// fenceValue is the value signaled after the last submitted work that used it.
+void DeferRelease( DeferredReleaseQueue& kQueue, Microsoft::WRL::ComPtr< ID3D12Resource >& spResource, uint64_t fenceValue );
+void DeferRelease( DeferredReleaseQueue& kQueue, Microsoft::WRL::ComPtr< ID3D12Heap >& spHeap, uint64_t fenceValue );
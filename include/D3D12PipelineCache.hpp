@@ -0,0 +1,30 @@
+#pragma once
+#include "stdafx.hpp"
+#include "PipelineCache.hpp"
+
+// Vendor, device and user mode driver version of the adapter pDevice was created on.
+PipelineCacheIdentity GetPipelineCacheIdentity( IDXGIFactory4* pFactory, ID3D12Device* pDevice );
+
+// A graphics pipeline PipelineCache can create. kDesc is kept as it is, so whatever it points to (shaders, input
+// layout, stream output) has to stay alive until the cache is done with it. The root signature is hashed by its
+// serialized blob, D3D12 does not hand that back, so it is passed along. It can only be left out when the root
+// signature is part of the shaders.
+class D3D12GraphicsPipeline : public ICachedPipeline
+{
+public:
+	D3D12GraphicsPipeline( ID3D12Device* pDevice, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& kDesc, const void* pRootSignatureBlob, size_t rootSignatureSize );
+
+	uint64_t GetHash() const override;
+	bool Create( const void* pBlob, size_t blobSize ) override;
+	std::vector< uint8_t > GetCachedBlob() const override;
+
+	ID3D12PipelineState* Get() const { return m_spPipelineState.Get(); }
+
+private:
+	ID3D12Device* m_pDevice;
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC m_kDesc;
+	const void* m_pRootSignatureBlob;
+	size_t m_rootSignatureSize;
+	Microsoft::WRL::ComPtr< ID3D12PipelineState > m_spPipelineState;
+
+};
@@ -0,0 +1,77 @@
+#pragma once
+#include "stdafx.hpp"
+#include "RenderGraph.hpp"
+
+class CommandRecorder;
+class DeferredReleaseQueue;
+class ThreadPool;
+
+// Backs a RenderGraph on a device: one heap per RenderGraphHeap with placed resources at the offsets Compile picked,
+// and one command list per compiled pass with its barriers around it. Heaps only grow, and a placed resource is kept
+// from frame to frame as long as the graph asks for the same description at the same offset. Whatever is replaced
+// goes to the deferred release queue. Which placed resource used each range of a heap last is kept across frames, so
+// a resource whose memory another one had before gets an aliasing barrier even when the graph does not alias it.
+class D3D12RenderGraph
+{
+public:
+	D3D12RenderGraph( ID3D12Device* pDevice, DeferredReleaseQueue& kDeferredRelease );
+
+	// Adds a transient texture or buffer to kGraph, sized and put in the right heap for this device.
+	// pClearValue for render targets and depth buffers.
+	uint32_t Create( RenderGraph& kGraph, std::string name, const D3D12_RESOURCE_DESC& kDesc, const D3D12_CLEAR_VALUE* pClearValue = nullptr );
+
+	// After kGraph.Compile. fenceValue is signaled after this frame, replaced heaps and resources are released with it.
+	void Allocate( const RenderGraph& kGraph, uint64_t fenceValue );
+
+	// Imported or placed, valid after Allocate. nullptr for transient resources that were culled.
+	ID3D12Resource* GetResource( uint32_t resource ) const { return m_resources.at( resource ); }
+
+	// One list per compiled pass, in parallel on the pool when there is one.
+	void Record( const RenderGraph& kGraph, CommandRecorder& kRecorder, ThreadPool* pPool = nullptr );
+
+private:
+	struct TransientDesc
+	{
+		D3D12_RESOURCE_DESC desc;
+		D3D12_CLEAR_VALUE clearValue;
+		bool bHasClearValue;
+	};
+
+	struct PlacedResource
+	{
+		RenderGraphHeap heap;
+		uint64_t offset;
+		uint32_t initialState;
+		TransientDesc kDesc;
+		Microsoft::WRL::ComPtr< ID3D12Resource > spResource;
+		bool bUsed;
+		uint64_t id;	// never reused, unlike the address of a released resource.
+	};
+
+	// A range of a heap and the placed resource whose aliasing barrier came last in it.
+	struct ActiveRange
+	{
+		uint64_t offset;
+		uint64_t sizeBytes;
+		uint64_t placedId;
+	};
+
+	static bool SameDesc( const TransientDesc& kFirst, const TransientDesc& kSecond );
+	// Replaces whatever overlaps kRange, keeping the parts of other ranges outside it.
+	static void SetActiveRange( std::vector< ActiveRange >& ranges, const ActiveRange& kRange );
+	const PlacedResource& GetPlacedResource( const RenderGraph& kGraph, uint32_t resource );
+	// pFirst goes in front of the graph's barriers, in the same call.
+	void ResourceBarriers( ID3D12GraphicsCommandList* pCommandList, const std::vector< RenderGraphBarrier >& barriers,
+						   const std::vector< D3D12_RESOURCE_BARRIER >* pFirst ) const;
+
+	ID3D12Device* m_pDevice;
+	DeferredReleaseQueue& m_kDeferredRelease;
+	Microsoft::WRL::ComPtr< ID3D12Heap > m_heaps[ static_cast< uint32_t >( RenderGraphHeap::Count ) ];
+	std::vector< TransientDesc > m_descs;		// by graph resource index, what Create was given this frame.
+	std::vector< PlacedResource > m_placed;
+	std::vector< ID3D12Resource* > m_resources;	// by graph resource index.
+	std::vector< std::vector< D3D12_RESOURCE_BARRIER > > m_createdByPass;	// by compiled pass, for memory another resource used last.
+	std::vector< ActiveRange > m_activeRanges[ static_cast< uint32_t >( RenderGraphHeap::Count ) ];
+	uint64_t m_nextPlacedId = 1;
+
+};
@@ -0,0 +1,17 @@
+#pragma once
+#include "stdafx.hpp"
+#include "FenceWaiter.hpp"
+
+// Lets FenceWaiter watch an ID3D12Fence, the fence sets the waiter's event itself.
+class D3D12WatchedFence : public IWatchedFence
+{
+public:
+	explicit D3D12WatchedFence( ID3D12Fence* pFence );
+
+	uint64_t GetCompletedValue() override { return m_spFence->GetCompletedValue(); }
+	void SetEventOnCompletion( uint64_t value, FenceEvent& kEvent ) override;
+
+private:
+	Microsoft::WRL::ComPtr< ID3D12Fence > m_spFence;
+
+};
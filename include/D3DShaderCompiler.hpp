@@ -0,0 +1,22 @@
+#pragma once
+#include "stdafx.hpp"
+#include "ShaderCache.hpp"
+
+// D3DPreprocess and D3DCompile from d3dcompiler_47 for ShaderCache. Quoted and angle bracket includes are looked up
+// next to the file that includes them, then next to the shader. Bindings come from D3DReflect.
+class D3DShaderCompiler : public IShaderCompiler
+{
+public:
+	// Looks up the version of the d3dcompiler DLL that was loaded, throws std::runtime_error when that fails.
+	D3DShaderCompiler();
+
+	// The file version of the loaded DLL, not the headers', so a redistributable update invalidates the cache.
+	uint64_t GetVersion() const override { return m_version; }
+	PreprocessedShader Preprocess( const ShaderCompileDesc& kDesc ) override;
+	void Compile( const ShaderCompileDesc& kDesc, const std::string& source, std::vector< uint8_t >& bytecode,
+				  std::vector< ShaderBinding >& bindings ) override;
+
+private:
+	uint64_t m_version = 0;
+
+};
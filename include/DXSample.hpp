@@ -1,8 +1,18 @@
 #pragma once
+#include <memory>
 #include "DXSampleHelper.hpp"
 #include "Win32App.hpp"
 #include "StepTimer.hpp"
 
+class ThreadPool;
+
+// CPU time spent in each phase of the last OnTick.
+struct FramePhaseTimes
+{
+	double updateSeconds = 0.0;
+	double renderSeconds = 0.0;
+};
+
 class DXSample
 {
 public:
@@ -13,6 +23,7 @@ public:
 	virtual void OnUpdate( const StepTimer& kTimer ) = 0;
 	virtual void OnRender() = 0;
 	virtual void OnTick();
+	virtual void OnFrameBegin() {}		// First thing in every OnTick, before input is read and anything is updated.
 	virtual void OnDestroy() = 0;
 
 	// Sample override the event handlers to handle specific messages.
@@ -28,16 +39,36 @@ public:
 	uint32_t GetWidth() const			{ return m_width; }
 	uint32_t GetHeight() const			{ return m_height; }
 	const wchar_t* GetTitle() const		{ return m_title.c_str(); }
+	const FramePhaseTimes& GetLastFramePhaseTimes() const { return m_kLastFramePhaseTimes; }
+
+	// Headless benchmark settings (--headless --frames N --warmup N --seconds S --report out.json).
+	bool IsHeadless() const						{ return m_bHeadless; }
+	uint32_t GetHeadlessFrames() const			{ return m_headlessFrames; }
+	uint32_t GetHeadlessWarmupFrames() const	{ return m_headlessWarmupFrames; }
+	double GetHeadlessSeconds() const			{ return m_headlessSeconds; }
+	const std::wstring& GetReportPath() const	{ return m_reportPath; }
+	bool IsMipBenchmarkEnabled() const			{ return m_bMipBenchmark; }
+	bool IsBcBenchmarkEnabled() const			{ return m_bBcBenchmark; }
+	bool IsTextureLoadBenchmarkEnabled() const	{ return m_bTextureLoadBenchmark; }
+
+	// Work-stealing job system shared by update, culling and recording. Created on first use with
+	// --threads N workers, one per core by default, the calling thread helps while it waits.
+	ThreadPool& GetJobSystem();
+
+	// --frames-in-flight N ( 1 to 4, default 2 ) frames the CPU may queue ahead of the GPU,
+	// --back-buffers N ( 2 to 4, default 3 ) buffers in the swap chain. Already clamped.
+	static constexpr uint32_t uMaxBackBufferCount = 4;
+	uint32_t GetFramesInFlight() const			{ return m_framesInFlight; }
+	uint32_t GetBackBufferCount() const			{ return m_backBufferCount; }
 
 	void ParseCommandLineArgs( _In_reads_( argc ) wchar_t* argv[], int argc );
+	std::wstring GetAssetFullPath( LPCWSTR assertName );
 
 protected:
 	virtual void CreateDevice() = 0;
 	virtual void CreateResources() = 0;
 	virtual void OnDeviceLost() = 0;
 
-	std::wstring GetAssetFullPath( LPCWSTR assertName );
-
 	void SetWidthAndHeight( uint32_t width, uint32_t height );
 	void GetHardwareAdapter( _In_ IDXGIFactory4* pFactory, 
 							 _Outptr_result_maybenull_ IDXGIAdapter1** ppAdapter, 
@@ -50,6 +81,12 @@ protected:
 
 	bool m_bIsInitialized;
 
+	// No window and no swap chain, driven by HeadlessApp instead of Win32App.
+	bool m_bHeadless;
+
+	// Use the WARP software adapter, so it runs on machines without a GPU.
+	bool m_bUseWarpDevice;
+
 	// Timer
 	StepTimer m_kTimer;
 
@@ -57,6 +94,25 @@ private:
 	// Root assert path.
 	std::wstring m_assesPath;
 
+	// Headless runs advance simulated time by a fixed step per frame, so every run does the same work.
+	std::shared_ptr< FakeClock > m_spSimulatedClock;
+	HighResolutionClock m_kProfileClock;
+	FramePhaseTimes m_kLastFramePhaseTimes;
+
+	uint32_t m_headlessFrames;
+	uint32_t m_headlessWarmupFrames;
+	double m_headlessSeconds;
+	bool m_bMipBenchmark;
+	bool m_bBcBenchmark;
+	bool m_bTextureLoadBenchmark;
+	std::wstring m_reportPath;
+
+	uint32_t m_jobThreadCount;
+	std::unique_ptr< ThreadPool > m_spJobSystem;
+
+	uint32_t m_framesInFlight;
+	uint32_t m_backBufferCount;
+
 	// Window title.
 	std::wstring m_title;
 
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include "CommandRecorder.hpp"
+
+struct DeferredReleaseQueueOptions
+{
+	// 0 for no limit. Past either limit Push waits for the oldest objects instead of queueing more.
+	uint32_t maxPending = 1024;
+	uint64_t maxPendingBytes = 256ull << 20;
+};
+
+struct DeferredReleaseStats
+{
+	uint32_t pending = 0;
+	uint64_t pendingBytes = 0;
+	uint32_t releasedLastCollect = 0;		// by the last Collect, which runs once per frame.
+	uint64_t bytesReleasedLastCollect = 0;
+	uint64_t released = 0;					// over the queue's lifetime.
+	uint64_t releasedBytes = 0;
+	uint32_t stalls = 0;					// Push calls that had to wait for the GPU to get under the limits.
+	uint32_t overflows = 0;					// Push calls that went past a limit, everything queued was still unsubmitted.
+};
+
+// GPU objects the CPU is done with but the GPU may still read, released in fence value order once the fence
+// passed the value they were pushed with. Knows nothing about D3D12, D3D12DeferredRelease.hpp pushes ComPtrs.
+// Not thread safe, objects are pushed and collected on the thread that submits.
+class DeferredReleaseQueue
+{
+public:
+	typedef void ( *ReleaseFunction )( void* pObject );
+
+	explicit DeferredReleaseQueue( ICommandBackend& kBackend, const DeferredReleaseQueueOptions& kOptions = {} );
+	// Releases whatever is left without waiting, after Flush or once the device is gone.
+	~DeferredReleaseQueue();
+
+	// pObject is released with pRelease once the fence reached fenceValue, the value that will be signaled after the
+	// last submitted work using it. Values below an earlier one are raised to it, releasing later is always safe.
+	// Every value below fenceValue must have been signaled already, only those are waited on to stay in the limits.
+	void Push( uint64_t fenceValue, void* pObject, ReleaseFunction pRelease, uint64_t bytes = 0 );
+
+	// Releases everything whose fence value passed, returns how many. Once per frame, the stats count per call.
+	uint32_t Collect();
+
+	// Waits for the newest pushed value and releases everything, for shutdown. That value must have been signaled.
+	void Flush();
+
+	// Releases everything right away, only when the GPU can not read any of it anymore, e.g. after device removal.
+	void ReleaseAll();
+
+	const DeferredReleaseStats& GetStats() const { return m_kStats; }
+
+private:
+	struct Entry
+	{
+		uint64_t fenceValue;
+		uint64_t bytes;
+		void* pObject;
+		ReleaseFunction pRelease;
+	};
+
+	bool IsOverLimit( uint64_t bytes ) const;
+	uint32_t ReleaseUpTo( uint64_t completedValue );
+
+	ICommandBackend& m_kBackend;
+	DeferredReleaseQueueOptions m_kOptions;
+	std::deque< Entry > m_entries;		// ascending fence values, only the front has to be checked.
+	DeferredReleaseStats m_kStats;
+
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include "stdafx.hpp"
+#include "DescriptorIndexAllocator.hpp"
+
+struct DescriptorHandle
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE cpu = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE gpu = {};
+	uint32_t index = DescriptorIndexAllocator::uInvalidIndex;
+	uint32_t count = 0;
+
+	bool IsValid() const { return index != DescriptorIndexAllocator::uInvalidIndex; }
+};
+
+// CPU-only heap to create descriptors in. Shader visible heaps are slow to read from the CPU,
+// so descriptors are created here first and then copied over with CopyDescriptors.
+class StagingDescriptorHeap
+{
+public:
+	void Create( ID3D12Device* pDevice, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t count );
+	void Destroy();
+
+	// Throws when the heap is full.
+	DescriptorHandle Allocate( uint32_t count = 1 );
+	void Free( DescriptorHandle& handle );
+
+private:
+	Microsoft::WRL::ComPtr< ID3D12DescriptorHeap > m_spHeap;
+	D3D12_CPU_DESCRIPTOR_HANDLE m_cpuStart = {};
+	uint32_t m_descriptorSize = 0;
+	DescriptorIndexAllocator m_kAllocator;
+
+};
+
+// Shader visible heap shared by everything the command list binds.
+// Persistent ranges hold long lived descriptors (textures, ImGui font), transient ranges hold
+// per-frame tables. Copies from staging heaps are queued and flushed in one CopyDescriptors call.
+class DescriptorHeapAllocator
+{
+public:
+	void Create( ID3D12Device* pDevice, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t persistentCount, uint32_t frameCount, uint32_t transientCountPerFrame );
+	void Destroy();
+
+	// Throws when the heap is full.
+	DescriptorHandle AllocatePersistent( uint32_t count = 1 );
+	void Free( DescriptorHandle& handle );
+
+	// Only call once the GPU is done with the last frame that used this index.
+	void BeginFrame( uint32_t frameIndex );
+	DescriptorHandle AllocateTransient( uint32_t count );
+
+	// Queue a copy of `count` staged descriptors into `destination`, executed by FlushCopies.
+	void QueueCopy( const DescriptorHandle& destination, D3D12_CPU_DESCRIPTOR_HANDLE source, uint32_t count );
+	// Allocate a transient table and fill it from the given staged descriptors.
+	DescriptorHandle CopyToTransient( const D3D12_CPU_DESCRIPTOR_HANDLE* pSources, uint32_t count );
+	void FlushCopies();
+
+	ID3D12DescriptorHeap* GetHeap() const { return m_spHeap.Get(); }
+	const DescriptorIndexAllocator& GetAllocator() const { return m_kAllocator; }
+
+private:
+	DescriptorHandle MakeHandle( uint32_t index, uint32_t count ) const;
+
+	Microsoft::WRL::ComPtr< ID3D12Device > m_spDevice;
+	Microsoft::WRL::ComPtr< ID3D12DescriptorHeap > m_spHeap;
+	D3D12_DESCRIPTOR_HEAP_TYPE m_type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	D3D12_CPU_DESCRIPTOR_HANDLE m_cpuStart = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE m_gpuStart = {};
+	uint32_t m_descriptorSize = 0;
+	DescriptorIndexAllocator m_kAllocator;
+
+	// Pending copies, one range per entry on both sides.
+	std::vector< D3D12_CPU_DESCRIPTOR_HANDLE > m_copyDestinations;
+	std::vector< UINT > m_copyDestinationSizes;
+	std::vector< D3D12_CPU_DESCRIPTOR_HANDLE > m_copySources;
+	std::vector< UINT > m_copySourceSizes;
+
+};
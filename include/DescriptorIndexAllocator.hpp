@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Index bookkeeping for a descriptor heap, no device needed.
+//
+// The heap is laid out as [ persistent | frame 0 | frame 1 | ... ].
+// Persistent ranges are rounded up to a power of two and recycled through one free list per size,
+// so both allocate and free are O(1). Each frame region is a bump allocator rewound by BeginFrame,
+// used for transient descriptor tables that only live for one frame.
+class DescriptorIndexAllocator
+{
+public:
+	static constexpr uint32_t uInvalidIndex = ~0u;
+	static constexpr uint32_t uSizeClassCount = 32;
+
+	DescriptorIndexAllocator() = default;
+	DescriptorIndexAllocator( uint32_t persistentCount, uint32_t frameCount, uint32_t transientCountPerFrame );
+
+	void Reset( uint32_t persistentCount, uint32_t frameCount, uint32_t transientCountPerFrame );
+
+	// Returns the first index of `count` contiguous descriptors, or uInvalidIndex when full.
+	uint32_t AllocatePersistent( uint32_t count );
+	// `count` must be the one passed to AllocatePersistent.
+	void FreePersistent( uint32_t index, uint32_t count );
+
+	// Only call once the GPU is done with the last frame that used this index.
+	void BeginFrame( uint32_t frameIndex );
+	uint32_t AllocateTransient( uint32_t count );
+
+	uint32_t GetCapacity() const { return m_persistentCount + m_frameCount * m_transientCountPerFrame; }
+	uint32_t GetPersistentCount() const { return m_persistentCount; }
+	uint32_t GetPersistentUsed() const { return m_persistentUsed; }
+	uint32_t GetTransientUsed() const { return m_transientOffset; }
+	uint32_t GetTransientCountPerFrame() const { return m_transientCountPerFrame; }
+
+	// log2 of count rounded up to a power of two, uSizeClassCount when no class is that large.
+	static uint32_t SizeClass( uint32_t count );
+
+private:
+	std::vector< uint32_t > m_freeLists[ uSizeClassCount ];
+	uint32_t m_persistentCount = 0;
+	uint32_t m_persistentBump = 0;
+	uint32_t m_persistentUsed = 0;
+
+	uint32_t m_frameCount = 0;
+	uint32_t m_transientCountPerFrame = 0;
+	uint32_t m_transientBegin = 0;
+	uint32_t m_transientOffset = 0;
+
+};
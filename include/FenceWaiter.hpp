@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Auto-reset event the waiter thread sleeps on. A Win32 event on Windows, so a D3D12 fence can set it itself.
+class FenceEvent
+{
+public:
+	FenceEvent();
+	~FenceEvent();
+	FenceEvent( const FenceEvent& ) = delete;
+	FenceEvent& operator=( const FenceEvent& ) = delete;
+
+	void Set();
+	void Wait();
+
+	// The HANDLE on Windows, nullptr anywhere else.
+	void* GetNativeHandle() const { return m_pHandle; }
+
+private:
+	void* m_pHandle = nullptr;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_bSet = false;
+
+};
+
+// A fence FenceWaiter can watch: D3D12WatchedFence for a real one, SoftwareFence for tests.
+class IWatchedFence
+{
+public:
+	virtual ~IWatchedFence() = default;
+
+	virtual uint64_t GetCompletedValue() = 0;
+	// Set kEvent once the fence reached value, right away when it already has. May be called again for the same value.
+	virtual void SetEventOnCompletion( uint64_t value, FenceEvent& kEvent ) = 0;
+};
+
+struct FenceWaiterStats
+{
+	uint64_t callbacksRun = 0;
+	uint64_t wakeups = 0;		// times the thread woke up, callbacks are batched when several fence values pass at once.
+};
+
+// One background thread watching every fence something registered a callback on, so nothing else has to block
+// to find out when the GPU is done. Callbacks run on that thread in fence value order, registration order for
+// equal values, and must not call Wait themselves. A fence has to outlive its callbacks, the ones still pending
+// when the waiter is destroyed are dropped without being called.
+class FenceWaiter
+{
+public:
+	FenceWaiter();
+	~FenceWaiter();
+
+	// Calls callback once kFence reached value. Any thread, also from inside a callback. Must not throw.
+	void OnCompletion( IWatchedFence& kFence, uint64_t value, std::function< void() > callback );
+
+	// Ready once kFence reached value, a callback that throws passes its exception on to the future.
+	std::future< void > WhenComplete( IWatchedFence& kFence, uint64_t value, std::function< void() > callback = {} );
+
+	// Blocks until kFence reached value, without a kernel wait when it already has.
+	void Wait( IWatchedFence& kFence, uint64_t value );
+
+	// Drops every callback still waiting on kFence without calling it, e.g. before the fence goes away with its device.
+	void Cancel( IWatchedFence& kFence );
+
+	FenceWaiterStats GetStats() const;
+
+private:
+	struct Watch
+	{
+		IWatchedFence* pFence;
+		uint64_t armedValue;
+		std::multimap< uint64_t, std::function< void() > > callbacks;
+	};
+
+	void ThreadLoop();
+
+	FenceEvent m_kEvent;
+	mutable std::mutex m_mutex;
+	std::vector< Watch > m_watches;
+	std::atomic< uint64_t > m_callbacksRun{ 0 };
+	std::atomic< uint64_t > m_wakeups{ 0 };
+	bool m_bStopping = false;
+	std::thread m_thread;
+
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include "Clock.hpp"
+#include "CommandRecorder.hpp"
+
+struct FramePacerStats
+{
+	uint32_t fenceWaits = 0;			// BeginFrame calls that had to wait for the GPU to give the slot back.
+	double inputToGpuSeconds = 0.0;		// smoothed, BeginFrame until the frame's fence was seen complete.
+	double inputToPresentSeconds = 0.0;	// smoothed, BeginFrame until the frame was on screen, 0 until OnFrameShown is called.
+	double frameIntervalSeconds = 0.0;	// smoothed, between BeginFrame calls.
+};
+
+// Hands out the slot of per-frame resources (constant buffer region, transient descriptors) a frame may use.
+// There are framesInFlight slots, which has nothing to do with the number of back buffers. How far the CPU runs
+// ahead is meant to be limited before BeginFrame, by the swap chain's frame latency object, so the fence wait
+// in here only triggers when the latency allows more frames than there are slots.
+class FramePacer
+{
+public:
+	static constexpr uint32_t uMaxFramesInFlight = 4;
+
+	// framesInFlight is clamped to [1, uMaxFramesInFlight].
+	FramePacer( ICommandBackend& kBackend, const IClock& kClock, uint32_t framesInFlight );
+
+	// Call before input is read, the latency estimate starts here. Calling it again before EndFrame
+	// returns the same slot without waiting.
+	uint32_t BeginFrame();
+
+	// The frame's work was submitted, fenceValue is signaled once the GPU finished it. Moves on to the next slot.
+	// presentId is whatever OnFrameShown will use for this frame, e.g. DXGI's present count.
+	void EndFrame( uint64_t fenceValue, uint64_t presentId = 0 );
+
+	// The display reports that presentId went on screen at `counter`, in the clock's units.
+	// Only the last uHistorySize frames are still known, older ids are ignored.
+	void OnFrameShown( uint64_t presentId, uint64_t counter );
+
+	uint32_t GetFrameSlot() const { return m_slot; }
+	uint32_t GetFramesInFlight() const { return m_framesInFlight; }
+	const FramePacerStats& GetStats() const { return m_kStats; }
+
+private:
+	struct Slot
+	{
+		uint64_t fenceValue = 0;
+		uint64_t beginCounter = 0;
+		bool bMeasured = true;
+	};
+
+	struct PresentedFrame
+	{
+		uint64_t presentId = 0;
+		uint64_t beginCounter = 0;
+		bool bShown = true;
+	};
+	static constexpr uint32_t uHistorySize = 16;
+
+	// Samples the latency of every frame whose fence completed since the last look.
+	void MeasureCompletedFrames( uint64_t counter );
+
+	ICommandBackend& m_kBackend;
+	const IClock& m_kClock;
+	uint32_t m_framesInFlight;
+	Slot m_slots[ uMaxFramesInFlight ];
+	PresentedFrame m_history[ uHistorySize ];
+	uint32_t m_slot = 0;
+	uint64_t m_lastBeginCounter = 0;
+	uint64_t m_frameCount = 0;
+	uint64_t m_endedCount = 0;
+	bool m_bInFrame = false;
+	FramePacerStats m_kStats;
+
+};
@@ -0,0 +1,156 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+// Log-bucketed histogram of frame times (in StepTimer ticks).
+// Every power of two is split into 8 linear sub-buckets, so any reported value is within
+// 12.5% of the real one while the whole table stays at a fixed ~4KB.
+// Record can be called from any thread without locking; queries read a relaxed snapshot.
+class FrameTimeHistogram
+{
+public:
+	static constexpr uint32_t uSubBucketBits = 3;
+	static constexpr uint32_t uSubBucketCount = 1u << uSubBucketBits;
+	static constexpr uint32_t uBucketCount = ( 64 - uSubBucketBits + 1 ) * uSubBucketCount;
+
+	FrameTimeHistogram() noexcept
+	{
+		Reset();
+	}
+
+	void Record( uint64_t value ) noexcept
+	{
+		m_buckets[ BucketIndex( value ) ].fetch_add( 1, std::memory_order_relaxed );
+		m_count.fetch_add( 1, std::memory_order_relaxed );
+		m_sum.fetch_add( value, std::memory_order_relaxed );
+
+		uint64_t currentMax = m_max.load( std::memory_order_relaxed );
+		while ( value > currentMax && !m_max.compare_exchange_weak( currentMax, value, std::memory_order_relaxed ) )
+		{
+		}
+	}
+
+	void Reset() noexcept
+	{
+		for ( auto& bucket : m_buckets )
+		{
+			bucket.store( 0, std::memory_order_relaxed );
+		}
+		m_count.store( 0, std::memory_order_relaxed );
+		m_sum.store( 0, std::memory_order_relaxed );
+		m_max.store( 0, std::memory_order_relaxed );
+	}
+
+	uint64_t GetCount() const noexcept { return m_count.load( std::memory_order_relaxed ); }
+	uint64_t GetMax() const noexcept { return m_max.load( std::memory_order_relaxed ); }
+
+	uint64_t GetMean() const noexcept
+	{
+		const uint64_t count = GetCount();
+		return count ? m_sum.load( std::memory_order_relaxed ) / count : 0;
+	}
+
+	// Smallest recorded value v such that at least `percentile` percent of samples are <= v.
+	// Reported as the upper edge of its bucket, clamped to the largest value ever recorded.
+	uint64_t GetPercentile( double percentile ) const noexcept
+	{
+		const uint64_t count = GetCount();
+		if ( count == 0 )
+		{
+			return 0;
+		}
+
+		if ( percentile < 0.0 ) percentile = 0.0;
+		if ( percentile > 100.0 ) percentile = 100.0;
+
+		uint64_t target = static_cast< uint64_t >( percentile / 100.0 * static_cast< double >( count ) + 0.5 );
+		if ( target == 0 )
+		{
+			target = 1;
+		}
+
+		const uint64_t maxValue = GetMax();
+		uint64_t seen = 0;
+		for ( uint32_t i = 0; i < uBucketCount; ++i )
+		{
+			seen += m_buckets[ i ].load( std::memory_order_relaxed );
+			if ( seen >= target )
+			{
+				const uint64_t upper = BucketUpperBound( i );
+				return upper < maxValue ? upper : maxValue;
+			}
+		}
+		return maxValue;
+	}
+
+	uint64_t GetP50() const noexcept { return GetPercentile( 50.0 ); }
+	uint64_t GetP95() const noexcept { return GetPercentile( 95.0 ); }
+	uint64_t GetP99() const noexcept { return GetPercentile( 99.0 ); }
+
+	uint64_t GetBucketSampleCount( uint32_t index ) const noexcept { return m_buckets[ index ].load( std::memory_order_relaxed ); }
+
+	static uint32_t BucketIndex( uint64_t value ) noexcept
+	{
+		if ( value < uSubBucketCount )
+		{
+			return static_cast< uint32_t >( value );
+		}
+
+		const uint32_t msb = MostSignificantBit( value );
+		const uint32_t shift = msb - uSubBucketBits;
+		const uint32_t sub = static_cast< uint32_t >( value >> shift ) & ( uSubBucketCount - 1 );
+		return ( shift + 1 ) * uSubBucketCount + sub;
+	}
+
+	static uint64_t BucketLowerBound( uint32_t index ) noexcept
+	{
+		if ( index < uSubBucketCount )
+		{
+			return index;
+		}
+
+		const uint32_t shift = index / uSubBucketCount - 1;
+		const uint64_t sub = index % uSubBucketCount;
+		return ( uSubBucketCount + sub ) << shift;
+	}
+
+	static uint64_t BucketUpperBound( uint32_t index ) noexcept
+	{
+		if ( index < uSubBucketCount )
+		{
+			return index;
+		}
+
+		const uint32_t shift = index / uSubBucketCount - 1;
+		return BucketLowerBound( index ) + ( ( uint64_t( 1 ) << shift ) - 1 );
+	}
+
+private:
+	static uint32_t MostSignificantBit( uint64_t value ) noexcept
+	{
+#if defined( _MSC_VER ) && defined( _WIN64 )
+		unsigned long index = 0;
+		_BitScanReverse64( &index, value );
+		return static_cast< uint32_t >( index );
+#elif defined( __GNUC__ ) || defined( __clang__ )
+		return 63u - static_cast< uint32_t >( __builtin_clzll( value ) );
+#else
+		uint32_t index = 0;
+		while ( value >>= 1 )
+		{
+			++index;
+		}
+		return index;
+#endif
+	}
+
+	std::atomic< uint64_t > m_buckets[ uBucketCount ];
+	std::atomic< uint64_t > m_count;
+	std::atomic< uint64_t > m_sum;
+	std::atomic< uint64_t > m_max;
+
+};
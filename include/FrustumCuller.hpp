@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Six planes (a, b, c, d) with the normal pointing inside and normalized, so a * x + b * y + c * z + d is a signed distance.
+// Order: left, right, bottom, top, near, far.
+struct FrustumPlanes
+{
+	float planes[ 6 ][ 4 ];
+};
+
+struct FrustumCullOptions
+{
+	bool useSimd = true;
+	uint32_t parallelThreshold = 1u << 16;	// fewer objects than this are culled on the calling thread.
+	uint32_t grainSize = 1u << 14;			// objects per task above the threshold.
+};
+
+// Object bounds kept as structure of arrays so 4 (SSE) or 8 (AVX2) objects are tested per plane at once.
+// Every object has an axis aligned box and the sphere around it, spheres are cheaper, boxes are tighter.
+class FrustumCuller
+{
+public:
+	// viewProj as DirectXMath builds it (row vectors, v * M) before it is transposed for HLSL, D3D clip space (0 <= z <= w).
+	static FrustumPlanes ExtractPlanes( const float viewProj[ 16 ] );
+
+	void Clear();
+	void Reserve( uint32_t count );
+	uint32_t GetObjectCount() const { return static_cast< uint32_t >( m_centerX.size() ); }
+
+	// Returns the object index, which is what ends up in the visible list.
+	uint32_t AddObject( const float boxMin[ 3 ], const float boxMax[ 3 ] );
+	void SetBounds( uint32_t index, const float boxMin[ 3 ], const float boxMax[ 3 ] );
+
+	// `visible` receives the indices of the objects that intersect the frustum, in increasing order.
+	void CullSpheres( const FrustumPlanes& kFrustum, std::vector< uint32_t >& visible, const FrustumCullOptions& kOptions = FrustumCullOptions(), ThreadPool* pPool = nullptr ) const;
+	void CullBoxes( const FrustumPlanes& kFrustum, std::vector< uint32_t >& visible, const FrustumCullOptions& kOptions = FrustumCullOptions(), ThreadPool* pPool = nullptr ) const;
+
+private:
+	template< bool bBoxes >
+	void Cull( const FrustumPlanes& kFrustum, std::vector< uint32_t >& visible, const FrustumCullOptions& kOptions, ThreadPool* pPool ) const;
+
+	// Box center / half extent, the sphere shares the center.
+	std::vector< float > m_centerX;
+	std::vector< float > m_centerY;
+	std::vector< float > m_centerZ;
+	std::vector< float > m_extentX;
+	std::vector< float > m_extentY;
+	std::vector< float > m_extentZ;
+	std::vector< float > m_radius;
+
+};
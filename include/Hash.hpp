@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// 64-bit FNV-1a for the on-disk caches, pipelines and shaders alike. Values are added one field at a time so struct
+// padding never ends up in the hash, and pointers are followed, so the same description built twice hashes the same.
+class Hasher
+{
+public:
+	template< typename T >
+	void Add( const T& value )
+	{
+		static_assert( std::is_arithmetic< T >::value || std::is_enum< T >::value, "Add fields one by one, not whole structs" );
+		AddBytes( &value, sizeof( value ) );
+	}
+
+	// The size goes in first, so two blobs next to each other can not hash like one. nullptr hashes like empty.
+	void AddBlob( const void* pData, size_t size )
+	{
+		Add( static_cast< uint64_t >( pData ? size : 0 ) );
+		if ( pData )
+		{
+			AddBytes( pData, size );
+		}
+	}
+
+	void AddString( const char* pText )
+	{
+		AddBlob( pText, pText ? strlen( pText ) : 0 );
+	}
+
+	uint64_t GetHash() const { return m_hash; }
+
+private:
+	void AddBytes( const void* pData, size_t size )
+	{
+		const uint8_t* p = static_cast< const uint8_t* >( pData );
+		uint64_t hash = m_hash;
+		for ( size_t n = 0; n < size; ++n )
+		{
+			hash = ( hash ^ p[ n ] ) * 1099511628211ull;
+		}
+		m_hash = hash;
+	}
+
+	uint64_t m_hash = 14695981039346656037ull;
+
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+class DXSample;
+class ThreadPool;
+
+// Drives a DXSample without a window or message pump, for a fixed number of frames (or seconds),
+// and reports the CPU time spent in each phase. Used for benchmarking in CI, with --warp on machines without a GPU.
+// The report goes to --report, or to stdout.
+class HeadlessApp
+{
+public:
+	static int Run( DXSample* pSample );
+
+private:
+	static bool WriteReport( const std::wstring& path, const std::string& json );
+	static bool WriteStandardOutput( const std::string& text );
+
+	// Scalar vs SIMD mip generation on random 1K / 4K / 8K images, single threaded.
+	static void RunMipBenchmark( std::ostringstream& out );
+
+	// PSNR and single threaded throughput of every BC format / quality on one image.
+	static void RunBlockCompressionBenchmark( std::ostringstream& out, const std::wstring& imagePath );
+
+	// Decoding the JPEG (plus mips on the job system) vs mapping a cooked .ldxt of the same image and copying its payload.
+	static void RunTextureLoadBenchmark( std::ostringstream& out, const std::wstring& imagePath, ThreadPool& kJobs );
+
+};
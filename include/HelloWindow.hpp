@@ -1,5 +1,21 @@
 #pragma once
 #include "DXSample.hpp"
+#include "CommandAllocatorPool.hpp"
+#include "CommandRecorder.hpp"
+#include "D3D12BarrierSink.hpp"
+#include "D3D12CommandBackend.hpp"
+#include "D3D12DeferredRelease.hpp"
+#include "D3D12PipelineCache.hpp"
+#include "D3D12RenderGraph.hpp"
+#include "D3DShaderCompiler.hpp"
+#include "FenceWaiter.hpp"
+#include "FramePacer.hpp"
+#include "UploadRingBuffer.hpp"
+#include "ConstantBufferPool.hpp"
+#include "DescriptorHeap.hpp"
+#include "FrustumCuller.hpp"
+#include "TransformHierarchy.hpp"
+#include "VertexFormat.hpp"
 
 using Microsoft::WRL::ComPtr;
 using Microsoft::WRL::Wrappers::Event;
@@ -12,6 +28,7 @@ public:
 	virtual void OnInit( uint32_t width, uint32_t height );
 	virtual void OnUpdate( const StepTimer& kTimer );
 	virtual void OnRender();
+	virtual void OnFrameBegin();
 	virtual void OnDestroy();
 
 	virtual void OnSizeChanged( uint32_t width, uint32_t height );
@@ -25,25 +42,35 @@ private:
 	void LoadAssets();
 	void InitImGui();
 	void PopulateCommandList();
+	void BuildRenderGraph( D3D12_GPU_VIRTUAL_ADDRESS sceneConstants );
 	void RenderImGui();
 	void WaitForGpu();
 	void MoveToNextFrame();
 
-	// In the sample we overload the meaning of FrameCount to mean both the maximum
-	// number of frames that will be queued to the GPU at a time, as well as the number
-	// of back buffers in the DXGI swap chain. For the majority of applications, this is
-	// convenient and works well. However, there will be certain cases where an application
-	// may want to queue up more frames than there are back buffers available.
-	// It should be noted that excessive buffering of frames dependent our user input may result
-	// in noticeable latency in yout application.
-	static const UINT FrameCount = 2;
+	// The number of frames queued to the GPU at a time ( GetFramesInFlight ) and the number of back buffers
+	// in the DXGI swap chain ( GetBackBufferCount ) are separate settings. Per-frame resources come once per
+	// frame in flight, only the render targets come per back buffer. More frames in flight keep a slow CPU or GPU
+	// busy, but every queued frame that depends on user input adds noticeable latency, see framepacing.
 
-	struct Vertex
-	{
-		DirectX::XMFLOAT3 position;
-		DirectX::XMFLOAT4 color;
-		DirectX::XMFLOAT2 uv;
-	};
+	// Transient, placed in the render graph's heap every frame.
+	static const DXGI_FORMAT DepthBufferFormat = DXGI_FORMAT_D32_FLOAT;
+
+	// Next to the assets, only written after something was compiled.
+	static constexpr wchar_t PipelineCacheFile[] = L"cache\\pipelines.ldpc";
+	static constexpr wchar_t ShaderCacheDirectory[] = L"cache\\shaders";
+
+	// Size of the shared upload ring, every staging copy (buffers, textures) is sub-allocated from it.
+	static const UINT64 UploadRingSize = 64 * 1024 * 1024;
+
+	// Constant buffer memory per frame in flight, room for 65536 256-byte draws.
+	static const UINT64 ConstantBufferBytesPerFrame = 16 * 1024 * 1024;
+
+	// CBV / SRV / UAV descriptor budget: long lived views, and per-frame tables.
+	static const UINT PersistentSrvCount = 1024;
+	static const UINT TransientSrvCountPerFrame = 1024;
+
+	// SNORM16 position, UNORM8 color, half uv: 16 bytes instead of 36. The input layout is generated from it.
+	using Vertex = CompactVertexLayout;
 
 	struct SceneConstantBuffer
 	{
@@ -59,45 +86,72 @@ private:
 	ComPtr< ID3D12CommandQueue > m_spCommandQueue;
 	ComPtr< ID3D12DescriptorHeap > m_spRtvHeap;
 	ComPtr< ID3D12DescriptorHeap > m_spDsvHeap;
-	ComPtr< ID3D12DescriptorHeap > m_spSrvHeap;
-	ComPtr< ID3D12CommandAllocator > m_spCommandAllocator[ FrameCount ];
+	DescriptorHeapAllocator m_kSrvHeap;
+	StagingDescriptorHeap m_kStagingSrvHeap;
 	ComPtr< ID3D12CommandAllocator > m_spBundleAllocator;
-	ComPtr< ID3D12GraphicsCommandList > m_spCommandList;
+	ComPtr< ID3D12GraphicsCommandList > m_spCommandList;	// asset uploads, frames go through the recorder.
+	FenceWaiter m_kFenceWaiter;		// every fence wait goes through it, declared before what waits so it is destroyed last.
+	std::unique_ptr< D3D12CommandBackend > m_spCommandBackend;
+	std::unique_ptr< CommandAllocatorPool > m_spCommandAllocatorPool;
+	std::unique_ptr< CommandRecorder > m_spCommandRecorder;
+	std::unique_ptr< DeferredReleaseQueue > m_spDeferredRelease;	// size dependent resources replaced while frames are in flight.
+	ResourceStateCache m_kResourceStates;		// resources that outlive a frame, the render graph imports them.
+	RenderGraph m_kRenderGraph;					// built, compiled and recorded every frame, one list per pass.
+	std::unique_ptr< D3D12RenderGraph > m_spRenderGraphHeaps;
 	ComPtr< ID3D12GraphicsCommandList > m_spBundle;
 	ComPtr< ID3D12PipelineState > m_spPipelineState;
+	std::unique_ptr< PipelineCache > m_spPipelineCache;	// driver blobs of compiled pipelines, kept from run to run.
+	D3DShaderCompiler m_kShaderCompiler;
+	std::unique_ptr< ShaderCache > m_spShaderCache;		// bytecode by source, defines and flags, kept from run to run.
 	ComPtr< ID3D12RootSignature > m_spRootSignature;
 	UINT m_rtvDescriptorSize = 0;
-	UINT m_srvDescriptorSize = 0;
+	UploadRingBuffer m_kUploadRing;
 
 	// Backbuffer / Renderiing resources
 	ComPtr< IDXGISwapChain3 > m_spSwapChain;
-	ComPtr< ID3D12Resource > m_renderTargets[ FrameCount ];
-	ComPtr< ID3D12Resource > m_spDepthStencil;
+	ComPtr< ID3D12Resource > m_renderTargets[ uMaxBackBufferCount ];
+	UINT m_backBufferCount = 0;
 
 	// App resources.
 	ComPtr< ID3D12Resource > m_spVertexBuffer;
 	D3D12_VERTEX_BUFFER_VIEW m_spVertexBufferView = {};
+	QuantizationBounds m_kMeshBounds;
+
+	// The spinning node, with the mesh below it scaled back out of its quantized range.
+	TransformHierarchy m_kTransforms;
+	uint32_t m_spinNode = TransformHierarchy::uInvalidNode;
+	uint32_t m_meshNode = TransformHierarchy::uInvalidNode;
+
+	// Culling, refreshed every OnUpdate.
+	FrustumCuller m_kCuller;
+	std::vector< uint32_t > m_visibleObjects;
 
 	ComPtr< ID3D12Resource > m_spIndexBuffer;
 	D3D12_INDEX_BUFFER_VIEW m_spIndexBufferView = {};
+	UINT m_indexCount = 0;
 
 	// Texture
 	ComPtr< ID3D12Resource > m_spTexture;
+	DescriptorHandle m_textureStagingSrv;
+	DescriptorHandle m_textureSrv;
+	DescriptorHandle m_imGuiFontSrv;
 
 	// Constant Buffer
-	ComPtr< ID3D12Resource > m_spConstantBuffer;
-	D3D12_INDEX_BUFFER_VIEW m_spConstantBufferView = {};
+	ConstantBufferPool m_kConstantBufferPool;
 	SceneConstantBuffer m_kConstantBuffer = {};
-	UINT8* m_pCbvDataBegin = nullptr;
 
 	// Scene State
 	bool m_showDemoWindow = false;
 	DirectX::XMFLOAT4 m_clearColor = { 0.45f, 0.55f, 0.60f, 1.0f };
 
-	// Synchronization objects.
+	// Synchronization objects. m_frameIndex is the FramePacer slot, m_backBufferIndex the swap chain's buffer.
 	UINT m_frameIndex = 0;
-	Event m_fenceEvent = {};
+	UINT m_backBufferIndex = 0;
 	ComPtr < ID3D12Fence > m_spFence;
-	UINT64 m_fenceValue[ FrameCount ] = { 0, 0 };
+	UINT64 m_fenceValue = 0;	// signaled after the next frame.
+	HighResolutionClock m_kPacingClock;
+	std::unique_ptr< FramePacer > m_spFramePacer;
+	Event m_frameLatencyWaitable = {};
+	bool m_bFrameLatencyWaited = false;		// the wait is only consumed by a Present.
 
 };
\ No newline at end of file
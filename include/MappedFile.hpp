@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+
+// Read-only memory mapping of a whole file. Pages are only read in when they are touched, and the mapping stays
+// valid until Close, so whatever points into it has to be done with it by then.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile& operator=( const MappedFile& ) = delete;
+
+	// Returns false when the file can not be opened or is empty.
+	bool Open( const std::filesystem::path& path );
+	void Close();
+
+	bool IsOpen() const { return m_pData != nullptr; }
+	const uint8_t* GetData() const { return m_pData; }
+	uint64_t GetSize() const { return m_size; }
+
+private:
+	const uint8_t* m_pData = nullptr;
+	uint64_t m_size = 0;
+
+#if defined( _WIN32 )
+	void* m_hFile = nullptr;
+	void* m_hMapping = nullptr;
+#endif
+
+};
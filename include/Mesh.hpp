@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Same layout as HelloWindow::Vertex (position, color, uv), without pulling in DirectXMath.
+struct MeshVertex
+{
+	float position[ 3 ];
+	float color[ 4 ];
+	float uv[ 2 ];
+};
+static_assert( sizeof( MeshVertex ) == 36, "MeshVertex has to match the input layout" );
+
+struct MeshData
+{
+	std::vector< MeshVertex > vertices;
+	std::vector< uint32_t > indices;	// triangle list.
+};
+
+// Loads triangle meshes into MeshData, one vertex per face corner (run MeshOptimizer::WeldVertices afterwards).
+// Positions are taken as they are in the file, texture coordinates are flipped to D3D's top-left origin where needed.
+class MeshImporter
+{
+public:
+	// Picks the loader from the extension (.obj, .gltf, .glb). Throws std::runtime_error on malformed files.
+	static MeshData Load( const std::filesystem::path& path );
+
+	// Also reads the common "v x y z r g b" vertex colour extension, faces with more than 3 corners are fanned.
+	static MeshData LoadObj( const std::filesystem::path& path );
+
+	// Every triangle primitive of every mesh, POSITION, COLOR_0 and TEXCOORD_0 only, node transforms are ignored.
+	// Buffers can be external files, data URIs, or the binary chunk of a .glb.
+	static MeshData LoadGltf( const std::filesystem::path& path );
+
+};
+
+struct VertexCacheStats
+{
+	uint32_t transformedVertices = 0;
+	float acmr = 0.0f;	// transformed vertices per triangle, 0.5 is the ideal for a regular grid, 3 the worst.
+	float atvr = 0.0f;	// transformed vertices per unique vertex, 1 is ideal.
+};
+
+class MeshOptimizer
+{
+public:
+	// Merges bitwise identical vertices (hashed), indices are remapped to the survivors.
+	static void WeldVertices( MeshData& kMesh );
+
+	// Reorders the triangles for the post-transform vertex cache, Forsyth's linear-speed algorithm.
+	static void OptimizeVertexCache( std::vector< uint32_t >& indices, size_t vertexCount );
+
+	// Reorders the vertices in the order the index buffer first uses them, unreferenced vertices are dropped.
+	static void OptimizeVertexFetch( MeshData& kMesh );
+
+	// Simulates a FIFO post-transform cache, which is what most hardware behaves like.
+	static VertexCacheStats AnalyzeVertexCache( const std::vector< uint32_t >& indices, size_t vertexCount, uint32_t cacheSize = 16 );
+
+	// Weld, cache and fetch optimization in that order.
+	static void Optimize( MeshData& kMesh );
+
+};
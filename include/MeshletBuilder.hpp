@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Mesh.hpp"
+
+class ThreadPool;
+
+// A cluster of triangles small enough for one mesh shader / culling thread group.
+struct Meshlet
+{
+	uint32_t vertexOffset;		// into MeshletData::vertices.
+	uint32_t triangleOffset;	// into MeshletData::triangles, in bytes.
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+};
+static_assert( sizeof( Meshlet ) == 16, "Meshlet is part of the meshlet buffer format" );
+
+// Culling data, the cluster can be skipped when the sphere is outside the frustum, or when the whole cone faces away:
+//   dot( normalize( coneApex - cameraPosition ), coneAxis ) > coneCutoff
+// A cutoff of 1 means the triangles face too many ways for the test to ever pass.
+struct MeshletBounds
+{
+	float center[ 3 ];
+	float radius;
+	float coneApex[ 3 ];
+	float coneCutoff;
+	float coneAxis[ 3 ];
+	uint32_t reserved;
+};
+static_assert( sizeof( MeshletBounds ) == 48, "MeshletBounds is part of the meshlet buffer format" );
+
+struct MeshletData
+{
+	std::vector< Meshlet > meshlets;
+	std::vector< MeshletBounds > bounds;	// one per meshlet.
+	std::vector< uint32_t > vertices;		// indices into the mesh vertex buffer.
+	std::vector< uint8_t > triangles;		// 3 meshlet-local vertex indices per triangle.
+};
+
+// The defaults are the usual mesh shader recommendation, 64 vertices and 124 triangles.
+struct MeshletBuildOptions
+{
+	uint32_t maxVertices = 64;	// at most 256, local indices are bytes.
+	uint32_t maxTriangles = 124;
+};
+
+struct MeshletFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t meshletCount;
+	uint32_t vertexCount;
+	uint32_t triangleByteCount;
+	uint32_t reserved;
+};
+static_assert( sizeof( MeshletFileHeader ) == 24, "MeshletFileHeader is part of the meshlet buffer format" );
+
+class MeshletBuilder
+{
+public:
+	static constexpr uint32_t uMagic = 0x544C534D; // "MSLT"
+	static constexpr uint32_t uVersion = 1;
+
+	// Greedy: keeps growing the current meshlet with the neighbouring triangle that adds the fewest new vertices,
+	// and starts a new one when the best neighbour no longer fits. The output only depends on the input.
+	static MeshletData Build( const MeshData& kMesh, const MeshletBuildOptions& kOptions = MeshletBuildOptions() );
+
+	// One Build per mesh, spread over the pool. The result is the same as calling Build on each mesh in turn.
+	static std::vector< MeshletData > Build( const std::vector< const MeshData* >& meshes, const MeshletBuildOptions& kOptions, ThreadPool* pPool );
+
+	static MeshletBounds ComputeBounds( const MeshData& kMesh, const MeshletData& kMeshlets, const Meshlet& kMeshlet );
+
+	// Flat little-endian buffer: MeshletFileHeader, meshlets, bounds, vertices, then triangles padded to 4 bytes.
+	// Deserialize throws std::runtime_error when the buffer is truncated or inconsistent.
+	static std::vector< uint8_t > Serialize( const MeshletData& kMeshlets );
+	static MeshletData Deserialize( const uint8_t* pData, size_t size );
+
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+enum class MipFilter
+{
+	Box,	// 2x2 average, fastest.
+	Kaiser,	// 6-tap Kaiser windowed sinc, sharper and less aliasing.
+};
+
+struct MipGenerateOptions
+{
+	MipFilter filter = MipFilter::Kaiser;
+
+	// Texels are sRGB encoded, filter in linear space and encode the result again.
+	bool gammaCorrect = true;
+
+	// Turn off to get the scalar reference path.
+	bool useSimd = true;
+};
+
+struct MipLevel
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	size_t rowPitch = 0;
+	size_t offset = 0;	// into the chain buffer returned by Generate.
+};
+
+// Where GenerateInto writes one level, e.g. its footprint in mapped upload memory.
+struct MipDestination
+{
+	uint8_t* pData = nullptr;
+	size_t rowPitch = 0;
+};
+
+// Builds RGBA8 mip chains on the CPU. Every level is downsampled from the previous one with
+// a separable filter, the rows of a level are spread over the thread pool when one is given.
+class MipGenerator
+{
+public:
+	static uint32_t CountMipLevels( uint32_t width, uint32_t height );
+
+	// Generates levels 1..N-1 from level 0 into `chain` (tightly packed) and returns their layout.
+	static std::vector< MipLevel > Generate( const uint8_t* pLevel0, uint32_t width, uint32_t height, size_t rowPitch,
+											 const MipGenerateOptions& kOptions, std::vector< uint8_t >& chain,
+											 ThreadPool* pPool = nullptr );
+
+	// Like Generate, but level n goes to pLevels[ n - 1 ] for n < levelCount, and is only ever written there, so the
+	// destinations can be write-combined upload memory. The level the next one is filtered from is also encoded into
+	// scratch memory, at most two levels at a time, and copied over row by row while it is in the cache.
+	static void GenerateInto( const uint8_t* pLevel0, uint32_t width, uint32_t height, size_t rowPitch,
+							  const MipGenerateOptions& kOptions, const MipDestination* pLevels, uint32_t levelCount,
+							  ThreadPool* pPool = nullptr );
+
+	// Halve one level, the destination is expected to be max( 1, source / 2 ) in each dimension.
+	static void Downsample( const uint8_t* pSource, uint32_t sourceWidth, uint32_t sourceHeight, size_t sourceRowPitch,
+							uint8_t* pDestination, uint32_t destinationWidth, uint32_t destinationHeight, size_t destinationRowPitch,
+							const MipGenerateOptions& kOptions, ThreadPool* pPool = nullptr );
+
+private:
+	// Downsample, rows are encoded into pKeep first and copied to pDestination from there when it is given.
+	static void DownsampleLevel( const uint8_t* pSource, uint32_t sourceWidth, uint32_t sourceHeight, size_t sourceRowPitch,
+								 uint8_t* pDestination, uint32_t destinationWidth, uint32_t destinationHeight, size_t destinationRowPitch,
+								 uint8_t* pKeep, size_t keepRowPitch, const MipGenerateOptions& kOptions, ThreadPool* pPool );
+
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include "CommandRecorder.hpp"
+
+// Command backend without a GPU, for checking the recorder and timing it anywhere. Lists take plain tokens
+// instead of commands, Execute appends them to a log in submission order, and the fence only moves when
+// Complete says the simulated GPU got that far. Misuse that D3D12 would reject (resetting an allocator the GPU
+// may still read, resetting an open list, executing an open one) throws std::runtime_error.
+class NullCommandBackend : public ICommandBackend
+{
+public:
+	// Stands in for a command, kList must come from this backend.
+	static void Write( ICommandList& kList, uint32_t token );
+
+	std::unique_ptr< ICommandAllocator > CreateAllocator() override;
+	std::unique_ptr< ICommandList > CreateCommandList( ICommandAllocator& kAllocator ) override;
+	void Execute( ICommandList* const* ppLists, uint32_t count, uint64_t fenceValue ) override;
+	uint64_t GetCompletedValue() override { return m_completedValue; }
+	void WaitForFence( uint64_t fenceValue ) override;
+
+	// The simulated GPU finished everything up to fenceValue.
+	void Complete( uint64_t fenceValue );
+
+	const std::vector< uint32_t >& GetExecutedTokens() const { return m_executedTokens; }
+	void ClearExecutedTokens() { m_executedTokens.clear(); }
+	uint32_t GetExecuteCount() const { return m_executeCount; }
+	uint32_t GetWaitCount() const { return m_waitCount; }
+
+private:
+	std::vector< uint32_t > m_executedTokens;
+	uint64_t m_completedValue = 0;
+	uint32_t m_executeCount = 0;
+	uint32_t m_waitCount = 0;
+
+};
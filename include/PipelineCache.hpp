@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Hash.hpp"
+
+class JobCounter;
+class ThreadPool;
+
+// The adapter and driver the cached blobs were made by. Blobs only work on the driver that wrote them, so a file
+// written for anything else is thrown away on Load.
+struct PipelineCacheIdentity
+{
+	uint32_t vendorId = 0;
+	uint32_t deviceId = 0;
+	uint32_t subSysId = 0;
+	uint32_t revision = 0;
+	uint64_t driverVersion = 0;		// the user mode driver version, IDXGIAdapter::CheckInterfaceSupport.
+};
+static_assert( sizeof( PipelineCacheIdentity ) == 24, "PipelineCacheIdentity is part of the file format" );
+
+enum class PipelineCacheLoad : uint32_t
+{
+	Loaded,
+	Missing,		// no file, e.g. the first run.
+	Invalidated,	// another adapter, driver or file version.
+	Corrupt,		// truncated or damaged, e.g. the app died while writing it.
+};
+
+struct PipelineCacheStats
+{
+	uint32_t entries = 0;
+	uint64_t blobBytes = 0;
+	uint32_t hits = 0;			// created from a cached blob.
+	uint32_t misses = 0;		// compiled, nothing was cached.
+	uint32_t rejected = 0;		// compiled, the driver turned the cached blob down.
+};
+
+// A pipeline the cache can create. D3D12GraphicsPipeline wraps a D3D12_GRAPHICS_PIPELINE_STATE_DESC.
+class ICachedPipeline
+{
+public:
+	virtual ~ICachedPipeline() = default;
+
+	// Covers everything the pipeline is created from, see Hasher.
+	virtual uint64_t GetHash() const = 0;
+	// pBlob is what GetCachedBlob returned on an earlier run, nullptr to compile from scratch. Returns false when the
+	// driver turns the blob down, throws on every other failure.
+	virtual bool Create( const void* pBlob, size_t blobSize ) = 0;
+	virtual std::vector< uint8_t > GetCachedBlob() const = 0;
+};
+
+// Driver blobs of compiled pipelines, by pipeline hash, kept in a file from run to run. A pipeline with a blob skips
+// the driver's compiler, which is most of what creating it costs. The cache only speeds things up: whatever goes
+// wrong with the file, Load starts over with an empty cache, and a blob the driver does not take is compiled again.
+// Every method can be called from several threads at once.
+//
+// File layout (.ldpc): a header with the identity and a hash of the payload, then per entry the pipeline hash,
+// the blob size and the blob. Entries are sorted by pipeline hash.
+class PipelineCache
+{
+public:
+	static constexpr uint32_t uMagic = 0x4350444C; // "LDPC"
+	static constexpr uint32_t uVersion = 1;
+
+	explicit PipelineCache( const PipelineCacheIdentity& kIdentity );
+
+	// Replaces what is cached with the file. Anything but Loaded leaves the cache empty, only I/O errors while
+	// reading throw.
+	PipelineCacheLoad Load( const std::filesystem::path& path );
+	// Written next to path first and then moved over it, so a crash never leaves half a file. Throws on I/O errors.
+	void Save( const std::filesystem::path& path );
+	// Something was compiled since the last Load or Save.
+	bool IsDirty() const;
+
+	// Creates kPipeline from its cached blob, or compiles it and keeps the new blob. Throws when it can not be compiled.
+	void Create( ICachedPipeline& kPipeline );
+	// The same on kPool, counted by kCounter. kPipeline has to stay alive until kCounter reaches zero, failures are
+	// rethrown from Wait.
+	void CreateAsync( ICachedPipeline& kPipeline, ThreadPool& kPool, JobCounter& kCounter );
+
+	PipelineCacheStats GetStats() const;
+	const PipelineCacheIdentity& GetIdentity() const { return m_kIdentity; }
+
+private:
+	using Blob = std::shared_ptr< const std::vector< uint8_t > >;
+
+	const PipelineCacheIdentity m_kIdentity;
+	mutable std::mutex m_mutex;		// guards everything below, never held while a pipeline is created.
+	std::unordered_map< uint64_t, Blob > m_blobs;
+	PipelineCacheStats m_kStats;
+	bool m_bDirty = false;
+
+};
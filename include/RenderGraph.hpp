@@ -0,0 +1,175 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class ICommandList;
+
+// Transient resources only share memory with others of the same kind, which is what resource heap tier 1 allows:
+// buffers, render target and depth textures, and every other texture each get a heap of their own.
+enum class RenderGraphHeap : uint32_t
+{
+	Buffers,
+	RenderTargets,
+	Textures,
+	Count
+};
+
+struct RenderGraphResourceDesc
+{
+	uint64_t sizeBytes = 0;			// GetResourceAllocationInfo on D3D12.
+	uint64_t alignment = 65536;		// D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+	RenderGraphHeap heap = RenderGraphHeap::Textures;
+};
+
+enum class RenderGraphBarrierType : uint32_t
+{
+	Transition,		// resource goes from state before to state after.
+	Aliasing,		// resource takes over its memory from resource before, RenderGraph::uInvalidIndex when that is not one resource.
+	Uav,			// resource stays in state before (== after), the pass waits for the UAV accesses of the passes before it.
+};
+
+// Resources are RenderGraph indices and states D3D12_RESOURCE_STATES values, the graph does not look at either.
+struct RenderGraphBarrier
+{
+	RenderGraphBarrierType type;
+	uint32_t resource;
+	uint32_t before;
+	uint32_t after;
+};
+
+struct RenderGraphCompiledPass
+{
+	uint32_t pass;		// what AddPass returned.
+	std::vector< RenderGraphBarrier > barriersBefore;
+	std::vector< RenderGraphBarrier > barriersAfter;
+};
+
+// Where a transient resource lives, for the frame that was compiled.
+struct RenderGraphPlacement
+{
+	uint64_t offset = 0;		// into the heap of its RenderGraphHeap.
+	uint64_t sizeBytes = 0;
+	uint32_t firstPass = 0;		// compiled pass indices, the resource is alive from the first through the last.
+	uint32_t lastPass = 0;
+	uint32_t initialState = 0;	// the state it is created in, every frame hands it over in this state and gets it back in it.
+	bool bUsed = false;			// false when every pass using it was culled, it then needs no memory.
+	bool bAliased = false;		// shares memory with another resource, its first pass starts with an aliasing barrier.
+};
+
+struct RenderGraphHeapLayout
+{
+	uint64_t sizeBytes = 0;
+	uint64_t alignment = 0;		// the largest alignment placed in it.
+};
+
+struct RenderGraphStats
+{
+	uint32_t passes = 0;				// added.
+	uint32_t culledPasses = 0;
+	uint32_t transientResources = 0;	// created and used by a pass that was kept.
+	uint32_t culledResources = 0;		// created but only used by culled passes, or not at all.
+	uint32_t transitions = 0;
+	uint32_t aliasingBarriers = 0;
+	uint32_t uavBarriers = 0;
+	uint64_t transientBytes = 0;		// every used transient resource in memory of its own, like committed resources.
+	uint64_t heapBytes = 0;				// every heap together, with aliasing.
+	uint64_t peakLiveBytes = 0;			// the most bytes alive at the same time per heap, summed. No placement can go below.
+};
+
+// One frame's passes and the resources they read and write. Compile culls the passes nothing depends on, works
+// out every barrier, and packs the transient resources into heaps so resources whose lifetimes do not overlap share
+// memory. Compile only looks at what was declared, the same declarations always give the same result, and nothing
+// in here touches D3D12, D3D12RenderGraph backs the heaps and records the passes. Built again every frame.
+//
+// Passes run in the order they were added, a read sees what the last pass added before it wrote. A write keeps what
+// was in the resource, so every earlier writer of something a kept pass reads or writes is kept as well. What ends
+// up in imported resources is the output, passes that do not contribute to it are culled unless added with side
+// effects. Transient resources have to be written before they are read, and after they take over aliased memory
+// their first pass has to overwrite them completely, e.g. with a clear.
+class RenderGraph
+{
+public:
+	static constexpr uint32_t uInvalidIndex = 0xFFFFFFFF;
+
+	using ExecuteFunction = std::function< void( ICommandList& ) >;
+
+	// Drops every pass and resource.
+	void Reset();
+
+	// A resource that outlives the frame. It is in initialState when the frame starts and has to end up in finalState.
+	// pResource is only kept for whoever executes the graph.
+	uint32_t Import( std::string name, void* pResource, uint32_t initialState, uint32_t finalState );
+	// Memory that only lives from its first to its last use in this frame.
+	uint32_t Create( std::string name, const RenderGraphResourceDesc& kDesc );
+
+	// bSideEffects keeps the pass even when nothing reads what it writes, e.g. readbacks or queries.
+	uint32_t AddPass( std::string name, ExecuteFunction execute, bool bSideEffects = false );
+	// The state the pass uses the resource in. Reads of one resource in one pass are combined, a write has to be the
+	// only state the pass uses it in. Throws std::runtime_error for unknown indices.
+	// bUnorderedAccess marks an access through a UAV. Passes that keep a UAV in the same state get no transition between
+	// them, so a write after any access, and any access after a write, get a UAV barrier instead.
+	void Read( uint32_t pass, uint32_t resource, uint32_t state, bool bUnorderedAccess = false );
+	void Write( uint32_t pass, uint32_t resource, uint32_t state, bool bUnorderedAccess = false );
+
+	// Throws std::runtime_error when a transient resource is read before it is written, or a pass mixes a write with
+	// another state of the same resource.
+	void Compile();
+
+	// In execution order, valid after Compile.
+	const std::vector< RenderGraphCompiledPass >& GetCompiledPasses() const { return m_compiledPasses; }
+	const RenderGraphPlacement& GetPlacement( uint32_t resource ) const { return m_resources.at( resource ).kPlacement; }
+	const RenderGraphHeapLayout& GetHeapLayout( RenderGraphHeap heap ) const { return m_heaps[ static_cast< uint32_t >( heap ) ]; }
+	const RenderGraphStats& GetStats() const { return m_kStats; }
+
+	uint32_t GetResourceCount() const { return static_cast< uint32_t >( m_resources.size() ); }
+	bool IsImported( uint32_t resource ) const { return m_resources.at( resource ).bImported; }
+	void* GetImportedResource( uint32_t resource ) const { return m_resources.at( resource ).pImported; }
+	const RenderGraphResourceDesc& GetResourceDesc( uint32_t resource ) const { return m_resources.at( resource ).kDesc; }
+	const std::string& GetResourceName( uint32_t resource ) const { return m_resources.at( resource ).name; }
+	const std::string& GetPassName( uint32_t pass ) const { return m_passes.at( pass ).name; }
+
+	// Runs what AddPass was given, on whichever thread records the pass.
+	void ExecutePass( uint32_t pass, ICommandList& kList ) const;
+
+private:
+	struct Resource
+	{
+		std::string name;
+		RenderGraphResourceDesc kDesc;
+		void* pImported = nullptr;
+		bool bImported = false;
+		uint32_t initialState = 0;
+		uint32_t finalState = 0;
+		RenderGraphPlacement kPlacement;
+		uint32_t aliasedFrom = uInvalidIndex;	// for the aliasing barrier, set by Compile.
+	};
+
+	struct Access
+	{
+		uint32_t resource;
+		uint32_t state;
+		bool bWrite;
+		bool bUnorderedAccess;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		ExecuteFunction execute;
+		bool bSideEffects = false;
+		std::vector< Access > accesses;
+	};
+
+	void AddAccess( uint32_t pass, uint32_t resource, uint32_t state, bool bWrite, bool bUnorderedAccess );
+	std::vector< uint32_t > CullPasses() const;
+	void PlaceResources( RenderGraphHeap heap );
+
+	std::vector< Resource > m_resources;
+	std::vector< Pass > m_passes;
+	std::vector< RenderGraphCompiledPass > m_compiledPasses;
+	RenderGraphHeapLayout m_heaps[ static_cast< uint32_t >( RenderGraphHeap::Count ) ];
+	RenderGraphStats m_kStats;
+
+};
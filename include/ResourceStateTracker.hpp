@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// States are D3D12_RESOURCE_STATES values and resources their ID3D12Resource pointers, but nothing in here
+// looks at either, so the tracking runs without a GPU.
+struct ResourceBarrierDesc
+{
+	const void* pResource;
+	uint32_t subresource;		// or ResourceStateCache::uAllSubresources.
+	uint32_t before;
+	uint32_t after;
+};
+
+// Receives one batch of transitions per call, D3D12BarrierSink turns it into one ResourceBarrier call.
+class IBarrierSink
+{
+public:
+	virtual ~IBarrierSink() = default;
+
+	virtual void ResourceBarriers( const ResourceBarrierDesc* pBarriers, uint32_t count ) = 0;
+};
+
+// Keeps every batch, for checking what a tracker emitted.
+class RecordingBarrierSink : public IBarrierSink
+{
+public:
+	void ResourceBarriers( const ResourceBarrierDesc* pBarriers, uint32_t count ) override
+	{
+		m_batches.emplace_back( pBarriers, pBarriers + count );
+	}
+
+	const std::vector< std::vector< ResourceBarrierDesc > >& GetBatches() const { return m_batches; }
+	void Clear() { m_batches.clear(); }
+
+private:
+	std::vector< std::vector< ResourceBarrierDesc > > m_batches;
+
+};
+
+// The state every subresource is in once everything submitted so far has executed. Only changed on the submitting
+// thread, by Register / Unregister and ResourceStateTracker::Resolve, never while lists are being recorded.
+class ResourceStateCache
+{
+public:
+	static constexpr uint32_t uAllSubresources = 0xFFFFFFFF;	// D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES
+
+	// With the state it was created in. Registering it again resets its state.
+	void Register( const void* pResource, uint32_t subresourceCount, uint32_t state );
+	void Unregister( const void* pResource );
+	void Clear() { m_states.clear(); }
+
+	bool IsRegistered( const void* pResource ) const { return m_states.count( pResource ) != 0; }
+	// Throws std::runtime_error for resources that were never registered.
+	uint32_t GetSubresourceCount( const void* pResource ) const;
+	uint32_t GetState( const void* pResource, uint32_t subresource ) const;
+
+private:
+	friend class ResourceStateTracker;
+
+	const std::vector< uint32_t >& GetStates( const void* pResource ) const;
+
+	std::unordered_map< const void*, std::vector< uint32_t > > m_states;
+
+};
+
+struct ResourceStateTrackerStats
+{
+	uint32_t transitions = 0;		// Transition calls since Begin.
+	uint32_t barriers = 0;			// barriers that made it into a batch.
+	uint32_t elided = 0;			// transitions to the state the subresource was already in.
+	uint32_t merged = 0;			// transitions folded into one already waiting in the batch, or cancelled by it.
+	uint32_t batches = 0;			// ResourceBarrier calls.
+	uint32_t fixups = 0;			// barriers Resolve put in front of the list.
+};
+
+// Tracks the states one command list leaves its resources in. Transition queues a barrier only when the state
+// changes, back and forth transitions before the next flush cancel out, and FlushBarriers hands everything queued
+// to the sink in one batch, right before the draw or copy that needs it. A list does not know what the lists
+// executed before it leave behind, so the first use of a subresource only records the state it needs, and Resolve
+// turns those into fixup barriers once the lists are submitted in order. One tracker per list, they can record
+// in parallel.
+class ResourceStateTracker
+{
+public:
+	static constexpr uint32_t uAllSubresources = ResourceStateCache::uAllSubresources;
+
+	explicit ResourceStateTracker( ResourceStateCache& kCache );
+
+	// Starts a list. bKnownStart says it is the first one of a submission, nothing else runs before it that is not
+	// in the cache yet, so first uses read the cache and get real barriers instead of fixups.
+	void Begin( bool bKnownStart );
+
+	// The resource has to be registered with the cache.
+	void Transition( const void* pResource, uint32_t state, uint32_t subresource = uAllSubresources );
+
+	// Call before every draw, dispatch or copy that depends on the transitions. Does nothing when none are queued.
+	void FlushBarriers( IBarrierSink& kSink );
+
+	// On the submitting thread, in execution order, after the list was recorded. Returns the barriers that have to
+	// run right before the list, and moves the cache on to the states the list leaves behind.
+	const std::vector< ResourceBarrierDesc >& Resolve();
+
+	const ResourceStateTrackerStats& GetStats() const { return m_kStats; }
+
+private:
+	static constexpr uint32_t uUnknownState = 0xFFFFFFFF;
+
+	struct TrackedResource
+	{
+		std::vector< uint32_t > required;	// per subresource, what the list expects at its start.
+		std::vector< uint32_t > current;	// per subresource, as of the last Transition.
+	};
+
+	TrackedResource& GetResource( const void* pResource );
+	void TransitionSubresource( const void* pResource, TrackedResource& kResource, uint32_t subresource, uint32_t state );
+	void QueueBarrier( const void* pResource, uint32_t subresourceCount, uint32_t subresource, uint32_t before, uint32_t after );
+
+	ResourceStateCache& m_kCache;
+	std::unordered_map< const void*, TrackedResource > m_resources;
+	std::vector< ResourceBarrierDesc > m_pending;
+	std::vector< ResourceBarrierDesc > m_fixups;
+	bool m_bKnownStart = false;
+	ResourceStateTrackerStats m_kStats;
+
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Offset-only ring allocator, it knows nothing about D3D12 so it can be driven by any fence.
+// Allocations made between two FinishFrame calls belong to that frame, and are all reclaimed
+// together once the fence value passed to FinishFrame has been reached by the GPU.
+class RingAllocator
+{
+public:
+	static constexpr uint64_t uInvalidOffset = ~0ull;
+
+	explicit RingAllocator( uint64_t size = 0 );
+
+	void Reset( uint64_t size );
+
+	// Returns the offset of a block of `size` bytes aligned to `alignment` (must be a power of two),
+	// or uInvalidOffset if there is not enough retired space.
+	uint64_t Allocate( uint64_t size, uint64_t alignment );
+
+	// Tag everything allocated since the last call with the fence value signaled after it.
+	void FinishFrame( uint64_t fenceValue );
+
+	// Reclaim the space of every frame whose fence value is <= completedFenceValue.
+	void ReleaseCompletedFrames( uint64_t completedFenceValue );
+
+	uint64_t GetSize() const { return m_size; }
+	uint64_t GetUsedSize() const { return m_usedSize; }
+	uint64_t GetCurrentFrameSize() const { return m_currentFrameSize; }
+	size_t GetPendingFrameCount() const { return m_pendingFrames.size(); }
+	bool IsEmpty() const { return m_usedSize == 0; }
+	bool IsFull() const { return m_usedSize == m_size; }
+
+	static uint64_t AlignUp( uint64_t value, uint64_t alignment ) { return ( value + alignment - 1 ) & ~( alignment - 1 ); }
+
+private:
+	struct PendingFrame
+	{
+		uint64_t fenceValue;
+		uint64_t tail;	// where the frame ended, becomes the new head once it retires.
+		uint64_t size;	// including alignment padding and space wasted at the wrap point.
+	};
+
+	std::deque< PendingFrame > m_pendingFrames;
+	uint64_t m_head;
+	uint64_t m_tail;
+	uint64_t m_size;
+	uint64_t m_usedSize;
+	uint64_t m_currentFrameSize;
+
+};
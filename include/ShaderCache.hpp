@@ -0,0 +1,141 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+
+class ThreadPool;
+
+struct ShaderDefine
+{
+	std::string name;
+	std::string value;
+};
+
+struct ShaderCompileDesc
+{
+	std::filesystem::path sourcePath;
+	std::string entryPoint;
+	std::string target;					// profile, e.g. vs_5_0.
+	std::vector< ShaderDefine > defines;
+	uint32_t flags = 0;					// D3DCOMPILE_* for D3DShaderCompiler.
+};
+
+// A resource the shader binds, from the compiler's reflection.
+struct ShaderBinding
+{
+	std::string name;
+	uint32_t type = 0;			// D3D_SHADER_INPUT_TYPE
+	uint32_t bindPoint = 0;
+	uint32_t bindCount = 0;
+	uint32_t space = 0;
+	uint32_t size = 0;			// constant buffers only, in bytes.
+};
+
+// A file the preprocessor read, with a hash of exactly the bytes it saw, see ShaderCache::HashContents.
+struct ShaderSourceFile
+{
+	std::filesystem::path path;
+	uint64_t size = 0;
+	uint64_t hash = 0;
+};
+
+struct PreprocessedShader
+{
+	std::string source;						// every include and define resolved.
+	std::vector< ShaderSourceFile > files;	// every file that was read, the shader's own first.
+};
+
+// What ShaderCache needs from a compiler. D3DShaderCompiler runs D3DPreprocess and D3DCompile, tools use a stub.
+// Called from several threads at once.
+class IShaderCompiler
+{
+public:
+	virtual ~IShaderCompiler() = default;
+
+	// Changes whenever the same source could compile to different code, it goes into every key.
+	virtual uint64_t GetVersion() const = 0;
+	// Throws std::runtime_error with the compiler's messages on failure.
+	virtual PreprocessedShader Preprocess( const ShaderCompileDesc& kDesc ) = 0;
+	// Compiles what Preprocess returned, the defines are already applied. Throws like Preprocess.
+	virtual void Compile( const ShaderCompileDesc& kDesc, const std::string& source, std::vector< uint8_t >& bytecode,
+						  std::vector< ShaderBinding >& bindings ) = 0;
+};
+
+// Bytecode and bindings of one shader. The bytecode points into the mapped cache file, or into memory of its own
+// when the cache could not be written.
+class CompiledShader
+{
+public:
+	const uint8_t* GetBytecode() const { return m_pBytecode; }
+	size_t GetBytecodeSize() const { return m_bytecodeSize; }
+	const std::vector< ShaderBinding >& GetBindings() const { return m_bindings; }
+	uint64_t GetKey() const { return m_key; }	// of the preprocessed source, shaders with the same key are the same.
+
+private:
+	friend class ShaderCache;
+
+	MappedFile m_kFile;
+	std::vector< uint8_t > m_bytecode;
+	const uint8_t* m_pBytecode = nullptr;
+	size_t m_bytecodeSize = 0;
+	std::vector< ShaderBinding > m_bindings;
+	uint64_t m_key = 0;
+
+};
+
+struct ShaderCacheStats
+{
+	uint32_t hits = 0;				// no file the shader reads changed, nothing was preprocessed.
+	uint32_t preprocessedHits = 0;	// a file changed, the preprocessed source did not, e.g. only comments.
+	uint32_t compiles = 0;
+	uint32_t unwritten = 0;			// compiled, but the cache directory could not take it.
+};
+
+// Compiled shaders in a directory, kept from run to run. Two kinds of files:
+//   <key>.ldsh   bytecode and bindings, by a hash of the preprocessed source, target, entry point and flags.
+//   <key>.ldsm   which .ldsh a description compiled to, by a hash of the description, with every file the
+//                preprocessor read and a hash of its contents.
+// A lookup first checks the files of the .ldsm, which only reads them. When one of them changed the shader is
+// preprocessed, and only compiled when no .ldsh has the preprocessed source. Files are written next to where they
+// go and then moved there, a damaged one is compiled again. Every method can be called from several threads at once.
+class ShaderCache
+{
+public:
+	static constexpr uint32_t uMagic = 0x4853444C;			// "LDSH"
+	static constexpr uint32_t uManifestMagic = 0x4D53444C;	// "LDSM"
+	static constexpr uint32_t uVersion = 1;
+
+	ShaderCache( std::filesystem::path directory, IShaderCompiler& kCompiler );
+
+	// Throws std::runtime_error when the shader does not compile.
+	std::shared_ptr< const CompiledShader > Get( const ShaderCompileDesc& kDesc );
+	// The same on a worker, failures are rethrown from future::get.
+	std::future< std::shared_ptr< const CompiledShader > > GetAsync( ShaderCompileDesc kDesc, ThreadPool& kPool );
+
+	ShaderCacheStats GetStats() const;
+
+	// For ShaderSourceFile::hash.
+	static uint64_t HashContents( const void* pData, size_t size );
+
+private:
+	std::filesystem::path GetPath( uint64_t key, const char* pExtension ) const;
+	bool SourcesChanged( const MappedFile& kManifest, uint64_t descKey, uint64_t& key ) const;
+	std::shared_ptr< CompiledShader > LoadShader( uint64_t key ) const;
+	std::shared_ptr< CompiledShader > StoreShader( uint64_t key, std::vector< uint8_t > bytecode, std::vector< ShaderBinding > bindings );
+	void StoreManifest( uint64_t descKey, const std::vector< ShaderSourceFile >& files, uint64_t key );
+	bool WriteFile( const std::filesystem::path& path, const std::vector< uint8_t >& file );
+
+	const std::filesystem::path m_directory;
+	IShaderCompiler& m_kCompiler;
+	std::atomic< uint32_t > m_nextTemporary{ 0 };
+	mutable std::mutex m_mutex;		// guards m_kStats.
+	ShaderCacheStats m_kStats;
+
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "FenceWaiter.hpp"
+
+// A fence the CPU signals, for running FenceWaiter without a GPU. Like a D3D12 fence the value only goes up,
+// and an event handed to SetEventOnCompletion has to stay alive until it was set or the fence is gone.
+class SoftwareFence : public IWatchedFence
+{
+public:
+	explicit SoftwareFence( uint64_t initialValue = 0 );
+
+	// Any thread. A lower value than the current one is ignored.
+	void Signal( uint64_t value );
+
+	uint64_t GetCompletedValue() override;
+	void SetEventOnCompletion( uint64_t value, FenceEvent& kEvent ) override;
+
+private:
+	std::atomic< uint64_t > m_value;
+	std::mutex m_mutex;
+	std::vector< std::pair< uint64_t, FenceEvent* > > m_events;
+
+};
@@ -2,14 +2,17 @@
 #include <cmath>
 #include <cstdint>
 #include <exception>
-#include <Windows.h>
+#include "Clock.hpp"
+#include "FrameTimeHistogram.hpp"
 
 // copy from DirectXTK12 StepTimer
 
 class StepTimer
 {
 public:
-	StepTimer() noexcept( false ) :
+	// Pass a clock to override the default high resolution one (e.g. a FakeClock for deterministic runs).
+	explicit StepTimer( ClockPtr spClock = nullptr ) noexcept( false ) :
+		m_spClock( spClock ? spClock : std::make_shared< HighResolutionClock >() ),
 		m_elapsedTicks( 0 ),
 		m_totalTicks( 0 ),
 		m_leftOverTicks( 0 ),
@@ -20,18 +23,30 @@ public:
 		m_isFixedTimeStep( false ),
 		m_targetElapsedTicks( uTicksPerSecond / 60 )
 	{
-		if ( !QueryPerformanceFrequency( &m_qpcFrequency ) )
+		m_qpcFrequency = m_spClock->GetFrequency();
+		if ( m_qpcFrequency == 0 )
 		{
 			throw std::exception();
 		}
 
-		if ( !QueryPerformanceCounter( &m_qpcLastTime ) )
+		m_qpcLastTime = m_spClock->GetCounter();
+
+		// Initialize max delta to 1/10 of a second.
+		m_qpcMaxDelta = m_qpcFrequency / 10;
+	}
+
+	// Swap the time source, e.g. to a FakeClock for deterministic runs. Also resets elapsed time.
+	void SetClock( ClockPtr spClock )
+	{
+		m_spClock = spClock ? spClock : std::make_shared< HighResolutionClock >();
+		m_qpcFrequency = m_spClock->GetFrequency();
+		if ( m_qpcFrequency == 0 )
 		{
 			throw std::exception();
 		}
+		m_qpcMaxDelta = m_qpcFrequency / 10;
 
-		// Initialize max delta to 1/10 of a second.
-		m_qpcMaxDelta = static_cast< uint64_t >( m_qpcFrequency.QuadPart / 10 );
+		ResetElapsedTime();
 	}
 
 	// Get elapsed time since the previous Update call.
@@ -48,6 +63,16 @@ public:
 	// Get the current framerate.
 	uint32_t GetFramePerSecond() const noexcept { return m_framePerSecond; }
 
+	// Distribution of every measured frame delta (in ticks, before clamping).
+	// The average above hides stutters, use the percentiles to find them.
+	const FrameTimeHistogram& GetFrameTimeHistogram() const noexcept { return m_frameTimeHistogram; }
+	void ResetFrameTimeHistogram() noexcept { m_frameTimeHistogram.Reset(); }
+	double GetFrameTimePercentileSeconds( double percentile ) const noexcept { return TicksToSeconds( m_frameTimeHistogram.GetPercentile( percentile ) ); }
+	double GetMaxFrameTimeSeconds() const noexcept { return TicksToSeconds( m_frameTimeHistogram.GetMax() ); }
+
+	// Set whether to use fixed or variable timestep mode.
+	void SetFixedTimeStep( bool isFixedTimestep ) noexcept { m_isFixedTimeStep = isFixedTimestep; }
+
 	// Set how often to call Update when in fixed timestep mode.
 	void SetTargetElapsedTicks( uint64_t targetElapsed ) noexcept { m_targetElapsedTicks = targetElapsed; }
 	void SetTargetElapsedSeconds( double targetElapsed ) noexcept { m_targetElapsedTicks = SecondsToTicks( targetElapsed ); }
@@ -62,10 +87,7 @@ public:
 	// call this to avoid having the fixed timstep logic attempt a set of catch-up Update calls.
 	void ResetElapsedTime()
 	{
-		if ( !QueryPerformanceCounter( &m_qpcLastTime ) )
-		{
-			throw std::exception();
-		}
+		m_qpcLastTime = m_spClock->GetCounter();
 
 		m_leftOverTicks = 0;
 		m_framePerSecond = 0;
@@ -78,17 +100,17 @@ public:
 	void Tick( const TUpdate& update )
 	{
 		// Query the current time.
-		LARGE_INTEGER currentTime;
-		if ( !QueryPerformanceCounter( &currentTime ) )
-		{
-			throw std::exception();
-		}
+		const uint64_t currentTime = m_spClock->GetCounter();
 
-		uint64_t timeDelta = static_cast< uint64_t >( currentTime.QuadPart - m_qpcLastTime.QuadPart );
+		uint64_t timeDelta = currentTime - m_qpcLastTime;
 
 		m_qpcLastTime = currentTime;
 		m_qpcSecondCounter += timeDelta;
 
+		// Record the real delta, long frames are exactly what the histogram is for.
+		// Split the conversion so it cannot overflow before the clamp below.
+		m_frameTimeHistogram.Record( ( timeDelta / m_qpcFrequency ) * uTicksPerSecond + ( timeDelta % m_qpcFrequency ) * uTicksPerSecond / m_qpcFrequency );
+
 		// Clamp excessively large time deltas (e.g. after pause in the debugger).
 		if ( timeDelta > m_qpcMaxDelta )
 		{
@@ -97,7 +119,7 @@ public:
 
 		// Convert QPC uints into a canonical tick foramt. This cannot overflow due to the previous clamp.
 		timeDelta *= uTicksPerSecond;
-		timeDelta /= static_cast< uint64_t >( m_qpcFrequency.QuadPart );
+		timeDelta /= m_qpcFrequency;
 
 		const uint32_t lastFrameCount = m_frameCount;
 		if ( m_isFixedTimeStep )
@@ -145,18 +167,20 @@ public:
 			m_frameThisSecond++;
 		}
 
-		if ( m_qpcSecondCounter >= static_cast< uint64_t >( m_qpcFrequency.QuadPart ) )
+		if ( m_qpcSecondCounter >= m_qpcFrequency )
 		{
 			m_framePerSecond = m_frameThisSecond;
 			m_frameThisSecond = 0;
-			m_qpcSecondCounter %= static_cast< uint64_t >( m_qpcFrequency.QuadPart );
+			m_qpcSecondCounter %= m_qpcFrequency;
 		}
 	}
 
 private:
-	// Source timing data use QPC units.
-	LARGE_INTEGER m_qpcFrequency;
-	LARGE_INTEGER m_qpcLastTime;
+	ClockPtr m_spClock;
+
+	// Source timing data use clock units (QPC units on Windows).
+	uint64_t m_qpcFrequency;
+	uint64_t m_qpcLastTime;
 	uint64_t m_qpcMaxDelta;
 
 	// Derived timing data use a canonical tick format.
@@ -173,4 +197,7 @@ private:
 	// Member for configuring fixed timestep mode.
 	bool m_isFixedTimeStep;
 	uint64_t m_targetElapsedTicks;
+
+	// Member for frame time distribution.
+	FrameTimeHistogram m_frameTimeHistogram;
 };
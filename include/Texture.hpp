@@ -3,17 +3,104 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <future>
+#include <atomic>
+#include "MipGenerator.hpp"
+#include "BlockCompressor.hpp"
 
 class Texture2D;
 typedef std::shared_ptr< Texture2D > Texture2DPtr;
+class ThreadPool;
+
+struct TextureDecodeStats
+{
+	uint64_t imageCount = 0;
+	uint64_t decodedBytes = 0;
+
+	// Summed over all workers, so it is CPU time rather than wall time.
+	double decodeSeconds = 0.0;
+	double mipSeconds = 0.0;
+	double compressSeconds = 0.0;
+
+	// What DecodeTexture2DInto copied into its destinations on top of what the stages wrote there themselves: the top
+	// level when it is not compressed, stb_image only decodes into a buffer of its own, and mip rows kept for the
+	// next level. CreateTexture2D copies nothing, whoever uploads its levels does.
+	uint64_t copiedBytes = 0;
+};
+
+struct TextureLoadOptions
+{
+	bool generateMips = true;
+	MipGenerateOptions mipOptions;
+
+	// Block compress every level. Skipped when the top level is not a multiple of 4, D3D12 requires that for BC.
+	bool compress = false;
+	BlockCompressOptions compressOptions;
+};
+
+// What DecodeTexture2DInto is going to write, known from the file header before decoding.
+struct Texture2DInfo
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t mipCount = 1;
+	bool compressed = false;
+	BlockFormat blockFormat = BlockFormat::BC7;
+};
+
+// One level of the texture, e.g. its footprint in mapped upload memory. Rows of blocks when compressed.
+struct Texture2DDestination
+{
+	uint8_t* pData = nullptr;
+	size_t rowPitch = 0;
+};
 
 class TextureManager
 {
 public:
-	static Texture2DPtr CreateTexture2D( const std::wstring& filename );
+	// Mip rows and block rows are split over pJobs when given, otherwise everything runs on the calling thread.
+	static Texture2DPtr CreateTexture2D( const std::wstring& filename, const TextureLoadOptions& kOptions = TextureLoadOptions(), ThreadPool* pJobs = nullptr );
+
+	// Decode on the job system, mips and compression too. Decode errors are rethrown from future::get.
+	static std::future< Texture2DPtr > CreateTexture2DAsync( const std::wstring& filename, ThreadPool& kJobs, const TextureLoadOptions& kOptions = TextureLoadOptions() );
+
+	// Decode every file concurrently and wait for all of them, results keep the input order.
+	static std::vector< Texture2DPtr > CreateTextures2D( const std::vector< std::wstring >& filenames, ThreadPool& kJobs, const TextureLoadOptions& kOptions = TextureLoadOptions() );
+
+	// Reads only the header, so the resource and its upload space can be set up before decoding starts.
+	static Texture2DInfo GetTexture2DInfo( const std::wstring& filename, const TextureLoadOptions& kOptions = TextureLoadOptions() );
+
+	// The last stage writes every level straight into destinations, one per mip level: the blocks when compressing,
+	// otherwise the mip levels. Destinations are only written, never read. Levels that are still needed on the CPU,
+	// to filter or compress the next ones from, live in scratch memory that is freed level by level.
+	// Throws std::runtime_error when the file no longer matches kInfo.
+	static void DecodeTexture2DInto( const std::wstring& filename, const Texture2DInfo& kInfo, const std::vector< Texture2DDestination >& destinations,
+									 const TextureLoadOptions& kOptions = TextureLoadOptions(), ThreadPool* pJobs = nullptr );
+	static std::future< void > DecodeTexture2DIntoAsync( const std::wstring& filename, const Texture2DInfo& kInfo, std::vector< Texture2DDestination > destinations,
+														 ThreadPool& kJobs, const TextureLoadOptions& kOptions = TextureLoadOptions() );
+
+	static TextureDecodeStats GetDecodeStats();
+	static void ResetDecodeStats();
+
+private:
+	static std::atomic< uint64_t > s_decodedImages;
+	static std::atomic< uint64_t > s_decodedBytes;
+	static std::atomic< uint64_t > s_decodeNanoseconds;
+	static std::atomic< uint64_t > s_mipNanoseconds;
+	static std::atomic< uint64_t > s_compressNanoseconds;
+	static std::atomic< uint64_t > s_copiedBytes;
 
 };
 
+struct Texture2DMip
+{
+	size_t width = 0;
+	size_t height = 0;
+	size_t rowPitch = 0;	// per row of blocks when compressed.
+	size_t slicePitch = 0;
+	const uint8_t* pData = nullptr;
+};
+
 class Texture2D
 {
 public:
@@ -28,4 +115,13 @@ public:
 
 	uint8_t* data;
 
+	// Every level including the top one (which points at data), the rest live in mipChain.
+	// Compressed textures point every level into compressedData instead.
+	std::vector< Texture2DMip > mips;
+	std::vector< uint8_t > mipChain;
+
+	bool compressed = false;
+	BlockFormat blockFormat = BlockFormat::BC7;
+	std::vector< uint8_t > compressedData;
+
 };
\ No newline at end of file
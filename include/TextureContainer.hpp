@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include "MappedFile.hpp"
+
+// Pre-cooked texture file (.ldxt). Layout:
+//   TextureFileHeader
+//   TextureFileSubresource[ mipCount * arraySize ]	(D3D12 subresource order, mips of slice 0 first)
+//   payload at header.payloadOffset
+// Every row in the payload is already padded to the D3D12 row pitch alignment and every subresource
+// starts on the placement alignment, so the payload can be copied into an upload buffer as is.
+enum class TextureFileFormat : uint32_t
+{
+	RGBA8 = 0,
+	BC1 = 1,
+	BC3 = 2,
+	BC5 = 3,
+	BC7 = 4,
+};
+
+struct TextureFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	TextureFileFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipCount;
+	uint32_t arraySize;
+	uint32_t reserved;
+	uint64_t payloadOffset;	// from the start of the file.
+	uint64_t payloadSize;
+};
+static_assert( sizeof( TextureFileHeader ) == 48, "TextureFileHeader is part of the file format" );
+
+struct TextureFileSubresource
+{
+	uint32_t width;		// in texels.
+	uint32_t height;
+	uint32_t rowCount;	// rows of texels, or rows of blocks for BC.
+	uint32_t rowBytes;	// bytes of real data per row, the rest of the pitch is padding.
+	uint32_t rowPitch;
+	uint32_t reserved;
+	uint64_t offset;	// from the start of the payload.
+	uint64_t size;
+};
+static_assert( sizeof( TextureFileSubresource ) == 40, "TextureFileSubresource is part of the file format" );
+
+// One level handed to the writer, rows tightly packed or not, the writer repacks them.
+struct TextureFileLevel
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	size_t rowPitch = 0;
+	const uint8_t* pData = nullptr;
+};
+
+class TextureContainer
+{
+public:
+	static constexpr uint32_t uMagic = 0x5458444C; // "LDXT"
+	static constexpr uint32_t uVersion = 1;
+
+	// Same values as D3D12_TEXTURE_DATA_PITCH_ALIGNMENT / D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT,
+	// kept here so the cooker does not need the D3D12 headers.
+	static constexpr uint32_t uRowPitchAlignment = 256;
+	static constexpr uint32_t uPlacementAlignment = 512;
+
+	static bool IsBlockCompressed( TextureFileFormat format ) { return format != TextureFileFormat::RGBA8; }
+	static uint32_t GetBytesPerUnit( TextureFileFormat format );	// per texel, or per 4x4 block.
+
+	// `levels` are in subresource order, mipCount * arraySize of them. Throws on I/O errors.
+	static void Write( const std::filesystem::path& path, TextureFileFormat format, uint32_t mipCount, uint32_t arraySize,
+					   const std::vector< TextureFileLevel >& levels );
+
+};
+
+// Read-only memory mapping of a .ldxt file. Nothing is decoded or copied, the accessors point into the mapping.
+class MappedTextureFile
+{
+public:
+	// Returns false when the file can not be opened, throws when it is not a valid container.
+	bool Open( const std::filesystem::path& path );
+	void Close() { m_kFile.Close(); }
+
+	bool IsOpen() const { return m_kFile.IsOpen(); }
+
+	const TextureFileHeader& GetHeader() const { return *reinterpret_cast< const TextureFileHeader* >( m_kFile.GetData() ); }
+	uint32_t GetSubresourceCount() const { return GetHeader().mipCount * GetHeader().arraySize; }
+	const TextureFileSubresource& GetSubresource( uint32_t index ) const;
+
+	const uint8_t* GetPayload() const { return m_kFile.GetData() + GetHeader().payloadOffset; }
+	uint64_t GetPayloadSize() const { return GetHeader().payloadSize; }
+
+private:
+	void Validate() const;
+
+	MappedFile m_kFile;
+
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct PoolJob;
+
+// Counts unfinished jobs. Pass it to ThreadPool::Run to wait on a group of jobs, or as the dependency
+// of jobs that must not start before the group is done. Can be reused once it reaches zero.
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter( const JobCounter& ) = delete;
+	JobCounter& operator=( const JobCounter& ) = delete;
+
+	bool IsDone() const { return m_pending.load( std::memory_order_acquire ) == 0; }
+
+private:
+	friend class ThreadPool;
+
+	std::atomic< uint32_t > m_pending{ 0 };
+	std::mutex m_mutex;						// guards the last decrement, m_waiting and m_exception.
+	std::vector< PoolJob* > m_waiting;		// jobs that depend on this counter.
+	std::exception_ptr m_exception;
+
+};
+
+// Fixed set of worker threads with work stealing. Every worker, and the thread that created the pool, has its own
+// Chase-Lev deque: the owner pushes and pops at the bottom, idle threads steal the oldest job from the top.
+// Other threads hand their jobs over through one shared queue.
+class ThreadPool
+{
+public:
+	// 0 means one worker per hardware thread.
+	explicit ThreadPool( uint32_t threadCount = 0 );
+	~ThreadPool();
+
+	ThreadPool( const ThreadPool& ) = delete;
+	ThreadPool& operator=( const ThreadPool& ) = delete;
+
+	// Run `task` on the pool. pCounter is bumped now and dropped when `task` returns, `task` only starts once
+	// pDependency has reached zero. An exception thrown by `task` is rethrown from Wait( *pCounter ),
+	// without a counter `task` must not throw.
+	void Run( std::function< void() > task, JobCounter* pCounter = nullptr, JobCounter* pDependency = nullptr );
+
+	// Runs queued jobs on the calling thread until kCounter reaches zero, then rethrows the first exception of its jobs.
+	void Wait( JobCounter& kCounter );
+
+	// Run `task` on a worker, exceptions thrown by it are rethrown from future::get.
+	template< typename TTask >
+	auto Submit( TTask&& task ) -> std::future< decltype( task() ) >
+	{
+		using TResult = decltype( task() );
+		auto spTask = std::make_shared< std::packaged_task< TResult() > >( std::forward< TTask >( task ) );
+		std::future< TResult > result = spTask->get_future();
+		Run( [ spTask ]() { ( *spTask )(); } );
+		return result;
+	}
+
+	// Split [0, count) into chunks of `grainSize` and run `body( begin, end )` on them in parallel.
+	// The calling thread works on chunks too, so this is safe to call from inside a pool task.
+	// The first exception thrown by `body` is rethrown once every chunk has finished.
+	void ParallelFor( uint32_t count, uint32_t grainSize, const std::function< void( uint32_t, uint32_t ) >& body );
+
+	uint32_t GetThreadCount() const { return static_cast< uint32_t >( m_workers.size() ); }
+
+private:
+	struct WorkQueue;
+
+	WorkQueue* GetLocalQueue() const;
+	void Push( PoolJob* pJob );
+	PoolJob* FindJob( WorkQueue* pLocal, uint32_t& victim );
+	bool HasWork() const;
+	void Execute( PoolJob* pJob );
+	void Finish( JobCounter& kCounter );
+	void WorkerLoop( uint32_t queueIndex );
+
+	std::vector< std::thread > m_workers;
+	std::vector< std::unique_ptr< WorkQueue > > m_queues;	// [ 0 ] belongs to the owner thread, [ n + 1 ] to worker n.
+	std::thread::id m_ownerThread;
+
+	// Jobs from threads without a queue, and the idle workers sleeping on m_condition.
+	std::deque< PoolJob* > m_injected;
+	std::atomic< uint32_t > m_injectedCount{ 0 };
+	std::atomic< uint32_t > m_sleeping{ 0 };
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_bStopping;
+
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+class ThreadPool;
+
+struct TransformUpdateOptions
+{
+	uint32_t parallelThreshold = 1u << 12;	// levels with fewer nodes than this are updated on the calling thread.
+	uint32_t grainSize = 1u << 10;			// nodes per task above the threshold.
+};
+
+// Scene graph transforms kept as structure of arrays, sorted by depth so every parent comes before its children.
+// Setting a local transform only flags the node, Update recomputes the world matrix of flagged nodes and of
+// everything below them one level at a time, and skips whole levels nothing changed in.
+// World matrices are row vectors ( v * M ) like the rest of DirectXMath, world = local * parent world.
+class TransformHierarchy
+{
+public:
+	static constexpr uint32_t uInvalidNode = 0xFFFFFFFF;
+
+	void Clear();
+	void Reserve( uint32_t count );
+	uint32_t GetNodeCount() const { return static_cast< uint32_t >( m_slotOfNode.size() ); }
+	uint32_t GetDepthCount() const { return static_cast< uint32_t >( m_levelBegin.size() ) - 1; }
+
+	// `parent` is uInvalidNode for a root, otherwise a node added before. Returns the node index, it never changes.
+	uint32_t AddNode( uint32_t parent, const DirectX::XMFLOAT3& kTranslation, const DirectX::XMFLOAT4& kRotation, const DirectX::XMFLOAT3& kScale );
+	uint32_t AddNode( uint32_t parent );
+
+	// Rotation is a quaternion. The local matrix is scale, then rotation, then translation.
+	void SetLocal( uint32_t node, const DirectX::XMFLOAT3& kTranslation, const DirectX::XMFLOAT4& kRotation, const DirectX::XMFLOAT3& kScale );
+	void SetTranslation( uint32_t node, const DirectX::XMFLOAT3& kTranslation );
+	void SetRotation( uint32_t node, const DirectX::XMFLOAT4& kRotation );
+	void SetScale( uint32_t node, const DirectX::XMFLOAT3& kScale );
+
+	// With pTransposedOut, the transposed world matrix of node n (ready for HLSL) is written to
+	// pTransposedOut + n * stride for every node, changed or not, e.g. straight into this frame's upload memory.
+	// Returns how many world matrices were recomputed.
+	uint32_t Update( ThreadPool* pPool = nullptr, void* pTransposedOut = nullptr, size_t stride = sizeof( DirectX::XMFLOAT4X4 ), const TransformUpdateOptions& kOptions = TransformUpdateOptions() );
+
+	// Valid after Update.
+	const DirectX::XMFLOAT4X4& GetWorld( uint32_t node ) const { return m_world[ m_slotOfNode[ node ] ]; }
+
+private:
+	void MarkDirty( uint32_t slot );
+	void SortByDepth();
+	uint32_t UpdateRange( uint32_t begin, uint32_t end, bool bParentLevelChanged, uint8_t* pTransposedOut, size_t stride );
+
+	// Per slot, in depth order.
+	std::vector< DirectX::XMFLOAT3 > m_translation;
+	std::vector< DirectX::XMFLOAT4 > m_rotation;
+	std::vector< DirectX::XMFLOAT3 > m_scale;
+	std::vector< uint32_t > m_parentSlot;
+	std::vector< uint32_t > m_nodeOfSlot;
+	std::vector< uint8_t > m_dirty;			// set: local changed, then during Update: world changed.
+	std::vector< DirectX::XMFLOAT4X4 > m_world;
+
+	// Per node.
+	std::vector< uint32_t > m_slotOfNode;
+	std::vector< uint32_t > m_depth;
+
+	// Slots of depth d are [m_levelBegin[ d ], m_levelBegin[ d + 1 ]).
+	std::vector< uint32_t > m_levelBegin = { 0 };
+	std::vector< uint8_t > m_levelDirty;
+	bool m_bSorted = true;
+
+};
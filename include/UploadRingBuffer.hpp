@@ -0,0 +1,40 @@
+#pragma once
+#include "stdafx.hpp"
+#include "RingAllocator.hpp"
+
+struct UploadAllocation
+{
+	ID3D12Resource* pResource = nullptr;
+	uint64_t offset = 0;
+	uint8_t* pCpuAddress = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+};
+
+// One large, persistently mapped upload buffer shared by every upload.
+// Space is handed out by a RingAllocator and given back once the frame's fence has passed.
+class UploadRingBuffer
+{
+public:
+	UploadRingBuffer() = default;
+	~UploadRingBuffer();
+
+	void Create( ID3D12Device* pDevice, uint64_t size );
+	void Destroy();
+
+	// Throws when the ring has no retired space left for the request.
+	UploadAllocation Allocate( uint64_t size, uint64_t alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT );
+	UploadAllocation AllocateConstantBuffer( uint64_t size ) { return Allocate( size, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT ); }
+
+	void FinishFrame( uint64_t fenceValue ) { m_kAllocator.FinishFrame( fenceValue ); }
+	void Retire( uint64_t completedFenceValue ) { m_kAllocator.ReleaseCompletedFrames( completedFenceValue ); }
+
+	ID3D12Resource* GetResource() const { return m_spBuffer.Get(); }
+	const RingAllocator& GetAllocator() const { return m_kAllocator; }
+
+private:
+	Microsoft::WRL::ComPtr< ID3D12Resource > m_spBuffer;
+	uint8_t* m_pMappedData = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS m_gpuAddress = 0;
+	RingAllocator m_kAllocator;
+
+};
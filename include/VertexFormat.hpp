@@ -0,0 +1,287 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Mesh.hpp"
+
+// Formats a vertex attribute can be stored in. HelloWindow maps them to DXGI, so this header stays portable.
+enum class VertexElementFormat : uint32_t
+{
+	Float2,
+	Float3,
+	Float4,
+	Half2,		// R16G16_FLOAT
+	Unorm8x4,	// R8G8B8A8_UNORM
+	Snorm16x2,	// R16G16_SNORM
+	Snorm16x4,	// R16G16B16A16_SNORM
+};
+
+// One entry of a generated input layout.
+struct VertexAttribute
+{
+	const char* pSemanticName;
+	uint32_t semanticIndex;
+	VertexElementFormat format;
+	uint32_t offset;
+};
+
+// Quantized positions are stored relative to the mesh bounds: position = center + snorm * extent.
+// The vertex shader does not need to know, the extent and center fold into the model matrix.
+struct QuantizationBounds
+{
+	float center[ 3 ] = { 0.0f, 0.0f, 0.0f };
+	float extent[ 3 ] = { 1.0f, 1.0f, 1.0f };
+};
+
+class VertexQuantizer
+{
+public:
+	static QuantizationBounds ComputeBounds( const std::vector< MeshVertex >& vertices );
+
+	// Round to nearest even, out of range values turn into infinity like the hardware conversion.
+	static uint16_t FloatToHalf( float value );
+	static float HalfToFloat( uint16_t value );
+
+	static int16_t FloatToSnorm16( float value );
+	static float Snorm16ToFloat( int16_t value ) { return value < -32767 ? -1.0f : value / 32767.0f; }
+	static uint8_t FloatToUnorm8( float value );
+	static float Unorm8ToFloat( uint8_t value ) { return value / 255.0f; }
+
+	// Unit vector <-> [-1, 1]^2, the lower hemisphere is folded over the diagonals.
+	static void EncodeOctahedral( const float normal[ 3 ], float encoded[ 2 ] );
+	static void DecodeOctahedral( const float encoded[ 2 ], float normal[ 3 ] );
+
+};
+
+// Vertex elements, each one knows its semantic, its format, and how to pack it from / unpack it to a source vertex.
+// The source only needs the members an element reads (position, color, uv, normal), so TVertex does not have to be MeshVertex.
+namespace VertexElement
+{
+	struct PositionFloat3
+	{
+		static constexpr const char* pSemantic = "POSITION";
+		static constexpr VertexElementFormat format = VertexElementFormat::Float3;
+		static constexpr uint32_t uSize = 12;
+
+		template< typename TVertex >
+		static void Pack( const TVertex& kVertex, const QuantizationBounds&, uint8_t* pDest )
+		{
+			memcpy( pDest, kVertex.position, uSize );
+		}
+
+		template< typename TVertex >
+		static void Unpack( const uint8_t* pSource, const QuantizationBounds&, TVertex& kVertex )
+		{
+			memcpy( kVertex.position, pSource, uSize );
+		}
+	};
+
+	// The fourth component is padding, SNORM16x3 is not a vertex format.
+	struct PositionSnorm16
+	{
+		static constexpr const char* pSemantic = "POSITION";
+		static constexpr VertexElementFormat format = VertexElementFormat::Snorm16x4;
+		static constexpr uint32_t uSize = 8;
+
+		template< typename TVertex >
+		static void Pack( const TVertex& kVertex, const QuantizationBounds& kBounds, uint8_t* pDest )
+		{
+			int16_t packed[ 4 ] = {};
+			for ( uint32_t n = 0; n < 3; ++n )
+			{
+				packed[ n ] = VertexQuantizer::FloatToSnorm16( ( kVertex.position[ n ] - kBounds.center[ n ] ) / kBounds.extent[ n ] );
+			}
+			memcpy( pDest, packed, uSize );
+		}
+
+		template< typename TVertex >
+		static void Unpack( const uint8_t* pSource, const QuantizationBounds& kBounds, TVertex& kVertex )
+		{
+			int16_t packed[ 4 ];
+			memcpy( packed, pSource, uSize );
+			for ( uint32_t n = 0; n < 3; ++n )
+			{
+				kVertex.position[ n ] = kBounds.center[ n ] + VertexQuantizer::Snorm16ToFloat( packed[ n ] ) * kBounds.extent[ n ];
+			}
+		}
+	};
+
+	struct ColorFloat4
+	{
+		static constexpr const char* pSemantic = "COLOR";
+		static constexpr VertexElementFormat format = VertexElementFormat::Float4;
+		static constexpr uint32_t uSize = 16;
+
+		template< typename TVertex >
+		static void Pack( const TVertex& kVertex, const QuantizationBounds&, uint8_t* pDest )
+		{
+			memcpy( pDest, kVertex.color, uSize );
+		}
+
+		template< typename TVertex >
+		static void Unpack( const uint8_t* pSource, const QuantizationBounds&, TVertex& kVertex )
+		{
+			memcpy( kVertex.color, pSource, uSize );
+		}
+	};
+
+	struct ColorUnorm8
+	{
+		static constexpr const char* pSemantic = "COLOR";
+		static constexpr VertexElementFormat format = VertexElementFormat::Unorm8x4;
+		static constexpr uint32_t uSize = 4;
+
+		template< typename TVertex >
+		static void Pack( const TVertex& kVertex, const QuantizationBounds&, uint8_t* pDest )
+		{
+			for ( uint32_t n = 0; n < 4; ++n )
+			{
+				pDest[ n ] = VertexQuantizer::FloatToUnorm8( kVertex.color[ n ] );
+			}
+		}
+
+		template< typename TVertex >
+		static void Unpack( const uint8_t* pSource, const QuantizationBounds&, TVertex& kVertex )
+		{
+			for ( uint32_t n = 0; n < 4; ++n )
+			{
+				kVertex.color[ n ] = VertexQuantizer::Unorm8ToFloat( pSource[ n ] );
+			}
+		}
+	};
+
+	struct TexCoordFloat2
+	{
+		static constexpr const char* pSemantic = "TEXCOORD";
+		static constexpr VertexElementFormat format = VertexElementFormat::Float2;
+		static constexpr uint32_t uSize = 8;
+
+		template< typename TVertex >
+		static void Pack( const TVertex& kVertex, const QuantizationBounds&, uint8_t* pDest )
+		{
+			memcpy( pDest, kVertex.uv, uSize );
+		}
+
+		template< typename TVertex >
+		static void Unpack( const uint8_t* pSource, const QuantizationBounds&, TVertex& kVertex )
+		{
+			memcpy( kVertex.uv, pSource, uSize );
+		}
+	};
+
+	// Exact enough for [0, 1] uvs on textures up to 2048 texels, tiling uvs lose precision away from 0.
+	struct TexCoordHalf2
+	{
+		static constexpr const char* pSemantic = "TEXCOORD";
+		static constexpr VertexElementFormat format = VertexElementFormat::Half2;
+		static constexpr uint32_t uSize = 4;
+
+		template< typename TVertex >
+		static void Pack( const TVertex& kVertex, const QuantizationBounds&, uint8_t* pDest )
+		{
+			const uint16_t packed[ 2 ] = { VertexQuantizer::FloatToHalf( kVertex.uv[ 0 ] ), VertexQuantizer::FloatToHalf( kVertex.uv[ 1 ] ) };
+			memcpy( pDest, packed, uSize );
+		}
+
+		template< typename TVertex >
+		static void Unpack( const uint8_t* pSource, const QuantizationBounds&, TVertex& kVertex )
+		{
+			uint16_t packed[ 2 ];
+			memcpy( packed, pSource, uSize );
+			kVertex.uv[ 0 ] = VertexQuantizer::HalfToFloat( packed[ 0 ] );
+			kVertex.uv[ 1 ] = VertexQuantizer::HalfToFloat( packed[ 1 ] );
+		}
+	};
+
+	struct NormalFloat3
+	{
+		static constexpr const char* pSemantic = "NORMAL";
+		static constexpr VertexElementFormat format = VertexElementFormat::Float3;
+		static constexpr uint32_t uSize = 12;
+
+		template< typename TVertex >
+		static void Pack( const TVertex& kVertex, const QuantizationBounds&, uint8_t* pDest )
+		{
+			memcpy( pDest, kVertex.normal, uSize );
+		}
+
+		template< typename TVertex >
+		static void Unpack( const uint8_t* pSource, const QuantizationBounds&, TVertex& kVertex )
+		{
+			memcpy( kVertex.normal, pSource, uSize );
+		}
+	};
+
+	// The vertex shader reads a float2 and has to decode it, same math as VertexQuantizer::DecodeOctahedral.
+	struct NormalOctahedral
+	{
+		static constexpr const char* pSemantic = "NORMAL";
+		static constexpr VertexElementFormat format = VertexElementFormat::Snorm16x2;
+		static constexpr uint32_t uSize = 4;
+
+		template< typename TVertex >
+		static void Pack( const TVertex& kVertex, const QuantizationBounds&, uint8_t* pDest )
+		{
+			float encoded[ 2 ];
+			VertexQuantizer::EncodeOctahedral( kVertex.normal, encoded );
+			const int16_t packed[ 2 ] = { VertexQuantizer::FloatToSnorm16( encoded[ 0 ] ), VertexQuantizer::FloatToSnorm16( encoded[ 1 ] ) };
+			memcpy( pDest, packed, uSize );
+		}
+
+		template< typename TVertex >
+		static void Unpack( const uint8_t* pSource, const QuantizationBounds&, TVertex& kVertex )
+		{
+			int16_t packed[ 2 ];
+			memcpy( packed, pSource, uSize );
+			const float encoded[ 2 ] = { VertexQuantizer::Snorm16ToFloat( packed[ 0 ] ), VertexQuantizer::Snorm16ToFloat( packed[ 1 ] ) };
+			VertexQuantizer::DecodeOctahedral( encoded, kVertex.normal );
+		}
+	};
+}
+
+// Interleaved vertex made of the given elements in order. The stride and the input layout are worked out at compile time,
+// so the packing code and the layout the PSO sees can not drift apart.
+template< typename... TElements >
+class VertexLayout
+{
+public:
+	static constexpr uint32_t uStride = ( TElements::uSize + ... );
+	static constexpr uint32_t uAttributeCount = sizeof...( TElements );
+
+	static constexpr std::array< VertexAttribute, uAttributeCount > GetAttributes()
+	{
+		std::array< VertexAttribute, uAttributeCount > attributes = {};
+		uint32_t index = 0;
+		uint32_t offset = 0;
+		( ( attributes[ index++ ] = VertexAttribute{ TElements::pSemantic, 0, TElements::format, offset }, offset += TElements::uSize ), ... );
+		return attributes;
+	}
+
+	// `pDest` receives count * uStride bytes, it can be mapped upload memory.
+	template< typename TVertex >
+	static void Pack( const TVertex* pVertices, size_t count, const QuantizationBounds& kBounds, uint8_t* pDest )
+	{
+		for ( size_t n = 0; n < count; ++n, pDest += uStride )
+		{
+			uint32_t offset = 0;
+			( ( TElements::Pack( pVertices[ n ], kBounds, pDest + offset ), offset += TElements::uSize ), ... );
+		}
+	}
+
+	template< typename TVertex >
+	static void Unpack( const uint8_t* pSource, const QuantizationBounds& kBounds, TVertex& kVertex )
+	{
+		uint32_t offset = 0;
+		( ( TElements::Unpack( pSource + offset, kBounds, kVertex ), offset += TElements::uSize ), ... );
+	}
+
+};
+
+// What MeshVertex maps to with and without quantization.
+using FullVertexLayout = VertexLayout< VertexElement::PositionFloat3, VertexElement::ColorFloat4, VertexElement::TexCoordFloat2 >;
+using CompactVertexLayout = VertexLayout< VertexElement::PositionSnorm16, VertexElement::ColorUnorm8, VertexElement::TexCoordHalf2 >;
+
+static_assert( FullVertexLayout::uStride == sizeof( MeshVertex ), "FullVertexLayout has to match MeshVertex" );
+static_assert( CompactVertexLayout::uStride == 16, "CompactVertexLayout should be 16 bytes" );
+static_assert( CompactVertexLayout::GetAttributes()[ 2 ].offset == 12, "Attribute offsets are generated in declaration order" );
@@ -0,0 +1,896 @@
+#include "BlockCompressor.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined( _M_X64 ) || defined( _M_AMD64 ) || defined( __SSE2__ )
+#define BLOCKCOMP_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	constexpr uint32_t kBlockTexels = 16;
+
+	// Channel major so 4 texels of one channel can be loaded at once.
+	struct Block
+	{
+		float channels[ 4 ][ kBlockTexels ];
+	};
+
+	// Up to 16 entries (BC7 4-bit indices), 4 channels each.
+	struct Palette
+	{
+		float colors[ 16 ][ 4 ];
+		uint32_t count;
+	};
+
+	void LoadBlock( const uint8_t* pSource, uint32_t width, uint32_t height, size_t rowPitch, uint32_t blockX, uint32_t blockY, Block& kBlock )
+	{
+		for ( uint32_t y = 0; y < 4; ++y )
+		{
+			const uint32_t sourceY = std::min( blockY * 4 + y, height - 1 );
+			const uint8_t* pRow = pSource + sourceY * rowPitch;
+			for ( uint32_t x = 0; x < 4; ++x )
+			{
+				const uint8_t* pTexel = pRow + std::min( blockX * 4 + x, width - 1 ) * 4;
+				for ( uint32_t c = 0; c < 4; ++c )
+				{
+					kBlock.channels[ c ][ y * 4 + x ] = pTexel[ c ];
+				}
+			}
+		}
+	}
+
+	// Picks the nearest palette entry for every texel over channels [first, first + count), returns the summed squared error.
+	float SelectIndices( const Block& kBlock, uint32_t firstChannel, uint32_t channelCount, const Palette& kPalette, bool useSimd, uint8_t* pIndices )
+	{
+#if BLOCKCOMP_SSE
+		if ( useSimd )
+		{
+			__m128 total = _mm_setzero_ps();
+			for ( uint32_t t = 0; t < kBlockTexels; t += 4 )
+			{
+				__m128 best = _mm_set1_ps( FLT_MAX );
+				__m128i bestIndex = _mm_setzero_si128();
+				for ( uint32_t e = 0; e < kPalette.count; ++e )
+				{
+					__m128 distance = _mm_setzero_ps();
+					for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+					{
+						const __m128 difference = _mm_sub_ps( _mm_loadu_ps( kBlock.channels[ c ] + t ), _mm_set1_ps( kPalette.colors[ e ][ c ] ) );
+						distance = _mm_add_ps( distance, _mm_mul_ps( difference, difference ) );
+					}
+
+					const __m128i closer = _mm_castps_si128( _mm_cmplt_ps( distance, best ) );
+					best = _mm_min_ps( best, distance );
+					bestIndex = _mm_or_si128( _mm_and_si128( closer, _mm_set1_epi32( static_cast< int >( e ) ) ), _mm_andnot_si128( closer, bestIndex ) );
+				}
+
+				total = _mm_add_ps( total, best );
+				alignas( 16 ) int32_t indices[ 4 ];
+				_mm_store_si128( reinterpret_cast< __m128i* >( indices ), bestIndex );
+				for ( uint32_t n = 0; n < 4; ++n )
+				{
+					pIndices[ t + n ] = static_cast< uint8_t >( indices[ n ] );
+				}
+			}
+
+			alignas( 16 ) float sums[ 4 ];
+			_mm_store_ps( sums, total );
+			return sums[ 0 ] + sums[ 1 ] + sums[ 2 ] + sums[ 3 ];
+		}
+#else
+		( void ) useSimd;
+#endif
+		float total = 0.0f;
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			float best = FLT_MAX;
+			uint8_t bestIndex = 0;
+			for ( uint32_t e = 0; e < kPalette.count; ++e )
+			{
+				float distance = 0.0f;
+				for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+				{
+					const float difference = kBlock.channels[ c ][ t ] - kPalette.colors[ e ][ c ];
+					distance += difference * difference;
+				}
+				if ( distance < best )
+				{
+					best = distance;
+					bestIndex = static_cast< uint8_t >( e );
+				}
+			}
+			total += best;
+			pIndices[ t ] = bestIndex;
+		}
+		return total;
+	}
+
+	// Initial endpoints: the bounding box diagonal (Fast) or the extent along the principal axis (High).
+	void FindEndpoints( const Block& kBlock, uint32_t firstChannel, uint32_t channelCount, BlockQuality quality, float* pLow, float* pHigh )
+	{
+		float mean[ 4 ] = {};
+		float minimum[ 4 ] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+		float maximum[ 4 ] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+		{
+			for ( uint32_t t = 0; t < kBlockTexels; ++t )
+			{
+				const float value = kBlock.channels[ c ][ t ];
+				mean[ c ] += value;
+				minimum[ c ] = std::min( minimum[ c ], value );
+				maximum[ c ] = std::max( maximum[ c ], value );
+			}
+			mean[ c ] /= kBlockTexels;
+		}
+
+		if ( quality == BlockQuality::Fast || channelCount == 1 )
+		{
+			// Pull the box in a little, the extremes are usually outliers and this halves the error of the interpolants.
+			for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+			{
+				const float inset = channelCount == 1 ? 0.0f : ( maximum[ c ] - minimum[ c ] ) / 16.0f;
+				pLow[ c ] = minimum[ c ] + inset;
+				pHigh[ c ] = maximum[ c ] - inset;
+			}
+			return;
+		}
+
+		float covariance[ 4 ][ 4 ] = {};
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			for ( uint32_t i = firstChannel; i < firstChannel + channelCount; ++i )
+			{
+				for ( uint32_t j = firstChannel; j < firstChannel + channelCount; ++j )
+				{
+					covariance[ i ][ j ] += ( kBlock.channels[ i ][ t ] - mean[ i ] ) * ( kBlock.channels[ j ][ t ] - mean[ j ] );
+				}
+			}
+		}
+
+		// Power iteration from the box diagonal, converges in a handful of steps for 3-4 dimensions.
+		float axis[ 4 ] = {};
+		for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+		{
+			axis[ c ] = maximum[ c ] - minimum[ c ];
+		}
+		for ( uint32_t iteration = 0; iteration < 8; ++iteration )
+		{
+			float next[ 4 ] = {};
+			float length = 0.0f;
+			for ( uint32_t i = firstChannel; i < firstChannel + channelCount; ++i )
+			{
+				for ( uint32_t j = firstChannel; j < firstChannel + channelCount; ++j )
+				{
+					next[ i ] += covariance[ i ][ j ] * axis[ j ];
+				}
+				length = std::max( length, std::fabs( next[ i ] ) );
+			}
+			if ( length <= 0.0f )
+			{
+				break;
+			}
+			for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+			{
+				axis[ c ] = next[ c ] / length;
+			}
+		}
+
+		float axisLengthSquared = 0.0f;
+		for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+		{
+			axisLengthSquared += axis[ c ] * axis[ c ];
+		}
+		if ( axisLengthSquared <= 0.0f )
+		{
+			// Flat block.
+			for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+			{
+				pLow[ c ] = pHigh[ c ] = mean[ c ];
+			}
+			return;
+		}
+
+		float lowest = FLT_MAX;
+		float highest = -FLT_MAX;
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			float projection = 0.0f;
+			for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+			{
+				projection += ( kBlock.channels[ c ][ t ] - mean[ c ] ) * axis[ c ];
+			}
+			lowest = std::min( lowest, projection );
+			highest = std::max( highest, projection );
+		}
+
+		for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+		{
+			pLow[ c ] = std::min( std::max( mean[ c ] + axis[ c ] * lowest / axisLengthSquared, 0.0f ), 255.0f );
+			pHigh[ c ] = std::min( std::max( mean[ c ] + axis[ c ] * highest / axisLengthSquared, 0.0f ), 255.0f );
+		}
+	}
+
+	// Given the indices, solve for the endpoints that minimise the squared error.
+	// `pWeights[ index ]` is how far along low -> high that palette entry sits.
+	bool RefineEndpoints( const Block& kBlock, uint32_t firstChannel, uint32_t channelCount, const uint8_t* pIndices, const float* pWeights, float* pLow, float* pHigh )
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[ 4 ] = {};
+		float bx[ 4 ] = {};
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			const float b = pWeights[ pIndices[ t ] ];
+			const float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+			{
+				ax[ c ] += a * kBlock.channels[ c ][ t ];
+				bx[ c ] += b * kBlock.channels[ c ][ t ];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if ( std::fabs( determinant ) < 1e-6f )
+		{
+			return false;
+		}
+
+		for ( uint32_t c = firstChannel; c < firstChannel + channelCount; ++c )
+		{
+			pLow[ c ] = std::min( std::max( ( ax[ c ] * bb - bx[ c ] * ab ) / determinant, 0.0f ), 255.0f );
+			pHigh[ c ] = std::min( std::max( ( bx[ c ] * aa - ax[ c ] * ab ) / determinant, 0.0f ), 255.0f );
+		}
+		return true;
+	}
+
+	// Little endian bit stream, at most 128 bits.
+	class BitWriter
+	{
+	public:
+		explicit BitWriter( uint8_t* pOut ) : m_pOut( pOut ), m_position( 0 )
+		{
+			memset( m_pOut, 0, 16 );
+		}
+
+		void Write( uint32_t value, uint32_t bitCount )
+		{
+			for ( uint32_t n = 0; n < bitCount; ++n, ++m_position )
+			{
+				m_pOut[ m_position >> 3 ] |= static_cast< uint8_t >( ( ( value >> n ) & 1 ) << ( m_position & 7 ) );
+			}
+		}
+
+	private:
+		uint8_t* m_pOut;
+		uint32_t m_position;
+
+	};
+
+	class BitReader
+	{
+	public:
+		explicit BitReader( const uint8_t* pIn ) : m_pIn( pIn ), m_position( 0 ) {}
+
+		uint32_t Read( uint32_t bitCount )
+		{
+			uint32_t value = 0;
+			for ( uint32_t n = 0; n < bitCount; ++n, ++m_position )
+			{
+				value |= static_cast< uint32_t >( ( m_pIn[ m_position >> 3 ] >> ( m_position & 7 ) ) & 1 ) << n;
+			}
+			return value;
+		}
+
+	private:
+		const uint8_t* m_pIn;
+		uint32_t m_position;
+
+	};
+
+	// ---- BC1 ----
+
+	uint16_t PackRgb565( const float* pColor )
+	{
+		const uint32_t r = static_cast< uint32_t >( pColor[ 0 ] * 31.0f / 255.0f + 0.5f );
+		const uint32_t g = static_cast< uint32_t >( pColor[ 1 ] * 63.0f / 255.0f + 0.5f );
+		const uint32_t b = static_cast< uint32_t >( pColor[ 2 ] * 31.0f / 255.0f + 0.5f );
+		return static_cast< uint16_t >( ( r << 11 ) | ( g << 5 ) | b );
+	}
+
+	void UnpackRgb565( uint16_t packed, uint32_t* pColor )
+	{
+		const uint32_t r = ( packed >> 11 ) & 31;
+		const uint32_t g = ( packed >> 5 ) & 63;
+		const uint32_t b = packed & 31;
+		pColor[ 0 ] = ( r << 3 ) | ( r >> 2 );
+		pColor[ 1 ] = ( g << 2 ) | ( g >> 4 );
+		pColor[ 2 ] = ( b << 3 ) | ( b >> 2 );
+	}
+
+	// Four colour mode palette, shared by the encoder and the decoder so both agree on rounding.
+	void Bc1Palette( uint16_t color0, uint16_t color1, uint32_t palette[ 4 ][ 3 ] )
+	{
+		UnpackRgb565( color0, palette[ 0 ] );
+		UnpackRgb565( color1, palette[ 1 ] );
+		for ( uint32_t c = 0; c < 3; ++c )
+		{
+			palette[ 2 ][ c ] = ( 2 * palette[ 0 ][ c ] + palette[ 1 ][ c ] + 1 ) / 3;
+			palette[ 3 ][ c ] = ( palette[ 0 ][ c ] + 2 * palette[ 1 ][ c ] + 1 ) / 3;
+		}
+	}
+
+	void EncodeBc1( const Block& kBlock, const BlockCompressOptions& kOptions, uint8_t* pOut )
+	{
+		// Palette order is 0 = color0, 1 = color1, 2 and 3 the interpolants.
+		static const float s_weights[ 4 ] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		float high[ 4 ] = {};
+		float low[ 4 ] = {};
+		FindEndpoints( kBlock, 0, 3, kOptions.quality, low, high );
+
+		const uint32_t iterations = kOptions.quality == BlockQuality::High ? 3 : 1;
+		float bestError = FLT_MAX;
+		uint16_t bestColor0 = 0, bestColor1 = 0;
+		uint8_t bestIndices[ kBlockTexels ] = {};
+		for ( uint32_t iteration = 0; iteration < iterations; ++iteration )
+		{
+			uint16_t color0 = PackRgb565( high );
+			uint16_t color1 = PackRgb565( low );
+			if ( color0 < color1 )
+			{
+				std::swap( color0, color1 );
+			}
+
+			uint8_t indices[ kBlockTexels ] = {};
+			float error = 0.0f;
+			if ( color0 != color1 )
+			{
+				uint32_t colors[ 4 ][ 3 ];
+				Bc1Palette( color0, color1, colors );
+
+				Palette kPalette = {};
+				kPalette.count = 4;
+				for ( uint32_t e = 0; e < 4; ++e )
+				{
+					for ( uint32_t c = 0; c < 3; ++c )
+					{
+						kPalette.colors[ e ][ c ] = static_cast< float >( colors[ e ][ c ] );
+					}
+				}
+				error = SelectIndices( kBlock, 0, 3, kPalette, kOptions.useSimd, indices );
+			}
+			else
+			{
+				// color0 == color1 switches to three colour mode, index 0 is still color0.
+				uint32_t colors[ 4 ][ 3 ];
+				UnpackRgb565( color0, colors[ 0 ] );
+				for ( uint32_t t = 0; t < kBlockTexels; ++t )
+				{
+					for ( uint32_t c = 0; c < 3; ++c )
+					{
+						const float difference = kBlock.channels[ c ][ t ] - colors[ 0 ][ c ];
+						error += difference * difference;
+					}
+				}
+			}
+
+			if ( error < bestError )
+			{
+				bestError = error;
+				bestColor0 = color0;
+				bestColor1 = color1;
+				memcpy( bestIndices, indices, sizeof( indices ) );
+			}
+
+			if ( iteration + 1 < iterations )
+			{
+				// Refine in terms of the packed order, color0 is the `high` end.
+				uint32_t unpacked[ 2 ][ 3 ];
+				UnpackRgb565( color0, unpacked[ 0 ] );
+				UnpackRgb565( color1, unpacked[ 1 ] );
+				for ( uint32_t c = 0; c < 3; ++c )
+				{
+					high[ c ] = static_cast< float >( unpacked[ 0 ][ c ] );
+					low[ c ] = static_cast< float >( unpacked[ 1 ][ c ] );
+				}
+				if ( color0 == color1 || !RefineEndpoints( kBlock, 0, 3, indices, s_weights, high, low ) )
+				{
+					break;
+				}
+			}
+		}
+
+		uint32_t packedIndices = 0;
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			packedIndices |= static_cast< uint32_t >( bestIndices[ t ] ) << ( t * 2 );
+		}
+		memcpy( pOut, &bestColor0, 2 );
+		memcpy( pOut + 2, &bestColor1, 2 );
+		memcpy( pOut + 4, &packedIndices, 4 );
+	}
+
+	void DecodeBc1( const uint8_t* pIn, uint8_t* pTexels, size_t rowPitch, bool alwaysFourColors )
+	{
+		uint16_t color0, color1;
+		uint32_t packedIndices;
+		memcpy( &color0, pIn, 2 );
+		memcpy( &color1, pIn + 2, 2 );
+		memcpy( &packedIndices, pIn + 4, 4 );
+
+		uint32_t palette[ 4 ][ 3 ];
+		Bc1Palette( color0, color1, palette );
+		uint32_t alpha[ 4 ] = { 255, 255, 255, 255 };
+		if ( color0 <= color1 && !alwaysFourColors )
+		{
+			for ( uint32_t c = 0; c < 3; ++c )
+			{
+				palette[ 2 ][ c ] = ( palette[ 0 ][ c ] + palette[ 1 ][ c ] ) / 2;
+				palette[ 3 ][ c ] = 0;
+			}
+			alpha[ 3 ] = 0;
+		}
+
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			const uint32_t index = ( packedIndices >> ( t * 2 ) ) & 3;
+			uint8_t* pTexel = pTexels + ( t / 4 ) * rowPitch + ( t % 4 ) * 4;
+			pTexel[ 0 ] = static_cast< uint8_t >( palette[ index ][ 0 ] );
+			pTexel[ 1 ] = static_cast< uint8_t >( palette[ index ][ 1 ] );
+			pTexel[ 2 ] = static_cast< uint8_t >( palette[ index ][ 2 ] );
+			pTexel[ 3 ] = static_cast< uint8_t >( alpha[ index ] );
+		}
+	}
+
+	// ---- BC4 (alpha of BC3, both halves of BC5) ----
+
+	// Eight value mode when endpoint0 > endpoint1, otherwise six values plus 0 and 255.
+	void Bc4Palette( uint32_t endpoint0, uint32_t endpoint1, uint32_t palette[ 8 ] )
+	{
+		palette[ 0 ] = endpoint0;
+		palette[ 1 ] = endpoint1;
+		if ( endpoint0 > endpoint1 )
+		{
+			for ( uint32_t k = 2; k < 8; ++k )
+			{
+				palette[ k ] = ( ( 8 - k ) * endpoint0 + ( k - 1 ) * endpoint1 + 3 ) / 7;
+			}
+		}
+		else
+		{
+			for ( uint32_t k = 2; k < 6; ++k )
+			{
+				palette[ k ] = ( ( 6 - k ) * endpoint0 + ( k - 1 ) * endpoint1 + 2 ) / 5;
+			}
+			palette[ 6 ] = 0;
+			palette[ 7 ] = 255;
+		}
+	}
+
+	float TryBc4( const Block& kBlock, uint32_t channel, uint32_t endpoint0, uint32_t endpoint1, bool useSimd, uint8_t* pIndices )
+	{
+		uint32_t values[ 8 ];
+		Bc4Palette( endpoint0, endpoint1, values );
+
+		Palette kPalette = {};
+		kPalette.count = 8;
+		for ( uint32_t e = 0; e < 8; ++e )
+		{
+			kPalette.colors[ e ][ channel ] = static_cast< float >( values[ e ] );
+		}
+		return SelectIndices( kBlock, channel, 1, kPalette, useSimd, pIndices );
+	}
+
+	void EncodeBc4( const Block& kBlock, uint32_t channel, const BlockCompressOptions& kOptions, uint8_t* pOut )
+	{
+		float minimum = 255.0f, maximum = 0.0f;
+		float innerMinimum = 255.0f, innerMaximum = 0.0f;
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			const float value = kBlock.channels[ channel ][ t ];
+			minimum = std::min( minimum, value );
+			maximum = std::max( maximum, value );
+			if ( value > 0.0f && value < 255.0f )
+			{
+				innerMinimum = std::min( innerMinimum, value );
+				innerMaximum = std::max( innerMaximum, value );
+			}
+		}
+
+		uint32_t bestEndpoint0 = static_cast< uint32_t >( maximum );
+		uint32_t bestEndpoint1 = static_cast< uint32_t >( minimum );
+		uint8_t bestIndices[ kBlockTexels ];
+		float bestError = TryBc4( kBlock, channel, bestEndpoint0, bestEndpoint1, kOptions.useSimd, bestIndices );
+
+		if ( kOptions.quality == BlockQuality::High && bestError > 0.0f )
+		{
+			auto Consider = [ & ]( uint32_t endpoint0, uint32_t endpoint1 )
+			{
+				uint8_t indices[ kBlockTexels ];
+				const float error = TryBc4( kBlock, channel, endpoint0, endpoint1, kOptions.useSimd, indices );
+				if ( error < bestError )
+				{
+					bestError = error;
+					bestEndpoint0 = endpoint0;
+					bestEndpoint1 = endpoint1;
+					memcpy( bestIndices, indices, sizeof( indices ) );
+				}
+			};
+
+			// Six value mode, 0 and 255 come for free so the endpoints only need to span the rest.
+			if ( innerMinimum <= innerMaximum )
+			{
+				Consider( static_cast< uint32_t >( innerMinimum ), static_cast< uint32_t >( innerMaximum ) );
+			}
+
+			// Least squares on the eight value mode, then nudge the endpoints inwards.
+			static const float s_weights[ 8 ] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+			for ( uint32_t iteration = 0; iteration < 2 && bestEndpoint0 > bestEndpoint1; ++iteration )
+			{
+				float low[ 4 ] = {}, high[ 4 ] = {};
+				if ( !RefineEndpoints( kBlock, channel, 1, bestIndices, s_weights, high, low ) )
+				{
+					break;
+				}
+				const uint32_t endpoint0 = static_cast< uint32_t >( high[ channel ] + 0.5f );
+				const uint32_t endpoint1 = static_cast< uint32_t >( low[ channel ] + 0.5f );
+				if ( endpoint0 <= endpoint1 )
+				{
+					break;
+				}
+				Consider( endpoint0, endpoint1 );
+			}
+			for ( uint32_t step = 1; step <= 4; ++step )
+			{
+				const uint32_t endpoint0 = bestEndpoint0 > step ? bestEndpoint0 - step : 0;
+				const uint32_t endpoint1 = std::min( bestEndpoint1 + step, 255u );
+				if ( endpoint0 > endpoint1 )
+				{
+					Consider( endpoint0, endpoint1 );
+				}
+			}
+		}
+
+		pOut[ 0 ] = static_cast< uint8_t >( bestEndpoint0 );
+		pOut[ 1 ] = static_cast< uint8_t >( bestEndpoint1 );
+		uint64_t packedIndices = 0;
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			packedIndices |= static_cast< uint64_t >( bestIndices[ t ] ) << ( t * 3 );
+		}
+		for ( uint32_t n = 0; n < 6; ++n )
+		{
+			pOut[ 2 + n ] = static_cast< uint8_t >( packedIndices >> ( n * 8 ) );
+		}
+	}
+
+	void DecodeBc4( const uint8_t* pIn, uint8_t* pTexels, size_t rowPitch, uint32_t channel )
+	{
+		uint32_t palette[ 8 ];
+		Bc4Palette( pIn[ 0 ], pIn[ 1 ], palette );
+		uint64_t packedIndices = 0;
+		for ( uint32_t n = 0; n < 6; ++n )
+		{
+			packedIndices |= static_cast< uint64_t >( pIn[ 2 + n ] ) << ( n * 8 );
+		}
+
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			const uint32_t index = static_cast< uint32_t >( packedIndices >> ( t * 3 ) ) & 7;
+			pTexels[ ( t / 4 ) * rowPitch + ( t % 4 ) * 4 + channel ] = static_cast< uint8_t >( palette[ index ] );
+		}
+	}
+
+	// ---- BC7 mode 6 ----
+
+	const uint32_t s_bc7Weights4[ 16 ] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	inline uint32_t Bc7Interpolate( uint32_t endpoint0, uint32_t endpoint1, uint32_t weight )
+	{
+		return ( ( 64 - weight ) * endpoint0 + weight * endpoint1 + 32 ) >> 6;
+	}
+
+	// 7 bits per channel plus a p-bit shared by the whole endpoint.
+	void QuantizeBc7Endpoint( const float* pColor, uint32_t pBit, uint32_t* pQuantized )
+	{
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			const int32_t value = static_cast< int32_t >( std::floor( ( pColor[ c ] - pBit ) * 0.5f + 0.5f ) );
+			pQuantized[ c ] = static_cast< uint32_t >( std::min( std::max( value, 0 ), 127 ) );
+		}
+	}
+
+	float EndpointError( const float* pColor, const uint32_t* pQuantized, uint32_t pBit )
+	{
+		float error = 0.0f;
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			const float difference = pColor[ c ] - static_cast< float >( ( pQuantized[ c ] << 1 ) | pBit );
+			error += difference * difference;
+		}
+		return error;
+	}
+
+	struct Bc7Candidate
+	{
+		uint32_t endpoints[ 2 ][ 4 ];	// 7-bit.
+		uint32_t pBits[ 2 ];
+		uint8_t indices[ kBlockTexels ];
+		float error;
+	};
+
+	void EvaluateBc7( const Block& kBlock, bool useSimd, Bc7Candidate& kCandidate )
+	{
+		Palette kPalette = {};
+		kPalette.count = 16;
+		for ( uint32_t e = 0; e < 16; ++e )
+		{
+			for ( uint32_t c = 0; c < 4; ++c )
+			{
+				const uint32_t endpoint0 = ( kCandidate.endpoints[ 0 ][ c ] << 1 ) | kCandidate.pBits[ 0 ];
+				const uint32_t endpoint1 = ( kCandidate.endpoints[ 1 ][ c ] << 1 ) | kCandidate.pBits[ 1 ];
+				kPalette.colors[ e ][ c ] = static_cast< float >( Bc7Interpolate( endpoint0, endpoint1, s_bc7Weights4[ e ] ) );
+			}
+		}
+		kCandidate.error = SelectIndices( kBlock, 0, 4, kPalette, useSimd, kCandidate.indices );
+	}
+
+	void EncodeBc7( const Block& kBlock, const BlockCompressOptions& kOptions, uint8_t* pOut )
+	{
+		static const float s_weights[ 16 ] =
+		{
+			0.0f / 64, 4.0f / 64, 9.0f / 64, 13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64, 30.0f / 64,
+			34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 64.0f / 64
+		};
+
+		float endpoints[ 2 ][ 4 ] = {};
+		FindEndpoints( kBlock, 0, 4, kOptions.quality, endpoints[ 0 ], endpoints[ 1 ] );
+
+		const bool bHigh = kOptions.quality == BlockQuality::High;
+		Bc7Candidate kBest = {};
+		kBest.error = FLT_MAX;
+		for ( uint32_t iteration = 0; iteration < ( bHigh ? 3u : 1u ); ++iteration )
+		{
+			// Fast picks each p-bit on its own, High tries all four combinations against the real index error.
+			for ( uint32_t combination = 0; combination < ( bHigh ? 4u : 1u ); ++combination )
+			{
+				Bc7Candidate kCandidate = {};
+				for ( uint32_t e = 0; e < 2; ++e )
+				{
+					if ( bHigh )
+					{
+						kCandidate.pBits[ e ] = ( combination >> e ) & 1;
+						QuantizeBc7Endpoint( endpoints[ e ], kCandidate.pBits[ e ], kCandidate.endpoints[ e ] );
+						continue;
+					}
+
+					uint32_t quantized[ 2 ][ 4 ];
+					QuantizeBc7Endpoint( endpoints[ e ], 0, quantized[ 0 ] );
+					QuantizeBc7Endpoint( endpoints[ e ], 1, quantized[ 1 ] );
+					const uint32_t pBit = EndpointError( endpoints[ e ], quantized[ 1 ], 1 ) < EndpointError( endpoints[ e ], quantized[ 0 ], 0 ) ? 1 : 0;
+					kCandidate.pBits[ e ] = pBit;
+					memcpy( kCandidate.endpoints[ e ], quantized[ pBit ], sizeof( quantized[ pBit ] ) );
+				}
+
+				EvaluateBc7( kBlock, kOptions.useSimd, kCandidate );
+				if ( kCandidate.error < kBest.error )
+				{
+					kBest = kCandidate;
+				}
+			}
+
+			if ( kBest.error <= 0.0f || iteration + 1 == ( bHigh ? 3u : 1u ) || !RefineEndpoints( kBlock, 0, 4, kBest.indices, s_weights, endpoints[ 0 ], endpoints[ 1 ] ) )
+			{
+				break;
+			}
+		}
+
+		// The anchor (texel 0) index is stored with 3 bits, so its top bit has to be 0.
+		if ( kBest.indices[ 0 ] & 8 )
+		{
+			std::swap( kBest.endpoints[ 0 ], kBest.endpoints[ 1 ] );
+			std::swap( kBest.pBits[ 0 ], kBest.pBits[ 1 ] );
+			for ( uint32_t t = 0; t < kBlockTexels; ++t )
+			{
+				kBest.indices[ t ] = static_cast< uint8_t >( 15 - kBest.indices[ t ] );
+			}
+		}
+
+		BitWriter kWriter( pOut );
+		kWriter.Write( 1 << 6, 7 );
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			kWriter.Write( kBest.endpoints[ 0 ][ c ], 7 );
+			kWriter.Write( kBest.endpoints[ 1 ][ c ], 7 );
+		}
+		kWriter.Write( kBest.pBits[ 0 ], 1 );
+		kWriter.Write( kBest.pBits[ 1 ], 1 );
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			kWriter.Write( kBest.indices[ t ], t == 0 ? 3 : 4 );
+		}
+	}
+
+	void DecodeBc7( const uint8_t* pIn, uint8_t* pTexels, size_t rowPitch )
+	{
+		BitReader kReader( pIn );
+		if ( kReader.Read( 7 ) != ( 1 << 6 ) )
+		{
+			// Not mode 6, decode as the error colour.
+			for ( uint32_t t = 0; t < kBlockTexels; ++t )
+			{
+				memset( pTexels + ( t / 4 ) * rowPitch + ( t % 4 ) * 4, 0, 4 );
+			}
+			return;
+		}
+
+		uint32_t endpoints[ 2 ][ 4 ];
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			endpoints[ 0 ][ c ] = kReader.Read( 7 ) << 1;
+			endpoints[ 1 ][ c ] = kReader.Read( 7 ) << 1;
+		}
+		const uint32_t pBit0 = kReader.Read( 1 );
+		const uint32_t pBit1 = kReader.Read( 1 );
+		for ( uint32_t c = 0; c < 4; ++c )
+		{
+			endpoints[ 0 ][ c ] |= pBit0;
+			endpoints[ 1 ][ c ] |= pBit1;
+		}
+
+		for ( uint32_t t = 0; t < kBlockTexels; ++t )
+		{
+			const uint32_t index = kReader.Read( t == 0 ? 3 : 4 );
+			uint8_t* pTexel = pTexels + ( t / 4 ) * rowPitch + ( t % 4 ) * 4;
+			for ( uint32_t c = 0; c < 4; ++c )
+			{
+				pTexel[ c ] = static_cast< uint8_t >( Bc7Interpolate( endpoints[ 0 ][ c ], endpoints[ 1 ][ c ], s_bc7Weights4[ index ] ) );
+			}
+		}
+	}
+}
+
+size_t BlockCompressor::GetBlockBytes( BlockFormat format )
+{
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t BlockCompressor::GetRowPitch( BlockFormat format, uint32_t width )
+{
+	return static_cast< size_t >( ( width + 3 ) / 4 ) * GetBlockBytes( format );
+}
+
+size_t BlockCompressor::GetCompressedSize( BlockFormat format, uint32_t width, uint32_t height )
+{
+	return GetRowPitch( format, width ) * ( ( height + 3 ) / 4 );
+}
+
+void BlockCompressor::Compress( const uint8_t* pSource, uint32_t width, uint32_t height, size_t rowPitch,
+								const BlockCompressOptions& kOptions, uint8_t* pDestination, size_t destinationRowPitch,
+								ThreadPool* pPool )
+{
+	const uint32_t blocksWide = ( width + 3 ) / 4;
+	const uint32_t blocksHigh = ( height + 3 ) / 4;
+	const size_t blockBytes = GetBlockBytes( kOptions.format );
+
+	auto CompressRows = [ & ]( uint32_t rowBegin, uint32_t rowEnd )
+	{
+		Block kBlock;
+		for ( uint32_t blockY = rowBegin; blockY < rowEnd; ++blockY )
+		{
+			uint8_t* pRow = pDestination + blockY * destinationRowPitch;
+			for ( uint32_t blockX = 0; blockX < blocksWide; ++blockX )
+			{
+				LoadBlock( pSource, width, height, rowPitch, blockX, blockY, kBlock );
+
+				uint8_t* pOut = pRow + blockX * blockBytes;
+				switch ( kOptions.format )
+				{
+					case BlockFormat::BC1:
+						EncodeBc1( kBlock, kOptions, pOut );
+						break;
+					case BlockFormat::BC3:
+						EncodeBc4( kBlock, 3, kOptions, pOut );
+						EncodeBc1( kBlock, kOptions, pOut + 8 );
+						break;
+					case BlockFormat::BC5:
+						EncodeBc4( kBlock, 0, kOptions, pOut );
+						EncodeBc4( kBlock, 1, kOptions, pOut + 8 );
+						break;
+					case BlockFormat::BC7:
+						EncodeBc7( kBlock, kOptions, pOut );
+						break;
+				}
+			}
+		}
+	};
+
+	// Blocks are independent, a few rows per task is plenty to amortise the hand-off.
+	const uint32_t grainSize = std::max( 1u, 256u / std::max( 1u, blocksWide ) );
+	if ( pPool && blocksHigh > grainSize )
+	{
+		pPool->ParallelFor( blocksHigh, grainSize, CompressRows );
+	}
+	else
+	{
+		CompressRows( 0, blocksHigh );
+	}
+}
+
+void BlockCompressor::Decompress( const uint8_t* pSource, size_t sourceRowPitch, BlockFormat format, uint32_t width, uint32_t height,
+								  uint8_t* pDestination, size_t destinationRowPitch )
+{
+	const uint32_t blocksWide = ( width + 3 ) / 4;
+	const uint32_t blocksHigh = ( height + 3 ) / 4;
+	const size_t blockBytes = GetBlockBytes( format );
+
+	uint8_t texels[ 4 * 4 * 4 ];
+	for ( uint32_t blockY = 0; blockY < blocksHigh; ++blockY )
+	{
+		for ( uint32_t blockX = 0; blockX < blocksWide; ++blockX )
+		{
+			const uint8_t* pIn = pSource + blockY * sourceRowPitch + blockX * blockBytes;
+			switch ( format )
+			{
+				case BlockFormat::BC1:
+					DecodeBc1( pIn, texels, 16, false );
+					break;
+				case BlockFormat::BC3:
+					DecodeBc1( pIn + 8, texels, 16, true );
+					DecodeBc4( pIn, texels, 16, 3 );
+					break;
+				case BlockFormat::BC5:
+					DecodeBc4( pIn, texels, 16, 0 );
+					DecodeBc4( pIn + 8, texels, 16, 1 );
+					for ( uint32_t t = 0; t < kBlockTexels; ++t )
+					{
+						texels[ t * 4 + 2 ] = 0;
+						texels[ t * 4 + 3 ] = 255;
+					}
+					break;
+				case BlockFormat::BC7:
+					DecodeBc7( pIn, texels, 16 );
+					break;
+			}
+
+			// Clip partial blocks.
+			for ( uint32_t y = 0; y < 4 && blockY * 4 + y < height; ++y )
+			{
+				const uint32_t columns = std::min( 4u, width - blockX * 4 );
+				memcpy( pDestination + ( blockY * 4 + y ) * destinationRowPitch + blockX * 16, texels + y * 16, columns * 4 );
+			}
+		}
+	}
+}
+
+double BlockCompressor::ComputePsnr( const uint8_t* pA, const uint8_t* pB, uint32_t width, uint32_t height, size_t rowPitch, uint32_t channelCount )
+{
+	double squaredError = 0.0;
+	for ( uint32_t y = 0; y < height; ++y )
+	{
+		const uint8_t* pRowA = pA + y * rowPitch;
+		const uint8_t* pRowB = pB + y * rowPitch;
+		for ( uint32_t x = 0; x < width; ++x )
+		{
+			for ( uint32_t c = 0; c < channelCount; ++c )
+			{
+				const double difference = static_cast< double >( pRowA[ x * 4 + c ] ) - static_cast< double >( pRowB[ x * 4 + c ] );
+				squaredError += difference * difference;
+			}
+		}
+	}
+
+	const double meanSquaredError = squaredError / ( static_cast< double >( width ) * height * channelCount );
+	if ( meanSquaredError <= 0.0 )
+	{
+		return 99.0;
+	}
+	return 10.0 * std::log10( 255.0 * 255.0 / meanSquaredError );
+}
@@ -0,0 +1,69 @@
+#include "CommandAllocatorPool.hpp"
+#include <algorithm>
+
+CommandAllocatorPool::CommandAllocatorPool( ICommandBackend& kBackend, const CommandAllocatorPoolOptions& kOptions ) :
+	m_kBackend( kBackend ),
+	m_kOptions( kOptions )
+{
+}
+
+ICommandAllocator& CommandAllocatorPool::Acquire()
+{
+	// The front has the lowest fence value, when that one is still in flight all of them are.
+	if ( !m_returned.empty() )
+	{
+		const Returned kOldest = m_returned.front();
+		const bool bLimitReached = ( m_kOptions.maxAllocators != 0 ) && ( m_allocators.size() >= m_kOptions.maxAllocators );
+		bool bIdle = m_kBackend.GetCompletedValue() >= kOldest.fenceValue;
+		if ( !bIdle && bLimitReached )
+		{
+			++m_stalls;
+			m_kBackend.WaitForFence( kOldest.fenceValue );
+			bIdle = true;
+		}
+		if ( bIdle )
+		{
+			m_returned.pop_front();
+			kOldest.pAllocator->Reset();
+			return *kOldest.pAllocator;
+		}
+	}
+
+	m_allocators.push_back( m_kBackend.CreateAllocator() );
+	return *m_allocators.back();
+}
+
+void CommandAllocatorPool::Release( ICommandAllocator& kAllocator, uint64_t fenceValue )
+{
+	// Almost always the highest value so far, which lands at the back without searching.
+	auto it = m_returned.end();
+	if ( !m_returned.empty() && m_returned.back().fenceValue > fenceValue )
+	{
+		it = std::upper_bound( m_returned.begin(), m_returned.end(), fenceValue, []( uint64_t value, const Returned& kReturned )
+		{
+			return value < kReturned.fenceValue;
+		} );
+	}
+	m_returned.insert( it, { fenceValue, &kAllocator } );
+}
+
+CommandAllocatorPoolStats CommandAllocatorPool::GetStats() const
+{
+	CommandAllocatorPoolStats kStats;
+	kStats.live = static_cast< uint32_t >( m_allocators.size() );
+	kStats.stalls = m_stalls;
+
+	const uint64_t completedValue = m_kBackend.GetCompletedValue();
+	for ( const Returned& kReturned : m_returned )
+	{
+		if ( kReturned.fenceValue <= completedValue )
+		{
+			++kStats.idle;
+		}
+		else
+		{
+			++kStats.inFlight;
+		}
+	}
+	return kStats;
+}
@@ -0,0 +1,100 @@
+#include "CommandRecorder.hpp"
+#include "CommandAllocatorPool.hpp"
+#include "ThreadPool.hpp"
+
+CommandRecorder::CommandRecorder( ICommandBackend& kBackend, CommandAllocatorPool& kAllocatorPool ) :
+	m_kBackend( kBackend ),
+	m_kAllocatorPool( kAllocatorPool )
+{
+}
+
+void CommandRecorder::Record( uint32_t count, const RecordFunction& record, ThreadPool* pPool )
+{
+	const uint32_t first = static_cast< uint32_t >( m_frameAllocators.size() );
+	if ( first == 0 )
+	{
+		m_kStats.listsRecorded = 0;
+	}
+
+	// The pool is not thread safe and creating lists is rare, do both up front on this thread.
+	for ( uint32_t n = 0; n < count; ++n )
+	{
+		m_frameAllocators.push_back( &m_kAllocatorPool.Acquire() );
+		if ( m_lists.size() < m_frameAllocators.size() )
+		{
+			m_lists.push_back( m_kBackend.CreateCommandList( *m_frameAllocators.back() ) );
+			++m_kStats.listCount;
+		}
+	}
+	m_kStats.listsRecorded += count;
+
+	auto RecordRange = [ & ]( uint32_t begin, uint32_t end )
+	{
+		for ( uint32_t n = first + begin; n < first + end; ++n )
+		{
+			ICommandList& kList = *m_lists[ n ];
+			kList.Reset( *m_frameAllocators[ n ] );
+			record( n, kList );
+			kList.Close();
+		}
+	};
+
+	if ( pPool && count > 1 )
+	{
+		pPool->ParallelFor( count, 1, RecordRange );
+	}
+	else
+	{
+		RecordRange( 0, count );
+	}
+}
+
+void CommandRecorder::Submit( uint64_t fenceValue, const FixupFunction& fixup )
+{
+	m_submitLists.clear();
+	m_fixupAllocators.clear();
+	for ( uint32_t n = 0; n < m_frameAllocators.size(); ++n )
+	{
+		if ( fixup )
+		{
+			ICommandList* pFixupList = nullptr;
+			fixup( n, [ & ]() -> ICommandList&
+			{
+				if ( !pFixupList )
+				{
+					m_fixupAllocators.push_back( &m_kAllocatorPool.Acquire() );
+					if ( m_fixupLists.size() < m_fixupAllocators.size() )
+					{
+						m_fixupLists.push_back( m_kBackend.CreateCommandList( *m_fixupAllocators.back() ) );
+						++m_kStats.listCount;
+					}
+					pFixupList = m_fixupLists[ m_fixupAllocators.size() - 1 ].get();
+					pFixupList->Reset( *m_fixupAllocators.back() );
+				}
+				return *pFixupList;
+			} );
+			if ( pFixupList )
+			{
+				pFixupList->Close();
+				m_submitLists.push_back( pFixupList );
+			}
+		}
+		m_submitLists.push_back( m_lists[ n ].get() );
+	}
+	m_kStats.fixupLists = static_cast< uint32_t >( m_fixupAllocators.size() );
+	if ( !m_submitLists.empty() )
+	{
+		m_kBackend.Execute( m_submitLists.data(), static_cast< uint32_t >( m_submitLists.size() ), fenceValue );
+	}
+
+	for ( ICommandAllocator* pAllocator : m_frameAllocators )
+	{
+		m_kAllocatorPool.Release( *pAllocator, fenceValue );
+	}
+	for ( ICommandAllocator* pAllocator : m_fixupAllocators )
+	{
+		m_kAllocatorPool.Release( *pAllocator, fenceValue );
+	}
+	m_frameAllocators.clear();
+	m_fixupAllocators.clear();
+}
@@ -0,0 +1,85 @@
+#include "stdafx.hpp"
+#include "ConstantBufferPool.hpp"
+#include "DXSampleHelper.hpp"
+#include "RingAllocator.hpp"
+
+ConstantBufferPool::~ConstantBufferPool()
+{
+	Destroy();
+}
+
+void ConstantBufferPool::Create( ID3D12Device* pDevice, uint32_t frameCount, uint64_t bytesPerFrame )
+{
+	Destroy();
+
+	m_bytesPerFrame = RingAllocator::AlignUp( bytesPerFrame, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT );
+
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer( m_bytesPerFrame * frameCount );
+	ThrowIfFailed( pDevice->CreateCommittedResource(
+		HeapPropertiesFactory::GetUploadHeapProperties(),
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS( m_spBuffer.ReleaseAndGetAddressOf() )
+	) );
+	m_spBuffer->SetName( L"Constant Buffer Pool" );
+
+	// Map and keep it mapped untill the pool is destroyed.
+	CD3DX12_RANGE readRange( 0, 0 ); // we do not intend to read from this resource on the CPU.
+	ThrowIfFailed( m_spBuffer->Map( 0, &readRange, reinterpret_cast< void** >( &m_pMappedData ) ) );
+	m_gpuAddress = m_spBuffer->GetGPUVirtualAddress();
+
+	BeginFrame( 0 );
+}
+
+void ConstantBufferPool::Destroy()
+{
+	if ( m_spBuffer && m_pMappedData )
+	{
+		m_spBuffer->Unmap( 0, nullptr );
+	}
+
+	m_spBuffer.Reset();
+	m_pMappedData = nullptr;
+	m_gpuAddress = 0;
+	m_bytesPerFrame = 0;
+	m_regionBegin = 0;
+	m_offset = 0;
+	m_kFrameStats = {};
+	m_kLastFrameStats = {};
+	m_peakBytesPerFrame = 0;
+}
+
+void ConstantBufferPool::BeginFrame( uint32_t frameIndex )
+{
+	m_kLastFrameStats = m_kFrameStats;
+	m_kFrameStats = {};
+
+	m_regionBegin = m_bytesPerFrame * frameIndex;
+	m_offset = 0;
+}
+
+ConstantBufferAllocation ConstantBufferPool::Allocate( uint64_t size )
+{
+	const uint64_t alignedSize = RingAllocator::AlignUp( size, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT );
+	if ( m_offset + alignedSize > m_bytesPerFrame )
+	{
+		throw std::runtime_error( "Constant buffer pool is out of memory for this frame" );
+	}
+
+	ConstantBufferAllocation kAllocation;
+	kAllocation.pCpuAddress = m_pMappedData + m_regionBegin + m_offset;
+	kAllocation.gpuAddress = m_gpuAddress + m_regionBegin + m_offset;
+	kAllocation.size = alignedSize;
+	m_offset += alignedSize;
+
+	m_kFrameStats.bytesWritten += size;
+	m_kFrameStats.allocationCount++;
+	if ( m_offset > m_peakBytesPerFrame )
+	{
+		m_peakBytesPerFrame = m_offset;
+	}
+
+	return kAllocation;
+}
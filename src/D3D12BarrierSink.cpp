@@ -0,0 +1,17 @@
+#include "stdafx.hpp"
+#include "D3D12BarrierSink.hpp"
+
+void D3D12BarrierSink::ResourceBarriers( const ResourceBarrierDesc* pBarriers, uint32_t count )
+{
+	m_barriers.clear();
+	for ( uint32_t n = 0; n < count; ++n )
+	{
+		const ResourceBarrierDesc& kBarrier = pBarriers[ n ];
+		ID3D12Resource* pResource = const_cast< ID3D12Resource* >( static_cast< const ID3D12Resource* >( kBarrier.pResource ) );
+		m_barriers.push_back( CD3DX12_RESOURCE_BARRIER::Transition( pResource,
+																	static_cast< D3D12_RESOURCE_STATES >( kBarrier.before ),
+																	static_cast< D3D12_RESOURCE_STATES >( kBarrier.after ),
+																	kBarrier.subresource ) );
+	}
+	m_pCommandList->ResourceBarrier( count, m_barriers.data() );
+}
@@ -0,0 +1,84 @@
+#include "stdafx.hpp"
+#include "D3D12CommandBackend.hpp"
+#include "DXSampleHelper.hpp"
+
+namespace
+{
+	class D3D12CommandAllocator : public ICommandAllocator
+	{
+	public:
+		void Reset() override { ThrowIfFailed( m_spAllocator->Reset() ); }
+
+		Microsoft::WRL::ComPtr< ID3D12CommandAllocator > m_spAllocator;
+	};
+
+	class D3D12CommandList : public ICommandList
+	{
+	public:
+		// No initial pipeline state, the recording code sets its own.
+		void Reset( ICommandAllocator& kAllocator ) override
+		{
+			ThrowIfFailed( m_spList->Reset( static_cast< D3D12CommandAllocator& >( kAllocator ).m_spAllocator.Get(), nullptr ) );
+		}
+		void Close() override { ThrowIfFailed( m_spList->Close() ); }
+
+		Microsoft::WRL::ComPtr< ID3D12GraphicsCommandList > m_spList;
+	};
+}
+
+D3D12CommandBackend::D3D12CommandBackend( ID3D12Device* pDevice, ID3D12CommandQueue* pQueue, ID3D12Fence* pFence, FenceWaiter& kWaiter,
+										  D3D12_COMMAND_LIST_TYPE type ) :
+	m_spDevice( pDevice ),
+	m_spQueue( pQueue ),
+	m_spFence( pFence ),
+	m_kWaiter( kWaiter ),
+	m_kWatchedFence( pFence ),
+	m_type( type )
+{
+}
+
+D3D12CommandBackend::~D3D12CommandBackend()
+{
+	// Nothing may be left waiting on the watched fence once it is gone.
+	m_kWaiter.Cancel( m_kWatchedFence );
+}
+
+ID3D12GraphicsCommandList* D3D12CommandBackend::GetNative( ICommandList& kList )
+{
+	return static_cast< D3D12CommandList& >( kList ).m_spList.Get();
+}
+
+ID3D12CommandAllocator* D3D12CommandBackend::GetNative( ICommandAllocator& kAllocator )
+{
+	return static_cast< D3D12CommandAllocator& >( kAllocator ).m_spAllocator.Get();
+}
+
+std::unique_ptr< ICommandAllocator > D3D12CommandBackend::CreateAllocator()
+{
+	auto spAllocator = std::make_unique< D3D12CommandAllocator >();
+	ThrowIfFailed( m_spDevice->CreateCommandAllocator( m_type, IID_PPV_ARGS( spAllocator->m_spAllocator.ReleaseAndGetAddressOf() ) ) );
+	return spAllocator;
+}
+
+std::unique_ptr< ICommandList > D3D12CommandBackend::CreateCommandList( ICommandAllocator& kAllocator )
+{
+	auto spList = std::make_unique< D3D12CommandList >();
+	ThrowIfFailed( m_spDevice->CreateCommandList( 0, m_type, GetNative( kAllocator ), nullptr, IID_PPV_ARGS( spList->m_spList.ReleaseAndGetAddressOf() ) ) );
+	ThrowIfFailed( spList->m_spList->Close() );
+	return spList;
+}
+
+void D3D12CommandBackend::Execute( ICommandList* const* ppLists, uint32_t count, uint64_t /*fenceValue*/ )
+{
+	m_nativeLists.clear();
+	for ( uint32_t n = 0; n < count; ++n )
+	{
+		m_nativeLists.push_back( GetNative( *ppLists[ n ] ) );
+	}
+	m_spQueue->ExecuteCommandLists( count, m_nativeLists.data() );
+}
+
+void D3D12CommandBackend::WaitForFence( uint64_t fenceValue )
+{
+	m_kWaiter.Wait( m_kWatchedFence, fenceValue );
+}
@@ -0,0 +1,44 @@
+#include "stdafx.hpp"
+#include "D3D12DeferredRelease.hpp"
+#include "DXSampleHelper.hpp"
+
+namespace
+{
+	void ReleaseUnknown( void* pObject )
+	{
+		static_cast< IUnknown* >( pObject )->Release();
+	}
+
+	void Push( DeferredReleaseQueue& kQueue, IUnknown* pObject, uint64_t fenceValue, uint64_t bytes )
+	{
+		kQueue.Push( fenceValue, pObject, &ReleaseUnknown, bytes );
+	}
+}
+
+void DeferRelease( DeferredReleaseQueue& kQueue, Microsoft::WRL::ComPtr< ID3D12Resource >& spResource, uint64_t fenceValue )
+{
+	if ( !spResource )
+	{
+		return;
+	}
+
+	// What the resource takes up in its heap, so the byte limit means the same for committed and placed resources.
+	Microsoft::WRL::ComPtr< ID3D12Device > spDevice;
+	ThrowIfFailed( spResource->GetDevice( IID_PPV_ARGS( &spDevice ) ) );
+	const D3D12_RESOURCE_DESC kDesc = spResource->GetDesc();
+	const uint64_t bytes = spDevice->GetResourceAllocationInfo( 0, 1, &kDesc ).SizeInBytes;
+
+	// The queue owns the reference from here on.
+	Push( kQueue, spResource.Detach(), fenceValue, bytes );
+}
+
+void DeferRelease( DeferredReleaseQueue& kQueue, Microsoft::WRL::ComPtr< ID3D12Heap >& spHeap, uint64_t fenceValue )
+{
+	if ( !spHeap )
+	{
+		return;
+	}
+
+	const uint64_t bytes = spHeap->GetDesc().SizeInBytes;
+	Push( kQueue, spHeap.Detach(), fenceValue, bytes );
+}
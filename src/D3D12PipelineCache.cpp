@@ -0,0 +1,177 @@
+#include "stdafx.hpp"
+#include <stdexcept>
+#include "D3D12PipelineCache.hpp"
+#include "DXSampleHelper.hpp"
+
+namespace
+{
+	void AddShader( Hasher& kHasher, const D3D12_SHADER_BYTECODE& kShader )
+	{
+		kHasher.AddBlob( kShader.pShaderBytecode, kShader.BytecodeLength );
+	}
+
+	void AddStencilOp( Hasher& kHasher, const D3D12_DEPTH_STENCILOP_DESC& kOp )
+	{
+		kHasher.Add( kOp.StencilFailOp );
+		kHasher.Add( kOp.StencilDepthFailOp );
+		kHasher.Add( kOp.StencilPassOp );
+		kHasher.Add( kOp.StencilFunc );
+	}
+}
+
+PipelineCacheIdentity GetPipelineCacheIdentity( IDXGIFactory4* pFactory, ID3D12Device* pDevice )
+{
+	// By LUID, the device may have been created on the default adapter without one being picked.
+	Microsoft::WRL::ComPtr< IDXGIAdapter1 > spAdapter;
+	ThrowIfFailed( pFactory->EnumAdapterByLuid( pDevice->GetAdapterLuid(), IID_PPV_ARGS( &spAdapter ) ) );
+	DXGI_ADAPTER_DESC1 kAdapterDesc = {};
+	ThrowIfFailed( spAdapter->GetDesc1( &kAdapterDesc ) );
+
+	PipelineCacheIdentity kIdentity;
+	kIdentity.vendorId = kAdapterDesc.VendorId;
+	kIdentity.deviceId = kAdapterDesc.DeviceId;
+	kIdentity.subSysId = kAdapterDesc.SubSysId;
+	kIdentity.revision = kAdapterDesc.Revision;
+	LARGE_INTEGER driverVersion = {};
+	if ( SUCCEEDED( spAdapter->CheckInterfaceSupport( __uuidof( IDXGIDevice ), &driverVersion ) ) )
+	{
+		kIdentity.driverVersion = static_cast< uint64_t >( driverVersion.QuadPart );
+	}
+	return kIdentity;
+}
+
+D3D12GraphicsPipeline::D3D12GraphicsPipeline( ID3D12Device* pDevice, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& kDesc, const void* pRootSignatureBlob, size_t rootSignatureSize ) :
+	m_pDevice( pDevice ),
+	m_kDesc( kDesc ),
+	m_pRootSignatureBlob( pRootSignatureBlob ),
+	m_rootSignatureSize( rootSignatureSize )
+{
+	if ( kDesc.pRootSignature && !pRootSignatureBlob )
+	{
+		throw std::runtime_error( "A pipeline with a root signature needs its serialized blob for the cache" );
+	}
+	m_kDesc.CachedPSO = {};
+}
+
+uint64_t D3D12GraphicsPipeline::GetHash() const
+{
+	// Every field but CachedPSO, which is what the cache fills in.
+	Hasher kHasher;
+	kHasher.AddBlob( m_pRootSignatureBlob, m_rootSignatureSize );
+	AddShader( kHasher, m_kDesc.VS );
+	AddShader( kHasher, m_kDesc.PS );
+	AddShader( kHasher, m_kDesc.DS );
+	AddShader( kHasher, m_kDesc.HS );
+	AddShader( kHasher, m_kDesc.GS );
+
+	const D3D12_STREAM_OUTPUT_DESC& kStreamOutput = m_kDesc.StreamOutput;
+	kHasher.Add( kStreamOutput.NumEntries );
+	for ( UINT n = 0; n < kStreamOutput.NumEntries; ++n )
+	{
+		const D3D12_SO_DECLARATION_ENTRY& kEntry = kStreamOutput.pSODeclaration[ n ];
+		kHasher.Add( kEntry.Stream );
+		kHasher.AddString( kEntry.SemanticName );
+		kHasher.Add( kEntry.SemanticIndex );
+		kHasher.Add( kEntry.StartComponent );
+		kHasher.Add( kEntry.ComponentCount );
+		kHasher.Add( kEntry.OutputSlot );
+	}
+	kHasher.AddBlob( kStreamOutput.pBufferStrides, kStreamOutput.NumStrides * sizeof( UINT ) );
+	kHasher.Add( kStreamOutput.RasterizedStream );
+
+	const D3D12_BLEND_DESC& kBlend = m_kDesc.BlendState;
+	kHasher.Add( kBlend.AlphaToCoverageEnable );
+	kHasher.Add( kBlend.IndependentBlendEnable );
+	for ( const D3D12_RENDER_TARGET_BLEND_DESC& kTarget : kBlend.RenderTarget )
+	{
+		kHasher.Add( kTarget.BlendEnable );
+		kHasher.Add( kTarget.LogicOpEnable );
+		kHasher.Add( kTarget.SrcBlend );
+		kHasher.Add( kTarget.DestBlend );
+		kHasher.Add( kTarget.BlendOp );
+		kHasher.Add( kTarget.SrcBlendAlpha );
+		kHasher.Add( kTarget.DestBlendAlpha );
+		kHasher.Add( kTarget.BlendOpAlpha );
+		kHasher.Add( kTarget.LogicOp );
+		kHasher.Add( kTarget.RenderTargetWriteMask );
+	}
+	kHasher.Add( m_kDesc.SampleMask );
+
+	const D3D12_RASTERIZER_DESC& kRasterizer = m_kDesc.RasterizerState;
+	kHasher.Add( kRasterizer.FillMode );
+	kHasher.Add( kRasterizer.CullMode );
+	kHasher.Add( kRasterizer.FrontCounterClockwise );
+	kHasher.Add( kRasterizer.DepthBias );
+	kHasher.Add( kRasterizer.DepthBiasClamp );
+	kHasher.Add( kRasterizer.SlopeScaledDepthBias );
+	kHasher.Add( kRasterizer.DepthClipEnable );
+	kHasher.Add( kRasterizer.MultisampleEnable );
+	kHasher.Add( kRasterizer.AntialiasedLineEnable );
+	kHasher.Add( kRasterizer.ForcedSampleCount );
+	kHasher.Add( kRasterizer.ConservativeRaster );
+
+	const D3D12_DEPTH_STENCIL_DESC& kDepthStencil = m_kDesc.DepthStencilState;
+	kHasher.Add( kDepthStencil.DepthEnable );
+	kHasher.Add( kDepthStencil.DepthWriteMask );
+	kHasher.Add( kDepthStencil.DepthFunc );
+	kHasher.Add( kDepthStencil.StencilEnable );
+	kHasher.Add( kDepthStencil.StencilReadMask );
+	kHasher.Add( kDepthStencil.StencilWriteMask );
+	AddStencilOp( kHasher, kDepthStencil.FrontFace );
+	AddStencilOp( kHasher, kDepthStencil.BackFace );
+
+	const D3D12_INPUT_LAYOUT_DESC& kInputLayout = m_kDesc.InputLayout;
+	kHasher.Add( kInputLayout.NumElements );
+	for ( UINT n = 0; n < kInputLayout.NumElements; ++n )
+	{
+		const D3D12_INPUT_ELEMENT_DESC& kElement = kInputLayout.pInputElementDescs[ n ];
+		kHasher.AddString( kElement.SemanticName );
+		kHasher.Add( kElement.SemanticIndex );
+		kHasher.Add( kElement.Format );
+		kHasher.Add( kElement.InputSlot );
+		kHasher.Add( kElement.AlignedByteOffset );
+		kHasher.Add( kElement.InputSlotClass );
+		kHasher.Add( kElement.InstanceDataStepRate );
+	}
+
+	kHasher.Add( m_kDesc.IBStripCutValue );
+	kHasher.Add( m_kDesc.PrimitiveTopologyType );
+	kHasher.Add( m_kDesc.NumRenderTargets );
+	for ( DXGI_FORMAT format : m_kDesc.RTVFormats )
+	{
+		kHasher.Add( format );
+	}
+	kHasher.Add( m_kDesc.DSVFormat );
+	kHasher.Add( m_kDesc.SampleDesc.Count );
+	kHasher.Add( m_kDesc.SampleDesc.Quality );
+	kHasher.Add( m_kDesc.NodeMask );
+	kHasher.Add( m_kDesc.Flags );
+	return kHasher.GetHash();
+}
+
+bool D3D12GraphicsPipeline::Create( const void* pBlob, size_t blobSize )
+{
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC kDesc = m_kDesc;
+	kDesc.CachedPSO = { pBlob, pBlob ? blobSize : 0 };
+	const HRESULT hr = m_pDevice->CreateGraphicsPipelineState( &kDesc, IID_PPV_ARGS( m_spPipelineState.ReleaseAndGetAddressOf() ) );
+
+	// A blob from another driver or adapter, or one that does not match the description.
+	if ( pBlob && ( hr == D3D12_ERROR_DRIVER_VERSION_MISMATCH || hr == D3D12_ERROR_ADAPTER_NOT_FOUND || hr == E_INVALIDARG ) )
+	{
+		return false;
+	}
+	ThrowIfFailed( hr );
+	return true;
+}
+
+std::vector< uint8_t > D3D12GraphicsPipeline::GetCachedBlob() const
+{
+	// Not every driver hands out blobs, the pipeline is then simply not cached.
+	Microsoft::WRL::ComPtr< ID3DBlob > spBlob;
+	if ( !m_spPipelineState || FAILED( m_spPipelineState->GetCachedBlob( &spBlob ) ) )
+	{
+		return {};
+	}
+	const uint8_t* pData = static_cast< const uint8_t* >( spBlob->GetBufferPointer() );
+	return std::vector< uint8_t >( pData, pData + spBlob->GetBufferSize() );
+}
@@ -0,0 +1,272 @@
+#include "stdafx.hpp"
+#include <algorithm>
+#include <cstring>
+#include "D3D12RenderGraph.hpp"
+#include "CommandRecorder.hpp"
+#include "D3D12CommandBackend.hpp"
+#include "D3D12DeferredRelease.hpp"
+#include "DXSampleHelper.hpp"
+
+namespace
+{
+	D3D12_HEAP_FLAGS GetHeapFlags( RenderGraphHeap heap )
+	{
+		switch ( heap )
+		{
+			case RenderGraphHeap::Buffers: return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+			case RenderGraphHeap::RenderTargets: return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+			case RenderGraphHeap::Textures: return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+			case RenderGraphHeap::Count: break;
+		}
+		return D3D12_HEAP_FLAG_NONE;
+	}
+}
+
+D3D12RenderGraph::D3D12RenderGraph( ID3D12Device* pDevice, DeferredReleaseQueue& kDeferredRelease ) :
+	m_pDevice( pDevice ),
+	m_kDeferredRelease( kDeferredRelease )
+{
+}
+
+uint32_t D3D12RenderGraph::Create( RenderGraph& kGraph, std::string name, const D3D12_RESOURCE_DESC& kDesc, const D3D12_CLEAR_VALUE* pClearValue )
+{
+	const D3D12_RESOURCE_ALLOCATION_INFO kInfo = m_pDevice->GetResourceAllocationInfo( 0, 1, &kDesc );
+
+	RenderGraphResourceDesc kGraphDesc;
+	kGraphDesc.sizeBytes = kInfo.SizeInBytes;
+	kGraphDesc.alignment = kInfo.Alignment;
+	if ( kDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER )
+	{
+		kGraphDesc.heap = RenderGraphHeap::Buffers;
+	}
+	else if ( kDesc.Flags & ( D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL ) )
+	{
+		kGraphDesc.heap = RenderGraphHeap::RenderTargets;
+	}
+	const uint32_t resource = kGraph.Create( std::move( name ), kGraphDesc );
+
+	if ( m_descs.size() <= resource )
+	{
+		m_descs.resize( resource + 1 );
+	}
+	m_descs[ resource ] = { kDesc, pClearValue ? *pClearValue : D3D12_CLEAR_VALUE(), pClearValue != nullptr };
+	return resource;
+}
+
+void D3D12RenderGraph::Allocate( const RenderGraph& kGraph, uint64_t fenceValue )
+{
+	// A heap that is too small is replaced along with every resource placed in it.
+	for ( uint32_t heap = 0; heap < static_cast< uint32_t >( RenderGraphHeap::Count ); ++heap )
+	{
+		const RenderGraphHeapLayout& kLayout = kGraph.GetHeapLayout( static_cast< RenderGraphHeap >( heap ) );
+		if ( kLayout.sizeBytes == 0 )
+		{
+			continue;
+		}
+
+		const uint64_t alignment = std::max< uint64_t >( kLayout.alignment, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT );
+		if ( m_heaps[ heap ] )
+		{
+			const D3D12_HEAP_DESC kCurrent = m_heaps[ heap ]->GetDesc();
+			if ( kCurrent.SizeInBytes >= kLayout.sizeBytes && kCurrent.Alignment >= alignment )
+			{
+				continue;
+			}
+		}
+
+		for ( PlacedResource& kPlaced : m_placed )
+		{
+			if ( kPlaced.heap == static_cast< RenderGraphHeap >( heap ) )
+			{
+				DeferRelease( m_kDeferredRelease, kPlaced.spResource, fenceValue );
+			}
+		}
+		DeferRelease( m_kDeferredRelease, m_heaps[ heap ], fenceValue );
+		m_activeRanges[ heap ].clear();
+
+		CD3DX12_HEAP_DESC kHeapDesc( kLayout.sizeBytes, D3D12_HEAP_TYPE_DEFAULT, alignment, GetHeapFlags( static_cast< RenderGraphHeap >( heap ) ) );
+		ThrowIfFailed( m_pDevice->CreateHeap( &kHeapDesc, IID_PPV_ARGS( &m_heaps[ heap ] ) ) );
+		m_heaps[ heap ]->SetName( L"Render Graph Heap" );
+	}
+	m_placed.erase( std::remove_if( m_placed.begin(), m_placed.end(), []( const PlacedResource& kPlaced ) { return !kPlaced.spResource; } ), m_placed.end() );
+
+	for ( PlacedResource& kPlaced : m_placed )
+	{
+		kPlaced.bUsed = false;
+	}
+	m_resources.assign( kGraph.GetResourceCount(), nullptr );
+	m_createdByPass.assign( kGraph.GetCompiledPasses().size(), {} );
+	std::vector< uint32_t > transients;
+	std::vector< uint64_t > placedIds( kGraph.GetResourceCount(), 0 );
+	for ( uint32_t resource = 0; resource < kGraph.GetResourceCount(); ++resource )
+	{
+		if ( kGraph.IsImported( resource ) )
+		{
+			m_resources[ resource ] = static_cast< ID3D12Resource* >( kGraph.GetImportedResource( resource ) );
+		}
+		else if ( kGraph.GetPlacement( resource ).bUsed )
+		{
+			const PlacedResource& kPlaced = GetPlacedResource( kGraph, resource );
+			m_resources[ resource ] = kPlaced.spResource.Get();
+			placedIds[ resource ] = kPlaced.id;
+			transients.push_back( resource );
+
+			// The graph only knows about aliasing within the frame, and resources it aliases start with a barrier of
+			// their own. Any other resource needs one when another placed resource was the last to use part of its
+			// memory, in an earlier frame or one still in flight.
+			const RenderGraphPlacement& kPlacement = kGraph.GetPlacement( resource );
+			const std::vector< ActiveRange >& kActive = m_activeRanges[ static_cast< uint32_t >( kPlaced.heap ) ];
+			const bool bTakesOver = std::any_of( kActive.begin(), kActive.end(), [ &kPlacement, &kPlaced ]( const ActiveRange& kRange )
+			{
+				return kRange.placedId != kPlaced.id && kRange.offset < kPlacement.offset + kPlacement.sizeBytes && kPlacement.offset < kRange.offset + kRange.sizeBytes;
+			} );
+			if ( bTakesOver && !kPlacement.bAliased )
+			{
+				m_createdByPass[ kPlacement.firstPass ].push_back( CD3DX12_RESOURCE_BARRIER::Aliasing( nullptr, m_resources[ resource ] ) );
+			}
+		}
+	}
+
+	// After this frame every range belongs to the last resource in it to take over its memory.
+	std::sort( transients.begin(), transients.end(), [ &kGraph ]( uint32_t first, uint32_t second )
+	{
+		return kGraph.GetPlacement( first ).firstPass < kGraph.GetPlacement( second ).firstPass;
+	} );
+	for ( uint32_t resource : transients )
+	{
+		const RenderGraphPlacement& kPlacement = kGraph.GetPlacement( resource );
+		std::vector< ActiveRange >& ranges = m_activeRanges[ static_cast< uint32_t >( kGraph.GetResourceDesc( resource ).heap ) ];
+		SetActiveRange( ranges, { kPlacement.offset, kPlacement.sizeBytes, placedIds[ resource ] } );
+	}
+
+	// Whatever this frame did not ask for, the frames in flight may still use it.
+	for ( PlacedResource& kPlaced : m_placed )
+	{
+		if ( !kPlaced.bUsed )
+		{
+			DeferRelease( m_kDeferredRelease, kPlaced.spResource, fenceValue );
+		}
+	}
+	m_placed.erase( std::remove_if( m_placed.begin(), m_placed.end(), []( const PlacedResource& kPlaced ) { return !kPlaced.spResource; } ), m_placed.end() );
+}
+
+void D3D12RenderGraph::Record( const RenderGraph& kGraph, CommandRecorder& kRecorder, ThreadPool* pPool )
+{
+	// The barriers were all worked out by Compile, every list records its own without knowing about the others.
+	const std::vector< RenderGraphCompiledPass >& passes = kGraph.GetCompiledPasses();
+	const uint32_t firstList = kRecorder.GetPendingListCount();
+	kRecorder.Record( static_cast< uint32_t >( passes.size() ), [ this, &kGraph, &passes, firstList ]( uint32_t index, ICommandList& kList )
+	{
+		const RenderGraphCompiledPass& kPass = passes[ index - firstList ];
+		ID3D12GraphicsCommandList* pCommandList = D3D12CommandBackend::GetNative( kList );
+		ResourceBarriers( pCommandList, kPass.barriersBefore, &m_createdByPass[ index - firstList ] );
+		kGraph.ExecutePass( kPass.pass, kList );
+		ResourceBarriers( pCommandList, kPass.barriersAfter, nullptr );
+	}, pPool );
+}
+
+bool D3D12RenderGraph::SameDesc( const TransientDesc& kFirst, const TransientDesc& kSecond )
+{
+	// Descriptions are filled in field by field, padding can differ, so no memcmp on the whole struct.
+	const D3D12_RESOURCE_DESC& kA = kFirst.desc;
+	const D3D12_RESOURCE_DESC& kB = kSecond.desc;
+	const bool bSameResource = kA.Dimension == kB.Dimension && kA.Alignment == kB.Alignment && kA.Width == kB.Width &&
+		kA.Height == kB.Height && kA.DepthOrArraySize == kB.DepthOrArraySize && kA.MipLevels == kB.MipLevels &&
+		kA.Format == kB.Format && kA.SampleDesc.Count == kB.SampleDesc.Count && kA.SampleDesc.Quality == kB.SampleDesc.Quality &&
+		kA.Layout == kB.Layout && kA.Flags == kB.Flags;
+	if ( !bSameResource || kFirst.bHasClearValue != kSecond.bHasClearValue )
+	{
+		return false;
+	}
+	return !kFirst.bHasClearValue || ( kFirst.clearValue.Format == kSecond.clearValue.Format &&
+		memcmp( kFirst.clearValue.Color, kSecond.clearValue.Color, sizeof( kFirst.clearValue.Color ) ) == 0 );
+}
+
+void D3D12RenderGraph::SetActiveRange( std::vector< ActiveRange >& ranges, const ActiveRange& kRange )
+{
+	const uint64_t end = kRange.offset + kRange.sizeBytes;
+	std::vector< ActiveRange > kept;
+	kept.reserve( ranges.size() + 2 );
+	for ( const ActiveRange& kOther : ranges )
+	{
+		const uint64_t otherEnd = kOther.offset + kOther.sizeBytes;
+		if ( otherEnd <= kRange.offset || end <= kOther.offset )
+		{
+			kept.push_back( kOther );
+			continue;
+		}
+		if ( kOther.offset < kRange.offset )
+		{
+			kept.push_back( { kOther.offset, kRange.offset - kOther.offset, kOther.placedId } );
+		}
+		if ( end < otherEnd )
+		{
+			kept.push_back( { end, otherEnd - end, kOther.placedId } );
+		}
+	}
+	kept.push_back( kRange );
+	ranges.swap( kept );
+}
+
+const D3D12RenderGraph::PlacedResource& D3D12RenderGraph::GetPlacedResource( const RenderGraph& kGraph, uint32_t resource )
+{
+	const RenderGraphPlacement& kPlacement = kGraph.GetPlacement( resource );
+	const RenderGraphHeap heap = kGraph.GetResourceDesc( resource ).heap;
+	const TransientDesc& kDesc = m_descs.at( resource );
+	for ( PlacedResource& kPlaced : m_placed )
+	{
+		if ( !kPlaced.bUsed && kPlaced.heap == heap && kPlaced.offset == kPlacement.offset &&
+			 kPlaced.initialState == kPlacement.initialState && SameDesc( kPlaced.kDesc, kDesc ) )
+		{
+			kPlaced.bUsed = true;
+			return kPlaced;
+		}
+	}
+
+	// Created in the state every frame starts it in, see RenderGraphPlacement::initialState.
+	PlacedResource kPlaced = { heap, kPlacement.offset, kPlacement.initialState, kDesc, nullptr, true, m_nextPlacedId++ };
+	ThrowIfFailed( m_pDevice->CreatePlacedResource( m_heaps[ static_cast< uint32_t >( heap ) ].Get(),
+													kPlacement.offset,
+													&kDesc.desc,
+													static_cast< D3D12_RESOURCE_STATES >( kPlacement.initialState ),
+													kDesc.bHasClearValue ? &kDesc.clearValue : nullptr,
+													IID_PPV_ARGS( &kPlaced.spResource ) ) );
+	const std::string& name = kGraph.GetResourceName( resource );
+	kPlaced.spResource->SetName( std::wstring( name.begin(), name.end() ).c_str() );
+	m_placed.push_back( kPlaced );
+	return m_placed.back();
+}
+
+void D3D12RenderGraph::ResourceBarriers( ID3D12GraphicsCommandList* pCommandList, const std::vector< RenderGraphBarrier >& barriers,
+										  const std::vector< D3D12_RESOURCE_BARRIER >* pFirst ) const
+{
+	// Several passes record at the same time, so every call gets its own array.
+	std::vector< D3D12_RESOURCE_BARRIER > d3dBarriers;
+	if ( pFirst )
+	{
+		d3dBarriers = *pFirst;
+	}
+	d3dBarriers.reserve( d3dBarriers.size() + barriers.size() );
+	for ( const RenderGraphBarrier& kBarrier : barriers )
+	{
+		if ( kBarrier.type == RenderGraphBarrierType::Aliasing )
+		{
+			ID3D12Resource* pBefore = ( kBarrier.before != RenderGraph::uInvalidIndex ) ? m_resources[ kBarrier.before ] : nullptr;
+			d3dBarriers.push_back( CD3DX12_RESOURCE_BARRIER::Aliasing( pBefore, m_resources[ kBarrier.resource ] ) );
+		}
+		else if ( kBarrier.type == RenderGraphBarrierType::Uav )
+		{
+			d3dBarriers.push_back( CD3DX12_RESOURCE_BARRIER::UAV( m_resources[ kBarrier.resource ] ) );
+		}
+		else
+		{
+			d3dBarriers.push_back( CD3DX12_RESOURCE_BARRIER::Transition( m_resources[ kBarrier.resource ],
+																		 static_cast< D3D12_RESOURCE_STATES >( kBarrier.before ),
+																		 static_cast< D3D12_RESOURCE_STATES >( kBarrier.after ) ) );
+		}
+	}
+	if ( !d3dBarriers.empty() )
+	{
+		pCommandList->ResourceBarrier( static_cast< UINT >( d3dBarriers.size() ), d3dBarriers.data() );
+	}
+}
@@ -0,0 +1,13 @@
+#include "stdafx.hpp"
+#include "D3D12WatchedFence.hpp"
+#include "DXSampleHelper.hpp"
+
+D3D12WatchedFence::D3D12WatchedFence( ID3D12Fence* pFence ) :
+	m_spFence( pFence )
+{
+}
+
+void D3D12WatchedFence::SetEventOnCompletion( uint64_t value, FenceEvent& kEvent )
+{
+	ThrowIfFailed( m_spFence->SetEventOnCompletion( value, static_cast< HANDLE >( kEvent.GetNativeHandle() ) ) );
+}
@@ -0,0 +1,213 @@
+#include "stdafx.hpp"
+#include <d3d12shader.h>
+#include <winver.h>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include "D3DShaderCompiler.hpp"
+#include "DXSampleHelper.hpp"
+#include "Hash.hpp"
+
+namespace
+{
+	bool ReadSource( const std::filesystem::path& path, std::vector< char >& contents )
+	{
+		std::ifstream in( path, std::ios::binary );
+		if ( !in )
+		{
+			return false;
+		}
+		contents.assign( std::istreambuf_iterator< char >( in ), std::istreambuf_iterator< char >() );
+		return true;
+	}
+
+	std::string GetMessages( ID3DBlob* pErrors, const std::string& fallback )
+	{
+		if ( !pErrors )
+		{
+			return fallback;
+		}
+		return std::string( static_cast< const char* >( pErrors->GetBufferPointer() ), pErrors->GetBufferSize() );
+	}
+
+	// Keeps every file it hands out open until D3DPreprocess closes it, and writes down what it read.
+	class IncludeHandler : public ID3DInclude
+	{
+	public:
+		IncludeHandler( std::filesystem::path directory, std::vector< ShaderSourceFile >& files ) :
+			m_directory( std::move( directory ) ),
+			m_files( files )
+		{
+		}
+
+		HRESULT __stdcall Open( D3D_INCLUDE_TYPE, LPCSTR pFileName, LPCVOID pParentData, LPCVOID* ppData, UINT* pBytes ) override
+		{
+			const auto parent = m_open.find( pParentData );
+			const std::filesystem::path& parentDirectory = ( parent != m_open.end() ) ? parent->second.directory : m_directory;
+			for ( const std::filesystem::path& directory : { parentDirectory, m_directory } )
+			{
+				const std::filesystem::path path = ( directory / pFileName ).lexically_normal();
+				std::unique_ptr< std::vector< char > > spContents = std::make_unique< std::vector< char > >();
+				if ( !ReadSource( path, *spContents ) )
+				{
+					continue;
+				}
+
+				m_files.push_back( { path, spContents->size(), ShaderCache::HashContents( spContents->data(), spContents->size() ) } );
+				*ppData = spContents->data();
+				*pBytes = static_cast< UINT >( spContents->size() );
+				m_open[ spContents->data() ] = { std::move( spContents ), path.parent_path() };
+				return S_OK;
+			}
+			return E_FAIL;
+		}
+
+		HRESULT __stdcall Close( LPCVOID pData ) override
+		{
+			m_open.erase( pData );
+			return S_OK;
+		}
+
+	private:
+		struct OpenFile
+		{
+			std::unique_ptr< std::vector< char > > spContents;
+			std::filesystem::path directory;
+		};
+
+		const std::filesystem::path m_directory;
+		std::vector< ShaderSourceFile >& m_files;
+		std::map< const void*, OpenFile > m_open;	// by the pointer D3DPreprocess hands back as the parent.
+	};
+
+	// Whichever DLL D3DCompile resolved to, its path can differ from what the headers were written for.
+	std::filesystem::path GetCompilerPath()
+	{
+		HMODULE hModule = nullptr;
+		if ( !GetModuleHandleExW( GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+								  reinterpret_cast< LPCWSTR >( &D3DCompile ), &hModule ) )
+		{
+			throw std::runtime_error( "Failed to find the module of D3DCompile" );
+		}
+
+		std::wstring path( MAX_PATH, L'\0' );
+		for ( ;; )
+		{
+			const DWORD length = GetModuleFileNameW( hModule, path.data(), static_cast< DWORD >( path.size() ) );
+			if ( length == 0 )
+			{
+				throw std::runtime_error( "Failed to get the path of the shader compiler" );
+			}
+			if ( length < path.size() )
+			{
+				path.resize( length );
+				return path;
+			}
+			path.resize( path.size() * 2 );
+		}
+	}
+
+	// The file version when the DLL has one, otherwise its contents.
+	uint64_t HashCompiler( const std::filesystem::path& path )
+	{
+		Hasher kHasher;
+		kHasher.Add( static_cast< uint64_t >( D3D_COMPILER_VERSION ) );
+
+		DWORD handle = 0;
+		const DWORD infoSize = GetFileVersionInfoSizeW( path.c_str(), &handle );
+		std::vector< uint8_t > info( infoSize );
+		VS_FIXEDFILEINFO* pFixedInfo = nullptr;
+		UINT fixedInfoSize = 0;
+		if ( infoSize != 0 && GetFileVersionInfoW( path.c_str(), 0, infoSize, info.data() ) &&
+			 VerQueryValueW( info.data(), L"\\", reinterpret_cast< void** >( &pFixedInfo ), &fixedInfoSize ) &&
+			 fixedInfoSize >= sizeof( VS_FIXEDFILEINFO ) )
+		{
+			kHasher.Add( static_cast< uint32_t >( pFixedInfo->dwFileVersionMS ) );
+			kHasher.Add( static_cast< uint32_t >( pFixedInfo->dwFileVersionLS ) );
+			return kHasher.GetHash();
+		}
+
+		std::vector< char > contents;
+		if ( !ReadSource( path, contents ) )
+		{
+			throw std::runtime_error( "Failed to read " + path.string() );
+		}
+		kHasher.AddBlob( contents.data(), contents.size() );
+		return kHasher.GetHash();
+	}
+}
+
+D3DShaderCompiler::D3DShaderCompiler() :
+	m_version( HashCompiler( GetCompilerPath() ) )
+{
+}
+
+PreprocessedShader D3DShaderCompiler::Preprocess( const ShaderCompileDesc& kDesc )
+{
+	const std::string sourceName = kDesc.sourcePath.string();
+	std::vector< char > source;
+	if ( !ReadSource( kDesc.sourcePath, source ) )
+	{
+		throw std::runtime_error( "Failed to open " + sourceName );
+	}
+
+	PreprocessedShader kResult;
+	kResult.files.push_back( { kDesc.sourcePath, source.size(), ShaderCache::HashContents( source.data(), source.size() ) } );
+	IncludeHandler kIncludes( kDesc.sourcePath.parent_path(), kResult.files );
+
+	std::vector< D3D_SHADER_MACRO > macros;
+	for ( const ShaderDefine& kDefine : kDesc.defines )
+	{
+		macros.push_back( { kDefine.name.c_str(), kDefine.value.c_str() } );
+	}
+	macros.push_back( { nullptr, nullptr } );
+
+	Microsoft::WRL::ComPtr< ID3DBlob > spText;
+	Microsoft::WRL::ComPtr< ID3DBlob > spErrors;
+	if ( FAILED( D3DPreprocess( source.data(), source.size(), sourceName.c_str(), macros.data(), &kIncludes, &spText, &spErrors ) ) )
+	{
+		throw std::runtime_error( GetMessages( spErrors.Get(), "Failed to preprocess " + sourceName ) );
+	}
+
+	// The text comes with its terminating zero.
+	kResult.source.assign( static_cast< const char* >( spText->GetBufferPointer() ), spText->GetBufferSize() );
+	while ( !kResult.source.empty() && kResult.source.back() == '\0' )
+	{
+		kResult.source.pop_back();
+	}
+	return kResult;
+}
+
+void D3DShaderCompiler::Compile( const ShaderCompileDesc& kDesc, const std::string& source, std::vector< uint8_t >& bytecode,
+								 std::vector< ShaderBinding >& bindings )
+{
+	const std::string sourceName = kDesc.sourcePath.string();
+	Microsoft::WRL::ComPtr< ID3DBlob > spCode;
+	Microsoft::WRL::ComPtr< ID3DBlob > spErrors;
+	if ( FAILED( D3DCompile( source.data(), source.size(), sourceName.c_str(), nullptr, nullptr, kDesc.entryPoint.c_str(),
+							 kDesc.target.c_str(), kDesc.flags, 0, &spCode, &spErrors ) ) )
+	{
+		throw std::runtime_error( GetMessages( spErrors.Get(), "Failed to compile " + kDesc.entryPoint + " in " + sourceName ) );
+	}
+	const uint8_t* pCode = static_cast< const uint8_t* >( spCode->GetBufferPointer() );
+	bytecode.assign( pCode, pCode + spCode->GetBufferSize() );
+
+	Microsoft::WRL::ComPtr< ID3D12ShaderReflection > spReflection;
+	ThrowIfFailed( D3DReflect( bytecode.data(), bytecode.size(), IID_PPV_ARGS( &spReflection ) ) );
+	D3D12_SHADER_DESC kShaderDesc = {};
+	ThrowIfFailed( spReflection->GetDesc( &kShaderDesc ) );
+	for ( UINT n = 0; n < kShaderDesc.BoundResources; ++n )
+	{
+		D3D12_SHADER_INPUT_BIND_DESC kBind = {};
+		ThrowIfFailed( spReflection->GetResourceBindingDesc( n, &kBind ) );
+		ShaderBinding kBinding = { kBind.Name, static_cast< uint32_t >( kBind.Type ), kBind.BindPoint, kBind.BindCount, kBind.Space, 0 };
+
+		D3D12_SHADER_BUFFER_DESC kBuffer = {};
+		if ( kBind.Type == D3D_SIT_CBUFFER && SUCCEEDED( spReflection->GetConstantBufferByName( kBind.Name )->GetDesc( &kBuffer ) ) )
+		{
+			kBinding.size = kBuffer.Size;
+		}
+		bindings.push_back( kBinding );
+	}
+}
@@ -1,11 +1,24 @@
 #include <stdafx.hpp>
 #include "DXSample.hpp"
+#include "FramePacer.hpp"
+#include "ThreadPool.hpp"
 
 using Microsoft::WRL::ComPtr;
 
 DXSample::DXSample( uint32_t width, uint32_t height, std::wstring title ) :
     m_title( title ),
-    m_bIsInitialized( false )
+    m_bIsInitialized( false ),
+    m_bHeadless( false ),
+    m_bUseWarpDevice( false ),
+    m_headlessFrames( 600 ),
+    m_headlessWarmupFrames( 60 ),
+    m_headlessSeconds( 0.0 ),
+    m_bMipBenchmark( false ),
+    m_bBcBenchmark( false ),
+    m_bTextureLoadBenchmark( false ),
+    m_jobThreadCount( 0 ),
+    m_framesInFlight( 2 ),
+    m_backBufferCount( 3 )
 {
     SetWidthAndHeight( width, height );
 
@@ -25,12 +38,28 @@ void DXSample::OnTick()
         return;
 	}
 
+    OnFrameBegin();
+
+    if ( m_spSimulatedClock )
+    {
+        m_spSimulatedClock->Advance( m_spSimulatedClock->GetFrequency() / 60 );
+    }
+
+    const uint64_t frequency = m_kProfileClock.GetFrequency();
+    const uint64_t tickBegin = m_kProfileClock.GetCounter();
+
 	m_kTimer.Tick( [ & ]()
 	{
 		OnUpdate( m_kTimer );
 	} );
 
+    const uint64_t updateEnd = m_kProfileClock.GetCounter();
+
     OnRender();
+
+    const uint64_t renderEnd = m_kProfileClock.GetCounter();
+    m_kLastFramePhaseTimes.updateSeconds = static_cast< double >( updateEnd - tickBegin ) / static_cast< double >( frequency );
+    m_kLastFramePhaseTimes.renderSeconds = static_cast< double >( renderEnd - updateEnd ) / static_cast< double >( frequency );
 }
 
 void DXSample::OnResuming()
@@ -42,7 +71,77 @@ void DXSample::OnResuming()
 _Use_decl_annotations_
 void DXSample::ParseCommandLineArgs( wchar_t* argv[], int argc )
 {
-    return;
+    for ( int i = 1; i < argc; ++i )
+    {
+        const bool hasValue = ( i + 1 ) < argc;
+
+        if ( _wcsicmp( argv[ i ], L"--headless" ) == 0 )
+        {
+            m_bHeadless = true;
+        }
+        else if ( _wcsicmp( argv[ i ], L"--warp" ) == 0 )
+        {
+            m_bUseWarpDevice = true;
+        }
+        else if ( _wcsicmp( argv[ i ], L"--frames" ) == 0 && hasValue )
+        {
+            m_headlessFrames = static_cast< uint32_t >( wcstoul( argv[ ++i ], nullptr, 10 ) );
+        }
+        else if ( _wcsicmp( argv[ i ], L"--warmup" ) == 0 && hasValue )
+        {
+            m_headlessWarmupFrames = static_cast< uint32_t >( wcstoul( argv[ ++i ], nullptr, 10 ) );
+        }
+        else if ( _wcsicmp( argv[ i ], L"--seconds" ) == 0 && hasValue )
+        {
+            // Overrides --frames, run until this much wall time has been measured.
+            m_headlessSeconds = wcstod( argv[ ++i ], nullptr );
+        }
+        else if ( _wcsicmp( argv[ i ], L"--report" ) == 0 && hasValue )
+        {
+            m_reportPath = argv[ ++i ];
+        }
+        else if ( _wcsicmp( argv[ i ], L"--mip-benchmark" ) == 0 )
+        {
+            m_bMipBenchmark = true;
+        }
+        else if ( _wcsicmp( argv[ i ], L"--bc-benchmark" ) == 0 )
+        {
+            m_bBcBenchmark = true;
+        }
+        else if ( _wcsicmp( argv[ i ], L"--texture-load-benchmark" ) == 0 )
+        {
+            m_bTextureLoadBenchmark = true;
+        }
+        else if ( _wcsicmp( argv[ i ], L"--threads" ) == 0 && hasValue )
+        {
+            m_jobThreadCount = static_cast< uint32_t >( wcstoul( argv[ ++i ], nullptr, 10 ) );
+        }
+        else if ( _wcsicmp( argv[ i ], L"--frames-in-flight" ) == 0 && hasValue )
+        {
+            const uint32_t framesInFlight = static_cast< uint32_t >( wcstoul( argv[ ++i ], nullptr, 10 ) );
+            m_framesInFlight = min( max( framesInFlight, 1u ), FramePacer::uMaxFramesInFlight );
+        }
+        else if ( _wcsicmp( argv[ i ], L"--back-buffers" ) == 0 && hasValue )
+        {
+            const uint32_t backBufferCount = static_cast< uint32_t >( wcstoul( argv[ ++i ], nullptr, 10 ) );
+            m_backBufferCount = min( max( backBufferCount, 2u ), uMaxBackBufferCount );
+        }
+    }
+
+    if ( m_bHeadless )
+    {
+        m_spSimulatedClock = std::make_shared< FakeClock >();
+        m_kTimer.SetClock( m_spSimulatedClock );
+    }
+}
+
+ThreadPool& DXSample::GetJobSystem()
+{
+    if ( !m_spJobSystem )
+    {
+        m_spJobSystem = std::make_unique< ThreadPool >( m_jobThreadCount );
+    }
+    return *m_spJobSystem;
 }
 
 std::wstring DXSample::GetAssetFullPath( LPCWSTR assertName )
@@ -0,0 +1,94 @@
+#include "DeferredReleaseQueue.hpp"
+#include <algorithm>
+
+DeferredReleaseQueue::DeferredReleaseQueue( ICommandBackend& kBackend, const DeferredReleaseQueueOptions& kOptions ) :
+	m_kBackend( kBackend ),
+	m_kOptions( kOptions )
+{
+}
+
+DeferredReleaseQueue::~DeferredReleaseQueue()
+{
+	ReleaseAll();
+}
+
+void DeferredReleaseQueue::Push( uint64_t fenceValue, void* pObject, ReleaseFunction pRelease, uint64_t bytes )
+{
+	if ( !m_entries.empty() )
+	{
+		fenceValue = std::max( fenceValue, m_entries.back().fenceValue );
+	}
+
+	// Only values below fenceValue are known to be signaled, waiting on fenceValue itself could wait forever.
+	if ( IsOverLimit( bytes ) )
+	{
+		ReleaseUpTo( m_kBackend.GetCompletedValue() );
+	}
+	if ( IsOverLimit( bytes ) )
+	{
+		if ( !m_entries.empty() && m_entries.front().fenceValue < fenceValue )
+		{
+			++m_kStats.stalls;
+			do
+			{
+				m_kBackend.WaitForFence( m_entries.front().fenceValue );
+				ReleaseUpTo( m_entries.front().fenceValue );
+			}
+			while ( IsOverLimit( bytes ) && !m_entries.empty() && m_entries.front().fenceValue < fenceValue );
+		}
+		if ( IsOverLimit( bytes ) )
+		{
+			++m_kStats.overflows;
+		}
+	}
+
+	m_entries.push_back( { fenceValue, bytes, pObject, pRelease } );
+	++m_kStats.pending;
+	m_kStats.pendingBytes += bytes;
+}
+
+uint32_t DeferredReleaseQueue::Collect()
+{
+	const uint64_t releasedBytes = m_kStats.releasedBytes;
+	m_kStats.releasedLastCollect = ReleaseUpTo( m_kBackend.GetCompletedValue() );
+	m_kStats.bytesReleasedLastCollect = m_kStats.releasedBytes - releasedBytes;
+	return m_kStats.releasedLastCollect;
+}
+
+void DeferredReleaseQueue::Flush()
+{
+	if ( !m_entries.empty() )
+	{
+		m_kBackend.WaitForFence( m_entries.back().fenceValue );
+	}
+	ReleaseAll();
+}
+
+void DeferredReleaseQueue::ReleaseAll()
+{
+	ReleaseUpTo( ~0ull );
+}
+
+bool DeferredReleaseQueue::IsOverLimit( uint64_t bytes ) const
+{
+	const bool bTooMany = ( m_kOptions.maxPending != 0 ) && ( m_kStats.pending + 1 > m_kOptions.maxPending );
+	const bool bTooLarge = ( m_kOptions.maxPendingBytes != 0 ) && ( m_kStats.pendingBytes + bytes > m_kOptions.maxPendingBytes );
+	return bTooMany || bTooLarge;
+}
+
+uint32_t DeferredReleaseQueue::ReleaseUpTo( uint64_t completedValue )
+{
+	uint32_t count = 0;
+	while ( !m_entries.empty() && m_entries.front().fenceValue <= completedValue )
+	{
+		const Entry kEntry = m_entries.front();
+		m_entries.pop_front();
+		--m_kStats.pending;
+		m_kStats.pendingBytes -= kEntry.bytes;
+		++m_kStats.released;
+		m_kStats.releasedBytes += kEntry.bytes;
+		kEntry.pRelease( kEntry.pObject );
+		++count;
+	}
+	return count;
+}
@@ -0,0 +1,154 @@
+#include "stdafx.hpp"
+#include "DescriptorHeap.hpp"
+#include "DXSampleHelper.hpp"
+
+void StagingDescriptorHeap::Create( ID3D12Device* pDevice, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t count )
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = count;
+	heapDesc.Type = type;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	ThrowIfFailed( pDevice->CreateDescriptorHeap( &heapDesc, IID_PPV_ARGS( m_spHeap.ReleaseAndGetAddressOf() ) ) );
+
+	m_cpuStart = m_spHeap->GetCPUDescriptorHandleForHeapStart();
+	m_descriptorSize = pDevice->GetDescriptorHandleIncrementSize( type );
+	m_kAllocator.Reset( count, 0, 0 );
+}
+
+void StagingDescriptorHeap::Destroy()
+{
+	m_spHeap.Reset();
+	m_kAllocator.Reset( 0, 0, 0 );
+}
+
+DescriptorHandle StagingDescriptorHeap::Allocate( uint32_t count )
+{
+	const uint32_t index = m_kAllocator.AllocatePersistent( count );
+	if ( index == DescriptorIndexAllocator::uInvalidIndex )
+	{
+		throw std::runtime_error( "Staging descriptor heap is full" );
+	}
+
+	DescriptorHandle handle;
+	handle.cpu = CD3DX12_CPU_DESCRIPTOR_HANDLE( m_cpuStart, static_cast< INT >( index ), m_descriptorSize );
+	handle.index = index;
+	handle.count = count;
+	return handle;
+}
+
+void StagingDescriptorHeap::Free( DescriptorHandle& handle )
+{
+	m_kAllocator.FreePersistent( handle.index, handle.count );
+	handle = {};
+}
+
+void DescriptorHeapAllocator::Create( ID3D12Device* pDevice, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t persistentCount, uint32_t frameCount, uint32_t transientCountPerFrame )
+{
+	m_kAllocator.Reset( persistentCount, frameCount, transientCountPerFrame );
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = m_kAllocator.GetCapacity();
+	heapDesc.Type = type;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed( pDevice->CreateDescriptorHeap( &heapDesc, IID_PPV_ARGS( m_spHeap.ReleaseAndGetAddressOf() ) ) );
+
+	m_spDevice = pDevice;
+	m_type = type;
+	m_cpuStart = m_spHeap->GetCPUDescriptorHandleForHeapStart();
+	m_gpuStart = m_spHeap->GetGPUDescriptorHandleForHeapStart();
+	m_descriptorSize = pDevice->GetDescriptorHandleIncrementSize( type );
+}
+
+void DescriptorHeapAllocator::Destroy()
+{
+	m_copyDestinations.clear();
+	m_copyDestinationSizes.clear();
+	m_copySources.clear();
+	m_copySourceSizes.clear();
+
+	m_spHeap.Reset();
+	m_spDevice.Reset();
+	m_kAllocator.Reset( 0, 0, 0 );
+}
+
+DescriptorHandle DescriptorHeapAllocator::MakeHandle( uint32_t index, uint32_t count ) const
+{
+	DescriptorHandle handle;
+	handle.cpu = CD3DX12_CPU_DESCRIPTOR_HANDLE( m_cpuStart, static_cast< INT >( index ), m_descriptorSize );
+	handle.gpu = CD3DX12_GPU_DESCRIPTOR_HANDLE( m_gpuStart, static_cast< INT >( index ), m_descriptorSize );
+	handle.index = index;
+	handle.count = count;
+	return handle;
+}
+
+DescriptorHandle DescriptorHeapAllocator::AllocatePersistent( uint32_t count )
+{
+	const uint32_t index = m_kAllocator.AllocatePersistent( count );
+	if ( index == DescriptorIndexAllocator::uInvalidIndex )
+	{
+		throw std::runtime_error( "Descriptor heap has no persistent space left" );
+	}
+	return MakeHandle( index, count );
+}
+
+void DescriptorHeapAllocator::Free( DescriptorHandle& handle )
+{
+	m_kAllocator.FreePersistent( handle.index, handle.count );
+	handle = {};
+}
+
+void DescriptorHeapAllocator::BeginFrame( uint32_t frameIndex )
+{
+	m_kAllocator.BeginFrame( frameIndex );
+}
+
+DescriptorHandle DescriptorHeapAllocator::AllocateTransient( uint32_t count )
+{
+	const uint32_t index = m_kAllocator.AllocateTransient( count );
+	if ( index == DescriptorIndexAllocator::uInvalidIndex )
+	{
+		throw std::runtime_error( "Descriptor heap has no transient space left for this frame" );
+	}
+	return MakeHandle( index, count );
+}
+
+void DescriptorHeapAllocator::QueueCopy( const DescriptorHandle& destination, D3D12_CPU_DESCRIPTOR_HANDLE source, uint32_t count )
+{
+	m_copyDestinations.push_back( destination.cpu );
+	m_copyDestinationSizes.push_back( count );
+	m_copySources.push_back( source );
+	m_copySourceSizes.push_back( count );
+}
+
+DescriptorHandle DescriptorHeapAllocator::CopyToTransient( const D3D12_CPU_DESCRIPTOR_HANDLE* pSources, uint32_t count )
+{
+	DescriptorHandle table = AllocateTransient( count );
+
+	// Destination is one contiguous range, sources may be scattered across the staging heap.
+	m_copyDestinations.push_back( table.cpu );
+	m_copyDestinationSizes.push_back( count );
+	for ( uint32_t n = 0; n < count; ++n )
+	{
+		m_copySources.push_back( pSources[ n ] );
+		m_copySourceSizes.push_back( 1 );
+	}
+	return table;
+}
+
+void DescriptorHeapAllocator::FlushCopies()
+{
+	if ( m_copyDestinations.empty() )
+	{
+		return;
+	}
+
+	m_spDevice->CopyDescriptors(
+		static_cast< UINT >( m_copyDestinations.size() ), m_copyDestinations.data(), m_copyDestinationSizes.data(),
+		static_cast< UINT >( m_copySources.size() ), m_copySources.data(), m_copySourceSizes.data(),
+		m_type );
+
+	m_copyDestinations.clear();
+	m_copyDestinationSizes.clear();
+	m_copySources.clear();
+	m_copySourceSizes.clear();
+}
@@ -0,0 +1,105 @@
+#include "DescriptorIndexAllocator.hpp"
+
+DescriptorIndexAllocator::DescriptorIndexAllocator( uint32_t persistentCount, uint32_t frameCount, uint32_t transientCountPerFrame )
+{
+	Reset( persistentCount, frameCount, transientCountPerFrame );
+}
+
+void DescriptorIndexAllocator::Reset( uint32_t persistentCount, uint32_t frameCount, uint32_t transientCountPerFrame )
+{
+	for ( auto& freeList : m_freeLists )
+	{
+		freeList.clear();
+	}
+
+	m_persistentCount = persistentCount;
+	m_persistentBump = 0;
+	m_persistentUsed = 0;
+
+	m_frameCount = frameCount;
+	m_transientCountPerFrame = transientCountPerFrame;
+	m_transientBegin = persistentCount;
+	m_transientOffset = 0;
+}
+
+uint32_t DescriptorIndexAllocator::SizeClass( uint32_t count )
+{
+	// Stops at uSizeClassCount for counts above 2^31, shifting by 32 would be undefined.
+	uint32_t sizeClass = 0;
+	while ( sizeClass < uSizeClassCount && ( 1u << sizeClass ) < count )
+	{
+		++sizeClass;
+	}
+	return sizeClass;
+}
+
+uint32_t DescriptorIndexAllocator::AllocatePersistent( uint32_t count )
+{
+	if ( count == 0 )
+	{
+		return uInvalidIndex;
+	}
+
+	const uint32_t sizeClass = SizeClass( count );
+	if ( sizeClass >= uSizeClassCount )
+	{
+		return uInvalidIndex;
+	}
+
+	const uint32_t blockSize = 1u << sizeClass;
+	auto& freeList = m_freeLists[ sizeClass ];
+
+	uint32_t index = uInvalidIndex;
+	if ( !freeList.empty() )
+	{
+		index = freeList.back();
+		freeList.pop_back();
+	}
+	else if ( m_persistentCount - m_persistentBump >= blockSize )
+	{
+		index = m_persistentBump;
+		m_persistentBump += blockSize;
+	}
+	else
+	{
+		return uInvalidIndex;
+	}
+
+	m_persistentUsed += blockSize;
+	return index;
+}
+
+void DescriptorIndexAllocator::FreePersistent( uint32_t index, uint32_t count )
+{
+	if ( index == uInvalidIndex || count == 0 )
+	{
+		return;
+	}
+
+	const uint32_t sizeClass = SizeClass( count );
+	if ( sizeClass >= uSizeClassCount )
+	{
+		return;
+	}
+
+	m_freeLists[ sizeClass ].push_back( index );
+	m_persistentUsed -= 1u << sizeClass;
+}
+
+void DescriptorIndexAllocator::BeginFrame( uint32_t frameIndex )
+{
+	m_transientBegin = m_persistentCount + frameIndex * m_transientCountPerFrame;
+	m_transientOffset = 0;
+}
+
+uint32_t DescriptorIndexAllocator::AllocateTransient( uint32_t count )
+{
+	if ( count == 0 || m_transientCountPerFrame - m_transientOffset < count )
+	{
+		return uInvalidIndex;
+	}
+
+	const uint32_t index = m_transientBegin + m_transientOffset;
+	m_transientOffset += count;
+	return index;
+}
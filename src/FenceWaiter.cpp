@@ -0,0 +1,190 @@
+#include "FenceWaiter.hpp"
+#include <algorithm>
+#include <memory>
+#include <system_error>
+
+#if defined( _WIN32 )
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+
+FenceEvent::FenceEvent()
+{
+#if defined( _WIN32 )
+	m_pHandle = CreateEventEx( nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE );
+	if ( !m_pHandle )
+	{
+		throw std::system_error( std::error_code( static_cast< int >( GetLastError() ), std::system_category() ), "CreateEventEx" );
+	}
+#endif
+}
+
+FenceEvent::~FenceEvent()
+{
+#if defined( _WIN32 )
+	CloseHandle( m_pHandle );
+#endif
+}
+
+void FenceEvent::Set()
+{
+#if defined( _WIN32 )
+	SetEvent( m_pHandle );
+#else
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_bSet = true;
+	}
+	m_condition.notify_one();
+#endif
+}
+
+void FenceEvent::Wait()
+{
+#if defined( _WIN32 )
+	WaitForSingleObjectEx( m_pHandle, INFINITE, FALSE );
+#else
+	std::unique_lock< std::mutex > lock( m_mutex );
+	m_condition.wait( lock, [ this ]() { return m_bSet; } );
+	m_bSet = false;
+#endif
+}
+
+FenceWaiter::FenceWaiter() :
+	m_thread( &FenceWaiter::ThreadLoop, this )
+{
+}
+
+FenceWaiter::~FenceWaiter()
+{
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_bStopping = true;
+	}
+	m_kEvent.Set();
+	m_thread.join();
+}
+
+void FenceWaiter::OnCompletion( IWatchedFence& kFence, uint64_t value, std::function< void() > callback )
+{
+	bool bRearm = false;
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		auto it = std::find_if( m_watches.begin(), m_watches.end(), [ & ]( const Watch& kWatch ) { return kWatch.pFence == &kFence; } );
+		if ( it == m_watches.end() )
+		{
+			m_watches.push_back( { &kFence, 0, {} } );
+			it = m_watches.end() - 1;
+		}
+
+		// The thread only has to look again when this is now the earliest value of the fence.
+		bRearm = it->callbacks.empty() || value < it->callbacks.begin()->first;
+		it->callbacks.emplace( value, std::move( callback ) );
+	}
+	if ( bRearm )
+	{
+		m_kEvent.Set();
+	}
+}
+
+std::future< void > FenceWaiter::WhenComplete( IWatchedFence& kFence, uint64_t value, std::function< void() > callback )
+{
+	// std::function needs something copyable, the promise is shared.
+	auto spPromise = std::make_shared< std::promise< void > >();
+	std::future< void > future = spPromise->get_future();
+	OnCompletion( kFence, value, [ spPromise, callback = std::move( callback ) ]()
+	{
+		try
+		{
+			if ( callback )
+			{
+				callback();
+			}
+			spPromise->set_value();
+		}
+		catch ( ... )
+		{
+			spPromise->set_exception( std::current_exception() );
+		}
+	} );
+	return future;
+}
+
+void FenceWaiter::Wait( IWatchedFence& kFence, uint64_t value )
+{
+	if ( kFence.GetCompletedValue() >= value )
+	{
+		return;
+	}
+	WhenComplete( kFence, value ).get();
+}
+
+void FenceWaiter::Cancel( IWatchedFence& kFence )
+{
+	std::lock_guard< std::mutex > lock( m_mutex );
+	m_watches.erase( std::remove_if( m_watches.begin(), m_watches.end(), [ & ]( const Watch& kWatch ) { return kWatch.pFence == &kFence; } ), m_watches.end() );
+}
+
+FenceWaiterStats FenceWaiter::GetStats() const
+{
+	FenceWaiterStats kStats;
+	// Pairs with the release after a batch, what the counted callbacks wrote is visible to the caller.
+	kStats.callbacksRun = m_callbacksRun.load( std::memory_order_acquire );
+	kStats.wakeups = m_wakeups.load( std::memory_order_relaxed );
+	return kStats;
+}
+
+void FenceWaiter::ThreadLoop()
+{
+	std::vector< std::function< void() > > ready;
+	for ( ;; )
+	{
+		{
+			std::lock_guard< std::mutex > lock( m_mutex );
+			if ( m_bStopping )
+			{
+				return;
+			}
+
+			for ( Watch& kWatch : m_watches )
+			{
+				const uint64_t completedValue = kWatch.pFence->GetCompletedValue();
+				const auto end = kWatch.callbacks.upper_bound( completedValue );
+				for ( auto it = kWatch.callbacks.begin(); it != end; ++it )
+				{
+					ready.push_back( std::move( it->second ) );
+				}
+				kWatch.callbacks.erase( kWatch.callbacks.begin(), end );
+
+				// Only the earliest value needs the event, the later ones are checked once it fires.
+				// Checking first and arming after is fine, the event is set right away when the value already passed.
+				if ( !kWatch.callbacks.empty() && kWatch.callbacks.begin()->first != kWatch.armedValue )
+				{
+					kWatch.armedValue = kWatch.callbacks.begin()->first;
+					kWatch.pFence->SetEventOnCompletion( kWatch.armedValue, m_kEvent );
+				}
+			}
+			m_watches.erase( std::remove_if( m_watches.begin(), m_watches.end(), []( const Watch& kWatch ) { return kWatch.callbacks.empty(); } ), m_watches.end() );
+		}
+
+		if ( ready.empty() )
+		{
+			m_kEvent.Wait();
+			m_wakeups.fetch_add( 1, std::memory_order_relaxed );
+			continue;
+		}
+
+		// Outside the lock, so callbacks can register more.
+		for ( auto& callback : ready )
+		{
+			callback();
+		}
+		m_callbacksRun.fetch_add( ready.size(), std::memory_order_release );
+		ready.clear();
+	}
+}
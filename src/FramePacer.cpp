@@ -0,0 +1,96 @@
+#include "FramePacer.hpp"
+#include <algorithm>
+
+namespace
+{
+	// Weight of the newest sample, about the last 10 frames count.
+	const double s_smoothing = 0.1;
+
+	void Smooth( double& average, double sample, bool bFirst )
+	{
+		average = bFirst ? sample : average + ( sample - average ) * s_smoothing;
+	}
+}
+
+FramePacer::FramePacer( ICommandBackend& kBackend, const IClock& kClock, uint32_t framesInFlight ) :
+	m_kBackend( kBackend ),
+	m_kClock( kClock ),
+	m_framesInFlight( std::min( std::max( framesInFlight, 1u ), uMaxFramesInFlight ) )
+{
+}
+
+uint32_t FramePacer::BeginFrame()
+{
+	if ( m_bInFrame )
+	{
+		return m_slot;
+	}
+	m_bInFrame = true;
+
+	const uint64_t counter = m_kClock.GetCounter();
+	const double frequency = static_cast< double >( m_kClock.GetFrequency() );
+	if ( m_frameCount > 0 )
+	{
+		Smooth( m_kStats.frameIntervalSeconds, static_cast< double >( counter - m_lastBeginCounter ) / frequency, m_frameCount == 1 );
+	}
+	m_lastBeginCounter = counter;
+	++m_frameCount;
+	MeasureCompletedFrames( counter );
+
+	Slot& kSlot = m_slots[ m_slot ];
+	if ( m_kBackend.GetCompletedValue() < kSlot.fenceValue )
+	{
+		++m_kStats.fenceWaits;
+		m_kBackend.WaitForFence( kSlot.fenceValue );
+		MeasureCompletedFrames( m_kClock.GetCounter() );
+	}
+	kSlot.beginCounter = m_kClock.GetCounter();
+	return m_slot;
+}
+
+void FramePacer::EndFrame( uint64_t fenceValue, uint64_t presentId )
+{
+	Slot& kSlot = m_slots[ m_slot ];
+	kSlot.fenceValue = fenceValue;
+	kSlot.bMeasured = false;
+
+	PresentedFrame& kFrame = m_history[ m_endedCount++ % uHistorySize ];
+	kFrame.presentId = presentId;
+	kFrame.beginCounter = kSlot.beginCounter;
+	kFrame.bShown = false;
+
+	m_slot = ( m_slot + 1 ) % m_framesInFlight;
+	m_bInFrame = false;
+}
+
+void FramePacer::OnFrameShown( uint64_t presentId, uint64_t counter )
+{
+	for ( PresentedFrame& kFrame : m_history )
+	{
+		if ( !kFrame.bShown && kFrame.presentId == presentId && counter >= kFrame.beginCounter )
+		{
+			const bool bFirst = m_kStats.inputToPresentSeconds == 0.0;
+			const double seconds = static_cast< double >( counter - kFrame.beginCounter ) / static_cast< double >( m_kClock.GetFrequency() );
+			Smooth( m_kStats.inputToPresentSeconds, seconds, bFirst );
+			kFrame.bShown = true;
+			return;
+		}
+	}
+}
+
+void FramePacer::MeasureCompletedFrames( uint64_t counter )
+{
+	// Completion is only noticed here, so a frame that finished early is counted as late as this call.
+	const uint64_t completedValue = m_kBackend.GetCompletedValue();
+	const double frequency = static_cast< double >( m_kClock.GetFrequency() );
+	for ( uint32_t n = 0; n < m_framesInFlight; ++n )
+	{
+		Slot& kSlot = m_slots[ n ];
+		if ( !kSlot.bMeasured && kSlot.fenceValue <= completedValue )
+		{
+			const bool bFirst = m_kStats.inputToGpuSeconds == 0.0;
+			Smooth( m_kStats.inputToGpuSeconds, static_cast< double >( counter - kSlot.beginCounter ) / frequency, bFirst );
+			kSlot.bMeasured = true;
+		}
+	}
+}
@@ -0,0 +1,318 @@
+#include "FrustumCuller.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined( _M_X64 ) || defined( _M_AMD64 ) || defined( __SSE2__ )
+#define CULL_SSE 1
+#include <emmintrin.h>
+#if defined( __AVX2__ )
+#define CULL_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+namespace
+{
+	struct BoundsArrays
+	{
+		const float* pCenterX;
+		const float* pCenterY;
+		const float* pCenterZ;
+		const float* pExtentX;
+		const float* pExtentY;
+		const float* pExtentZ;
+		const float* pRadius;
+	};
+
+	// Writes the visible indices of [begin, end) to pOut and returns how many there were.
+	template< bool bBoxes >
+	uint32_t CullRangeScalar( const BoundsArrays& kBounds, const FrustumPlanes& kFrustum, uint32_t begin, uint32_t end, uint32_t* pOut )
+	{
+		uint32_t count = 0;
+		for ( uint32_t i = begin; i < end; ++i )
+		{
+			bool bVisible = true;
+			for ( uint32_t p = 0; p < 6; ++p )
+			{
+				const float* pPlane = kFrustum.planes[ p ];
+				// Same association as the SIMD paths so every path gives the same answer on the plane.
+				const float distance = ( pPlane[ 0 ] * kBounds.pCenterX[ i ] + pPlane[ 1 ] * kBounds.pCenterY[ i ] ) + ( pPlane[ 2 ] * kBounds.pCenterZ[ i ] + pPlane[ 3 ] );
+				const float radius = bBoxes ? fabsf( pPlane[ 0 ] ) * kBounds.pExtentX[ i ] + fabsf( pPlane[ 1 ] ) * kBounds.pExtentY[ i ] + fabsf( pPlane[ 2 ] ) * kBounds.pExtentZ[ i ]
+											: kBounds.pRadius[ i ];
+				bVisible &= distance + radius >= 0.0f;
+			}
+			// Branchless compaction, the slot is always written and only kept when visible.
+			pOut[ count ] = i;
+			count += bVisible ? 1 : 0;
+		}
+		return count;
+	}
+
+#if CULL_SSE
+	template< bool bBoxes >
+	uint32_t CullRangeSse( const BoundsArrays& kBounds, const FrustumPlanes& kFrustum, uint32_t begin, uint32_t end, uint32_t* pOut )
+	{
+		__m128 planes[ 6 ][ 4 ];
+		__m128 absolutes[ 6 ][ 3 ];
+		for ( uint32_t p = 0; p < 6; ++p )
+		{
+			for ( uint32_t c = 0; c < 4; ++c )
+			{
+				planes[ p ][ c ] = _mm_set1_ps( kFrustum.planes[ p ][ c ] );
+			}
+			for ( uint32_t c = 0; c < 3; ++c )
+			{
+				absolutes[ p ][ c ] = _mm_set1_ps( fabsf( kFrustum.planes[ p ][ c ] ) );
+			}
+		}
+		const __m128 zero = _mm_setzero_ps();
+
+		uint32_t count = 0;
+		uint32_t i = begin;
+		for ( ; i + 4 <= end; i += 4 )
+		{
+			const __m128 x = _mm_loadu_ps( kBounds.pCenterX + i );
+			const __m128 y = _mm_loadu_ps( kBounds.pCenterY + i );
+			const __m128 z = _mm_loadu_ps( kBounds.pCenterZ + i );
+			__m128 ex = zero, ey = zero, ez = zero, radius = zero;
+			if constexpr ( bBoxes )
+			{
+				ex = _mm_loadu_ps( kBounds.pExtentX + i );
+				ey = _mm_loadu_ps( kBounds.pExtentY + i );
+				ez = _mm_loadu_ps( kBounds.pExtentZ + i );
+			}
+			else
+			{
+				radius = _mm_loadu_ps( kBounds.pRadius + i );
+			}
+
+			__m128 inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+			for ( uint32_t p = 0; p < 6; ++p )
+			{
+				__m128 distance = _mm_add_ps( _mm_add_ps( _mm_mul_ps( planes[ p ][ 0 ], x ), _mm_mul_ps( planes[ p ][ 1 ], y ) ),
+											  _mm_add_ps( _mm_mul_ps( planes[ p ][ 2 ], z ), planes[ p ][ 3 ] ) );
+				if constexpr ( bBoxes )
+				{
+					radius = _mm_add_ps( _mm_add_ps( _mm_mul_ps( absolutes[ p ][ 0 ], ex ), _mm_mul_ps( absolutes[ p ][ 1 ], ey ) ), _mm_mul_ps( absolutes[ p ][ 2 ], ez ) );
+				}
+				distance = _mm_add_ps( distance, radius );
+				inside = _mm_and_ps( inside, _mm_cmpge_ps( distance, zero ) );
+			}
+
+			const int mask = _mm_movemask_ps( inside );
+			pOut[ count ] = i;
+			count += mask & 1;
+			pOut[ count ] = i + 1;
+			count += ( mask >> 1 ) & 1;
+			pOut[ count ] = i + 2;
+			count += ( mask >> 2 ) & 1;
+			pOut[ count ] = i + 3;
+			count += ( mask >> 3 ) & 1;
+		}
+		return count + CullRangeScalar< bBoxes >( kBounds, kFrustum, i, end, pOut + count );
+	}
+#endif
+
+#if CULL_AVX2
+	template< bool bBoxes >
+	uint32_t CullRangeAvx2( const BoundsArrays& kBounds, const FrustumPlanes& kFrustum, uint32_t begin, uint32_t end, uint32_t* pOut )
+	{
+		__m256 planes[ 6 ][ 4 ];
+		__m256 absolutes[ 6 ][ 3 ];
+		for ( uint32_t p = 0; p < 6; ++p )
+		{
+			for ( uint32_t c = 0; c < 4; ++c )
+			{
+				planes[ p ][ c ] = _mm256_set1_ps( kFrustum.planes[ p ][ c ] );
+			}
+			for ( uint32_t c = 0; c < 3; ++c )
+			{
+				absolutes[ p ][ c ] = _mm256_set1_ps( fabsf( kFrustum.planes[ p ][ c ] ) );
+			}
+		}
+		const __m256 zero = _mm256_setzero_ps();
+
+		uint32_t count = 0;
+		uint32_t i = begin;
+		for ( ; i + 8 <= end; i += 8 )
+		{
+			const __m256 x = _mm256_loadu_ps( kBounds.pCenterX + i );
+			const __m256 y = _mm256_loadu_ps( kBounds.pCenterY + i );
+			const __m256 z = _mm256_loadu_ps( kBounds.pCenterZ + i );
+			__m256 ex = zero, ey = zero, ez = zero, radius = zero;
+			if constexpr ( bBoxes )
+			{
+				ex = _mm256_loadu_ps( kBounds.pExtentX + i );
+				ey = _mm256_loadu_ps( kBounds.pExtentY + i );
+				ez = _mm256_loadu_ps( kBounds.pExtentZ + i );
+			}
+			else
+			{
+				radius = _mm256_loadu_ps( kBounds.pRadius + i );
+			}
+
+			__m256 inside = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+			for ( uint32_t p = 0; p < 6; ++p )
+			{
+				__m256 distance = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( planes[ p ][ 0 ], x ), _mm256_mul_ps( planes[ p ][ 1 ], y ) ),
+												 _mm256_add_ps( _mm256_mul_ps( planes[ p ][ 2 ], z ), planes[ p ][ 3 ] ) );
+				if constexpr ( bBoxes )
+				{
+					radius = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( absolutes[ p ][ 0 ], ex ), _mm256_mul_ps( absolutes[ p ][ 1 ], ey ) ), _mm256_mul_ps( absolutes[ p ][ 2 ], ez ) );
+				}
+				distance = _mm256_add_ps( distance, radius );
+				inside = _mm256_and_ps( inside, _mm256_cmp_ps( distance, zero, _CMP_GE_OQ ) );
+			}
+
+			const int mask = _mm256_movemask_ps( inside );
+			for ( uint32_t lane = 0; lane < 8; ++lane )
+			{
+				pOut[ count ] = i + lane;
+				count += ( mask >> lane ) & 1;
+			}
+		}
+		return count + CullRangeSse< bBoxes >( kBounds, kFrustum, i, end, pOut + count );
+	}
+#endif
+
+	template< bool bBoxes >
+	uint32_t CullRange( const BoundsArrays& kBounds, const FrustumPlanes& kFrustum, uint32_t begin, uint32_t end, bool bSimd, uint32_t* pOut )
+	{
+#if CULL_AVX2
+		if ( bSimd )
+		{
+			return CullRangeAvx2< bBoxes >( kBounds, kFrustum, begin, end, pOut );
+		}
+#elif CULL_SSE
+		if ( bSimd )
+		{
+			return CullRangeSse< bBoxes >( kBounds, kFrustum, begin, end, pOut );
+		}
+#else
+		( void )bSimd;
+#endif
+		return CullRangeScalar< bBoxes >( kBounds, kFrustum, begin, end, pOut );
+	}
+}
+
+FrustumPlanes FrustumCuller::ExtractPlanes( const float viewProj[ 16 ] )
+{
+	// clip = v * M, so clip.x is v dotted with column 0 of M. Gribb / Hartmann with D3D's 0 <= z <= w.
+	auto Column = [ & ]( uint32_t column, uint32_t row ) { return viewProj[ row * 4 + column ]; };
+
+	FrustumPlanes kFrustum;
+	for ( uint32_t row = 0; row < 4; ++row )
+	{
+		kFrustum.planes[ 0 ][ row ] = Column( 3, row ) + Column( 0, row );	// left
+		kFrustum.planes[ 1 ][ row ] = Column( 3, row ) - Column( 0, row );	// right
+		kFrustum.planes[ 2 ][ row ] = Column( 3, row ) + Column( 1, row );	// bottom
+		kFrustum.planes[ 3 ][ row ] = Column( 3, row ) - Column( 1, row );	// top
+		kFrustum.planes[ 4 ][ row ] = Column( 2, row );						// near
+		kFrustum.planes[ 5 ][ row ] = Column( 3, row ) - Column( 2, row );	// far
+	}
+
+	for ( auto& plane : kFrustum.planes )
+	{
+		const float length = sqrtf( plane[ 0 ] * plane[ 0 ] + plane[ 1 ] * plane[ 1 ] + plane[ 2 ] * plane[ 2 ] );
+		if ( length > 0.0f )
+		{
+			for ( float& value : plane )
+			{
+				value /= length;
+			}
+		}
+	}
+	return kFrustum;
+}
+
+void FrustumCuller::Clear()
+{
+	for ( auto* pArray : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ, &m_radius } )
+	{
+		pArray->clear();
+	}
+}
+
+void FrustumCuller::Reserve( uint32_t count )
+{
+	for ( auto* pArray : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ, &m_radius } )
+	{
+		pArray->reserve( count );
+	}
+}
+
+uint32_t FrustumCuller::AddObject( const float boxMin[ 3 ], const float boxMax[ 3 ] )
+{
+	const uint32_t index = GetObjectCount();
+	for ( auto* pArray : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ, &m_radius } )
+	{
+		pArray->push_back( 0.0f );
+	}
+	SetBounds( index, boxMin, boxMax );
+	return index;
+}
+
+void FrustumCuller::SetBounds( uint32_t index, const float boxMin[ 3 ], const float boxMax[ 3 ] )
+{
+	const float extent[ 3 ] =
+	{
+		( boxMax[ 0 ] - boxMin[ 0 ] ) * 0.5f,
+		( boxMax[ 1 ] - boxMin[ 1 ] ) * 0.5f,
+		( boxMax[ 2 ] - boxMin[ 2 ] ) * 0.5f,
+	};
+	m_centerX[ index ] = boxMin[ 0 ] + extent[ 0 ];
+	m_centerY[ index ] = boxMin[ 1 ] + extent[ 1 ];
+	m_centerZ[ index ] = boxMin[ 2 ] + extent[ 2 ];
+	m_extentX[ index ] = extent[ 0 ];
+	m_extentY[ index ] = extent[ 1 ];
+	m_extentZ[ index ] = extent[ 2 ];
+	m_radius[ index ] = sqrtf( extent[ 0 ] * extent[ 0 ] + extent[ 1 ] * extent[ 1 ] + extent[ 2 ] * extent[ 2 ] );
+}
+
+void FrustumCuller::CullSpheres( const FrustumPlanes& kFrustum, std::vector< uint32_t >& visible, const FrustumCullOptions& kOptions, ThreadPool* pPool ) const
+{
+	Cull< false >( kFrustum, visible, kOptions, pPool );
+}
+
+void FrustumCuller::CullBoxes( const FrustumPlanes& kFrustum, std::vector< uint32_t >& visible, const FrustumCullOptions& kOptions, ThreadPool* pPool ) const
+{
+	Cull< true >( kFrustum, visible, kOptions, pPool );
+}
+
+template< bool bBoxes >
+void FrustumCuller::Cull( const FrustumPlanes& kFrustum, std::vector< uint32_t >& visible, const FrustumCullOptions& kOptions, ThreadPool* pPool ) const
+{
+	const BoundsArrays kBounds = { m_centerX.data(), m_centerY.data(), m_centerZ.data(), m_extentX.data(), m_extentY.data(), m_extentZ.data(), m_radius.data() };
+	const uint32_t objectCount = GetObjectCount();
+
+	// Worst case everything is visible, every range writes into its own slice and the slices are packed afterwards.
+	visible.resize( objectCount );
+	if ( !pPool || objectCount < kOptions.parallelThreshold )
+	{
+		visible.resize( CullRange< bBoxes >( kBounds, kFrustum, 0, objectCount, kOptions.useSimd, visible.data() ) );
+		return;
+	}
+
+	const uint32_t grainSize = std::max( kOptions.grainSize, 8u );
+	const uint32_t chunkCount = ( objectCount + grainSize - 1 ) / grainSize;
+	std::vector< uint32_t > chunkVisible( chunkCount );
+	pPool->ParallelFor( chunkCount, 1, [ & ]( uint32_t chunkBegin, uint32_t chunkEnd )
+	{
+		for ( uint32_t chunk = chunkBegin; chunk < chunkEnd; ++chunk )
+		{
+			const uint32_t begin = chunk * grainSize;
+			const uint32_t end = std::min( begin + grainSize, objectCount );
+			chunkVisible[ chunk ] = CullRange< bBoxes >( kBounds, kFrustum, begin, end, kOptions.useSimd, visible.data() + begin );
+		}
+	} );
+
+	uint32_t count = chunkVisible[ 0 ];
+	for ( uint32_t chunk = 1; chunk < chunkCount; ++chunk )
+	{
+		memmove( visible.data() + count, visible.data() + chunk * grainSize, chunkVisible[ chunk ] * sizeof( uint32_t ) );
+		count += chunkVisible[ chunk ];
+	}
+	visible.resize( count );
+}
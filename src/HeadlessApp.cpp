@@ -0,0 +1,486 @@
+#include "stdafx.hpp"
+#include <psapi.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include "HeadlessApp.hpp"
+#include "DXSample.hpp"
+#include "FrameTimeHistogram.hpp"
+#include "Texture.hpp"
+#include "MipGenerator.hpp"
+#include "BlockCompressor.hpp"
+#include "TextureContainer.hpp"
+
+namespace
+{
+	// Histograms are filled with nanoseconds.
+	constexpr double kNanosecondsPerMillisecond = 1000000.0;
+
+	uint64_t SecondsToNanoseconds( double seconds )
+	{
+		return static_cast< uint64_t >( seconds * 1000000000.0 );
+	}
+
+	PROCESS_MEMORY_COUNTERS GetMemoryCounters()
+	{
+		PROCESS_MEMORY_COUNTERS kCounters = {};
+		GetProcessMemoryInfo( GetCurrentProcess(), &kCounters, sizeof( kCounters ) );
+		return kCounters;
+	}
+
+	double ToMegabytes( SIZE_T bytes )
+	{
+		return static_cast< double >( bytes ) / ( 1024.0 * 1024.0 );
+	}
+
+	// The highest working set since construction, above what it was then. The process peak can not be reset between
+	// two measurements, so a thread polls the current working set until Stop.
+	class WorkingSetPeak
+	{
+	public:
+		WorkingSetPeak() :
+			m_baseline( GetMemoryCounters().WorkingSetSize ),
+			m_peak( m_baseline ),
+			m_thread( [ this ]()
+			{
+				while ( !m_bStop.load( std::memory_order_relaxed ) )
+				{
+					m_peak = std::max( m_peak, GetMemoryCounters().WorkingSetSize );
+				}
+			} )
+		{
+		}
+
+		SIZE_T Stop()
+		{
+			m_bStop.store( true, std::memory_order_relaxed );
+			m_thread.join();
+			m_peak = std::max( m_peak, GetMemoryCounters().WorkingSetSize );
+			return m_peak - m_baseline;
+		}
+
+	private:
+		const SIZE_T m_baseline;
+		SIZE_T m_peak;
+		std::atomic< bool > m_bStop{ false };
+		std::thread m_thread;
+	};
+
+	// Where each level goes in upload memory, at the footprints GetCopyableFootprints hands out: rows padded to
+	// 256 bytes and levels placed on 512 bytes. upload is resized to hold all of them.
+	std::vector< Texture2DDestination > MakeUploadLayout( const Texture2DInfo& kInfo, std::vector< uint8_t >& upload, std::vector< size_t >& rowCounts )
+	{
+		std::vector< Texture2DDestination > destinations( kInfo.mipCount );
+		std::vector< size_t > offsets( kInfo.mipCount );
+		rowCounts.resize( kInfo.mipCount );
+		size_t size = 0;
+		uint32_t width = kInfo.width;
+		uint32_t height = kInfo.height;
+		for ( uint32_t n = 0; n < kInfo.mipCount; ++n )
+		{
+			const size_t rowBytes = kInfo.compressed ? BlockCompressor::GetRowPitch( kInfo.blockFormat, width ) : static_cast< size_t >( width ) * 4;
+			rowCounts[ n ] = kInfo.compressed ? ( height + 3 ) / 4 : height;
+			destinations[ n ].rowPitch = ( rowBytes + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1 ) & ~static_cast< size_t >( D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1 );
+			offsets[ n ] = ( size + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1 ) & ~static_cast< size_t >( D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1 );
+			size = offsets[ n ] + destinations[ n ].rowPitch * rowCounts[ n ];
+			width = std::max( 1u, width / 2 );
+			height = std::max( 1u, height / 2 );
+		}
+
+		upload.resize( size );
+		for ( uint32_t n = 0; n < kInfo.mipCount; ++n )
+		{
+			destinations[ n ].pData = upload.data() + offsets[ n ];
+		}
+		return destinations;
+	}
+
+	void WritePhase( std::ostringstream& out, const char* name, const FrameTimeHistogram& kHistogram, bool last )
+	{
+		out << "    \"" << name << "\": { "
+			<< "\"meanMs\": " << kHistogram.GetMean() / kNanosecondsPerMillisecond << ", "
+			<< "\"p50Ms\": " << kHistogram.GetP50() / kNanosecondsPerMillisecond << ", "
+			<< "\"p95Ms\": " << kHistogram.GetP95() / kNanosecondsPerMillisecond << ", "
+			<< "\"p99Ms\": " << kHistogram.GetP99() / kNanosecondsPerMillisecond << ", "
+			<< "\"maxMs\": " << kHistogram.GetMax() / kNanosecondsPerMillisecond << " }"
+			<< ( last ? "\n" : ",\n" );
+	}
+}
+
+int HeadlessApp::Run( DXSample* pSample )
+{
+	HighResolutionClock kClock;
+	const double frequency = static_cast< double >( kClock.GetFrequency() );
+	auto Elapsed = [ & ]( uint64_t begin ) { return static_cast< double >( kClock.GetCounter() - begin ) / frequency; };
+
+	// Initialize the sample with its requested size, there is no client area to measure.
+	uint64_t begin = kClock.GetCounter();
+	pSample->OnInit( pSample->GetWidth(), pSample->GetHeight() );
+	const double initSeconds = Elapsed( begin );
+	// Loading the assets is where the process peaks, the frames after it allocate next to nothing.
+	const PROCESS_MEMORY_COUNTERS kInitMemory = GetMemoryCounters();
+
+	for ( uint32_t n = 0; n < pSample->GetHeadlessWarmupFrames(); ++n )
+	{
+		pSample->OnTick();
+	}
+
+	// Histograms are ~4KB each, keep them off the stack.
+	auto spUpdate = std::make_unique< FrameTimeHistogram >();
+	auto spRender = std::make_unique< FrameTimeHistogram >();
+	auto spFrame = std::make_unique< FrameTimeHistogram >();
+
+	const double runSeconds = pSample->GetHeadlessSeconds();
+	const uint64_t runBegin = kClock.GetCounter();
+	uint32_t measuredFrames = 0;
+	while ( runSeconds > 0.0 ? Elapsed( runBegin ) < runSeconds : measuredFrames < pSample->GetHeadlessFrames() )
+	{
+		begin = kClock.GetCounter();
+		pSample->OnTick();
+		const double frameSeconds = Elapsed( begin );
+
+		const FramePhaseTimes& kTimes = pSample->GetLastFramePhaseTimes();
+		spUpdate->Record( SecondsToNanoseconds( kTimes.updateSeconds ) );
+		spRender->Record( SecondsToNanoseconds( kTimes.renderSeconds ) );
+		spFrame->Record( SecondsToNanoseconds( frameSeconds ) );
+		++measuredFrames;
+	}
+	const double totalSeconds = Elapsed( runBegin );
+
+	begin = kClock.GetCounter();
+	pSample->OnDestroy();
+	const double destroySeconds = Elapsed( begin );
+	const PROCESS_MEMORY_COUNTERS kRunMemory = GetMemoryCounters();
+
+	// Decode throughput is per core, decodeSeconds is summed over the workers.
+	const TextureDecodeStats kDecodeStats = TextureManager::GetDecodeStats();
+	const double decodedMegabytes = static_cast< double >( kDecodeStats.decodedBytes ) / ( 1024.0 * 1024.0 );
+	const double decodeSeconds = kDecodeStats.decodeSeconds > 0.0 ? kDecodeStats.decodeSeconds : 1.0;
+
+	std::ostringstream out;
+	out << "{\n"
+		<< "  \"sample\": \"" << WstrToStr( pSample->GetTitle() ) << "\",\n"
+		<< "  \"width\": " << pSample->GetWidth() << ",\n"
+		<< "  \"height\": " << pSample->GetHeight() << ",\n"
+		<< "  \"warmupFrames\": " << pSample->GetHeadlessWarmupFrames() << ",\n"
+		<< "  \"frames\": " << measuredFrames << ",\n"
+		<< "  \"totalSeconds\": " << totalSeconds << ",\n"
+		<< "  \"initMs\": " << initSeconds * 1000.0 << ",\n"
+		<< "  \"destroyMs\": " << destroySeconds * 1000.0 << ",\n"
+		<< "  \"memory\": { "
+		<< "\"initWorkingSetMB\": " << ToMegabytes( kInitMemory.WorkingSetSize ) << ", "
+		<< "\"initPeakWorkingSetMB\": " << ToMegabytes( kInitMemory.PeakWorkingSetSize ) << ", "
+		<< "\"peakWorkingSetMB\": " << ToMegabytes( kRunMemory.PeakWorkingSetSize ) << " },\n"
+		<< "  \"textureDecode\": { "
+		<< "\"images\": " << kDecodeStats.imageCount << ", "
+		<< "\"megabytes\": " << decodedMegabytes << ", "
+		<< "\"megabytesPerSecondPerCore\": " << decodedMegabytes / decodeSeconds << ", "
+		<< "\"imagesPerSecondPerCore\": " << static_cast< double >( kDecodeStats.imageCount ) / decodeSeconds << ", "
+		<< "\"mipMs\": " << kDecodeStats.mipSeconds * 1000.0 << ", "
+		<< "\"compressMs\": " << kDecodeStats.compressSeconds * 1000.0 << " },\n";
+	if ( pSample->IsMipBenchmarkEnabled() )
+	{
+		RunMipBenchmark( out );
+	}
+	if ( pSample->IsBcBenchmarkEnabled() )
+	{
+		RunBlockCompressionBenchmark( out, pSample->GetAssetFullPath( L"assets\\textures\\rickroll.jpg" ) );
+	}
+	if ( pSample->IsTextureLoadBenchmarkEnabled() )
+	{
+		RunTextureLoadBenchmark( out, pSample->GetAssetFullPath( L"assets\\textures\\rickroll.jpg" ), pSample->GetJobSystem() );
+	}
+	out << "  \"phases\": {\n";
+	WritePhase( out, "update", *spUpdate, false );
+	WritePhase( out, "render", *spRender, false );
+	WritePhase( out, "frame", *spFrame, true );
+	out << "  }\n"
+		<< "}\n";
+
+	const std::string report = out.str();
+	if ( pSample->GetReportPath().empty() )
+	{
+		return WriteStandardOutput( report ) ? 0 : 1;
+	}
+
+	return WriteReport( pSample->GetReportPath(), report ) ? 0 : 1;
+}
+
+bool HeadlessApp::WriteStandardOutput( const std::string& text )
+{
+	// A WIN32 subsystem app gets no console. CI redirects stdout to a pipe or file, which is inherited as is,
+	// from a terminal the report goes to the parent's console instead.
+	HANDLE hOutput = GetStdHandle( STD_OUTPUT_HANDLE );
+	if ( hOutput == nullptr || hOutput == INVALID_HANDLE_VALUE )
+	{
+		if ( !AttachConsole( ATTACH_PARENT_PROCESS ) )
+		{
+			OutputDebugStringA( text.c_str() );
+			return false;
+		}
+		hOutput = GetStdHandle( STD_OUTPUT_HANDLE );
+	}
+
+	DWORD written = 0;
+	return WriteFile( hOutput, text.data(), static_cast< DWORD >( text.size() ), &written, nullptr ) && written == text.size();
+}
+
+bool HeadlessApp::WriteReport( const std::wstring& path, const std::string& json )
+{
+	std::ofstream file( path, std::ios::out | std::ios::trunc );
+	if ( !file )
+	{
+		return false;
+	}
+
+	file << json;
+	return static_cast< bool >( file );
+}
+
+void HeadlessApp::RunMipBenchmark( std::ostringstream& out )
+{
+	HighResolutionClock kClock;
+	const double frequency = static_cast< double >( kClock.GetFrequency() );
+
+	// Same seed every run so the numbers are comparable.
+	std::mt19937 kRandom( 1234 );
+
+	out << "  \"mipBenchmark\": [\n";
+	const uint32_t sizes[] = { 1024, 4096, 8192 };
+	const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser };
+	for ( uint32_t s = 0; s < _countof( sizes ); ++s )
+	{
+		const uint32_t size = sizes[ s ];
+		std::vector< uint8_t > image( static_cast< size_t >( size ) * size * 4 );
+		for ( auto& texel : image )
+		{
+			texel = static_cast< uint8_t >( kRandom() );
+		}
+
+		std::vector< uint8_t > chain;
+		for ( uint32_t f = 0; f < _countof( filters ); ++f )
+		{
+			double milliseconds[ 2 ] = {};
+			for ( uint32_t simd = 0; simd < 2; ++simd )
+			{
+				MipGenerateOptions kOptions;
+				kOptions.filter = filters[ f ];
+				kOptions.useSimd = simd != 0;
+
+				const uint64_t begin = kClock.GetCounter();
+				MipGenerator::Generate( image.data(), size, size, static_cast< size_t >( size ) * 4, kOptions, chain );
+				milliseconds[ simd ] = static_cast< double >( kClock.GetCounter() - begin ) / frequency * 1000.0;
+			}
+
+			const bool last = s + 1 == _countof( sizes ) && f + 1 == _countof( filters );
+			out << "    { \"size\": " << size << ", "
+				<< "\"filter\": \"" << ( filters[ f ] == MipFilter::Box ? "box" : "kaiser" ) << "\", "
+				<< "\"scalarMs\": " << milliseconds[ 0 ] << ", "
+				<< "\"simdMs\": " << milliseconds[ 1 ] << ", "
+				<< "\"speedup\": " << milliseconds[ 0 ] / milliseconds[ 1 ] << " }"
+				<< ( last ? "\n" : ",\n" );
+		}
+	}
+	out << "  ],\n";
+}
+
+void HeadlessApp::RunBlockCompressionBenchmark( std::ostringstream& out, const std::wstring& imagePath )
+{
+	HighResolutionClock kClock;
+	const double frequency = static_cast< double >( kClock.GetFrequency() );
+
+	TextureLoadOptions kLoadOptions;
+	kLoadOptions.generateMips = false;
+	const Texture2DPtr spImage = TextureManager::CreateTexture2D( imagePath, kLoadOptions );
+	const uint32_t width = static_cast< uint32_t >( spImage->width );
+	const uint32_t height = static_cast< uint32_t >( spImage->height );
+	const size_t rowPitch = spImage->width * spImage->pixelSize;
+	const double megapixels = static_cast< double >( width ) * height / 1000000.0;
+
+	struct Format
+	{
+		BlockFormat format;
+		const char* name;
+		uint32_t channelCount;
+	};
+	const Format formats[] =
+	{
+		{ BlockFormat::BC1, "bc1", 3 },
+		{ BlockFormat::BC3, "bc3", 4 },
+		{ BlockFormat::BC5, "bc5", 2 },
+		{ BlockFormat::BC7, "bc7", 4 },
+	};
+	const BlockQuality qualities[] = { BlockQuality::Fast, BlockQuality::High };
+
+	std::vector< uint8_t > decoded( rowPitch * height );
+	out << "  \"bcBenchmark\": [\n";
+	for ( uint32_t f = 0; f < _countof( formats ); ++f )
+	{
+		const size_t blockRowPitch = BlockCompressor::GetRowPitch( formats[ f ].format, width );
+		std::vector< uint8_t > blocks( BlockCompressor::GetCompressedSize( formats[ f ].format, width, height ) );
+		for ( uint32_t q = 0; q < _countof( qualities ); ++q )
+		{
+			BlockCompressOptions kOptions;
+			kOptions.format = formats[ f ].format;
+			kOptions.quality = qualities[ q ];
+
+			const uint64_t begin = kClock.GetCounter();
+			BlockCompressor::Compress( spImage->data, width, height, rowPitch, kOptions, blocks.data(), blockRowPitch );
+			const double seconds = static_cast< double >( kClock.GetCounter() - begin ) / frequency;
+
+			BlockCompressor::Decompress( blocks.data(), blockRowPitch, kOptions.format, width, height, decoded.data(), rowPitch );
+			const double psnr = BlockCompressor::ComputePsnr( spImage->data, decoded.data(), width, height, rowPitch, formats[ f ].channelCount );
+
+			const bool last = f + 1 == _countof( formats ) && q + 1 == _countof( qualities );
+			out << "    { \"format\": \"" << formats[ f ].name << "\", "
+				<< "\"quality\": \"" << ( qualities[ q ] == BlockQuality::Fast ? "fast" : "high" ) << "\", "
+				<< "\"psnr\": " << psnr << ", "
+				<< "\"megapixelsPerSecond\": " << megapixels / seconds << " }"
+				<< ( last ? "\n" : ",\n" );
+		}
+	}
+	out << "  ],\n";
+}
+
+void HeadlessApp::RunTextureLoadBenchmark( std::ostringstream& out, const std::wstring& imagePath, ThreadPool& kJobs )
+{
+	HighResolutionClock kClock;
+	const double frequency = static_cast< double >( kClock.GetFrequency() );
+	const uint32_t iterations = 10;
+
+	Texture2DPtr spTexture;
+	uint64_t begin = kClock.GetCounter();
+	for ( uint32_t n = 0; n < iterations; ++n )
+	{
+		spTexture = TextureManager::CreateTexture2D( imagePath, TextureLoadOptions(), &kJobs );
+	}
+	const double jpegSeconds = static_cast< double >( kClock.GetCounter() - begin ) / frequency / iterations;
+
+	// Cook the same image (RGBA8 with mips) into a temporary file.
+	std::vector< TextureFileLevel > levels;
+	for ( const Texture2DMip& kMip : spTexture->mips )
+	{
+		TextureFileLevel kLevel;
+		kLevel.width = static_cast< uint32_t >( kMip.width );
+		kLevel.height = static_cast< uint32_t >( kMip.height );
+		kLevel.rowPitch = kMip.rowPitch;
+		kLevel.pData = kMip.pData;
+		levels.push_back( kLevel );
+	}
+	const std::filesystem::path cookedPath = std::filesystem::temp_directory_path() / "learningdx12_benchmark.ldxt";
+	TextureContainer::Write( cookedPath, TextureFileFormat::RGBA8, static_cast< uint32_t >( levels.size() ), 1, levels );
+	spTexture.reset();
+
+	// The vector stands in for the upload ring. The file was just written, so this measures a warm page cache.
+	std::vector< uint8_t > upload;
+	begin = kClock.GetCounter();
+	for ( uint32_t n = 0; n < iterations; ++n )
+	{
+		MappedTextureFile kFile;
+		kFile.Open( cookedPath );
+		upload.resize( static_cast< size_t >( kFile.GetPayloadSize() ) );
+		memcpy( upload.data(), kFile.GetPayload(), upload.size() );
+	}
+	const double cookedSeconds = static_cast< double >( kClock.GetCounter() - begin ) / frequency / iterations;
+
+	std::vector< uint8_t >().swap( upload );
+	WorkingSetPeak kCookedPeak;
+	{
+		MappedTextureFile kFile;
+		kFile.Open( cookedPath );
+		std::vector< uint8_t > uploadCopy( kFile.GetPayload(), kFile.GetPayload() + kFile.GetPayloadSize() );
+	}
+	const SIZE_T cookedPeakBytes = kCookedPeak.Stop();
+
+	std::error_code error;
+	std::filesystem::remove( cookedPath, error );
+
+	// The JPEG into upload memory both ways, with the sample's options and as RGBA8 with mips. The copy path decodes
+	// into a Texture2D and copies its levels row by row like UpdateSubresources, the direct path has the last stage
+	// write straight into the footprints. A vector stands in for the upload ring, the same size for both.
+	auto CopyPath = [ & ]( const TextureLoadOptions& kOptions ) -> uint64_t
+	{
+		const Texture2DPtr spImage = TextureManager::CreateTexture2D( imagePath, kOptions, &kJobs );
+		std::vector< uint8_t > uploadMemory;
+		std::vector< size_t > rowCounts;
+		const std::vector< Texture2DDestination > destinations = MakeUploadLayout( TextureManager::GetTexture2DInfo( imagePath, kOptions ), uploadMemory, rowCounts );
+		uint64_t copiedBytes = 0;
+		for ( size_t n = 0; n < destinations.size(); ++n )
+		{
+			const Texture2DMip& kMip = spImage->mips[ n ];
+			for ( size_t y = 0; y < rowCounts[ n ]; ++y )
+			{
+				memcpy( destinations[ n ].pData + y * destinations[ n ].rowPitch, kMip.pData + y * kMip.rowPitch, kMip.rowPitch );
+			}
+			copiedBytes += kMip.rowPitch * rowCounts[ n ];
+		}
+		return copiedBytes;
+	};
+	auto DirectPath = [ & ]( const TextureLoadOptions& kOptions ) -> uint64_t
+	{
+		const Texture2DInfo kInfo = TextureManager::GetTexture2DInfo( imagePath, kOptions );
+		std::vector< uint8_t > uploadMemory;
+		std::vector< size_t > rowCounts;
+		const std::vector< Texture2DDestination > destinations = MakeUploadLayout( kInfo, uploadMemory, rowCounts );
+		const uint64_t copiedBefore = TextureManager::GetDecodeStats().copiedBytes;
+		TextureManager::DecodeTexture2DInto( imagePath, kInfo, destinations, kOptions, &kJobs );
+		return TextureManager::GetDecodeStats().copiedBytes - copiedBefore;
+	};
+
+	TextureLoadOptions kSampleOptions;
+	kSampleOptions.compress = true;
+	kSampleOptions.compressOptions.format = BlockFormat::BC7;
+	kSampleOptions.compressOptions.quality = BlockQuality::Fast;
+	struct Variant
+	{
+		const char* name;
+		TextureLoadOptions kOptions;
+	};
+	const Variant variants[] = { { "sample", kSampleOptions }, { "rgba8", TextureLoadOptions() } };
+
+	out << "  \"textureLoadBenchmark\": { "
+		<< "\"jpegMs\": " << jpegSeconds * 1000.0 << ", "
+		<< "\"cookedMs\": " << cookedSeconds * 1000.0 << ", "
+		<< "\"speedup\": " << jpegSeconds / cookedSeconds << ", "
+		<< "\"cookedPeakWorkingSetMB\": " << ToMegabytes( cookedPeakBytes ) << ",\n"
+		<< "    \"uploadPaths\": [\n";
+	for ( size_t v = 0; v < _countof( variants ); ++v )
+	{
+		const Variant& kVariant = variants[ v ];
+		const bool bCompressed = TextureManager::GetTexture2DInfo( imagePath, kVariant.kOptions ).compressed;
+
+		// The peaks come from a run of their own, the polling thread would slow down the timed ones.
+		double seconds[ 2 ] = {};
+		uint64_t copiedBytes[ 2 ] = {};
+		SIZE_T peakBytes[ 2 ] = {};
+		for ( uint32_t path = 0; path < 2; ++path )
+		{
+			auto Load = [ & ]() { return path == 0 ? CopyPath( kVariant.kOptions ) : DirectPath( kVariant.kOptions ); };
+			begin = kClock.GetCounter();
+			for ( uint32_t n = 0; n < iterations; ++n )
+			{
+				copiedBytes[ path ] = Load();
+			}
+			seconds[ path ] = static_cast< double >( kClock.GetCounter() - begin ) / frequency / iterations;
+
+			WorkingSetPeak kPeak;
+			Load();
+			peakBytes[ path ] = kPeak.Stop();
+		}
+
+		out << "      { \"options\": \"" << kVariant.name << "\", "
+			<< "\"compressed\": " << ( bCompressed ? "true" : "false" ) << ", "
+			<< "\"copyMs\": " << seconds[ 0 ] * 1000.0 << ", "
+			<< "\"directMs\": " << seconds[ 1 ] * 1000.0 << ", "
+			<< "\"copyPeakWorkingSetMB\": " << ToMegabytes( peakBytes[ 0 ] ) << ", "
+			<< "\"directPeakWorkingSetMB\": " << ToMegabytes( peakBytes[ 1 ] ) << ", "
+			<< "\"copyCopiedMB\": " << ToMegabytes( static_cast< SIZE_T >( copiedBytes[ 0 ] ) ) << ", "
+			<< "\"directCopiedMB\": " << ToMegabytes( static_cast< SIZE_T >( copiedBytes[ 1 ] ) ) << " }"
+			<< ( v + 1 == _countof( variants ) ? "\n" : ",\n" );
+	}
+	out << "    ] },\n";
+}
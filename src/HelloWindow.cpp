@@ -2,16 +2,61 @@
 #include <system_error>
 #include "Math.hpp"
 #include "HelloWindow.hpp"
+#include "Mesh.hpp"
 #include "Texture.hpp"
+#include "TextureContainer.hpp"
+#include "ThreadPool.hpp"
 
 CD3DX12_HEAP_PROPERTIES HeapPropertiesFactory::m_upload( D3D12_HEAP_TYPE_UPLOAD );
 CD3DX12_HEAP_PROPERTIES HeapPropertiesFactory::m_default( D3D12_HEAP_TYPE_DEFAULT );
 
+namespace
+{
+	DXGI_FORMAT GetBlockFormat( BlockFormat format )
+	{
+		switch ( format )
+		{
+			case BlockFormat::BC1: return DXGI_FORMAT_BC1_UNORM;
+			case BlockFormat::BC3: return DXGI_FORMAT_BC3_UNORM;
+			case BlockFormat::BC5: return DXGI_FORMAT_BC5_UNORM;
+			case BlockFormat::BC7: return DXGI_FORMAT_BC7_UNORM;
+		}
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	DXGI_FORMAT GetTextureFileFormat( TextureFileFormat format )
+	{
+		switch ( format )
+		{
+			case TextureFileFormat::RGBA8: return DXGI_FORMAT_R8G8B8A8_UNORM;
+			case TextureFileFormat::BC1: return DXGI_FORMAT_BC1_UNORM;
+			case TextureFileFormat::BC3: return DXGI_FORMAT_BC3_UNORM;
+			case TextureFileFormat::BC5: return DXGI_FORMAT_BC5_UNORM;
+			case TextureFileFormat::BC7: return DXGI_FORMAT_BC7_UNORM;
+		}
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	DXGI_FORMAT GetVertexElementFormat( VertexElementFormat format )
+	{
+		switch ( format )
+		{
+			case VertexElementFormat::Float2: return DXGI_FORMAT_R32G32_FLOAT;
+			case VertexElementFormat::Float3: return DXGI_FORMAT_R32G32B32_FLOAT;
+			case VertexElementFormat::Float4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+			case VertexElementFormat::Half2: return DXGI_FORMAT_R16G16_FLOAT;
+			case VertexElementFormat::Unorm8x4: return DXGI_FORMAT_R8G8B8A8_UNORM;
+			case VertexElementFormat::Snorm16x2: return DXGI_FORMAT_R16G16_SNORM;
+			case VertexElementFormat::Snorm16x4: return DXGI_FORMAT_R16G16B16A16_SNORM;
+		}
+		return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
 HelloWindow::HelloWindow( uint32_t width, uint32_t height, std::wstring title ) :
 	DXSample( width, height, title ),
 	m_frameIndex( 0 ),
-	m_rtvDescriptorSize( 0 ),
-	m_srvDescriptorSize( 0 )
+	m_rtvDescriptorSize( 0 )
 {
 }
 
@@ -22,7 +67,10 @@ void HelloWindow::OnInit( uint32_t width, uint32_t height )
 
 	LoadPipeline();
 	LoadAssets();
-	InitImGui();
+	if ( !m_bHeadless )
+	{
+		InitImGui();
+	}
 
 	m_bIsInitialized = true;
 }
@@ -34,29 +82,22 @@ void HelloWindow::OnUpdate( const StepTimer& kTimer )
 	float fDeltaTime = static_cast< float >( kTimer.GetElapsedSeconds() );
 
 	using namespace DirectX;
-	// Model Matrix
-	{
-		XMMATRIX model = XMLoadFloat4x4( &m_kConstantBuffer.model );
 
-		// Identity
-		model = XMMatrixIdentity();
+	// Transforms and culling don't depend on each other, both go to the job system and we wait for them at the end.
+	ThreadPool& kJobs = GetJobSystem();
+	JobCounter kUpdateJobs;
 
+	// Model Matrix
+	{
 		// Rotate
 		auto angle = static_cast< float >( Math::Radians( 50.0f ) ) * fCurrentTime;
 		XMVECTOR rotationAxis = XMVectorSet( 0.5f, 1.0f, 0.0f, 0.0f );
-		XMMATRIX rotationMatrix = XMMatrixRotationAxis( rotationAxis, angle );
+		XMFLOAT4 kRotation;
+		XMStoreFloat4( &kRotation, XMQuaternionRotationAxis( rotationAxis, angle ) );
+		m_kTransforms.SetRotation( m_spinNode, kRotation );
 
-		// create world matrix by first rotating the cube and then translating it.
-		model = XMMatrixMultiply( model, rotationMatrix );
-
-		// Trans
-		model = XMMatrixMultiply( model, XMMatrixTranslation( 0.0, 0.0f, 0.0f ) );
-
-		// must transpose the matrix before sending it to the GPU.
-		model = XMMatrixTranspose( model );
-
-		// Update back
-		XMStoreFloat4x4( &m_kConstantBuffer.model, model );
+		// Only the spin node and the mesh below it are recomputed.
+		kJobs.Run( [ this, &kJobs ]() { m_kTransforms.Update( &kJobs ); }, &kUpdateJobs );
 	}
 
 	// View Project Matrix
@@ -70,6 +111,12 @@ void HelloWindow::OnUpdate( const StepTimer& kTimer )
 		view = XMMatrixLookAtLH( cameraPos, cameraTarget, cameraUp );
 
 		XMMATRIX viewProj = XMMatrixMultiply( view, proj );
+
+		// Cull before the transpose, the planes are extracted from the row vector form.
+		XMFLOAT4X4 kCullViewProj;
+		XMStoreFloat4x4( &kCullViewProj, viewProj );
+		const FrustumPlanes kFrustum = FrustumCuller::ExtractPlanes( &kCullViewProj.m[ 0 ][ 0 ] );
+		kJobs.Run( [ this, &kJobs, kFrustum ]() { m_kCuller.CullSpheres( kFrustum, m_visibleObjects, FrustumCullOptions(), &kJobs ); }, &kUpdateJobs );
 		
 		// must transpose the matrix before sending it to the GPU.
 		viewProj = XMMatrixTranspose( viewProj );
@@ -77,7 +124,16 @@ void HelloWindow::OnUpdate( const StepTimer& kTimer )
 		XMStoreFloat4x4( &m_kConstantBuffer.viewProj, viewProj );
 	}
 
-	memcpy( m_pCbvDataBegin, &m_kConstantBuffer, sizeof( m_kConstantBuffer ) );
+	kJobs.Wait( kUpdateJobs );
+	{
+		// must transpose the matrix before sending it to the GPU.
+		XMMATRIX model = XMMatrixTranspose( XMLoadFloat4x4( &m_kTransforms.GetWorld( m_meshNode ) ) );
+
+		// Update back
+		XMStoreFloat4x4( &m_kConstantBuffer.model, model );
+	}
+
+	// Copied into this frame's constant buffer region when the command list is recorded.
 }
 
 // Render the scene.
@@ -89,32 +145,72 @@ void HelloWindow::OnRender()
 		return;
 	}
 
-	RenderImGui();
+	if ( !m_bHeadless )
+	{
+		RenderImGui();
+	}
 
-	// Record all the command we need to render the scene into the command list.
+	// Record all the command we need to render the scene into the command lists.
 	PopulateCommandList();
 
-	// Execute the commad list.
-	ID3D12CommandList* ppCommandList[] = { m_spCommandList.Get() };
-	m_spCommandQueue->ExecuteCommandLists( _countof( ppCommandList ), ppCommandList );
+	// Execute the commad lists, all of them in one go. Their allocators are recycled once the fence MoveToNextFrame signals has passed.
+	// The render graph put every barrier into the lists already, nothing needs fixing up.
+	m_spCommandRecorder->Submit( m_fenceValue );
 
-	// Present the frame.
-	ThrowIfFailed( m_spSwapChain->Present( 1, 0 ) );
+	// Present the frame. Headless runs have nothing to present to.
+	if ( m_spSwapChain )
+	{
+		ThrowIfFailed( m_spSwapChain->Present( 1, 0 ) );
+		m_bFrameLatencyWaited = false;
+	}
 
 	MoveToNextFrame();
 }
 
+// Wait for the swap chain before the frame starts, so input is read as late as possible
+// instead of the frame being built first and then held back behind the queued ones.
+void HelloWindow::OnFrameBegin()
+{
+	if ( !m_spFramePacer )
+	{
+		return;
+	}
+
+	if ( m_frameLatencyWaitable.IsValid() && !m_bFrameLatencyWaited )
+	{
+		std::ignore = WaitForSingleObjectEx( m_frameLatencyWaitable.Get(), 1000, TRUE );
+		m_bFrameLatencyWaited = true;
+	}
+
+	// The flip DXGI reported last, on the same QPC clock the pacer reads.
+	DXGI_FRAME_STATISTICS frameStatistics = {};
+	if ( m_spSwapChain && SUCCEEDED( m_spSwapChain->GetFrameStatistics( &frameStatistics ) ) )
+	{
+		m_spFramePacer->OnFrameShown( frameStatistics.PresentCount, static_cast< uint64_t >( frameStatistics.SyncQPCTime.QuadPart ) );
+	}
+
+	// Only blocks when the GPU still uses this slot's constant buffer and descriptor regions.
+	m_frameIndex = m_spFramePacer->BeginFrame();
+}
+
 void HelloWindow::OnDestroy()
 {
 	// Ensure that GPU is no langer refernencing resource that are about to be cleaned up by the destructor.
 	WaitForGpu();
+	if ( m_spDeferredRelease )
+	{
+		m_spDeferredRelease->Flush();
+	}
 
 	// Cleanup Imgui
-	ImGui_ImplDX12_Shutdown();
-	ImGui_ImplWin32_Shutdown();
-	ImGui::DestroyContext();
+	if ( !m_bHeadless )
+	{
+		ImGui_ImplDX12_Shutdown();
+		ImGui_ImplWin32_Shutdown();
+		ImGui::DestroyContext();
+	}
 
-	m_fenceEvent.Close();
+	m_frameLatencyWaitable.Close();
 }
 
 void HelloWindow::OnSizeChanged( uint32_t width, uint32_t height )
@@ -163,10 +259,21 @@ void HelloWindow::CreateDevice()
 
 	// get adpater
 	ComPtr< IDXGIAdapter1 > spHardwareAdapter;
-	GetHardwareAdapter( m_spDxgiFactory.Get(), &spHardwareAdapter );
+	if ( m_bUseWarpDevice )
+	{
+		ThrowIfFailed( m_spDxgiFactory->EnumWarpAdapter( IID_PPV_ARGS( spHardwareAdapter.ReleaseAndGetAddressOf() ) ) );
+	}
+	else
+	{
+		GetHardwareAdapter( m_spDxgiFactory.Get(), &spHardwareAdapter );
+	}
 	
 	// create DX12 device
 	ThrowIfFailed( D3D12CreateDevice( spHardwareAdapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS( m_spDevice.ReleaseAndGetAddressOf() ) ) );
+
+	// Pipelines an earlier run compiled on this adapter and driver, a cache from anything else is thrown away.
+	m_spPipelineCache = std::make_unique< PipelineCache >( GetPipelineCacheIdentity( m_spDxgiFactory.Get(), m_spDevice.Get() ) );
+	m_spPipelineCache->Load( GetAssetFullPath( PipelineCacheFile ) );
 	
 #ifndef NDEBUG
 	// Configure debug device (if active).
@@ -202,7 +309,7 @@ void HelloWindow::CreateDevice()
 	{
 		// create descriptor heap for render target views
 		D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-		rtvHeapDesc.NumDescriptors = FrameCount;
+		rtvHeapDesc.NumDescriptors = GetBackBufferCount();
 		rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
 		rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 		ThrowIfFailed( m_spDevice->CreateDescriptorHeap( &rtvHeapDesc, IID_PPV_ARGS( m_spRtvHeap.ReleaseAndGetAddressOf() ) ) );
@@ -214,31 +321,17 @@ void HelloWindow::CreateDevice()
 		dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 		ThrowIfFailed( m_spDevice->CreateDescriptorHeap( &dsvHeapDesc, IID_PPV_ARGS( m_spDsvHeap.ReleaseAndGetAddressOf() ) ) );
 
-		// Describe and create a shader resource view (SRV) heap for the texture
-		D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-		srvHeapDesc.NumDescriptors = 3; // 0: ImGui, 1: Texture, 2: Constant Buffer
-		srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-		srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-		ThrowIfFailed( m_spDevice->CreateDescriptorHeap( &srvHeapDesc, IID_PPV_ARGS( m_spSrvHeap.ReleaseAndGetAddressOf() ) ) );
+		// Shader visible CBV / SRV / UAV heap: persistent slots (ImGui font, textures) followed by
+		// a transient region per frame. Views are created in the CPU-only staging heap and copied over.
+		m_kSrvHeap.Create( m_spDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, PersistentSrvCount, GetFramesInFlight(), TransientSrvCountPerFrame );
+		m_kStagingSrvHeap.Create( m_spDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, PersistentSrvCount );
 
 		m_rtvDescriptorSize = m_spDevice->GetDescriptorHandleIncrementSize( D3D12_DESCRIPTOR_HEAP_TYPE_RTV );
-		m_srvDescriptorSize = m_spDevice->GetDescriptorHandleIncrementSize( D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV );
 	}
 
-	// create a command allocator for each back buffer that will be rendered to
-	{
-		for ( UINT n = 0; n < FrameCount; ++n )
-		{
-			ThrowIfFailed( m_spDevice->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS( m_spCommandAllocator[ n ].ReleaseAndGetAddressOf() ) ) );
-		}
-	}
 	// create a command allocator for bundle usage
 	ThrowIfFailed( m_spDevice->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS( m_spBundleAllocator.ReleaseAndGetAddressOf() ) ) );
-
-	// create a command list for recording graphics commands.
 	m_frameIndex = 0;
-	ThrowIfFailed( m_spDevice->CreateCommandList( 0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_spCommandAllocator[ m_frameIndex ].Get(), nullptr, IID_PPV_ARGS( m_spCommandList.ReleaseAndGetAddressOf() ) ) );
-	ThrowIfFailed( m_spCommandList->Close() );
 
 	// create a command list for bundle usage
 	ThrowIfFailed( m_spDevice->CreateCommandList( 0, D3D12_COMMAND_LIST_TYPE_BUNDLE, m_spBundleAllocator.Get(), nullptr, IID_PPV_ARGS( m_spBundle.ReleaseAndGetAddressOf() ) ) );
@@ -247,15 +340,18 @@ void HelloWindow::CreateDevice()
 	// create a fence for tracking GPU execution progress => 
 	// fence wait until assets have been uploaded to the GPU.
 	{
-		ThrowIfFailed( m_spDevice->CreateFence( m_fenceValue[ m_frameIndex ], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS( m_spFence.ReleaseAndGetAddressOf() ) ) );
-		m_fenceValue[ m_frameIndex ]++;
-
-		// Create an event handle to use for frame synchronization
-		m_fenceEvent.Attach( CreateEventEx( nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE ) );
-		if ( !m_fenceEvent.IsValid() )
-		{
-			throw std::system_error( std::error_code( static_cast< int >( GetLastError() ), std::system_category() ), "CreateEventEx" );
-		}
+		ThrowIfFailed( m_spDevice->CreateFence( m_fenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS( m_spFence.ReleaseAndGetAddressOf() ) ) );
+		m_fenceValue++;
+
+		// Per-frame command lists, one allocator each so they can be recorded in parallel. Allocators are
+		// pooled by the fence value they were submitted with, not by back buffer, and reused once it passed.
+		// Every wait on the fence, the pacer's, the pool's and the release queue's, goes through the fence waiter.
+		m_spCommandBackend = std::make_unique< D3D12CommandBackend >( m_spDevice.Get(), m_spCommandQueue.Get(), m_spFence.Get(), m_kFenceWaiter );
+		m_spCommandAllocatorPool = std::make_unique< CommandAllocatorPool >( *m_spCommandBackend );
+		m_spCommandRecorder = std::make_unique< CommandRecorder >( *m_spCommandBackend, *m_spCommandAllocatorPool );
+		m_spFramePacer = std::make_unique< FramePacer >( *m_spCommandBackend, m_kPacingClock, GetFramesInFlight() );
+		m_spDeferredRelease = std::make_unique< DeferredReleaseQueue >( *m_spCommandBackend );
+		m_spRenderGraphHeaps = std::make_unique< D3D12RenderGraph >( m_spDevice.Get(), *m_spDeferredRelease );
 
 		// Check Shader Model 6 support
 		D3D12_FEATURE_DATA_SHADER_MODEL shaderModel = { D3D_SHADER_MODEL_6_0 };
@@ -267,30 +363,44 @@ void HelloWindow::CreateDevice()
 	}
 
 	// Initialize device dependent objects here (independent of window size).
+	m_kUploadRing.Create( m_spDevice.Get(), UploadRingSize );
+	m_kConstantBufferPool.Create( m_spDevice.Get(), GetFramesInFlight(), ConstantBufferBytesPerFrame );
 }
 
 // Allocate all memory resources that change on a window SizeChanged event.
 void HelloWindow::CreateResources()
 {
-	// Wait until all previous GPU work is complete.
-	WaitForGpu();
+	// The swap chain can only resize once the GPU is done with every back buffer. Everything else tied to the
+	// size goes to the deferred release queue, so a headless resize does not drain the GPU.
+	if ( m_spSwapChain )
+	{
+		WaitForGpu();
+	}
 
-	// Release resources that are tied ti the swap chain and update fence values.
-	for ( UINT n = 0; n < FrameCount; ++n )
+	// Release resources that are tied ti the swap chain.
+	for ( UINT n = 0; n < uMaxBackBufferCount; ++n )
 	{
-		m_renderTargets[ n ].Reset();
-		m_fenceValue[ n ] = m_fenceValue[ m_frameIndex ];
+		m_kResourceStates.Unregister( m_renderTargets[ n ].Get() );
+		if ( m_spSwapChain )
+		{
+			m_renderTargets[ n ].Reset();
+		}
+		else
+		{
+			DeferRelease( *m_spDeferredRelease, m_renderTargets[ n ], m_fenceValue );
+		}
 	}
+	m_backBufferCount = GetBackBufferCount();
 
 	constexpr DXGI_FORMAT backBufferFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
-	constexpr DXGI_FORMAT depthBufferFormat = DXGI_FORMAT_D32_FLOAT;
 	const auto backBufferWidth = static_cast< UINT >( m_width );
 	const auto backBufferHeight = static_cast< UINT >( m_height );
 
 	// if the swap chain already exists, resize it, otherwise create one.
+	// Headless runs have no window, the render targets are plain textures created below.
 	if ( m_spSwapChain )
 	{
-		auto hr = m_spSwapChain->ResizeBuffers( FrameCount, backBufferWidth, backBufferHeight, backBufferFormat, 0 );
+		auto hr = m_spSwapChain->ResizeBuffers( m_backBufferCount, backBufferWidth, backBufferHeight, backBufferFormat, DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT );
 		if ( hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET )
 		{
 			// If the device was removed for any reason, a new device and swap chain will need to be created.
@@ -305,11 +415,11 @@ void HelloWindow::CreateResources()
 			ThrowIfFailed( hr );
 		}
 	}
-	else
+	else if ( !m_bHeadless )
 	{
 		// create swap chain
 		DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-		swapChainDesc.BufferCount = FrameCount;
+		swapChainDesc.BufferCount = m_backBufferCount;
 		swapChainDesc.Width = backBufferWidth;
 		swapChainDesc.Height = backBufferHeight;
 		swapChainDesc.Format = backBufferFormat;
@@ -319,6 +429,7 @@ void HelloWindow::CreateResources()
 		swapChainDesc.SampleDesc.Quality = 0;
 		swapChainDesc.Scaling = DXGI_SCALING_STRETCH;
 		swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
+		swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 
 		DXGI_SWAP_CHAIN_FULLSCREEN_DESC fsSwapChainDesc = {};
 		fsSwapChainDesc.Windowed = TRUE;
@@ -333,6 +444,10 @@ void HelloWindow::CreateResources()
 
 		ThrowIfFailed( spSwapChain.As( &m_spSwapChain ) );
 
+		// Present stops queuing after this many frames, and the waitable object is signaled whenever there is room again.
+		ThrowIfFailed( m_spSwapChain->SetMaximumFrameLatency( GetFramesInFlight() ) );
+		m_frameLatencyWaitable.Attach( m_spSwapChain->GetFrameLatencyWaitableObject() );
+
 		// this template does not support exclusive fullscreen mode and prevents DXGI from responding to the ALT+ENTER shortcut
 		ThrowIfFailed( m_spDxgiFactory->MakeWindowAssociation( Win32App::GetHwnd(), DXGI_MWA_NO_ALT_ENTER ) );
 	}
@@ -340,10 +455,29 @@ void HelloWindow::CreateResources()
 	// Obtain the back buffers for this window which will be the final render targets
 	// and create render target views for each of them.
 	{
-		// Crate a RTV for each frame.
-		for ( UINT n = 0; n < FrameCount; ++n )
+		// Crate a RTV for each back buffer.
+		for ( UINT n = 0; n < m_backBufferCount; ++n )
 		{
-			ThrowIfFailed( m_spSwapChain->GetBuffer( n, IID_PPV_ARGS( &m_renderTargets[ n ] ) ) );
+			if ( m_spSwapChain )
+			{
+				ThrowIfFailed( m_spSwapChain->GetBuffer( n, IID_PPV_ARGS( &m_renderTargets[ n ] ) ) );
+			}
+			else
+			{
+				D3D12_RESOURCE_DESC renderTargetDesc = CD3DX12_RESOURCE_DESC::Tex2D( backBufferFormat, backBufferWidth, backBufferHeight, 1, 1 );
+				renderTargetDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+
+				// Created in the PRESENT state so PopulateCommandList can treat it like a back buffer.
+				ThrowIfFailed( m_spDevice->CreateCommittedResource(
+					HeapPropertiesFactory::GetDefaultHeapProperties(),
+					D3D12_HEAP_FLAG_NONE,
+					&renderTargetDesc,
+					D3D12_RESOURCE_STATE_PRESENT,
+					nullptr,
+					IID_PPV_ARGS( m_renderTargets[ n ].ReleaseAndGetAddressOf() ) ) );
+			}
+
+			m_kResourceStates.Register( m_renderTargets[ n ].Get(), 1, D3D12_RESOURCE_STATE_PRESENT );
 
 			wchar_t rtvName[ 25 ] = {};
 			swprintf_s( rtvName, L"Render Target %d", n );
@@ -355,57 +489,43 @@ void HelloWindow::CreateResources()
 		}
 	}
 
-	// Reset the frame index to the current back buffer.
-	m_frameIndex = m_spSwapChain->GetCurrentBackBufferIndex();
-
-	// allocate a 2-D surface as the depth / stencil buffer and create a dpeth / stencil view on this surface
-	const CD3DX12_HEAP_PROPERTIES depthHeapProperties( D3D12_HEAP_TYPE_DEFAULT );
-	D3D12_RESOURCE_DESC drvDesc = CD3DX12_RESOURCE_DESC::Tex2D( 
-		depthBufferFormat, 
-		backBufferWidth, 
-		backBufferHeight, 
-		1, // This depth stencil view has only one texture.
-		1  // Use a single mipmap level.
-	);
-	drvDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
-
-	const CD3DX12_CLEAR_VALUE depthOptimizedClearValue( depthBufferFormat, 1.0f, 0u );
-	ThrowIfFailed( m_spDevice->CreateCommittedResource( 
-		&depthHeapProperties, 
-		D3D12_HEAP_FLAG_NONE, 
-		&drvDesc, 
-		D3D12_RESOURCE_STATE_DEPTH_WRITE, 
-		&depthOptimizedClearValue, 
-		IID_PPV_ARGS( m_spDepthStencil.ReleaseAndGetAddressOf() ) ) );
-	m_spDepthStencil->SetName( L"Depth Stencil" );
-
-	D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
-	dsvDesc.Format = depthBufferFormat;
-	dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+	// Reset the back buffer index to the current back buffer.
+	m_backBufferIndex = m_spSwapChain ? m_spSwapChain->GetCurrentBackBufferIndex() : 0;
 
-	auto dsvHandle = m_spDsvHeap->GetCPUDescriptorHandleForHeapStart();
-	m_spDevice->CreateDepthStencilView( m_spDepthStencil.Get(), &dsvDesc, dsvHandle );
+	// No depth buffer here, it is a transient render graph resource sized from m_width / m_height every frame.
 
 	// TODO: Initialize window size-dependent objects here.
 }
 
 void HelloWindow::OnDeviceLost()
 {
-	for ( UINT n = 0; n < FrameCount; ++n )
+	// The device is gone, nothing has to wait for the GPU anymore. The backend cancels what waits on its fence.
+	m_kRenderGraph.Reset();
+	m_spRenderGraphHeaps.reset();
+	m_spDeferredRelease.reset();
+	m_kResourceStates.Clear();
+	m_spFramePacer.reset();
+	m_spCommandRecorder.reset();
+	m_spCommandAllocatorPool.reset();
+	m_spCommandBackend.reset();
+	m_frameLatencyWaitable.Close();
+	m_bFrameLatencyWaited = false;
+	for ( UINT n = 0; n < uMaxBackBufferCount; ++n )
 	{
-		m_spCommandAllocator[ n ].Reset();
 		m_renderTargets[ n ].Reset();
 	}
 	m_spBundleAllocator.Reset();
+	m_kUploadRing.Destroy();
+	m_kConstantBufferPool.Destroy();
 
-	m_spDepthStencil.Reset();
 	m_spFence.Reset();
 	m_spBundle.Reset();
 	m_spCommandList.Reset();
 	m_spSwapChain.Reset();
 	m_spRtvHeap.Reset();
 	m_spDsvHeap.Reset();
-	m_spSrvHeap.Reset();
+	m_kSrvHeap.Destroy();
+	m_kStagingSrvHeap.Destroy();
 	m_spCommandQueue.Reset();
 	m_spDxgiFactory.Reset();
 
@@ -422,6 +542,131 @@ void HelloWindow::LoadPipeline()
 // Load the sample assets.
 void HelloWindow::LoadAssets()
 {
+	// Both entry points go to the pool first. They come straight from the shader cache when no file they read has
+	// changed, and are compiled in parallel when one has.
+	if ( !m_spShaderCache )
+	{
+		m_spShaderCache = std::make_unique< ShaderCache >( GetAssetFullPath( ShaderCacheDirectory ), m_kShaderCompiler );
+	}
+#if defined( _DEBUG )
+	// Enable better shader debugging with the graphics debugging tools.
+	const uint32_t compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+	const uint32_t compileFlags = 0;
+#endif
+	const std::filesystem::path shaderPath = GetAssetFullPath( L"assets\\shaders.hlsl" );
+	std::future< std::shared_ptr< const CompiledShader > > vertexShaderFuture = m_spShaderCache->GetAsync( { shaderPath, "VSMain", "vs_5_0", {}, compileFlags }, GetJobSystem() );
+	std::future< std::shared_ptr< const CompiledShader > > pixelShaderFuture = m_spShaderCache->GetAsync( { shaderPath, "PSMain", "ps_5_0", {}, compileFlags }, GetJobSystem() );
+
+	// Start decoding the texture on the job system right away too, it overlaps with the shaders.
+	// Fast BC7 is cheap enough to do at load time and takes a quarter of the memory of RGBA8.
+	TextureLoadOptions kTextureOptions;
+	kTextureOptions.compress = true;
+	kTextureOptions.compressOptions.format = BlockFormat::BC7;
+	kTextureOptions.compressOptions.quality = BlockQuality::Fast;
+	// A cooked .ldxt next to the source image skips decoding altogether, see tools/TextureCooker.cpp.
+	MappedTextureFile kCookedTexture;
+	const std::wstring texturePath = GetAssetFullPath( L"assets\\textures\\rickroll.jpg" );
+	Texture2DInfo kTextureInfo;
+	D3D12_RESOURCE_DESC textureDesc = {};
+	if ( kCookedTexture.Open( GetAssetFullPath( L"assets\\textures\\rickroll.ldxt" ) ) )
+	{
+		const TextureFileHeader& kHeader = kCookedTexture.GetHeader();
+		if ( kHeader.arraySize != 1 )
+		{
+			throw std::runtime_error( "rickroll.ldxt should hold a single texture, not an array" );
+		}
+		textureDesc.MipLevels = static_cast< UINT16 >( kHeader.mipCount );
+		textureDesc.Format = GetTextureFileFormat( kHeader.format );
+		textureDesc.Width = kHeader.width;
+		textureDesc.Height = kHeader.height;
+	}
+	else
+	{
+		// Only the header for now, the decode writes into the upload ring and needs the resource's footprints first.
+		kTextureInfo = TextureManager::GetTexture2DInfo( texturePath, kTextureOptions );
+		textureDesc.MipLevels = static_cast< UINT16 >( kTextureInfo.mipCount );
+		textureDesc.Format = kTextureInfo.compressed ? GetBlockFormat( kTextureInfo.blockFormat ) : DXGI_FORMAT_R8G8B8A8_UNORM;
+		textureDesc.Width = kTextureInfo.width;
+		textureDesc.Height = kTextureInfo.height;
+	}
+	textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+	textureDesc.DepthOrArraySize = 1;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+
+	ThrowIfFailed( m_spDevice->CreateCommittedResource(
+		HeapPropertiesFactory::GetDefaultHeapProperties(),
+		D3D12_HEAP_FLAG_NONE,
+		&textureDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS( &m_spTexture )
+	) );
+
+	// The last stage of the decode, the BC7 blocks or the mip levels, writes every level straight to its footprint in
+	// the upload ring. No decoded copy of the image is kept and nothing is copied again before the GPU copy.
+	std::vector< D3D12_PLACED_SUBRESOURCE_FOOTPRINT > textureFootprints;
+	UploadAllocation kTextureUpload;
+	std::future< void > textureFuture;
+	if ( !kCookedTexture.IsOpen() )
+	{
+		textureFootprints.resize( textureDesc.MipLevels );
+		UINT64 uploadSize = 0;
+		m_spDevice->GetCopyableFootprints( &textureDesc, 0, textureDesc.MipLevels, 0, textureFootprints.data(), nullptr, nullptr, &uploadSize );
+		kTextureUpload = m_kUploadRing.Allocate( uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT );
+
+		std::vector< Texture2DDestination > destinations( textureDesc.MipLevels );
+		for ( UINT n = 0; n < textureDesc.MipLevels; ++n )
+		{
+			destinations[ n ].pData = kTextureUpload.pCpuAddress + textureFootprints[ n ].Offset;
+			destinations[ n ].rowPitch = textureFootprints[ n ].Footprint.RowPitch;
+			textureFootprints[ n ].Offset += kTextureUpload.offset;
+		}
+		textureFuture = TextureManager::DecodeTexture2DIntoAsync( texturePath, kTextureInfo, std::move( destinations ), GetJobSystem(), kTextureOptions );
+	}
+
+	// The decode writes into the upload ring, a throw before the wait for it below waits for it as well.
+	struct TextureJobGuard
+	{
+		std::future< void >& future;
+		~TextureJobGuard()
+		{
+			if ( future.valid() )
+			{
+				future.wait();
+			}
+		}
+	} kTextureJobGuard{ textureFuture };
+
+	// The pipeline is created on the pool while the assets upload. What its description points to has to live until
+	// the wait before the bundle is recorded.
+	ComPtr< ID3DBlob > spSignature;
+	std::shared_ptr< const CompiledShader > spVertexShader;
+	std::shared_ptr< const CompiledShader > spPixelShader;
+	D3D12_INPUT_ELEMENT_DESC inputElementDescs[ Vertex::uAttributeCount ] = {};
+	std::unique_ptr< D3D12GraphicsPipeline > spPipeline;
+	JobCounter kPipelineJobs;
+
+	// A throw before that wait would free all of the above under the running job, so unwinding waits as well.
+	// Its own error is dropped there, the one being thrown already says what went wrong.
+	struct PipelineJobsGuard
+	{
+		ThreadPool& kJobs;
+		JobCounter& kCounter;
+		~PipelineJobsGuard()
+		{
+			try
+			{
+				kJobs.Wait( kCounter );
+			}
+			catch ( ... )
+			{
+			}
+		}
+	} kPipelineJobsGuard{ GetJobSystem(), kPipelineJobs };
+
 	// Create the root signature
 	{
 		D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
@@ -436,18 +681,18 @@ void HelloWindow::LoadAssets()
 
 
 		// Create a descriptor range (descriptor table) and a root parameter.
-		std::vector< CD3DX12_DESCRIPTOR_RANGE1 > ranges( 2 );
+		std::vector< CD3DX12_DESCRIPTOR_RANGE1 > ranges( 1 );
 		ranges[ 0 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC );	// إߤ@ SRV q t0 }l
-		ranges[ 1 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC );  // إߤ@ CBV q b0 }l
 
 
 		std::vector< CD3DX12_ROOT_PARAMETER1 > rootParameters( 2 );
 		rootParameters[ 0 ].InitAsDescriptorTable( 1, &ranges[ 0 ], D3D12_SHADER_VISIBILITY_PIXEL );
-		rootParameters[ 1 ].InitAsDescriptorTable( 1, &ranges[ 1 ], D3D12_SHADER_VISIBILITY_VERTEX );
+		// Constants come straight from the per-frame pool as a root CBV at b0, no descriptor needed.
+		rootParameters[ 1 ].InitAsConstantBufferView( 0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_VERTEX );
 
 
 		D3D12_STATIC_SAMPLER_DESC sampler = {};
-		sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
+		sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
 		sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
 		sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
 		sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
@@ -470,41 +715,31 @@ void HelloWindow::LoadAssets()
 		CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc = {};
 		rootSignatureDesc.Init_1_1( static_cast< UINT >( rootParameters.size() ), rootParameters.data(), 1, &sampler, rootSignatureFlags);
 
-		ComPtr< ID3DBlob > spSignature;
 		ComPtr< ID3DBlob > spError;
 		ThrowIfFailed( D3DX12SerializeVersionedRootSignature( &rootSignatureDesc, featureData.HighestVersion, &spSignature, &spError ) );
 		ThrowIfFailed( m_spDevice->CreateRootSignature( 0, spSignature->GetBufferPointer(), spSignature->GetBufferSize(), IID_PPV_ARGS( &m_spRootSignature ) ) );
 	}
 
-	// Create the pipeline state, which includes compiling and loading shaders.
+	// Create the pipeline state, once both shaders are in.
 	{
-		ComPtr< ID3DBlob > spVertexShader;
-		ComPtr< ID3DBlob > spPixelShader;
-
-#if defined( _DEBUG )
-		// Enable better shader debugging with the graphics debugging tools.
-		UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-		UINT compileFlags = 0;
-#endif
-
-		ThrowIfFailed( D3DCompileFromFile( GetAssetFullPath( L"assets\\shaders.hlsl" ).c_str(), nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &spVertexShader, nullptr ) );
-		ThrowIfFailed( D3DCompileFromFile( GetAssetFullPath( L"assets\\shaders.hlsl" ).c_str(), nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &spPixelShader, nullptr ) );
+		spVertexShader = vertexShaderFuture.get();
+		spPixelShader = pixelShaderFuture.get();
 
 		// Define the vertex input layout.
-		D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+		// Generated from the vertex layout, so the offsets and formats always match what Vertex::Pack writes.
+		constexpr auto kAttributes = Vertex::GetAttributes();
+		for ( uint32_t n = 0; n < Vertex::uAttributeCount; ++n )
 		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0,  0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "COLOR",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,       0, 28, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-		};
+			inputElementDescs[ n ] = { kAttributes[ n ].pSemanticName, kAttributes[ n ].semanticIndex, GetVertexElementFormat( kAttributes[ n ].format ),
+									   0, kAttributes[ n ].offset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+		}
 
 		// Describe and create the graphics pipeline state object (PSO).
 		D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
 		psoDesc.InputLayout = { inputElementDescs, _countof( inputElementDescs ) };
 		psoDesc.pRootSignature = m_spRootSignature.Get();
-		psoDesc.VS = CD3DX12_SHADER_BYTECODE( spVertexShader.Get() );
-		psoDesc.PS = CD3DX12_SHADER_BYTECODE( spPixelShader.Get() );
+		psoDesc.VS = CD3DX12_SHADER_BYTECODE( spVertexShader->GetBytecode(), spVertexShader->GetBytecodeSize() );
+		psoDesc.PS = CD3DX12_SHADER_BYTECODE( spPixelShader->GetBytecode(), spPixelShader->GetBytecodeSize() );
 		psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC( D3D12_DEFAULT );
 		psoDesc.BlendState = CD3DX12_BLEND_DESC( D3D12_DEFAULT );
 		psoDesc.DepthStencilState.DepthEnable = FALSE;
@@ -514,79 +749,53 @@ void HelloWindow::LoadAssets()
 		psoDesc.NumRenderTargets = 1;
 		psoDesc.RTVFormats[ 0 ] = DXGI_FORMAT_R8G8B8A8_UNORM;
 		psoDesc.SampleDesc.Count = 1;
-		ThrowIfFailed( m_spDevice->CreateGraphicsPipelineState( &psoDesc, IID_PPV_ARGS( &m_spPipelineState ) ) );
-	}
 
-	// create the command list
-	ThrowIfFailed( m_spDevice->CreateCommandList( 0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_spCommandAllocator[ m_frameIndex ].Get(), m_spPipelineState.Get(), IID_PPV_ARGS(&m_spCommandList)));
+		// From the driver's blob when an earlier run compiled the same description, see PipelineCache.
+		spPipeline = std::make_unique< D3D12GraphicsPipeline >( m_spDevice.Get(), psoDesc, spSignature->GetBufferPointer(), spSignature->GetBufferSize() );
+		m_spPipelineCache->CreateAsync( *spPipeline, GetJobSystem(), kPipelineJobs );
+	}
 
-	// Create the vertex buffer.
-	ComPtr< ID3D12Resource > spVertexBufferUploadHeap;
-	{
-		// Define the geometry for a triangle.
-		std::vector< Vertex > vertices =
-		{
-			// front face
-			{ {  0.5f,  0.5f, -0.5f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f } },
-			{ {  0.5f, -0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f } },
-			{ { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } },
-			{ { -0.5f,  0.5f, -0.5f }, { 1.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
-
-			// back face
-			{ { -0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
-			{ { -0.5f, -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
-			{ {  0.5f, -0.5f,  0.5f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f } },
-			{ {  0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } },
-			
-			// right face
-			{ {  0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f } },
-			{ {  0.5f, -0.5f,  0.5f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f } },
-			{ {  0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } },
-			{ {  0.5f,  0.5f, -0.5f }, { 1.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
-
-			// left face
-			{ { -0.5f,  0.5f, -0.5f }, { 1.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
-			{ { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
-			{ { -0.5f, -0.5f,  0.5f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f } },
-			{ { -0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } },
-
-			// top face
-			{ {  0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f } },
-			{ {  0.5f,  0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f } },
-			{ { -0.5f,  0.5f, -0.5f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } },
-			{ { -0.5f,  0.5f,  0.5f }, { 1.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
-			
-			// bottom face
-			{ { -0.5f, -0.5f,  0.5f }, { 1.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
-			{ { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
-			{ {  0.5f, -0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f } },
-			{ {  0.5f, -0.5f,  0.5f }, { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } },
-		};
+	// create the command list, the uploads do not draw so it starts without a pipeline.
+	ICommandAllocator& kUploadAllocator = m_spCommandAllocatorPool->Acquire();
+	ThrowIfFailed( m_spDevice->CreateCommandList( 0, D3D12_COMMAND_LIST_TYPE_DIRECT, D3D12CommandBackend::GetNative( kUploadAllocator ), nullptr, IID_PPV_ARGS(&m_spCommandList)));
 
-		const size_t vertexBufferSize = vertices.size() * sizeof( Vertex );
+	// Nothing else is recorded or queued before this list, so every state is known and all barriers go in one batch at the end.
+	ResourceStateTracker kUploadStates( m_kResourceStates );
+	kUploadStates.Begin( true );
+	D3D12BarrierSink kUploadBarriers( m_spCommandList.Get() );
 
-		// Note: using upload heaps to transfer static data like vertex buffers is not recommended.
-		// Every time the GPU needs it, the upload heap will be marshalled over.
-		// Please read up on Default Heap usage. An upload heap is used here for code simplicity and
-		// because there are very few vertices to actually transfer.
-		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer( vertexBufferSize );
-		ThrowIfFailed( m_spDevice->CreateCommittedResource(
-			HeapPropertiesFactory::GetUploadHeapProperties(),
-			D3D12_HEAP_FLAG_NONE,
-			&bufferDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS( &spVertexBufferUploadHeap )
-		) );
+	// Import the cube, welded and reordered for the post-transform cache.
+	MeshData kMesh = MeshImporter::Load( GetAssetFullPath( L"assets\\models\\cube.gltf" ) );
+	MeshOptimizer::Optimize( kMesh );
 
-		// Copy the triangle data to the vertex buffer.
-		UINT8* pVertexDataBegin = nullptr;
-		CD3DX12_RANGE readRange( 0, 0 ); // we do not intend to read from this resource on the CPU.
-		ThrowIfFailed( spVertexBufferUploadHeap->Map( 0, &readRange, reinterpret_cast< void** >( &pVertexDataBegin ) ) );
-		memcpy( pVertexDataBegin, vertices.data(), vertexBufferSize );
-		spVertexBufferUploadHeap->Unmap( 0, nullptr );
+	// Create the vertex buffer.
+	{
+		m_kMeshBounds = VertexQuantizer::ComputeBounds( kMesh.vertices );
+
+		// The cube only spins around its center, so the sphere around its bounds never changes.
+		const float boxMin[ 3 ] = { m_kMeshBounds.center[ 0 ] - m_kMeshBounds.extent[ 0 ], m_kMeshBounds.center[ 1 ] - m_kMeshBounds.extent[ 1 ], m_kMeshBounds.center[ 2 ] - m_kMeshBounds.extent[ 2 ] };
+		const float boxMax[ 3 ] = { m_kMeshBounds.center[ 0 ] + m_kMeshBounds.extent[ 0 ], m_kMeshBounds.center[ 1 ] + m_kMeshBounds.extent[ 1 ], m_kMeshBounds.center[ 2 ] + m_kMeshBounds.extent[ 2 ] };
+		m_kCuller.Clear();
+		m_kCuller.AddObject( boxMin, boxMax );
+
+		// Positions are SNORM16 relative to the mesh bounds, the mesh node scales and moves them back.
+		m_kTransforms.Clear();
+		m_spinNode = m_kTransforms.AddNode( TransformHierarchy::uInvalidNode );
+		m_meshNode = m_kTransforms.AddNode( m_spinNode,
+			DirectX::XMFLOAT3( m_kMeshBounds.center[ 0 ], m_kMeshBounds.center[ 1 ], m_kMeshBounds.center[ 2 ] ),
+			DirectX::XMFLOAT4( 0.0f, 0.0f, 0.0f, 1.0f ),
+			DirectX::XMFLOAT3( m_kMeshBounds.extent[ 0 ], m_kMeshBounds.extent[ 1 ], m_kMeshBounds.extent[ 2 ] ) );
+
+		const size_t vertexBufferSize = kMesh.vertices.size() * Vertex::uStride;
+
+		// Stage the triangle data in the upload ring, it is already mapped.
+		// Buffer to buffer copies only need 4-byte aligned offsets.
+		const UploadAllocation kUpload = m_kUploadRing.Allocate( vertexBufferSize, 4 );
+		// Quantized straight into the mapped upload memory.
+		Vertex::Pack( kMesh.vertices.data(), kMesh.vertices.size(), m_kMeshBounds, kUpload.pCpuAddress );
 
 		// create vertex buffer in default heap
+		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer( vertexBufferSize );
 		ThrowIfFailed( m_spDevice->CreateCommittedResource(
 			HeapPropertiesFactory::GetDefaultHeapProperties(),
 			D3D12_HEAP_FLAG_NONE,
@@ -595,61 +804,43 @@ void HelloWindow::LoadAssets()
 			nullptr,
 			IID_PPV_ARGS( &m_spVertexBuffer )
 		) );
-		m_spCommandList->CopyBufferRegion( m_spVertexBuffer.Get(), 0, spVertexBufferUploadHeap.Get(), 0, vertexBufferSize );
-
-		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition( m_spVertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER );
-		m_spCommandList->ResourceBarrier( 1, &barrier );
+		m_kResourceStates.Register( m_spVertexBuffer.Get(), 1, D3D12_RESOURCE_STATE_COPY_DEST );
+		kUploadStates.Transition( m_spVertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST );
+		kUploadStates.FlushBarriers( kUploadBarriers );
+		m_spCommandList->CopyBufferRegion( m_spVertexBuffer.Get(), 0, kUpload.pResource, kUpload.offset, vertexBufferSize );
+		kUploadStates.Transition( m_spVertexBuffer.Get(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER );
 
 		// Initialize the vertex buffer view.
 		m_spVertexBufferView.BufferLocation = m_spVertexBuffer->GetGPUVirtualAddress();
-		m_spVertexBufferView.StrideInBytes = sizeof( Vertex );
+		m_spVertexBufferView.StrideInBytes = Vertex::uStride;
 		m_spVertexBufferView.SizeInBytes = static_cast< UINT >( vertexBufferSize );
 	}
 
 	// Create Index Buffer
-	ComPtr< ID3D12Resource > spIndexBufferUploadHeap;
 	{
-		std::vector< uint16_t > indices =
+		// 16-bit indices halve the index fetch bandwidth whenever they are enough.
+		const std::vector< uint32_t >& indices = kMesh.indices;
+		const bool bShortIndices = kMesh.vertices.size() <= 0xFFFF;
+		const size_t indexSize = bShortIndices ? sizeof( uint16_t ) : sizeof( uint32_t );
+		const size_t indexBufferSize = indices.size() * indexSize;
+
+		// Stage the index data in the upload ring.
+		const UploadAllocation kUpload = m_kUploadRing.Allocate( indexBufferSize, 4 );
+		if ( bShortIndices )
 		{
-			0,  1,  2,
-			0,  2,  3,
-
-			4,  5,  6,
-			4,  6,  7,
-
-			8,  9, 10,
-			8, 10, 11,
-
-			12, 13, 14,
-			12, 14, 15,
-
-			16, 17, 18,
-			16, 18, 19,
-
-			20, 21, 22,
-			20, 22, 23,
-		};
-
-		const size_t indexBufferSize = indices.size() * sizeof( uint16_t );
-
-		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer( indexBufferSize );
-		ThrowIfFailed( m_spDevice->CreateCommittedResource(
-			HeapPropertiesFactory::GetUploadHeapProperties(),
-			D3D12_HEAP_FLAG_NONE,
-			&bufferDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS( &spIndexBufferUploadHeap )
-		) );
-
-		// Copy the triangle data to the vertex buffer.
-		UINT8* pIndexDataBegin = nullptr;
-		CD3DX12_RANGE readRange( 0, 0 ); // we do not intend to read from this resource on the CPU.
-		ThrowIfFailed( spIndexBufferUploadHeap->Map( 0, &readRange, reinterpret_cast< void** >( &pIndexDataBegin ) ) );
-		memcpy( pIndexDataBegin, indices.data(), indexBufferSize );
-		spIndexBufferUploadHeap->Unmap( 0, nullptr );
+			uint16_t* pIndices = reinterpret_cast< uint16_t* >( kUpload.pCpuAddress );
+			for ( size_t n = 0; n < indices.size(); ++n )
+			{
+				pIndices[ n ] = static_cast< uint16_t >( indices[ n ] );
+			}
+		}
+		else
+		{
+			memcpy( kUpload.pCpuAddress, indices.data(), indexBufferSize );
+		}
 
 		// create vertex buffer in default heap
+		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer( indexBufferSize );
 		ThrowIfFailed( m_spDevice->CreateCommittedResource(
 			HeapPropertiesFactory::GetDefaultHeapProperties(),
 			D3D12_HEAP_FLAG_NONE,
@@ -658,115 +849,106 @@ void HelloWindow::LoadAssets()
 			nullptr,
 			IID_PPV_ARGS( &m_spIndexBuffer )
 		) );
-		m_spCommandList->CopyBufferRegion( m_spIndexBuffer.Get(), 0, spIndexBufferUploadHeap.Get(), 0, indexBufferSize );
-		
-		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition( m_spIndexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER );
-		m_spCommandList->ResourceBarrier( 1, &barrier );
+		m_kResourceStates.Register( m_spIndexBuffer.Get(), 1, D3D12_RESOURCE_STATE_COPY_DEST );
+		kUploadStates.Transition( m_spIndexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST );
+		kUploadStates.FlushBarriers( kUploadBarriers );
+		m_spCommandList->CopyBufferRegion( m_spIndexBuffer.Get(), 0, kUpload.pResource, kUpload.offset, indexBufferSize );
+		kUploadStates.Transition( m_spIndexBuffer.Get(), D3D12_RESOURCE_STATE_INDEX_BUFFER );
 
 		// Initialize the vertex buffer view.
 		m_spIndexBufferView.BufferLocation = m_spIndexBuffer->GetGPUVirtualAddress();
 		m_spIndexBufferView.SizeInBytes = static_cast< UINT >( indexBufferSize );
-		m_spIndexBufferView.Format = DXGI_FORMAT_R16_UINT;
+		m_spIndexBufferView.Format = bShortIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		m_indexCount = static_cast< UINT >( indices.size() );
 	}
 
-	// Note: ComPtr's are CPU objects but this resource needs to stay in scope until
-	// the command list that references it has finished executing on the GPU.
-	// We will flush the GPU at the end of this method to ensure the resouce is not prematurely destroyed.
-	ComPtr< ID3D12Resource > spTextureUploadHeap;
-
-	// Create the texture.
+	// Copy the texture, it was created next to the decode.
 	{
-		Texture2DPtr spTexture = TextureManager::CreateTexture2D( GetAssetFullPath( L"assets\\textures\\rickroll.jpg" ) );
-
-		// Describe and create a Texture2D.
-		D3D12_RESOURCE_DESC textureDesc = {};
-		textureDesc.MipLevels = 1;
-		textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		textureDesc.Width = static_cast< UINT >( spTexture->width );
-		textureDesc.Height = static_cast< UINT >( spTexture->height );
-		textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-		textureDesc.DepthOrArraySize = 1;
-		textureDesc.SampleDesc.Count = 1;
-		textureDesc.SampleDesc.Quality = 0;
-		textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-
-		ThrowIfFailed( m_spDevice->CreateCommittedResource(
-			HeapPropertiesFactory::GetDefaultHeapProperties(),
-			D3D12_HEAP_FLAG_NONE,
-			&textureDesc,
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			nullptr,
-			IID_PPV_ARGS( &m_spTexture )
-		) );
-
-		const UINT64 uploadBufferSize = GetRequiredIntermediateSize( m_spTexture.Get(), 0, 1 );
-
-		// Create the GPU upload buffer.
-		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer( uploadBufferSize );
-		ThrowIfFailed( m_spDevice->CreateCommittedResource(
-			HeapPropertiesFactory::GetUploadHeapProperties(),
-			D3D12_HEAP_FLAG_NONE,
-			&bufferDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS( &spTextureUploadHeap )
-		) );
+		const UINT subresourceCount = textureDesc.MipLevels;
+		m_kResourceStates.Register( m_spTexture.Get(), subresourceCount, D3D12_RESOURCE_STATE_COPY_DEST );
+		kUploadStates.Transition( m_spTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST );
+		kUploadStates.FlushBarriers( kUploadBarriers );
+		if ( kCookedTexture.IsOpen() )
+		{
+			// The payload is already laid out the way the copy engine wants it, one memcpy and a copy per subresource.
+			const UploadAllocation kUpload = m_kUploadRing.Allocate( kCookedTexture.GetPayloadSize(), D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT );
+			memcpy( kUpload.pCpuAddress, kCookedTexture.GetPayload(), static_cast< size_t >( kCookedTexture.GetPayloadSize() ) );
 
-		// Copy data to the intermediate upload heap and then schedule a copy
-		// from the upload heap to the Texture2D.
-		D3D12_SUBRESOURCE_DATA textureData = {};
-		textureData.pData = spTexture->data;
-		textureData.RowPitch = spTexture->width * spTexture->pixelSize;
-		textureData.SlicePitch = textureData.RowPitch * spTexture->height;
+			const bool bBlocks = TextureContainer::IsBlockCompressed( kCookedTexture.GetHeader().format );
+			for ( UINT n = 0; n < subresourceCount; ++n )
+			{
+				const TextureFileSubresource& kEntry = kCookedTexture.GetSubresource( n );
+
+				// Footprints of block compressed levels cover whole blocks, even for the 2x2 and 1x1 mips.
+				D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+				footprint.Offset = kUpload.offset + kEntry.offset;
+				footprint.Footprint.Format = textureDesc.Format;
+				footprint.Footprint.Width = bBlocks ? ( kEntry.width + 3 ) & ~3u : kEntry.width;
+				footprint.Footprint.Height = bBlocks ? ( kEntry.height + 3 ) & ~3u : kEntry.height;
+				footprint.Footprint.Depth = 1;
+				footprint.Footprint.RowPitch = kEntry.rowPitch;
+
+				const CD3DX12_TEXTURE_COPY_LOCATION destination( m_spTexture.Get(), n );
+				const CD3DX12_TEXTURE_COPY_LOCATION source( kUpload.pResource, footprint );
+				m_spCommandList->CopyTextureRegion( &destination, 0, 0, 0, &source, nullptr );
+			}
 
-		UpdateSubresources( m_spCommandList.Get(), m_spTexture.Get(), spTextureUploadHeap.Get(), 0, 0, 1, &textureData );
-		
-		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition( m_spTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE );
-		m_spCommandList->ResourceBarrier( 1, &barrier );
+			// Everything lives in the upload ring now, unmap the file instead of holding it until LoadAssets returns.
+			kCookedTexture.Close();
+		}
+		else
+		{
+			// Every level is in the upload ring once the decode is done, only the GPU copy is left.
+			textureFuture.get();
+			for ( UINT n = 0; n < subresourceCount; ++n )
+			{
+				const CD3DX12_TEXTURE_COPY_LOCATION destination( m_spTexture.Get(), n );
+				const CD3DX12_TEXTURE_COPY_LOCATION source( kTextureUpload.pResource, textureFootprints[ n ] );
+				m_spCommandList->CopyTextureRegion( &destination, 0, 0, 0, &source, nullptr );
+			}
+		}
+		kUploadStates.Transition( m_spTexture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE );
 
 		// Describe and create a SRV for the texture.
 		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 		srvDesc.Format = textureDesc.Format;
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-		srvDesc.Texture2D.MipLevels = 1;
+		srvDesc.Texture2D.MipLevels = textureDesc.MipLevels;
+
+		m_textureStagingSrv = m_kStagingSrvHeap.Allocate();
+		m_spDevice->CreateShaderResourceView( m_spTexture.Get(), &srvDesc, m_textureStagingSrv.cpu );
 
-		CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle( m_spSrvHeap->GetCPUDescriptorHandleForHeapStart(), 1, m_srvDescriptorSize );
-		m_spDevice->CreateShaderResourceView( m_spTexture.Get(), &srvDesc, srvHandle );
+		m_textureSrv = m_kSrvHeap.AllocatePersistent();
+		m_kSrvHeap.QueueCopy( m_textureSrv, m_textureStagingSrv.cpu, 1 );
 	}
 
+	// Copy every staged view into the shader visible heap in one go.
+	m_kSrvHeap.FlushCopies();
+
+	// The vertex, index buffer and texture transitions, one ResourceBarrier call. The start was known, so there are no fixups.
+	kUploadStates.FlushBarriers( kUploadBarriers );
+	kUploadStates.Resolve();
+
 	// Close the command list and execute it to begin the initial GPU setup.
 	ThrowIfFailed( m_spCommandList->Close() );
 	ID3D12CommandList* ppCommandLists[] = { m_spCommandList.Get() };
 	m_spCommandQueue->ExecuteCommandLists( _countof( ppCommandLists ), ppCommandLists );
 
-	// Create the contant buffer
-	{
-		const UINT constantBufferSize = sizeof( SceneConstantBuffer );
-
-		auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer( constantBufferSize );
-		ThrowIfFailed( m_spDevice->CreateCommittedResource(
-			HeapPropertiesFactory::GetUploadHeapProperties(),
-			D3D12_HEAP_FLAG_NONE,
-			&bufferDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS( &m_spConstantBuffer )
-		) );
+	GetJobSystem().Wait( kPipelineJobs );
+	m_spPipelineState = spPipeline->Get();
 
-		// Describe and create a constant buffer view.
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-		cbvDesc.BufferLocation = m_spConstantBuffer->GetGPUVirtualAddress();
-		cbvDesc.SizeInBytes = constantBufferSize;
-
-		CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle( m_spSrvHeap->GetCPUDescriptorHandleForHeapStart(), 2, m_srvDescriptorSize );
-		m_spDevice->CreateConstantBufferView( &cbvDesc, srvHandle );
-
-		// Map and initialize the constant buffer. we don't unmap this untill the app close.
-		// Keeping mapped for the lifetime of the resource is okay.
-		CD3DX12_RANGE readRange( 0, 0 ); // we do not intend to read from this resource on the CPU.
-		ThrowIfFailed( m_spConstantBuffer->Map( 0, &readRange, reinterpret_cast< void** >( &m_pCbvDataBegin ) ) );
-		memcpy( m_pCbvDataBegin, &m_kConstantBuffer, sizeof( m_kConstantBuffer ) );
+	// Only written when something was compiled. The cache just saves time, a read-only folder is no reason to stop.
+	if ( m_spPipelineCache->IsDirty() )
+	{
+		try
+		{
+			m_spPipelineCache->Save( GetAssetFullPath( PipelineCacheFile ) );
+		}
+		catch ( const std::exception& kError )
+		{
+			OutputDebugStringA( ( std::string( "Pipeline cache not saved: " ) + kError.what() + "\n" ).c_str() );
+		}
 	}
 
 	// Create and record the bundle
@@ -777,11 +959,14 @@ void HelloWindow::LoadAssets()
 		m_spBundle->IASetPrimitiveTopology( D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
 		m_spBundle->IASetVertexBuffers( 0, 1, &m_spVertexBufferView );
 		m_spBundle->IASetIndexBuffer( &m_spIndexBufferView );
-		m_spBundle->DrawIndexedInstanced( 36, 1, 0, 0, 0 );
+		m_spBundle->DrawIndexedInstanced( m_indexCount, 1, 0, 0, 0 );
 		ThrowIfFailed( m_spBundle->Close() );
 	}
 
-	WaitForGpu();
+	// The first frame signals this fence value after the uploads, the ring space and the allocator are handed back
+	// once it passes, so there is nothing to wait for here.
+	m_kUploadRing.FinishFrame( m_fenceValue );
+	m_spCommandAllocatorPool->Release( kUploadAllocator, m_fenceValue );
 }
 
 void HelloWindow::InitImGui()
@@ -797,71 +982,118 @@ void HelloWindow::InitImGui()
 	ImGui::StyleColorsDark();
 
 	// է ImGui  Font Texture b Descriptor Heap m
-	CD3DX12_CPU_DESCRIPTOR_HANDLE srvCpuHandle( m_spSrvHeap->GetCPUDescriptorHandleForHeapStart(), 0, m_srvDescriptorSize );
-	CD3DX12_GPU_DESCRIPTOR_HANDLE srvGpuHandle( m_spSrvHeap->GetGPUDescriptorHandleForHeapStart(), 0, m_srvDescriptorSize );
+	m_imGuiFontSrv = m_kSrvHeap.AllocatePersistent();
 
 	// Setup Platform/Renderer bindings
 	ImGui_ImplWin32_Init( Win32App::GetHwnd() );
-	ImGui_ImplDX12_Init( m_spDevice.Get(), FrameCount, 
+	ImGui_ImplDX12_Init( m_spDevice.Get(), GetFramesInFlight(), 
 						 DXGI_FORMAT_R8G8B8A8_UNORM, 
-						 m_spSrvHeap.Get(), 
-						 srvCpuHandle,
-						 srvGpuHandle );
+						 m_kSrvHeap.GetHeap(), 
+						 m_imGuiFontSrv.cpu,
+						 m_imGuiFontSrv.gpu );
 }
 
 void HelloWindow::PopulateCommandList()
 {
-	// Command list allocators can only be reset when the associated
-	// command lists have finished execution on the GPU; apps should use
-	// fences to determine GPU execution progress.
-	ThrowIfFailed( m_spCommandAllocator[ m_frameIndex ]->Reset() );
+	// FramePacer made sure the GPU is done with this slot, so its region of the pool can be rewound and refilled.
+	// Both are only touched here on the main thread, the recording jobs just read the addresses.
+	m_kConstantBufferPool.BeginFrame( m_frameIndex );
+	m_kSrvHeap.BeginFrame( m_frameIndex );
+	const D3D12_GPU_VIRTUAL_ADDRESS sceneConstants = m_kConstantBufferPool.Push( m_kConstantBuffer );
+	BuildRenderGraph( sceneConstants );
+
+	// Each pass gets its own list and allocator and is recorded by whichever worker picks it up,
+	// they are still executed in pass order.
+	m_spRenderGraphHeaps->Record( m_kRenderGraph, *m_spCommandRecorder, &GetJobSystem() );
+}
 
-	// However, when ExecuteCommandList() is called on a particular command list,
-	// that command list can be reset at any time and must be before re-recording
-	ThrowIfFailed( m_spCommandList->Reset( m_spCommandAllocator[ m_frameIndex ].Get(), m_spPipelineState.Get() ) );
+// The frame as a render graph: every pass says what it reads and writes, Compile works out the barriers and where the
+// depth buffer lives. Built again every frame, the back buffer changes and the passes could as well.
+void HelloWindow::BuildRenderGraph( D3D12_GPU_VIRTUAL_ADDRESS sceneConstants )
+{
+	const CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle( m_spRtvHeap->GetCPUDescriptorHandleForHeapStart(), m_backBufferIndex, m_rtvDescriptorSize );
+	const CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle( m_spDsvHeap->GetCPUDescriptorHandleForHeapStart() );
+	ID3D12Resource* pBackBuffer = m_renderTargets[ m_backBufferIndex ].Get();
+
+	// The back buffer and the texture outlive the frame, it starts with them in the states the cache has and
+	// leaves them in the ones the next frame expects.
+	m_kRenderGraph.Reset();
+	const uint32_t backBuffer = m_kRenderGraph.Import( "Back Buffer", pBackBuffer, m_kResourceStates.GetState( pBackBuffer, 0 ), D3D12_RESOURCE_STATE_PRESENT );
+	const uint32_t textureState = m_kResourceStates.GetState( m_spTexture.Get(), 0 );
+	const uint32_t texture = m_kRenderGraph.Import( "Texture", m_spTexture.Get(), textureState, textureState );
+
+	D3D12_RESOURCE_DESC depthDesc = CD3DX12_RESOURCE_DESC::Tex2D( DepthBufferFormat, static_cast< UINT64 >( m_width ), static_cast< UINT >( m_height ), 1, 1 );
+	depthDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+	const CD3DX12_CLEAR_VALUE depthOptimizedClearValue( DepthBufferFormat, 1.0f, 0u );
+	const uint32_t depthStencil = m_spRenderGraphHeaps->Create( m_kRenderGraph, "Depth Stencil", depthDesc, &depthOptimizedClearValue );
 
 	// Every command list only allow sets descriptor deap one time. 
-	ID3D12DescriptorHeap* ppHeaps[] = { m_spSrvHeap.Get() };
-	m_spCommandList->SetDescriptorHeaps( _countof( ppHeaps ), ppHeaps );
-
-	// Set necessary state.
-	m_spCommandList->SetGraphicsRootSignature( m_spRootSignature.Get() );
-
-	// q Descriptor Heap o index  1  Gpu Handle => oO]pΨӵڭ̤KW Texture
-	CD3DX12_GPU_DESCRIPTOR_HANDLE textureHandle( m_spSrvHeap->GetGPUDescriptorHandleForHeapStart(), 1, m_srvDescriptorSize );
-	CD3DX12_GPU_DESCRIPTOR_HANDLE constantHandle( m_spSrvHeap->GetGPUDescriptorHandleForHeapStart(), 2, m_srvDescriptorSize );
-	m_spCommandList->SetGraphicsRootDescriptorTable( 0, textureHandle ); // ɧڭ̤wgwqn Root Signature  0 ӰѼƬO@ Descriptor Table ]SRV^
-	m_spCommandList->SetGraphicsRootDescriptorTable( 1, constantHandle );
-
-	// Indicate that the back buffer will be used as a render target.
-	auto barrier = CD3DX12_RESOURCE_BARRIER::Transition( m_renderTargets[ m_frameIndex ].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET );
-	m_spCommandList->ResourceBarrier( 1, &barrier );
-
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle( m_spRtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize );
-	CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle( m_spDsvHeap->GetCPUDescriptorHandleForHeapStart() );
-	m_spCommandList->OMSetRenderTargets( 1, &rtvHandle, FALSE, &dsvHandle );
-
-	const float clearColor[ 4 ] = { m_clearColor.x * m_clearColor.w, m_clearColor.y * m_clearColor.w, m_clearColor.z * m_clearColor.w, m_clearColor.w };
-	m_spCommandList->ClearRenderTargetView( rtvHandle, clearColor, 0, nullptr );
-	m_spCommandList->ClearDepthStencilView( dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr );
+	ID3D12DescriptorHeap* pSrvHeap = m_kSrvHeap.GetHeap();
 
-	// Set the viewport and scissor rect.
-	const CD3DX12_VIEWPORT viewport( 0.0f, 0.0f, static_cast< float >( m_width ), static_cast< float >( m_height ), D3D12_MIN_DEPTH, D3D12_MAX_DEPTH );
-	const CD3DX12_RECT scissorRect( 0, 0, static_cast< LONG >( m_width ), static_cast< LONG >( m_height ) );
-	m_spCommandList->RSSetViewports( 1, &viewport );
-	m_spCommandList->RSSetScissorRects( 1, &scissorRect );
-
-	// Draw the scene
-	m_spCommandList->ExecuteBundle( m_spBundle.Get() );
+	// Clear the back buffer, and the depth buffer, which has to be written completely before it is read since it may
+	// have taken over its memory from something else.
+	const uint32_t clearPass = m_kRenderGraph.AddPass( "Clear", [ this, rtvHandle, dsvHandle ]( ICommandList& kList )
+	{
+		ID3D12GraphicsCommandList* pCommandList = D3D12CommandBackend::GetNative( kList );
+		const float clearColor[ 4 ] = { m_clearColor.x * m_clearColor.w, m_clearColor.y * m_clearColor.w, m_clearColor.z * m_clearColor.w, m_clearColor.w };
+		pCommandList->ClearRenderTargetView( rtvHandle, clearColor, 0, nullptr );
+		pCommandList->ClearDepthStencilView( dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr );
+	} );
+	m_kRenderGraph.Write( clearPass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET );
+	m_kRenderGraph.Write( clearPass, depthStencil, D3D12_RESOURCE_STATE_DEPTH_WRITE );
+
+	// The scene. Command lists don't inherit state from each other, so this one sets everything it needs.
+	const uint32_t scenePass = m_kRenderGraph.AddPass( "Scene", [ this, rtvHandle, dsvHandle, pSrvHeap, sceneConstants ]( ICommandList& kList )
+	{
+		ID3D12GraphicsCommandList* pCommandList = D3D12CommandBackend::GetNative( kList );
+		ID3D12DescriptorHeap* ppHeaps[] = { pSrvHeap };
+		pCommandList->SetDescriptorHeaps( _countof( ppHeaps ), ppHeaps );
+		pCommandList->SetPipelineState( m_spPipelineState.Get() );
+		pCommandList->SetGraphicsRootSignature( m_spRootSignature.Get() );
+		pCommandList->SetGraphicsRootDescriptorTable( 0, m_textureSrv.gpu ); // ɧڭ̤wgwqn Root Signature  0 ӰѼƬO@ Descriptor Table ]SRV^
+		pCommandList->SetGraphicsRootConstantBufferView( 1, sceneConstants );
+		pCommandList->OMSetRenderTargets( 1, &rtvHandle, FALSE, &dsvHandle );
+
+		// Set the viewport and scissor rect.
+		const CD3DX12_VIEWPORT viewport( 0.0f, 0.0f, static_cast< float >( m_width ), static_cast< float >( m_height ), D3D12_MIN_DEPTH, D3D12_MAX_DEPTH );
+		const CD3DX12_RECT scissorRect( 0, 0, static_cast< LONG >( m_width ), static_cast< LONG >( m_height ) );
+		pCommandList->RSSetViewports( 1, &viewport );
+		pCommandList->RSSetScissorRects( 1, &scissorRect );
+
+		// Draw the scene, the bundle draws the cube so it is skipped when the cube got culled.
+		if ( !m_visibleObjects.empty() )
+		{
+			pCommandList->ExecuteBundle( m_spBundle.Get() );
+		}
+	} );
+	m_kRenderGraph.Write( scenePass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET );
+	m_kRenderGraph.Write( scenePass, depthStencil, D3D12_RESOURCE_STATE_DEPTH_WRITE );
+	m_kRenderGraph.Read( scenePass, texture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE );
 
-	// Render ImGui
-	ImGui_ImplDX12_RenderDrawData( ImGui::GetDrawData(), m_spCommandList.Get() );
+	// ImGui on top. It does not test depth, so the depth buffer's lifetime ends with the scene.
+	if ( !m_bHeadless )
+	{
+		const uint32_t imGuiPass = m_kRenderGraph.AddPass( "ImGui", [ rtvHandle, pSrvHeap ]( ICommandList& kList )
+		{
+			ID3D12GraphicsCommandList* pCommandList = D3D12CommandBackend::GetNative( kList );
+			ID3D12DescriptorHeap* ppHeaps[] = { pSrvHeap };
+			pCommandList->SetDescriptorHeaps( _countof( ppHeaps ), ppHeaps );
+			pCommandList->OMSetRenderTargets( 1, &rtvHandle, FALSE, nullptr );
+			ImGui_ImplDX12_RenderDrawData( ImGui::GetDrawData(), pCommandList );
+		} );
+		m_kRenderGraph.Write( imGuiPass, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET );
+	}
 
-	// Indicate that the back buffer will now be used to present.
-	barrier = CD3DX12_RESOURCE_BARRIER::Transition( m_renderTargets[ m_frameIndex ].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT );
-	m_spCommandList->ResourceBarrier( 1, &barrier );
+	// The present barrier comes from the back buffer's final state, after the last pass that draws to it.
+	m_kRenderGraph.Compile();
+	m_spRenderGraphHeaps->Allocate( m_kRenderGraph, m_fenceValue );
 
-	ThrowIfFailed( m_spCommandList->Close() );
+	// The placed depth buffer can change between frames. Lists copy the view when they are recorded, so writing it
+	// again here does not disturb the frames in flight.
+	D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+	dsvDesc.Format = DepthBufferFormat;
+	dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+	m_spDevice->CreateDepthStencilView( m_spRenderGraphHeaps->GetResource( depthStencil ), &dsvDesc, dsvHandle );
 }
 
 void HelloWindow::RenderImGui()
@@ -882,6 +1114,30 @@ void HelloWindow::RenderImGui()
 		ImGui::Checkbox( "Demo Window", &m_showDemoWindow );
 		ImGui::ColorEdit3( "clear color", ( float* ) &m_clearColor );
 		ImGui::Text( "Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate );
+		ImGui::Text( "Constant buffer %u allocations, %llu bytes last frame",
+					 m_kConstantBufferPool.GetLastFrameStats().allocationCount,
+					 static_cast< unsigned long long >( m_kConstantBufferPool.GetLastFrameStats().bytesWritten ) );
+		ImGui::Text( "Frame time p50 %.3f / p95 %.3f / p99 %.3f / max %.3f ms",
+					 1000.0 * m_kTimer.GetFrameTimePercentileSeconds( 50.0 ),
+					 1000.0 * m_kTimer.GetFrameTimePercentileSeconds( 95.0 ),
+					 1000.0 * m_kTimer.GetFrameTimePercentileSeconds( 99.0 ),
+					 1000.0 * m_kTimer.GetMaxFrameTimeSeconds() );
+
+		// Latency against throughput: more frames in flight only pay off while the CPU or the GPU would otherwise idle.
+		const FramePacerStats& kPacing = m_spFramePacer->GetStats();
+		ImGui::Text( "%u frames in flight, %u back buffers: input to present %.1f ms (GPU done %.1f ms), %.1f FPS, %u fence waits",
+					 m_spFramePacer->GetFramesInFlight(), m_backBufferCount,
+					 1000.0 * kPacing.inputToPresentSeconds, 1000.0 * kPacing.inputToGpuSeconds,
+					 ( kPacing.frameIntervalSeconds > 0.0 ) ? 1.0 / kPacing.frameIntervalSeconds : 0.0, kPacing.fenceWaits );
+		// Last frame's graph, this one is only built after ImGui.
+		const RenderGraphStats& kGraphStats = m_kRenderGraph.GetStats();
+		ImGui::Text( "Render graph: %u passes (%u culled), %u transitions, %u aliasing barriers, %llu KB transient in %llu KB of heaps",
+					 kGraphStats.passes, kGraphStats.culledPasses, kGraphStats.transitions, kGraphStats.aliasingBarriers,
+					 static_cast< unsigned long long >( kGraphStats.transientBytes >> 10 ), static_cast< unsigned long long >( kGraphStats.heapBytes >> 10 ) );
+		const DeferredReleaseStats& kReleases = m_spDeferredRelease->GetStats();
+		ImGui::Text( "Deferred releases: %u pending (%llu KB), %u released last frame, %u stalls",
+					 kReleases.pending, static_cast< unsigned long long >( kReleases.pendingBytes >> 10 ),
+					 kReleases.releasedLastCollect, kReleases.stalls );
 		ImGui::End();
 	}
 
@@ -891,39 +1147,41 @@ void HelloWindow::RenderImGui()
 // Wait for pending GPU work to complete.
 void HelloWindow::WaitForGpu()
 {
-	if ( !m_spCommandQueue || !m_spFence || !m_fenceEvent.IsValid() )
+	if ( !m_spCommandQueue || !m_spFence || !m_spCommandBackend )
 	{
 		return;
 	}
 
 	// Scheudle a Signal command in the queue.
-	ThrowIfFailed( m_spCommandQueue->Signal( m_spFence.Get(), m_fenceValue[ m_frameIndex ] ) );
+	ThrowIfFailed( m_spCommandQueue->Signal( m_spFence.Get(), m_fenceValue ) );
 
 	// Wait untill the fence has been processed.
-	ThrowIfFailed( m_spFence->SetEventOnCompletion( m_fenceValue[ m_frameIndex ], m_fenceEvent.Get() ) );
-	std::ignore = WaitForSingleObjectEx( m_fenceEvent.Get(), INFINITE, FALSE );
+	m_spCommandBackend->WaitForFence( m_fenceValue );
 
-	// Increment the fence value for the current frame.
-	m_fenceValue[ m_frameIndex ]++;
+	// Increment the fence value for the next frame.
+	m_fenceValue++;
 }
 
 // Prepare to render the next frame.
 void HelloWindow::MoveToNextFrame()
 {
 	// Scheudle a Signal command in the queue.
-	const UINT64 currentFenceValue = m_fenceValue[ m_frameIndex ];
-	ThrowIfFailed( m_spCommandQueue->Signal( m_spFence.Get(), currentFenceValue ) );
+	ThrowIfFailed( m_spCommandQueue->Signal( m_spFence.Get(), m_fenceValue ) );
+	m_kUploadRing.FinishFrame( m_fenceValue );
 
-	// Update the frame index.
-	m_frameIndex = m_spSwapChain->GetCurrentBackBufferIndex();
-
-	// If the next frame is not ready to be rendered yet, wait until it is ready.
-	if ( m_spFence->GetCompletedValue() < m_fenceValue[ m_frameIndex ] )
+	// Nothing waits here anymore, the next OnFrameBegin does: first on the swap chain, then on the pacer slot.
+	UINT presentCount = 0;
+	if ( m_spSwapChain )
 	{
-		ThrowIfFailed( m_spFence->SetEventOnCompletion( m_fenceValue[ m_frameIndex ], m_fenceEvent.Get() ) );
-		std::ignore = WaitForSingleObjectEx( m_fenceEvent.Get(), INFINITE, FALSE );
+		ThrowIfFailed( m_spSwapChain->GetLastPresentCount( &presentCount ) );
 	}
+	m_spFramePacer->EndFrame( m_fenceValue, presentCount );
+	m_fenceValue++;
+
+	// Update the back buffer index. Without a swap chain just cycle through the render targets.
+	m_backBufferIndex = m_spSwapChain ? m_spSwapChain->GetCurrentBackBufferIndex() : ( m_backBufferIndex + 1 ) % m_backBufferCount;
 
-	// Set the fence value for the next frame.
-	m_fenceValue[ m_frameIndex ] = currentFenceValue + 1;
+	// Hand back upload space of every frame the GPU has finished with, and release what those frames still used.
+	m_kUploadRing.Retire( m_spFence->GetCompletedValue() );
+	m_spDeferredRelease->Collect();
 }
@@ -0,0 +1,96 @@
+#include "MappedFile.hpp"
+
+#if defined( _WIN32 )
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open( const std::filesystem::path& path )
+{
+	Close();
+
+#if defined( _WIN32 )
+	HANDLE hFile = CreateFileW( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+	if ( hFile == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size = {};
+	HANDLE hMapping = nullptr;
+	if ( GetFileSizeEx( hFile, &size ) && size.QuadPart > 0 )
+	{
+		hMapping = CreateFileMappingW( hFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	}
+	const void* pView = hMapping ? MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+	if ( !pView )
+	{
+		if ( hMapping )
+		{
+			CloseHandle( hMapping );
+		}
+		CloseHandle( hFile );
+		return false;
+	}
+
+	m_hFile = hFile;
+	m_hMapping = hMapping;
+	m_pData = static_cast< const uint8_t* >( pView );
+	m_size = static_cast< uint64_t >( size.QuadPart );
+#else
+	const int file = open( path.c_str(), O_RDONLY );
+	if ( file < 0 )
+	{
+		return false;
+	}
+
+	struct stat kStat = {};
+	void* pView = MAP_FAILED;
+	if ( fstat( file, &kStat ) == 0 && kStat.st_size > 0 )
+	{
+		pView = mmap( nullptr, static_cast< size_t >( kStat.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+	}
+	// The mapping keeps the file alive on its own.
+	close( file );
+	if ( pView == MAP_FAILED )
+	{
+		return false;
+	}
+
+	m_pData = static_cast< const uint8_t* >( pView );
+	m_size = static_cast< uint64_t >( kStat.st_size );
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if ( !m_pData )
+	{
+		return;
+	}
+
+#if defined( _WIN32 )
+	UnmapViewOfFile( m_pData );
+	CloseHandle( m_hMapping );
+	CloseHandle( m_hFile );
+	m_hMapping = nullptr;
+	m_hFile = nullptr;
+#else
+	munmap( const_cast< uint8_t* >( m_pData ), static_cast< size_t >( m_size ) );
+#endif
+	m_pData = nullptr;
+	m_size = 0;
+}
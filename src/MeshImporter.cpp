@@ -0,0 +1,794 @@
+#include "Mesh.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace
+{
+	std::vector< char > ReadFile( const std::filesystem::path& path )
+	{
+		std::ifstream file( path, std::ios::binary | std::ios::ate );
+		if ( !file )
+		{
+			throw std::runtime_error( "Failed to open " + path.string() );
+		}
+
+		std::vector< char > content( static_cast< size_t >( file.tellg() ) );
+		file.seekg( 0 );
+		file.read( content.data(), static_cast< std::streamsize >( content.size() ) );
+		if ( !file )
+		{
+			throw std::runtime_error( "Failed to read " + path.string() );
+		}
+		return content;
+	}
+
+	// ---- OBJ ----
+
+	inline bool IsSpace( char c )
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline const char* SkipSpaces( const char* p, const char* pEnd )
+	{
+		while ( p < pEnd && IsSpace( *p ) )
+		{
+			++p;
+		}
+		return p;
+	}
+
+	// strtof stops at the first character that is not part of the number, the buffer always ends in '\0'.
+	inline const char* ParseFloat( const char* p, const char* pEnd, float& value )
+	{
+		p = SkipSpaces( p, pEnd );
+		char* pNext = nullptr;
+		value = strtof( p, &pNext );
+		return pNext == p ? nullptr : pNext;
+	}
+
+	inline const char* ParseInt( const char* p, int64_t& value )
+	{
+		char* pNext = nullptr;
+		value = strtoll( p, &pNext, 10 );
+		return pNext == p ? nullptr : pNext;
+	}
+
+	// OBJ indices are 1-based, negative ones count back from the end.
+	inline uint32_t ResolveObjIndex( int64_t index, size_t count, size_t line )
+	{
+		const int64_t resolved = index < 0 ? static_cast< int64_t >( count ) + index : index - 1;
+		if ( resolved < 0 || resolved >= static_cast< int64_t >( count ) )
+		{
+			throw std::runtime_error( "OBJ index out of range on line " + std::to_string( line ) );
+		}
+		return static_cast< uint32_t >( resolved );
+	}
+
+	// ---- JSON, just enough for glTF ----
+
+	struct JsonValue
+	{
+		enum class Type { Null, Bool, Number, String, Array, Object };
+
+		Type type = Type::Null;
+		bool boolean = false;
+		double number = 0.0;
+		std::string string;
+		std::vector< JsonValue > array;
+		std::vector< std::pair< std::string, JsonValue > > object;
+
+		const JsonValue* Find( const char* key ) const
+		{
+			for ( const auto& kMember : object )
+			{
+				if ( kMember.first == key )
+				{
+					return &kMember.second;
+				}
+			}
+			return nullptr;
+		}
+
+		const JsonValue& operator[]( const char* key ) const
+		{
+			const JsonValue* pValue = Find( key );
+			if ( !pValue )
+			{
+				throw std::runtime_error( std::string( "glTF is missing \"" ) + key + "\"" );
+			}
+			return *pValue;
+		}
+
+		const JsonValue& operator[]( size_t index ) const
+		{
+			if ( type != Type::Array || index >= array.size() )
+			{
+				throw std::runtime_error( "glTF index out of range" );
+			}
+			return array[ index ];
+		}
+
+		// Counts, offsets and indices have to be whole numbers a double holds exactly, anything else would not
+		// convert to size_t.
+		size_t AsIndex() const
+		{
+			if ( type != Type::Number || !( number >= 0.0 && number <= 9007199254740992.0 ) || std::floor( number ) != number )
+			{
+				throw std::runtime_error( "glTF expected a non-negative integer" );
+			}
+			return static_cast< size_t >( number );
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		JsonParser( const char* pBegin, const char* pEnd ) : m_p( pBegin ), m_pEnd( pEnd ) {}
+
+		JsonValue Parse()
+		{
+			JsonValue kValue = ParseValue( 0 );
+			SkipWhitespace();
+			if ( m_p != m_pEnd )
+			{
+				Fail( "trailing characters" );
+			}
+			return kValue;
+		}
+
+	private:
+		[[noreturn]] void Fail( const char* message ) const
+		{
+			throw std::runtime_error( std::string( "glTF JSON: " ) + message );
+		}
+
+		void SkipWhitespace()
+		{
+			while ( m_p < m_pEnd && ( *m_p == ' ' || *m_p == '\t' || *m_p == '\r' || *m_p == '\n' ) )
+			{
+				++m_p;
+			}
+		}
+
+		bool Consume( char c )
+		{
+			SkipWhitespace();
+			if ( m_p < m_pEnd && *m_p == c )
+			{
+				++m_p;
+				return true;
+			}
+			return false;
+		}
+
+		void Expect( char c )
+		{
+			if ( !Consume( c ) )
+			{
+				Fail( "unexpected character" );
+			}
+		}
+
+		bool ConsumeWord( const char* word )
+		{
+			const size_t length = strlen( word );
+			if ( static_cast< size_t >( m_pEnd - m_p ) >= length && memcmp( m_p, word, length ) == 0 )
+			{
+				m_p += length;
+				return true;
+			}
+			return false;
+		}
+
+		JsonValue ParseValue( uint32_t depth )
+		{
+			if ( depth > 64 )
+			{
+				Fail( "nested too deep" );
+			}
+
+			SkipWhitespace();
+			if ( m_p >= m_pEnd )
+			{
+				Fail( "unexpected end" );
+			}
+
+			JsonValue kValue;
+			if ( Consume( '{' ) )
+			{
+				kValue.type = JsonValue::Type::Object;
+				if ( Consume( '}' ) )
+				{
+					return kValue;
+				}
+				do
+				{
+					SkipWhitespace();
+					std::string key = ParseString();
+					Expect( ':' );
+					kValue.object.emplace_back( std::move( key ), ParseValue( depth + 1 ) );
+				} while ( Consume( ',' ) );
+				Expect( '}' );
+			}
+			else if ( Consume( '[' ) )
+			{
+				kValue.type = JsonValue::Type::Array;
+				if ( Consume( ']' ) )
+				{
+					return kValue;
+				}
+				do
+				{
+					kValue.array.push_back( ParseValue( depth + 1 ) );
+				} while ( Consume( ',' ) );
+				Expect( ']' );
+			}
+			else if ( *m_p == '"' )
+			{
+				kValue.type = JsonValue::Type::String;
+				kValue.string = ParseString();
+			}
+			else if ( ConsumeWord( "true" ) || ConsumeWord( "false" ) )
+			{
+				kValue.type = JsonValue::Type::Bool;
+				kValue.boolean = m_p[ -1 ] == 'e' && m_p[ -2 ] == 'u';
+			}
+			else if ( ConsumeWord( "null" ) )
+			{
+				kValue.type = JsonValue::Type::Null;
+			}
+			else
+			{
+				// The document is copied into a '\0' terminated string, so strtod can not run off the end.
+				char* pNext = nullptr;
+				kValue.type = JsonValue::Type::Number;
+				kValue.number = strtod( m_p, &pNext );
+				if ( pNext == m_p )
+				{
+					Fail( "bad number" );
+				}
+				m_p = pNext;
+			}
+			return kValue;
+		}
+
+		std::string ParseString()
+		{
+			if ( m_p >= m_pEnd || *m_p != '"' )
+			{
+				Fail( "expected a string" );
+			}
+			++m_p;
+
+			std::string result;
+			while ( m_p < m_pEnd && *m_p != '"' )
+			{
+				char c = *m_p++;
+				if ( c == '\\' && m_p < m_pEnd )
+				{
+					c = *m_p++;
+					switch ( c )
+					{
+						case 'n': c = '\n'; break;
+						case 't': c = '\t'; break;
+						case 'r': c = '\r'; break;
+						case 'b': c = '\b'; break;
+						case 'f': c = '\f'; break;
+						case 'u':
+							// Keys and URIs we care about are ASCII, anything else becomes '?'.
+							m_p += std::min< ptrdiff_t >( 4, m_pEnd - m_p );
+							c = '?';
+							break;
+						default: break;
+					}
+				}
+				result.push_back( c );
+			}
+			if ( m_p >= m_pEnd )
+			{
+				Fail( "unterminated string" );
+			}
+			++m_p;
+			return result;
+		}
+
+		const char* m_p;
+		const char* m_pEnd;
+
+	};
+
+	std::vector< uint8_t > DecodeBase64( const char* p, const char* pEnd )
+	{
+		auto Value = []( char c ) -> int
+		{
+			if ( c >= 'A' && c <= 'Z' ) return c - 'A';
+			if ( c >= 'a' && c <= 'z' ) return c - 'a' + 26;
+			if ( c >= '0' && c <= '9' ) return c - '0' + 52;
+			if ( c == '+' || c == '-' ) return 62;
+			if ( c == '/' || c == '_' ) return 63;
+			return -1;
+		};
+
+		std::vector< uint8_t > result;
+		result.reserve( static_cast< size_t >( pEnd - p ) * 3 / 4 );
+		uint32_t bits = 0;
+		int bitCount = 0;
+		for ( ; p < pEnd; ++p )
+		{
+			const int value = Value( *p );
+			if ( value < 0 )
+			{
+				continue;
+			}
+			bits = ( bits << 6 ) | static_cast< uint32_t >( value );
+			bitCount += 6;
+			if ( bitCount >= 8 )
+			{
+				bitCount -= 8;
+				result.push_back( static_cast< uint8_t >( bits >> bitCount ) );
+			}
+		}
+		return result;
+	}
+
+	// glTF componentType values.
+	enum : uint32_t
+	{
+		GltfByte = 5120,
+		GltfUnsignedByte = 5121,
+		GltfShort = 5122,
+		GltfUnsignedShort = 5123,
+		GltfUnsignedInt = 5125,
+		GltfFloat = 5126,
+	};
+
+	struct GltfAccessor
+	{
+		const uint8_t* pData = nullptr;
+		size_t count = 0;
+		size_t stride = 0;
+		uint32_t componentType = 0;
+		uint32_t componentCount = 0;
+		bool normalized = false;
+
+		float ReadFloat( size_t element, uint32_t component ) const
+		{
+			const uint8_t* p = pData + element * stride;
+			switch ( componentType )
+			{
+				case GltfFloat: { float v; memcpy( &v, p + component * 4, 4 ); return v; }
+				case GltfUnsignedByte: { const float v = p[ component ]; return normalized ? v / 255.0f : v; }
+				case GltfByte: { const float v = static_cast< int8_t >( p[ component ] ); return normalized ? std::max( v / 127.0f, -1.0f ) : v; }
+				case GltfUnsignedShort: { uint16_t v; memcpy( &v, p + component * 2, 2 ); return normalized ? v / 65535.0f : v; }
+				case GltfShort: { int16_t v; memcpy( &v, p + component * 2, 2 ); return normalized ? std::max( v / 32767.0f, -1.0f ) : v; }
+				default: return 0.0f;
+			}
+		}
+
+		uint32_t ReadIndex( size_t element ) const
+		{
+			const uint8_t* p = pData + element * stride;
+			switch ( componentType )
+			{
+				case GltfUnsignedByte: return p[ 0 ];
+				case GltfUnsignedShort: { uint16_t v; memcpy( &v, p, 2 ); return v; }
+				case GltfUnsignedInt: { uint32_t v; memcpy( &v, p, 4 ); return v; }
+				default: throw std::runtime_error( "glTF index accessor has an invalid component type" );
+			}
+		}
+	};
+
+	uint32_t ComponentSize( uint32_t componentType )
+	{
+		switch ( componentType )
+		{
+			case GltfByte: case GltfUnsignedByte: return 1;
+			case GltfShort: case GltfUnsignedShort: return 2;
+			case GltfUnsignedInt: case GltfFloat: return 4;
+			default: throw std::runtime_error( "glTF accessor has an unknown component type" );
+		}
+	}
+
+	uint32_t ComponentCount( const std::string& type )
+	{
+		if ( type == "SCALAR" ) return 1;
+		if ( type == "VEC2" ) return 2;
+		if ( type == "VEC3" ) return 3;
+		if ( type == "VEC4" ) return 4;
+		throw std::runtime_error( "glTF accessor type " + type + " is not supported" );
+	}
+
+	// Vertex attributes are read as floats, which glTF allows as FLOAT or as normalized integers.
+	void CheckFloatAttribute( const GltfAccessor& kAccessor, uint32_t minComponentCount, const char* pName )
+	{
+		const bool bNormalizedInteger = kAccessor.normalized && kAccessor.componentType != GltfUnsignedInt && kAccessor.componentType != GltfFloat;
+		if ( kAccessor.componentType != GltfFloat && !bNormalizedInteger )
+		{
+			throw std::runtime_error( std::string( "glTF " ) + pName + " has to be FLOAT or a normalized integer" );
+		}
+		if ( kAccessor.componentCount < minComponentCount )
+		{
+			throw std::runtime_error( std::string( "glTF " ) + pName + " needs at least " + std::to_string( minComponentCount ) + " components" );
+		}
+	}
+
+	GltfAccessor ResolveAccessor( const JsonValue& kDocument, const std::vector< std::vector< uint8_t > >& buffers, size_t index )
+	{
+		const JsonValue& kAccessor = kDocument[ "accessors" ][ index ];
+		GltfAccessor kResult;
+		kResult.count = kAccessor[ "count" ].AsIndex();
+		kResult.componentType = static_cast< uint32_t >( std::min< size_t >( kAccessor[ "componentType" ].AsIndex(), UINT32_MAX ) );
+		kResult.componentCount = ComponentCount( kAccessor[ "type" ].string );
+		const JsonValue* pNormalized = kAccessor.Find( "normalized" );
+		kResult.normalized = pNormalized && pNormalized->boolean;
+
+		const size_t elementSize = static_cast< size_t >( ComponentSize( kResult.componentType ) ) * kResult.componentCount;
+		const JsonValue* pViewIndex = kAccessor.Find( "bufferView" );
+		if ( !pViewIndex )
+		{
+			throw std::runtime_error( "glTF sparse / empty accessors are not supported" );
+		}
+
+		const JsonValue& kView = kDocument[ "bufferViews" ][ pViewIndex->AsIndex() ];
+		const size_t bufferIndex = kView[ "buffer" ].AsIndex();
+		if ( bufferIndex >= buffers.size() )
+		{
+			throw std::runtime_error( "glTF buffer index out of range" );
+		}
+		const JsonValue* pViewOffset = kView.Find( "byteOffset" );
+		const JsonValue* pAccessorOffset = kAccessor.Find( "byteOffset" );
+		const JsonValue* pStride = kView.Find( "byteStride" );
+		const size_t viewOffset = pViewOffset ? pViewOffset->AsIndex() : 0;
+		const size_t accessorOffset = pAccessorOffset ? pAccessorOffset->AsIndex() : 0;
+		kResult.stride = pStride ? pStride->AsIndex() : elementSize;
+		if ( kResult.stride < elementSize )
+		{
+			throw std::runtime_error( "glTF byteStride is smaller than its accessor's elements" );
+		}
+
+		// Written so nothing can wrap around: offset + ( count - 1 ) * stride + elementSize <= size.
+		const std::vector< uint8_t >& kBuffer = buffers[ bufferIndex ];
+		const size_t size = kBuffer.size();
+		if ( viewOffset > size || accessorOffset > size - viewOffset || elementSize > size - viewOffset - accessorOffset ||
+			 ( kResult.count > 0 && kResult.count - 1 > ( size - viewOffset - accessorOffset - elementSize ) / kResult.stride ) )
+		{
+			throw std::runtime_error( "glTF accessor runs past the end of its buffer" );
+		}
+		const size_t offset = viewOffset + accessorOffset;
+		kResult.pData = kBuffer.data() + offset;
+		return kResult;
+	}
+}
+
+MeshData MeshImporter::Load( const std::filesystem::path& path )
+{
+	std::string extension = path.extension().string();
+	for ( char& c : extension )
+	{
+		c = static_cast< char >( tolower( static_cast< unsigned char >( c ) ) );
+	}
+
+	if ( extension == ".obj" )
+	{
+		return LoadObj( path );
+	}
+	if ( extension == ".gltf" || extension == ".glb" )
+	{
+		return LoadGltf( path );
+	}
+	throw std::runtime_error( "Unsupported mesh format " + path.string() );
+}
+
+MeshData MeshImporter::LoadObj( const std::filesystem::path& path )
+{
+	std::vector< char > content = ReadFile( path );
+	content.push_back( '\0' );
+
+	struct Position
+	{
+		float xyz[ 3 ];
+		float rgb[ 3 ];
+	};
+	std::vector< Position > positions;
+	std::vector< std::pair< float, float > > uvs;
+
+	MeshData kMesh;
+	std::vector< MeshVertex > face;
+
+	const char* p = content.data();
+	const char* pEnd = content.data() + content.size() - 1;
+	size_t line = 0;
+	while ( p < pEnd )
+	{
+		++line;
+		const char* pLineEnd = static_cast< const char* >( memchr( p, '\n', static_cast< size_t >( pEnd - p ) ) );
+		if ( !pLineEnd )
+		{
+			pLineEnd = pEnd;
+		}
+
+		p = SkipSpaces( p, pLineEnd );
+		if ( pLineEnd - p >= 2 && p[ 0 ] == 'v' && IsSpace( p[ 1 ] ) )
+		{
+			Position kPosition = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+			const char* q = p + 1;
+			for ( uint32_t n = 0; n < 3 && q; ++n )
+			{
+				q = ParseFloat( q, pLineEnd, kPosition.xyz[ n ] );
+			}
+			if ( !q )
+			{
+				throw std::runtime_error( "Bad OBJ vertex on line " + std::to_string( line ) );
+			}
+
+			// Optional colour after the position.
+			float rgb[ 3 ];
+			const char* pColor = q;
+			for ( uint32_t n = 0; n < 3 && pColor && SkipSpaces( pColor, pLineEnd ) < pLineEnd; ++n )
+			{
+				pColor = ParseFloat( pColor, pLineEnd, rgb[ n ] );
+				if ( pColor && n == 2 )
+				{
+					memcpy( kPosition.rgb, rgb, sizeof( rgb ) );
+				}
+			}
+			positions.push_back( kPosition );
+		}
+		else if ( pLineEnd - p >= 3 && p[ 0 ] == 'v' && p[ 1 ] == 't' && IsSpace( p[ 2 ] ) )
+		{
+			float u = 0.0f, v = 0.0f;
+			const char* q = ParseFloat( p + 2, pLineEnd, u );
+			if ( q )
+			{
+				q = ParseFloat( q, pLineEnd, v );
+			}
+			if ( !q )
+			{
+				throw std::runtime_error( "Bad OBJ texture coordinate on line " + std::to_string( line ) );
+			}
+			// OBJ puts the origin at the bottom left.
+			uvs.emplace_back( u, 1.0f - v );
+		}
+		else if ( pLineEnd - p >= 2 && p[ 0 ] == 'f' && IsSpace( p[ 1 ] ) )
+		{
+			face.clear();
+			const char* q = SkipSpaces( p + 1, pLineEnd );
+			while ( q < pLineEnd )
+			{
+				int64_t positionIndex = 0;
+				q = ParseInt( q, positionIndex );
+				if ( !q )
+				{
+					throw std::runtime_error( "Bad OBJ face on line " + std::to_string( line ) );
+				}
+
+				MeshVertex kVertex = {};
+				const Position& kPosition = positions[ ResolveObjIndex( positionIndex, positions.size(), line ) ];
+				memcpy( kVertex.position, kPosition.xyz, sizeof( kVertex.position ) );
+				memcpy( kVertex.color, kPosition.rgb, sizeof( kPosition.rgb ) );
+				kVertex.color[ 3 ] = 1.0f;
+
+				// v/vt, v/vt/vn or v//vn, normals are not part of the vertex.
+				if ( q < pLineEnd && *q == '/' )
+				{
+					++q;
+					if ( q < pLineEnd && *q != '/' )
+					{
+						int64_t uvIndex = 0;
+						q = ParseInt( q, uvIndex );
+						if ( !q )
+						{
+							throw std::runtime_error( "Bad OBJ face on line " + std::to_string( line ) );
+						}
+						const auto& kUv = uvs[ ResolveObjIndex( uvIndex, uvs.size(), line ) ];
+						kVertex.uv[ 0 ] = kUv.first;
+						kVertex.uv[ 1 ] = kUv.second;
+					}
+					if ( q < pLineEnd && *q == '/' )
+					{
+						++q;
+						int64_t normalIndex = 0;
+						q = ParseInt( q, normalIndex );
+						if ( !q )
+						{
+							throw std::runtime_error( "Bad OBJ face on line " + std::to_string( line ) );
+						}
+					}
+				}
+
+				face.push_back( kVertex );
+				q = SkipSpaces( q, pLineEnd );
+			}
+
+			if ( face.size() < 3 )
+			{
+				throw std::runtime_error( "OBJ face with fewer than 3 corners on line " + std::to_string( line ) );
+			}
+
+			// Fan, one vertex per corner.
+			const uint32_t base = static_cast< uint32_t >( kMesh.vertices.size() );
+			kMesh.vertices.insert( kMesh.vertices.end(), face.begin(), face.end() );
+			for ( uint32_t n = 1; n + 1 < face.size(); ++n )
+			{
+				kMesh.indices.push_back( base );
+				kMesh.indices.push_back( base + n );
+				kMesh.indices.push_back( base + n + 1 );
+			}
+		}
+
+		p = pLineEnd + 1;
+	}
+
+	return kMesh;
+}
+
+MeshData MeshImporter::LoadGltf( const std::filesystem::path& path )
+{
+	std::vector< char > content = ReadFile( path );
+
+	// .glb: 12 byte header, then a JSON chunk and an optional BIN chunk.
+	std::string json;
+	std::vector< uint8_t > binaryChunk;
+	if ( content.size() >= 12 && memcmp( content.data(), "glTF", 4 ) == 0 )
+	{
+		size_t offset = 12;
+		while ( offset + 8 <= content.size() )
+		{
+			uint32_t chunkLength = 0, chunkType = 0;
+			memcpy( &chunkLength, content.data() + offset, 4 );
+			memcpy( &chunkType, content.data() + offset + 4, 4 );
+			offset += 8;
+			if ( chunkLength > content.size() - offset )
+			{
+				throw std::runtime_error( "GLB chunk runs past the end of " + path.string() );
+			}
+
+			const char* pChunk = content.data() + offset;
+			if ( chunkType == 0x4E4F534A ) // "JSON"
+			{
+				json.assign( pChunk, chunkLength );
+			}
+			else if ( chunkType == 0x004E4942 ) // "BIN\0"
+			{
+				binaryChunk.assign( pChunk, pChunk + chunkLength );
+			}
+			offset += ( chunkLength + 3 ) & ~3u;
+		}
+	}
+	else
+	{
+		json.assign( content.data(), content.size() );
+	}
+
+	const JsonValue kDocument = JsonParser( json.c_str(), json.c_str() + json.size() ).Parse();
+
+	std::vector< std::vector< uint8_t > > buffers;
+	if ( const JsonValue* pBuffers = kDocument.Find( "buffers" ) )
+	{
+		for ( const JsonValue& kBuffer : pBuffers->array )
+		{
+			const JsonValue* pUri = kBuffer.Find( "uri" );
+			if ( !pUri )
+			{
+				buffers.push_back( binaryChunk );
+				continue;
+			}
+
+			const std::string& uri = pUri->string;
+			if ( uri.compare( 0, 5, "data:" ) == 0 )
+			{
+				const size_t comma = uri.find( ',' );
+				if ( comma == std::string::npos || uri.rfind( ";base64", comma ) == std::string::npos )
+				{
+					throw std::runtime_error( "glTF data URIs have to be base64" );
+				}
+				buffers.push_back( DecodeBase64( uri.c_str() + comma + 1, uri.c_str() + uri.size() ) );
+			}
+			else
+			{
+				const std::vector< char > file = ReadFile( path.parent_path() / std::filesystem::u8path( uri ) );
+				buffers.emplace_back( file.begin(), file.end() );
+			}
+		}
+	}
+
+	MeshData kMesh;
+	const JsonValue* pMeshes = kDocument.Find( "meshes" );
+	if ( !pMeshes )
+	{
+		return kMesh;
+	}
+
+	for ( const JsonValue& kGltfMesh : pMeshes->array )
+	{
+		for ( const JsonValue& kPrimitive : kGltfMesh[ "primitives" ].array )
+		{
+			const JsonValue* pMode = kPrimitive.Find( "mode" );
+			if ( pMode && pMode->number != 4.0 )
+			{
+				// Points, lines and strips are skipped.
+				continue;
+			}
+
+			const JsonValue& kAttributes = kPrimitive[ "attributes" ];
+			const GltfAccessor kPositions = ResolveAccessor( kDocument, buffers, kAttributes[ "POSITION" ].AsIndex() );
+			const JsonValue* pColorIndex = kAttributes.Find( "COLOR_0" );
+			const JsonValue* pUvIndex = kAttributes.Find( "TEXCOORD_0" );
+			const GltfAccessor kColors = pColorIndex ? ResolveAccessor( kDocument, buffers, pColorIndex->AsIndex() ) : GltfAccessor();
+			const GltfAccessor kUvs = pUvIndex ? ResolveAccessor( kDocument, buffers, pUvIndex->AsIndex() ) : GltfAccessor();
+			CheckFloatAttribute( kPositions, 3, "POSITION" );
+			if ( pColorIndex )
+			{
+				CheckFloatAttribute( kColors, 3, "COLOR_0" );
+			}
+			if ( pUvIndex )
+			{
+				CheckFloatAttribute( kUvs, 2, "TEXCOORD_0" );
+			}
+
+			const uint32_t base = static_cast< uint32_t >( kMesh.vertices.size() );
+			for ( size_t n = 0; n < kPositions.count; ++n )
+			{
+				MeshVertex kVertex = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } };
+				for ( uint32_t c = 0; c < 3; ++c )
+				{
+					kVertex.position[ c ] = kPositions.ReadFloat( n, c );
+				}
+				if ( pColorIndex && n < kColors.count )
+				{
+					for ( uint32_t c = 0; c < kColors.componentCount && c < 4; ++c )
+					{
+						kVertex.color[ c ] = kColors.ReadFloat( n, c );
+					}
+				}
+				if ( pUvIndex && n < kUvs.count )
+				{
+					kVertex.uv[ 0 ] = kUvs.ReadFloat( n, 0 );
+					kVertex.uv[ 1 ] = kUvs.ReadFloat( n, 1 );
+				}
+				kMesh.vertices.push_back( kVertex );
+			}
+
+			if ( const JsonValue* pIndices = kPrimitive.Find( "indices" ) )
+			{
+				const GltfAccessor kIndices = ResolveAccessor( kDocument, buffers, pIndices->AsIndex() );
+				if ( kIndices.componentCount != 1 )
+				{
+					throw std::runtime_error( "glTF indices have to be SCALAR" );
+				}
+				for ( size_t n = 0; n + 2 < kIndices.count; n += 3 )
+				{
+					for ( size_t corner = 0; corner < 3; ++corner )
+					{
+						const uint32_t index = kIndices.ReadIndex( n + corner );
+						if ( index >= kPositions.count )
+						{
+							throw std::runtime_error( "glTF index out of range in " + path.string() );
+						}
+						kMesh.indices.push_back( base + index );
+					}
+				}
+			}
+			else
+			{
+				for ( uint32_t n = 0; n + 2 < kPositions.count; n += 3 )
+				{
+					kMesh.indices.push_back( base + n );
+					kMesh.indices.push_back( base + n + 1 );
+					kMesh.indices.push_back( base + n + 2 );
+				}
+			}
+		}
+	}
+
+	return kMesh;
+}
@@ -0,0 +1,307 @@
+#include "Mesh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	// FNV-1a over the raw bytes, welding is bitwise so this is all the hash needs to see.
+	inline uint32_t HashVertex( const MeshVertex& kVertex )
+	{
+		const uint8_t* p = reinterpret_cast< const uint8_t* >( &kVertex );
+		uint32_t hash = 2166136261u;
+		for ( size_t n = 0; n < sizeof( MeshVertex ); ++n )
+		{
+			hash = ( hash ^ p[ n ] ) * 16777619u;
+		}
+		return hash;
+	}
+
+	// Forsyth, "Linear-Speed Vertex Cache Optimisation".
+	constexpr uint32_t kCacheSize = 32;
+	constexpr float kCacheDecayPower = 1.5f;
+	constexpr float kLastTriangleScore = 0.75f;
+	constexpr float kValenceBoostScale = 2.0f;
+	constexpr float kValenceBoostPower = 0.5f;
+	constexpr uint32_t kMaxValence = 64;
+
+	struct ScoreTable
+	{
+		float cache[ kCacheSize ];
+		float valence[ kMaxValence + 1 ];
+
+		ScoreTable()
+		{
+			for ( uint32_t n = 0; n < kCacheSize; ++n )
+			{
+				// The three vertices of the last triangle get a fixed score so it is not simply repeated.
+				cache[ n ] = n < 3 ? kLastTriangleScore
+								   : powf( 1.0f - static_cast< float >( n - 3 ) / ( kCacheSize - 3 ), kCacheDecayPower );
+			}
+			valence[ 0 ] = 0.0f;
+			for ( uint32_t n = 1; n <= kMaxValence; ++n )
+			{
+				valence[ n ] = kValenceBoostScale * powf( static_cast< float >( n ), -kValenceBoostPower );
+			}
+		}
+
+		float Score( int32_t cachePosition, uint32_t remaining ) const
+		{
+			if ( remaining == 0 )
+			{
+				return -1.0f;
+			}
+			const float score = cachePosition >= 0 ? cache[ cachePosition ] : 0.0f;
+			return score + valence[ std::min( remaining, kMaxValence ) ];
+		}
+	};
+}
+
+void MeshOptimizer::WeldVertices( MeshData& kMesh )
+{
+	const size_t vertexCount = kMesh.vertices.size();
+	if ( vertexCount == 0 )
+	{
+		return;
+	}
+
+	// Open addressing, power of two and at most half full.
+	size_t tableSize = 1;
+	while ( tableSize < vertexCount * 2 )
+	{
+		tableSize <<= 1;
+	}
+	const uint32_t uEmpty = ~0u;
+	std::vector< uint32_t > table( tableSize, uEmpty );
+
+	std::vector< uint32_t > remap( vertexCount );
+	std::vector< MeshVertex > welded;
+	welded.reserve( vertexCount );
+	for ( size_t n = 0; n < vertexCount; ++n )
+	{
+		const MeshVertex& kVertex = kMesh.vertices[ n ];
+		size_t slot = HashVertex( kVertex ) & ( tableSize - 1 );
+		while ( table[ slot ] != uEmpty && memcmp( &welded[ table[ slot ] ], &kVertex, sizeof( MeshVertex ) ) != 0 )
+		{
+			slot = ( slot + 1 ) & ( tableSize - 1 );
+		}
+
+		if ( table[ slot ] == uEmpty )
+		{
+			table[ slot ] = static_cast< uint32_t >( welded.size() );
+			welded.push_back( kVertex );
+		}
+		remap[ n ] = table[ slot ];
+	}
+
+	for ( uint32_t& index : kMesh.indices )
+	{
+		if ( index >= vertexCount )
+		{
+			throw std::runtime_error( "Mesh index out of range" );
+		}
+		index = remap[ index ];
+	}
+	kMesh.vertices.swap( welded );
+}
+
+void MeshOptimizer::OptimizeVertexCache( std::vector< uint32_t >& indices, size_t vertexCount )
+{
+	const size_t triangleCount = indices.size() / 3;
+	if ( triangleCount == 0 )
+	{
+		return;
+	}
+
+	static const ScoreTable s_kScores;
+
+	// Vertex -> triangle adjacency, flattened.
+	std::vector< uint32_t > remaining( vertexCount, 0 );
+	for ( size_t n = 0; n < triangleCount * 3; ++n )
+	{
+		if ( indices[ n ] >= vertexCount )
+		{
+			throw std::runtime_error( "Mesh index out of range" );
+		}
+		++remaining[ indices[ n ] ];
+	}
+
+	std::vector< uint32_t > offsets( vertexCount + 1, 0 );
+	for ( size_t n = 0; n < vertexCount; ++n )
+	{
+		offsets[ n + 1 ] = offsets[ n ] + remaining[ n ];
+	}
+	std::vector< uint32_t > adjacency( triangleCount * 3 );
+	{
+		std::vector< uint32_t > fill( offsets.begin(), offsets.end() - 1 );
+		for ( size_t n = 0; n < triangleCount * 3; ++n )
+		{
+			adjacency[ fill[ indices[ n ] ]++ ] = static_cast< uint32_t >( n / 3 );
+		}
+	}
+
+	std::vector< int32_t > cachePosition( vertexCount, -1 );
+	std::vector< float > vertexScore( vertexCount );
+	for ( size_t n = 0; n < vertexCount; ++n )
+	{
+		vertexScore[ n ] = s_kScores.Score( -1, remaining[ n ] );
+	}
+
+	std::vector< float > triangleScore( triangleCount );
+	std::vector< bool > emitted( triangleCount, false );
+	for ( size_t t = 0; t < triangleCount; ++t )
+	{
+		triangleScore[ t ] = vertexScore[ indices[ t * 3 ] ] + vertexScore[ indices[ t * 3 + 1 ] ] + vertexScore[ indices[ t * 3 + 2 ] ];
+	}
+
+	std::vector< uint32_t > result;
+	result.reserve( triangleCount * 3 );
+
+	// The cache holds kCacheSize entries plus room for the 3 vertices pushed in front of it.
+	uint32_t cache[ kCacheSize + 3 ];
+	uint32_t cacheCount = 0;
+
+	size_t bestTriangle = 0;
+	for ( size_t t = 1; t < triangleCount; ++t )
+	{
+		if ( triangleScore[ t ] > triangleScore[ bestTriangle ] )
+		{
+			bestTriangle = t;
+		}
+	}
+
+	// Only used when the cache runs dry (disconnected pieces), then the scan resumes where it left off.
+	size_t scanCursor = 0;
+	for ( size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount )
+	{
+		const uint32_t* pTriangle = &indices[ bestTriangle * 3 ];
+		result.insert( result.end(), pTriangle, pTriangle + 3 );
+		emitted[ bestTriangle ] = true;
+
+		// Take the triangle out of its vertices' adjacency lists.
+		for ( uint32_t corner = 0; corner < 3; ++corner )
+		{
+			const uint32_t vertex = pTriangle[ corner ];
+			uint32_t* pBegin = &adjacency[ offsets[ vertex ] ];
+			uint32_t* pEnd = pBegin + remaining[ vertex ];
+			*std::find( pBegin, pEnd, static_cast< uint32_t >( bestTriangle ) ) = pEnd[ -1 ];
+			--remaining[ vertex ];
+		}
+
+		// LRU update, the new triangle's vertices go to the front.
+		uint32_t newCache[ kCacheSize + 3 ];
+		uint32_t newCount = 0;
+		for ( uint32_t corner = 0; corner < 3; ++corner )
+		{
+			newCache[ newCount++ ] = pTriangle[ corner ];
+		}
+		for ( uint32_t n = 0; n < cacheCount; ++n )
+		{
+			const uint32_t vertex = cache[ n ];
+			if ( vertex != pTriangle[ 0 ] && vertex != pTriangle[ 1 ] && vertex != pTriangle[ 2 ] )
+			{
+				newCache[ newCount++ ] = vertex;
+			}
+		}
+
+		// Rescore everything that was or is in the cache, and the triangles touching it.
+		for ( uint32_t n = 0; n < newCount; ++n )
+		{
+			const uint32_t vertex = newCache[ n ];
+			cachePosition[ vertex ] = n < kCacheSize ? static_cast< int32_t >( n ) : -1;
+			vertexScore[ vertex ] = s_kScores.Score( cachePosition[ vertex ], remaining[ vertex ] );
+		}
+
+		float bestScore = -1.0f;
+		bestTriangle = triangleCount;
+		for ( uint32_t n = 0; n < newCount; ++n )
+		{
+			const uint32_t vertex = newCache[ n ];
+			for ( uint32_t a = 0; a < remaining[ vertex ]; ++a )
+			{
+				const uint32_t t = adjacency[ offsets[ vertex ] + a ];
+				const float score = vertexScore[ indices[ t * 3 ] ] + vertexScore[ indices[ t * 3 + 1 ] ] + vertexScore[ indices[ t * 3 + 2 ] ];
+				if ( score > bestScore )
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheCount = std::min( newCount, kCacheSize );
+		std::copy( newCache, newCache + cacheCount, cache );
+
+		if ( bestTriangle == triangleCount )
+		{
+			while ( scanCursor < triangleCount && emitted[ scanCursor ] )
+			{
+				++scanCursor;
+			}
+			bestTriangle = scanCursor;
+		}
+	}
+
+	indices.swap( result );
+}
+
+void MeshOptimizer::OptimizeVertexFetch( MeshData& kMesh )
+{
+	const uint32_t uUnused = ~0u;
+	std::vector< uint32_t > remap( kMesh.vertices.size(), uUnused );
+	std::vector< MeshVertex > reordered;
+	reordered.reserve( kMesh.vertices.size() );
+
+	for ( uint32_t& index : kMesh.indices )
+	{
+		if ( index >= kMesh.vertices.size() )
+		{
+			throw std::runtime_error( "Mesh index out of range" );
+		}
+		if ( remap[ index ] == uUnused )
+		{
+			remap[ index ] = static_cast< uint32_t >( reordered.size() );
+			reordered.push_back( kMesh.vertices[ index ] );
+		}
+		index = remap[ index ];
+	}
+	kMesh.vertices.swap( reordered );
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache( const std::vector< uint32_t >& indices, size_t vertexCount, uint32_t cacheSize )
+{
+	VertexCacheStats kStats;
+	if ( indices.size() < 3 || vertexCount == 0 || cacheSize == 0 )
+	{
+		return kStats;
+	}
+
+	// A vertex is a hit while fewer than cacheSize misses happened since it was last loaded.
+	std::vector< uint32_t > loadedAt( vertexCount, 0 );
+	uint32_t misses = 0;
+	for ( uint32_t index : indices )
+	{
+		if ( index >= vertexCount )
+		{
+			throw std::runtime_error( "Mesh index out of range" );
+		}
+		if ( loadedAt[ index ] == 0 || misses - loadedAt[ index ] >= cacheSize )
+		{
+			++misses;
+			loadedAt[ index ] = misses;
+		}
+	}
+
+	kStats.transformedVertices = misses;
+	kStats.acmr = static_cast< float >( misses ) / static_cast< float >( indices.size() / 3 );
+	kStats.atvr = static_cast< float >( misses ) / static_cast< float >( vertexCount );
+	return kStats;
+}
+
+void MeshOptimizer::Optimize( MeshData& kMesh )
+{
+	WeldVertices( kMesh );
+	OptimizeVertexCache( kMesh.indices, kMesh.vertices.size() );
+	OptimizeVertexFetch( kMesh );
+}
@@ -0,0 +1,425 @@
+#include "MeshletBuilder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "ThreadPool.hpp"
+
+namespace
+{
+	inline void Subtract( const float a[ 3 ], const float b[ 3 ], float result[ 3 ] )
+	{
+		result[ 0 ] = a[ 0 ] - b[ 0 ];
+		result[ 1 ] = a[ 1 ] - b[ 1 ];
+		result[ 2 ] = a[ 2 ] - b[ 2 ];
+	}
+
+	inline float Dot( const float a[ 3 ], const float b[ 3 ] )
+	{
+		return a[ 0 ] * b[ 0 ] + a[ 1 ] * b[ 1 ] + a[ 2 ] * b[ 2 ];
+	}
+
+	inline float DistanceSquared( const float a[ 3 ], const float b[ 3 ] )
+	{
+		float d[ 3 ];
+		Subtract( a, b, d );
+		return Dot( d, d );
+	}
+
+	// Ritter's sphere: start from the two points furthest apart along a rough diameter, then grow to cover the rest.
+	void ComputeSphere( const MeshData& kMesh, const uint32_t* pVertices, uint32_t count, float center[ 3 ], float& radius )
+	{
+		const float* pFirst = kMesh.vertices[ pVertices[ 0 ] ].position;
+		const float* pA = pFirst;
+		for ( uint32_t n = 0; n < count; ++n )
+		{
+			const float* p = kMesh.vertices[ pVertices[ n ] ].position;
+			if ( DistanceSquared( p, pFirst ) > DistanceSquared( pA, pFirst ) )
+			{
+				pA = p;
+			}
+		}
+		const float* pB = pA;
+		for ( uint32_t n = 0; n < count; ++n )
+		{
+			const float* p = kMesh.vertices[ pVertices[ n ] ].position;
+			if ( DistanceSquared( p, pA ) > DistanceSquared( pB, pA ) )
+			{
+				pB = p;
+			}
+		}
+
+		for ( uint32_t c = 0; c < 3; ++c )
+		{
+			center[ c ] = ( pA[ c ] + pB[ c ] ) * 0.5f;
+		}
+		radius = sqrtf( DistanceSquared( pA, pB ) ) * 0.5f;
+
+		for ( uint32_t n = 0; n < count; ++n )
+		{
+			const float* p = kMesh.vertices[ pVertices[ n ] ].position;
+			const float distance = sqrtf( DistanceSquared( p, center ) );
+			if ( distance > radius )
+			{
+				const float grown = ( radius + distance ) * 0.5f;
+				const float t = ( grown - radius ) / distance;
+				for ( uint32_t c = 0; c < 3; ++c )
+				{
+					center[ c ] += ( p[ c ] - center[ c ] ) * t;
+				}
+				radius = grown;
+			}
+		}
+	}
+}
+
+MeshletData MeshletBuilder::Build( const MeshData& kMesh, const MeshletBuildOptions& kOptions )
+{
+	if ( kOptions.maxVertices < 3 || kOptions.maxVertices > 256 || kOptions.maxTriangles < 1 )
+	{
+		throw std::runtime_error( "Meshlets need between 3 and 256 vertices and at least one triangle" );
+	}
+
+	const size_t vertexCount = kMesh.vertices.size();
+	const size_t triangleCount = kMesh.indices.size() / 3;
+	const std::vector< uint32_t >& indices = kMesh.indices;
+
+	// Vertex -> live triangles, same flattened layout as MeshOptimizer::OptimizeVertexCache.
+	std::vector< uint32_t > live( vertexCount, 0 );
+	for ( size_t n = 0; n < triangleCount * 3; ++n )
+	{
+		if ( indices[ n ] >= vertexCount )
+		{
+			throw std::runtime_error( "Mesh index out of range" );
+		}
+		++live[ indices[ n ] ];
+	}
+	std::vector< uint32_t > offsets( vertexCount + 1, 0 );
+	for ( size_t n = 0; n < vertexCount; ++n )
+	{
+		offsets[ n + 1 ] = offsets[ n ] + live[ n ];
+	}
+	std::vector< uint32_t > adjacency( triangleCount * 3 );
+	{
+		std::vector< uint32_t > fill( offsets.begin(), offsets.end() - 1 );
+		for ( size_t n = 0; n < triangleCount * 3; ++n )
+		{
+			adjacency[ fill[ indices[ n ] ]++ ] = static_cast< uint32_t >( n / 3 );
+		}
+	}
+
+	MeshletData kResult;
+	kResult.vertices.reserve( triangleCount );
+	kResult.triangles.reserve( triangleCount * 3 );
+
+	const uint16_t uNotInMeshlet = 0xFFFF;
+	std::vector< uint16_t > local( vertexCount, uNotInMeshlet );
+	std::vector< bool > emitted( triangleCount, false );
+	Meshlet kCurrent = {};
+	std::vector< uint32_t > frontier;	// vertices of the current meshlet that still have live triangles.
+
+	auto Flush = [ & ]()
+	{
+		for ( uint32_t n = 0; n < kCurrent.vertexCount; ++n )
+		{
+			local[ kResult.vertices[ kCurrent.vertexOffset + n ] ] = uNotInMeshlet;
+		}
+		kResult.meshlets.push_back( kCurrent );
+		kCurrent.vertexOffset = static_cast< uint32_t >( kResult.vertices.size() );
+		kCurrent.triangleOffset = static_cast< uint32_t >( kResult.triangles.size() );
+		kCurrent.vertexCount = 0;
+		kCurrent.triangleCount = 0;
+		frontier.clear();
+	};
+
+	// Neighbours of the current meshlet, fewest new vertices first, then the triangle whose corners have the fewest
+	// triangles left (finishes off borders instead of leaving slivers), then the lowest index to stay deterministic.
+	auto FindNeighbour = [ & ]( size_t& bestTriangle, uint32_t& bestNewVertices )
+	{
+		uint32_t bestLive = ~0u;
+		bestNewVertices = 4;
+		bestTriangle = triangleCount;
+		size_t kept = 0;
+		for ( size_t n = 0; n < frontier.size(); ++n )
+		{
+			const uint32_t vertex = frontier[ n ];
+			if ( live[ vertex ] == 0 )
+			{
+				continue;
+			}
+			frontier[ kept++ ] = vertex;
+
+			for ( uint32_t a = 0; a < live[ vertex ]; ++a )
+			{
+				const uint32_t t = adjacency[ offsets[ vertex ] + a ];
+				const uint32_t* pTriangle = &indices[ static_cast< size_t >( t ) * 3 ];
+				const uint32_t newVertices = ( local[ pTriangle[ 0 ] ] == uNotInMeshlet ) + ( local[ pTriangle[ 1 ] ] == uNotInMeshlet ) + ( local[ pTriangle[ 2 ] ] == uNotInMeshlet );
+				const uint32_t liveSum = live[ pTriangle[ 0 ] ] + live[ pTriangle[ 1 ] ] + live[ pTriangle[ 2 ] ];
+				if ( newVertices < bestNewVertices || ( newVertices == bestNewVertices && ( liveSum < bestLive || ( liveSum == bestLive && t < bestTriangle ) ) ) )
+				{
+					bestTriangle = t;
+					bestNewVertices = newVertices;
+					bestLive = liveSum;
+				}
+			}
+		}
+		frontier.resize( kept );
+	};
+
+	size_t scanCursor = 0;
+	for ( size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount )
+	{
+		size_t triangle = triangleCount;
+		uint32_t newVertices = 0;
+		FindNeighbour( triangle, newVertices );
+
+		if ( triangle == triangleCount )
+		{
+			// Nothing connected is left, continue with the next triangle in index order. After
+			// OptimizeVertexCache that is close by anyway.
+			while ( emitted[ scanCursor ] )
+			{
+				++scanCursor;
+			}
+			triangle = scanCursor;
+			const uint32_t* pTriangle = &indices[ triangle * 3 ];
+			newVertices = ( local[ pTriangle[ 0 ] ] == uNotInMeshlet ) + ( local[ pTriangle[ 1 ] ] == uNotInMeshlet ) + ( local[ pTriangle[ 2 ] ] == uNotInMeshlet );
+		}
+
+		if ( kCurrent.vertexCount + newVertices > kOptions.maxVertices || kCurrent.triangleCount + 1 > kOptions.maxTriangles )
+		{
+			Flush();
+		}
+
+		const uint32_t* pTriangle = &indices[ triangle * 3 ];
+		for ( uint32_t corner = 0; corner < 3; ++corner )
+		{
+			const uint32_t vertex = pTriangle[ corner ];
+			if ( local[ vertex ] == uNotInMeshlet )
+			{
+				local[ vertex ] = static_cast< uint16_t >( kCurrent.vertexCount++ );
+				kResult.vertices.push_back( vertex );
+				frontier.push_back( vertex );
+			}
+			kResult.triangles.push_back( static_cast< uint8_t >( local[ vertex ] ) );
+
+			// Swap-remove the triangle from the vertex's live list.
+			uint32_t* pBegin = &adjacency[ offsets[ vertex ] ];
+			uint32_t* pEnd = pBegin + live[ vertex ];
+			uint32_t* pFound = std::find( pBegin, pEnd, static_cast< uint32_t >( triangle ) );
+			if ( pFound != pEnd )
+			{
+				*pFound = pEnd[ -1 ];
+				--live[ vertex ];
+			}
+		}
+		++kCurrent.triangleCount;
+		emitted[ triangle ] = true;
+	}
+	if ( kCurrent.triangleCount > 0 )
+	{
+		Flush();
+	}
+
+	kResult.bounds.reserve( kResult.meshlets.size() );
+	for ( const Meshlet& kMeshlet : kResult.meshlets )
+	{
+		kResult.bounds.push_back( ComputeBounds( kMesh, kResult, kMeshlet ) );
+	}
+	return kResult;
+}
+
+std::vector< MeshletData > MeshletBuilder::Build( const std::vector< const MeshData* >& meshes, const MeshletBuildOptions& kOptions, ThreadPool* pPool )
+{
+	std::vector< MeshletData > results( meshes.size() );
+	auto BuildRange = [ & ]( uint32_t begin, uint32_t end )
+	{
+		for ( uint32_t n = begin; n < end; ++n )
+		{
+			results[ n ] = Build( *meshes[ n ], kOptions );
+		}
+	};
+
+	if ( pPool )
+	{
+		pPool->ParallelFor( static_cast< uint32_t >( meshes.size() ), 1, BuildRange );
+	}
+	else
+	{
+		BuildRange( 0, static_cast< uint32_t >( meshes.size() ) );
+	}
+	return results;
+}
+
+MeshletBounds MeshletBuilder::ComputeBounds( const MeshData& kMesh, const MeshletData& kMeshlets, const Meshlet& kMeshlet )
+{
+	MeshletBounds kBounds = {};
+	kBounds.coneCutoff = 1.0f;
+	if ( kMeshlet.vertexCount == 0 )
+	{
+		return kBounds;
+	}
+
+	const uint32_t* pVertices = &kMeshlets.vertices[ kMeshlet.vertexOffset ];
+	ComputeSphere( kMesh, pVertices, kMeshlet.vertexCount, kBounds.center, kBounds.radius );
+
+	// Unit normals of the non-degenerate triangles, the cone axis is their normalized sum.
+	struct TrianglePlane
+	{
+		float normal[ 3 ];
+		float corner[ 3 ];
+	};
+	std::vector< TrianglePlane > planes( kMeshlet.triangleCount );
+	uint32_t planeCount = 0;
+	float axis[ 3 ] = { 0.0f, 0.0f, 0.0f };
+	const uint8_t* pTriangles = &kMeshlets.triangles[ kMeshlet.triangleOffset ];
+	for ( uint32_t t = 0; t < kMeshlet.triangleCount; ++t )
+	{
+		const float* p0 = kMesh.vertices[ pVertices[ pTriangles[ t * 3 + 0 ] ] ].position;
+		const float* p1 = kMesh.vertices[ pVertices[ pTriangles[ t * 3 + 1 ] ] ].position;
+		const float* p2 = kMesh.vertices[ pVertices[ pTriangles[ t * 3 + 2 ] ] ].position;
+		float e1[ 3 ], e2[ 3 ];
+		Subtract( p1, p0, e1 );
+		Subtract( p2, p0, e2 );
+
+		// Left-handed, clockwise front faces like the rest of the sample.
+		float* pNormal = planes[ planeCount ].normal;
+		pNormal[ 0 ] = e1[ 1 ] * e2[ 2 ] - e1[ 2 ] * e2[ 1 ];
+		pNormal[ 1 ] = e1[ 2 ] * e2[ 0 ] - e1[ 0 ] * e2[ 2 ];
+		pNormal[ 2 ] = e1[ 0 ] * e2[ 1 ] - e1[ 1 ] * e2[ 0 ];
+		const float length = sqrtf( Dot( pNormal, pNormal ) );
+		if ( length <= 0.0f )
+		{
+			continue;
+		}
+		for ( uint32_t c = 0; c < 3; ++c )
+		{
+			pNormal[ c ] /= length;
+			axis[ c ] += pNormal[ c ];
+			planes[ planeCount ].corner[ c ] = p0[ c ];
+		}
+		++planeCount;
+	}
+
+	const float axisLength = sqrtf( Dot( axis, axis ) );
+	if ( planeCount == 0 || axisLength <= 0.0f )
+	{
+		memcpy( kBounds.coneApex, kBounds.center, sizeof( kBounds.center ) );
+		return kBounds;
+	}
+	for ( uint32_t c = 0; c < 3; ++c )
+	{
+		kBounds.coneAxis[ c ] = axis[ c ] / axisLength;
+	}
+
+	float minimumDot = 1.0f;
+	for ( uint32_t n = 0; n < planeCount; ++n )
+	{
+		minimumDot = std::min( minimumDot, Dot( planes[ n ].normal, kBounds.coneAxis ) );
+	}
+	if ( minimumDot <= 0.0f )
+	{
+		// Wider than a hemisphere, there is always a triangle facing the camera.
+		memcpy( kBounds.coneApex, kBounds.center, sizeof( kBounds.center ) );
+		return kBounds;
+	}
+
+	// Move the apex back along the axis until it is behind every triangle plane.
+	float maximumT = 0.0f;
+	for ( uint32_t n = 0; n < planeCount; ++n )
+	{
+		float toCenter[ 3 ];
+		Subtract( kBounds.center, planes[ n ].corner, toCenter );
+		maximumT = std::max( maximumT, Dot( toCenter, planes[ n ].normal ) / Dot( kBounds.coneAxis, planes[ n ].normal ) );
+	}
+	for ( uint32_t c = 0; c < 3; ++c )
+	{
+		kBounds.coneApex[ c ] = kBounds.center[ c ] - kBounds.coneAxis[ c ] * maximumT;
+	}
+	// sin of the half angle, the view direction has to be further than 90 degrees from every normal.
+	kBounds.coneCutoff = sqrtf( 1.0f - minimumDot * minimumDot );
+	return kBounds;
+}
+
+std::vector< uint8_t > MeshletBuilder::Serialize( const MeshletData& kMeshlets )
+{
+	MeshletFileHeader kHeader = {};
+	kHeader.magic = uMagic;
+	kHeader.version = uVersion;
+	kHeader.meshletCount = static_cast< uint32_t >( kMeshlets.meshlets.size() );
+	kHeader.vertexCount = static_cast< uint32_t >( kMeshlets.vertices.size() );
+	kHeader.triangleByteCount = static_cast< uint32_t >( kMeshlets.triangles.size() );
+
+	const size_t meshletBytes = sizeof( Meshlet ) * kMeshlets.meshlets.size();
+	const size_t boundsBytes = sizeof( MeshletBounds ) * kMeshlets.bounds.size();
+	const size_t vertexBytes = sizeof( uint32_t ) * kMeshlets.vertices.size();
+	const size_t triangleBytes = ( kMeshlets.triangles.size() + 3 ) & ~size_t( 3 );
+
+	std::vector< uint8_t > buffer( sizeof( kHeader ) + meshletBytes + boundsBytes + vertexBytes + triangleBytes, 0 );
+	uint8_t* p = buffer.data();
+	memcpy( p, &kHeader, sizeof( kHeader ) );
+	p += sizeof( kHeader );
+	memcpy( p, kMeshlets.meshlets.data(), meshletBytes );
+	p += meshletBytes;
+	memcpy( p, kMeshlets.bounds.data(), boundsBytes );
+	p += boundsBytes;
+	memcpy( p, kMeshlets.vertices.data(), vertexBytes );
+	p += vertexBytes;
+	memcpy( p, kMeshlets.triangles.data(), kMeshlets.triangles.size() );
+	return buffer;
+}
+
+MeshletData MeshletBuilder::Deserialize( const uint8_t* pData, size_t size )
+{
+	MeshletFileHeader kHeader;
+	if ( size < sizeof( kHeader ) )
+	{
+		throw std::runtime_error( "Meshlet buffer is truncated" );
+	}
+	memcpy( &kHeader, pData, sizeof( kHeader ) );
+	if ( kHeader.magic != uMagic || kHeader.version != uVersion )
+	{
+		throw std::runtime_error( "Not a meshlet buffer, or an unsupported version" );
+	}
+
+	const uint64_t meshletBytes = sizeof( Meshlet ) * static_cast< uint64_t >( kHeader.meshletCount );
+	const uint64_t boundsBytes = sizeof( MeshletBounds ) * static_cast< uint64_t >( kHeader.meshletCount );
+	const uint64_t vertexBytes = sizeof( uint32_t ) * static_cast< uint64_t >( kHeader.vertexCount );
+	const uint64_t triangleBytes = ( static_cast< uint64_t >( kHeader.triangleByteCount ) + 3 ) & ~uint64_t( 3 );
+	if ( sizeof( kHeader ) + meshletBytes + boundsBytes + vertexBytes + triangleBytes != size )
+	{
+		throw std::runtime_error( "Meshlet buffer size does not match its header" );
+	}
+
+	MeshletData kResult;
+	kResult.meshlets.resize( kHeader.meshletCount );
+	kResult.bounds.resize( kHeader.meshletCount );
+	kResult.vertices.resize( kHeader.vertexCount );
+	kResult.triangles.resize( kHeader.triangleByteCount );
+
+	const uint8_t* p = pData + sizeof( kHeader );
+	memcpy( kResult.meshlets.data(), p, static_cast< size_t >( meshletBytes ) );
+	p += meshletBytes;
+	memcpy( kResult.bounds.data(), p, static_cast< size_t >( boundsBytes ) );
+	p += boundsBytes;
+	memcpy( kResult.vertices.data(), p, static_cast< size_t >( vertexBytes ) );
+	p += vertexBytes;
+	memcpy( kResult.triangles.data(), p, kResult.triangles.size() );
+
+	for ( const Meshlet& kMeshlet : kResult.meshlets )
+	{
+		if ( kMeshlet.vertexCount > 256 || kMeshlet.vertexOffset > kHeader.vertexCount || kMeshlet.vertexCount > kHeader.vertexCount - kMeshlet.vertexOffset ||
+			 kMeshlet.triangleOffset > kHeader.triangleByteCount || static_cast< uint64_t >( kMeshlet.triangleCount ) * 3 > kHeader.triangleByteCount - kMeshlet.triangleOffset )
+		{
+			throw std::runtime_error( "Meshlet buffer has a meshlet out of range" );
+		}
+		for ( uint32_t n = 0; n < kMeshlet.triangleCount * 3; ++n )
+		{
+			if ( kResult.triangles[ kMeshlet.triangleOffset + n ] >= kMeshlet.vertexCount )
+			{
+				throw std::runtime_error( "Meshlet buffer has a local index out of range" );
+			}
+		}
+	}
+	return kResult;
+}
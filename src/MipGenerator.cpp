@@ -0,0 +1,537 @@
+#include "MipGenerator.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined( _M_X64 ) || defined( _M_AMD64 ) || defined( __SSE2__ )
+#define MIPGEN_SSE 1
+#include <emmintrin.h>
+#if defined( __AVX2__ )
+#define MIPGEN_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+namespace
+{
+	constexpr uint32_t kMaxTaps = 6;
+	constexpr uint32_t kLinearToSrgbLutSize = 4096;
+
+	// Taps along one axis, destination texel x reads source texels 2x + offset[ n ].
+	struct Kernel
+	{
+		int32_t offsets[ kMaxTaps ];
+		float weights[ kMaxTaps ];
+		uint32_t tapCount;
+	};
+
+	double BesselI0( double x )
+	{
+		double sum = 1.0;
+		double term = 1.0;
+		for ( int k = 1; k < 32; ++k )
+		{
+			term *= ( x / ( 2.0 * k ) ) * ( x / ( 2.0 * k ) );
+			sum += term;
+		}
+		return sum;
+	}
+
+	Kernel MakeKernel( MipFilter filter )
+	{
+		Kernel kKernel = {};
+		if ( filter == MipFilter::Box )
+		{
+			kKernel.tapCount = 2;
+			kKernel.offsets[ 0 ] = 0;
+			kKernel.offsets[ 1 ] = 1;
+			kKernel.weights[ 0 ] = 0.5f;
+			kKernel.weights[ 1 ] = 0.5f;
+			return kKernel;
+		}
+
+		// Windowed sinc with the cutoff at the new Nyquist frequency, radius of 3 source texels.
+		const double pi = 3.14159265358979323846;
+		const double radius = 3.0;
+		const double beta = 4.0;
+
+		kKernel.tapCount = kMaxTaps;
+		double sum = 0.0;
+		double weights[ kMaxTaps ];
+		for ( uint32_t n = 0; n < kMaxTaps; ++n )
+		{
+			kKernel.offsets[ n ] = static_cast< int32_t >( n ) - 2;
+
+			// distance from the texel centre to the centre of the destination footprint.
+			const double distance = kKernel.offsets[ n ] - 0.5;
+			const double x = distance / 2.0;
+			const double sinc = x == 0.0 ? 1.0 : std::sin( pi * x ) / ( pi * x );
+			const double ratio = distance / radius;
+			const double window = BesselI0( beta * std::sqrt( std::max( 0.0, 1.0 - ratio * ratio ) ) ) / BesselI0( beta );
+			weights[ n ] = sinc * window;
+			sum += weights[ n ];
+		}
+
+		for ( uint32_t n = 0; n < kMaxTaps; ++n )
+		{
+			kKernel.weights[ n ] = static_cast< float >( weights[ n ] / sum );
+		}
+		return kKernel;
+	}
+
+	struct ColorTables
+	{
+		float srgbToLinear[ 256 ];
+		float unormToFloat[ 256 ];
+		uint8_t linearToSrgb[ kLinearToSrgbLutSize ];
+
+		ColorTables()
+		{
+			for ( uint32_t n = 0; n < 256; ++n )
+			{
+				const double c = n / 255.0;
+				srgbToLinear[ n ] = static_cast< float >( c <= 0.04045 ? c / 12.92 : std::pow( ( c + 0.055 ) / 1.055, 2.4 ) );
+				unormToFloat[ n ] = static_cast< float >( c );
+			}
+
+			for ( uint32_t n = 0; n < kLinearToSrgbLutSize; ++n )
+			{
+				const double l = n / static_cast< double >( kLinearToSrgbLutSize - 1 );
+				const double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow( l, 1.0 / 2.4 ) - 0.055;
+				linearToSrgb[ n ] = static_cast< uint8_t >( std::min( 255.0, c * 255.0 + 0.5 ) );
+			}
+		}
+	};
+
+	const ColorTables& GetColorTables()
+	{
+		static const ColorTables s_kTables;
+		return s_kTables;
+	}
+
+	inline uint32_t Clamp( int32_t value, uint32_t size )
+	{
+		return static_cast< uint32_t >( std::min( std::max( value, 0 ), static_cast< int32_t >( size ) - 1 ) );
+	}
+
+	// Decode one RGBA8 texel to 4 floats, rgb through `pColorTable`, alpha always linear.
+	inline void DecodeTexel( const uint8_t* pTexel, const float* pColorTable, const float* pAlphaTable, float* pOut )
+	{
+		pOut[ 0 ] = pColorTable[ pTexel[ 0 ] ];
+		pOut[ 1 ] = pColorTable[ pTexel[ 1 ] ];
+		pOut[ 2 ] = pColorTable[ pTexel[ 2 ] ];
+		pOut[ 3 ] = pAlphaTable[ pTexel[ 3 ] ];
+	}
+
+	inline uint8_t ToUnorm8( float value )
+	{
+		value = std::min( std::max( value, 0.0f ), 1.0f );
+		return static_cast< uint8_t >( value * 255.0f + 0.5f );
+	}
+
+	inline uint8_t ToSrgb8( const ColorTables& kTables, float value )
+	{
+		value = std::min( std::max( value, 0.0f ), 1.0f );
+		return kTables.linearToSrgb[ static_cast< uint32_t >( value * ( kLinearToSrgbLutSize - 1 ) + 0.5f ) ];
+	}
+
+#if MIPGEN_SSE
+	// Converts a source row to float4 texels once, so the taps of neighbouring destination texels read floats
+	// instead of each looking the same bytes up again. Alpha is always linear.
+	void DecodeRow( const uint8_t* pRow, uint32_t width, bool gammaCorrect, float* pOut )
+	{
+		const float* pSrgbTable = GetColorTables().srgbToLinear;
+		uint32_t x = 0;
+#if MIPGEN_AVX2
+		// two texels per iteration, the sRGB table is gathered.
+		const __m256 scale256 = _mm256_set1_ps( 1.0f / 255.0f );
+		for ( ; x + 2 <= width; x += 2 )
+		{
+			const __m256i integers = _mm256_cvtepu8_epi32( _mm_loadl_epi64( reinterpret_cast< const __m128i* >( pRow + x * 4 ) ) );
+			__m256 texels = _mm256_mul_ps( _mm256_cvtepi32_ps( integers ), scale256 );
+			if ( gammaCorrect )
+			{
+				texels = _mm256_blend_ps( _mm256_i32gather_ps( pSrgbTable, integers, 4 ), texels, 0x88 );
+			}
+			_mm256_storeu_ps( pOut + x * 4, texels );
+		}
+#endif
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 scale = _mm_set1_ps( 1.0f / 255.0f );
+		const __m128 alphaMask = _mm_castsi128_ps( _mm_setr_epi32( 0, 0, 0, -1 ) );
+		for ( ; x < width; ++x )
+		{
+			int32_t packed;
+			memcpy( &packed, pRow + x * 4, 4 );
+			const __m128i integers = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( packed ), zero ), zero );
+			__m128 texel = _mm_mul_ps( _mm_cvtepi32_ps( integers ), scale );
+			if ( gammaCorrect )
+			{
+				const uint8_t* pTexel = pRow + x * 4;
+				const __m128 linear = _mm_setr_ps( pSrgbTable[ pTexel[ 0 ] ], pSrgbTable[ pTexel[ 1 ] ], pSrgbTable[ pTexel[ 2 ] ], 0.0f );
+				texel = _mm_or_ps( _mm_and_ps( alphaMask, texel ), linear );
+			}
+			_mm_storeu_ps( pOut + x * 4, texel );
+		}
+	}
+
+	// Horizontal pass over a row DecodeRow converted: every tap is one unaligned load of a whole texel.
+	void FilterDecodedRow( const float* pDecoded, uint32_t sourceWidth, uint32_t destinationWidth, const Kernel& kKernel, float* pOut )
+	{
+		__m128 weights[ kMaxTaps ];
+		for ( uint32_t t = 0; t < kKernel.tapCount; ++t )
+		{
+			weights[ t ] = _mm_set1_ps( kKernel.weights[ t ] );
+		}
+
+		for ( uint32_t x = 0; x < destinationWidth; ++x )
+		{
+			const int32_t centre = static_cast< int32_t >( x * 2 );
+			__m128 accumulator = _mm_setzero_ps();
+			for ( uint32_t t = 0; t < kKernel.tapCount; ++t )
+			{
+				const float* pTexel = pDecoded + Clamp( centre + kKernel.offsets[ t ], sourceWidth ) * 4;
+				accumulator = _mm_add_ps( accumulator, _mm_mul_ps( weights[ t ], _mm_loadu_ps( pTexel ) ) );
+			}
+			_mm_storeu_ps( pOut + x * 4, accumulator );
+		}
+	}
+#endif
+
+	// Horizontal pass: filter one source row into `pOut` (destinationWidth float4 texels). The SIMD path converts
+	// the row into `pDecoded` (sourceWidth float4 texels) first.
+	void FilterRow( const uint8_t* pRow, uint32_t sourceWidth, uint32_t destinationWidth, const Kernel& kKernel,
+					const float* pColorTable, const float* pAlphaTable, bool gammaCorrect, bool useSimd, float* pDecoded, float* pOut )
+	{
+#if MIPGEN_SSE
+		if ( useSimd )
+		{
+			DecodeRow( pRow, sourceWidth, gammaCorrect, pDecoded );
+			FilterDecodedRow( pDecoded, sourceWidth, destinationWidth, kKernel, pOut );
+			return;
+		}
+#else
+		( void ) gammaCorrect;
+		( void ) useSimd;
+		( void ) pDecoded;
+#endif
+		for ( uint32_t x = 0; x < destinationWidth; ++x )
+		{
+			const int32_t centre = static_cast< int32_t >( x * 2 );
+			float accumulator[ 4 ] = {};
+			for ( uint32_t t = 0; t < kKernel.tapCount; ++t )
+			{
+				float texel[ 4 ];
+				DecodeTexel( pRow + Clamp( centre + kKernel.offsets[ t ], sourceWidth ) * 4, pColorTable, pAlphaTable, texel );
+				for ( uint32_t c = 0; c < 4; ++c )
+				{
+					accumulator[ c ] += kKernel.weights[ t ] * texel[ c ];
+				}
+			}
+			for ( uint32_t c = 0; c < 4; ++c )
+			{
+				pOut[ x * 4 + c ] = accumulator[ c ];
+			}
+		}
+	}
+
+	// Vertical pass: combine the horizontally filtered rows into `pOut` (float4 texels).
+	void CombineRows( const float* const* ppRows, uint32_t destinationWidth, const Kernel& kKernel, bool useSimd, float* pOut )
+	{
+		const uint32_t floatCount = destinationWidth * 4;
+		uint32_t n = 0;
+#if MIPGEN_AVX2
+		if ( useSimd )
+		{
+			// two texels per iteration.
+			for ( ; n + 8 <= floatCount; n += 8 )
+			{
+				__m256 accumulator = _mm256_setzero_ps();
+				for ( uint32_t t = 0; t < kKernel.tapCount; ++t )
+				{
+					accumulator = _mm256_add_ps( accumulator, _mm256_mul_ps( _mm256_set1_ps( kKernel.weights[ t ] ), _mm256_loadu_ps( ppRows[ t ] + n ) ) );
+				}
+				_mm256_storeu_ps( pOut + n, accumulator );
+			}
+		}
+#endif
+#if MIPGEN_SSE
+		if ( useSimd )
+		{
+			for ( ; n + 4 <= floatCount; n += 4 )
+			{
+				__m128 accumulator = _mm_setzero_ps();
+				for ( uint32_t t = 0; t < kKernel.tapCount; ++t )
+				{
+					accumulator = _mm_add_ps( accumulator, _mm_mul_ps( _mm_set1_ps( kKernel.weights[ t ] ), _mm_loadu_ps( ppRows[ t ] + n ) ) );
+				}
+				_mm_storeu_ps( pOut + n, accumulator );
+			}
+		}
+#else
+		( void ) useSimd;
+#endif
+		for ( ; n < floatCount; ++n )
+		{
+			float accumulator = 0.0f;
+			for ( uint32_t t = 0; t < kKernel.tapCount; ++t )
+			{
+				accumulator += kKernel.weights[ t ] * ppRows[ t ][ n ];
+			}
+			pOut[ n ] = accumulator;
+		}
+	}
+
+#if MIPGEN_SSE
+	// Linear to sRGB for values in [ 0, 1 ], a fit of x^( 1 / 2.4 ) on three square roots. Within one step of
+	// the exact curve after rounding to 8 bits, like the 12-bit table of the scalar path.
+	inline __m128 LinearToSrgb( __m128 linear )
+	{
+		const __m128 s1 = _mm_sqrt_ps( linear );
+		const __m128 s2 = _mm_sqrt_ps( s1 );
+		const __m128 s3 = _mm_sqrt_ps( s2 );
+		__m128 curve = _mm_mul_ps( _mm_set1_ps( 0.662002687f ), s1 );
+		curve = _mm_add_ps( curve, _mm_mul_ps( _mm_set1_ps( 0.684122060f ), s2 ) );
+		curve = _mm_sub_ps( curve, _mm_mul_ps( _mm_set1_ps( 0.323583601f ), s3 ) );
+		curve = _mm_sub_ps( curve, _mm_mul_ps( _mm_set1_ps( 0.0225411470f ), linear ) );
+
+		const __m128 bToe = _mm_cmple_ps( linear, _mm_set1_ps( 0.0031308f ) );
+		const __m128 toe = _mm_mul_ps( linear, _mm_set1_ps( 12.92f ) );
+		return _mm_or_ps( _mm_and_ps( bToe, toe ), _mm_andnot_ps( bToe, curve ) );
+	}
+
+	// One float4 texel to four integers in [ 0, 255 ], rgb sRGB encoded when gammaCorrect.
+	inline __m128i EncodeTexel( const float* pTexel, bool gammaCorrect )
+	{
+		const __m128 alphaMask = _mm_castsi128_ps( _mm_setr_epi32( 0, 0, 0, -1 ) );
+		__m128 texel = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( pTexel ), _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) );
+		if ( gammaCorrect )
+		{
+			texel = _mm_or_ps( _mm_and_ps( alphaMask, texel ), _mm_andnot_ps( alphaMask, LinearToSrgb( texel ) ) );
+		}
+		return _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( texel, _mm_set1_ps( 255.0f ) ), _mm_set1_ps( 0.5f ) ) );
+	}
+#endif
+
+	void EncodeRow( const float* pTexels, uint32_t width, bool gammaCorrect, bool useSimd, uint8_t* pOut )
+	{
+		const ColorTables& kTables = GetColorTables();
+		uint32_t x = 0;
+#if MIPGEN_SSE
+		if ( useSimd )
+		{
+			// four texels per store.
+			for ( ; x + 4 <= width; x += 4 )
+			{
+				const __m128i low = _mm_packs_epi32( EncodeTexel( pTexels + x * 4, gammaCorrect ), EncodeTexel( pTexels + x * 4 + 4, gammaCorrect ) );
+				const __m128i high = _mm_packs_epi32( EncodeTexel( pTexels + x * 4 + 8, gammaCorrect ), EncodeTexel( pTexels + x * 4 + 12, gammaCorrect ) );
+				_mm_storeu_si128( reinterpret_cast< __m128i* >( pOut + x * 4 ), _mm_packus_epi16( low, high ) );
+			}
+			for ( ; x < width; ++x )
+			{
+				__m128i integer = EncodeTexel( pTexels + x * 4, gammaCorrect );
+				integer = _mm_packs_epi32( integer, integer );
+				integer = _mm_packus_epi16( integer, integer );
+				const int packed = _mm_cvtsi128_si32( integer );
+				memcpy( pOut + x * 4, &packed, 4 );
+			}
+			return;
+		}
+#else
+		( void ) useSimd;
+#endif
+		for ( ; x < width; ++x )
+		{
+			const float* pTexel = pTexels + x * 4;
+			if ( gammaCorrect )
+			{
+				pOut[ x * 4 + 0 ] = ToSrgb8( kTables, pTexel[ 0 ] );
+				pOut[ x * 4 + 1 ] = ToSrgb8( kTables, pTexel[ 1 ] );
+				pOut[ x * 4 + 2 ] = ToSrgb8( kTables, pTexel[ 2 ] );
+			}
+			else
+			{
+				pOut[ x * 4 + 0 ] = ToUnorm8( pTexel[ 0 ] );
+				pOut[ x * 4 + 1 ] = ToUnorm8( pTexel[ 1 ] );
+				pOut[ x * 4 + 2 ] = ToUnorm8( pTexel[ 2 ] );
+			}
+			pOut[ x * 4 + 3 ] = ToUnorm8( pTexel[ 3 ] );
+		}
+	}
+}
+
+uint32_t MipGenerator::CountMipLevels( uint32_t width, uint32_t height )
+{
+	uint32_t levels = 1;
+	uint32_t size = std::max( width, height );
+	while ( size > 1 )
+	{
+		size /= 2;
+		++levels;
+	}
+	return levels;
+}
+
+std::vector< MipLevel > MipGenerator::Generate( const uint8_t* pLevel0, uint32_t width, uint32_t height, size_t rowPitch,
+												const MipGenerateOptions& kOptions, std::vector< uint8_t >& chain,
+												ThreadPool* pPool )
+{
+	std::vector< MipLevel > levels;
+	const uint32_t levelCount = CountMipLevels( width, height );
+
+	size_t totalSize = 0;
+	uint32_t levelWidth = width;
+	uint32_t levelHeight = height;
+	for ( uint32_t n = 1; n < levelCount; ++n )
+	{
+		levelWidth = std::max( 1u, levelWidth / 2 );
+		levelHeight = std::max( 1u, levelHeight / 2 );
+
+		MipLevel kLevel;
+		kLevel.width = levelWidth;
+		kLevel.height = levelHeight;
+		kLevel.rowPitch = static_cast< size_t >( levelWidth ) * 4;
+		kLevel.offset = totalSize;
+		totalSize += kLevel.rowPitch * levelHeight;
+		levels.push_back( kLevel );
+	}
+
+	chain.resize( totalSize );
+
+	// Each level depends on the previous one, so levels run in order and the rows within a level in parallel.
+	const uint8_t* pSource = pLevel0;
+	uint32_t sourceWidth = width;
+	uint32_t sourceHeight = height;
+	size_t sourceRowPitch = rowPitch;
+	for ( const MipLevel& kLevel : levels )
+	{
+		uint8_t* pDestination = chain.data() + kLevel.offset;
+		Downsample( pSource, sourceWidth, sourceHeight, sourceRowPitch, pDestination, kLevel.width, kLevel.height, kLevel.rowPitch, kOptions, pPool );
+
+		pSource = pDestination;
+		sourceWidth = kLevel.width;
+		sourceHeight = kLevel.height;
+		sourceRowPitch = kLevel.rowPitch;
+	}
+
+	return levels;
+}
+
+void MipGenerator::GenerateInto( const uint8_t* pLevel0, uint32_t width, uint32_t height, size_t rowPitch,
+								 const MipGenerateOptions& kOptions, const MipDestination* pLevels, uint32_t levelCount,
+								 ThreadPool* pPool )
+{
+	// Two scratch levels take turns, the one filtered from and the one being written.
+	std::vector< uint8_t > scratch[ 2 ];
+	const uint8_t* pSource = pLevel0;
+	uint32_t sourceWidth = width;
+	uint32_t sourceHeight = height;
+	size_t sourceRowPitch = rowPitch;
+	for ( uint32_t n = 1; n < levelCount; ++n )
+	{
+		const uint32_t levelWidth = std::max( 1u, sourceWidth / 2 );
+		const uint32_t levelHeight = std::max( 1u, sourceHeight / 2 );
+		const size_t keepRowPitch = static_cast< size_t >( levelWidth ) * 4;
+
+		// Nothing is filtered from the last level, it goes straight to its destination.
+		uint8_t* pKeep = nullptr;
+		if ( n + 1 < levelCount )
+		{
+			scratch[ n % 2 ].resize( keepRowPitch * levelHeight );
+			pKeep = scratch[ n % 2 ].data();
+		}
+		DownsampleLevel( pSource, sourceWidth, sourceHeight, sourceRowPitch, pLevels[ n - 1 ].pData, levelWidth, levelHeight, pLevels[ n - 1 ].rowPitch,
+						 pKeep, keepRowPitch, kOptions, pPool );
+
+		pSource = pKeep;
+		sourceWidth = levelWidth;
+		sourceHeight = levelHeight;
+		sourceRowPitch = keepRowPitch;
+	}
+}
+
+void MipGenerator::Downsample( const uint8_t* pSource, uint32_t sourceWidth, uint32_t sourceHeight, size_t sourceRowPitch,
+							   uint8_t* pDestination, uint32_t destinationWidth, uint32_t destinationHeight, size_t destinationRowPitch,
+							   const MipGenerateOptions& kOptions, ThreadPool* pPool )
+{
+	DownsampleLevel( pSource, sourceWidth, sourceHeight, sourceRowPitch, pDestination, destinationWidth, destinationHeight, destinationRowPitch,
+					 nullptr, 0, kOptions, pPool );
+}
+
+void MipGenerator::DownsampleLevel( const uint8_t* pSource, uint32_t sourceWidth, uint32_t sourceHeight, size_t sourceRowPitch,
+									uint8_t* pDestination, uint32_t destinationWidth, uint32_t destinationHeight, size_t destinationRowPitch,
+									uint8_t* pKeep, size_t keepRowPitch, const MipGenerateOptions& kOptions, ThreadPool* pPool )
+{
+	const ColorTables& kTables = GetColorTables();
+	const float* pColorTable = kOptions.gammaCorrect ? kTables.srgbToLinear : kTables.unormToFloat;
+	const float* pAlphaTable = kTables.unormToFloat;
+
+	// A 1-texel wide (or tall) source has nothing to average along that axis.
+	Kernel kHorizontal = MakeKernel( kOptions.filter );
+	Kernel kVertical = kHorizontal;
+	if ( sourceWidth == 1 )
+	{
+		kHorizontal = { { 0 }, { 1.0f }, 1 };
+	}
+	if ( sourceHeight == 1 )
+	{
+		kVertical = { { 0 }, { 1.0f }, 1 };
+	}
+
+	const size_t rowStride = static_cast< size_t >( destinationWidth ) * 4;
+
+	auto FilterRows = [ & ]( uint32_t rowBegin, uint32_t rowEnd )
+	{
+		// Horizontally filtered source rows are cached by source row, neighbouring destination rows
+		// share all but two of them. The window never spans more than kMaxTaps rows so the slots never collide.
+		const uint32_t slotCount = kMaxTaps + 2;
+		std::vector< float > scratch( rowStride * ( slotCount + 1 ) + static_cast< size_t >( sourceWidth ) * 4 );
+		uint32_t slotRows[ slotCount ];
+		std::fill( slotRows, slotRows + slotCount, UINT32_MAX );
+		float* pCombined = scratch.data() + rowStride * slotCount;
+		float* pDecoded = pCombined + rowStride;
+		const float* pRows[ kMaxTaps ];
+
+		for ( uint32_t y = rowBegin; y < rowEnd; ++y )
+		{
+			const int32_t centre = static_cast< int32_t >( y * 2 );
+			for ( uint32_t t = 0; t < kVertical.tapCount; ++t )
+			{
+				const uint32_t sourceY = Clamp( centre + kVertical.offsets[ t ], sourceHeight );
+				const uint32_t slot = sourceY % slotCount;
+				float* pSlot = scratch.data() + slot * rowStride;
+				if ( slotRows[ slot ] != sourceY )
+				{
+					FilterRow( pSource + sourceY * sourceRowPitch, sourceWidth, destinationWidth, kHorizontal,
+							   pColorTable, pAlphaTable, kOptions.gammaCorrect, kOptions.useSimd, pDecoded, pSlot );
+					slotRows[ slot ] = sourceY;
+				}
+				pRows[ t ] = pSlot;
+			}
+
+			CombineRows( pRows, destinationWidth, kVertical, kOptions.useSimd, pCombined );
+			if ( pKeep )
+			{
+				uint8_t* pKeepRow = pKeep + y * keepRowPitch;
+				EncodeRow( pCombined, destinationWidth, kOptions.gammaCorrect, kOptions.useSimd, pKeepRow );
+				memcpy( pDestination + y * destinationRowPitch, pKeepRow, static_cast< size_t >( destinationWidth ) * 4 );
+			}
+			else
+			{
+				EncodeRow( pCombined, destinationWidth, kOptions.gammaCorrect, kOptions.useSimd, pDestination + y * destinationRowPitch );
+			}
+		}
+	};
+
+	// Small levels are not worth the hand-off.
+	const uint32_t grainSize = std::max( 1u, 16384u / std::max( 1u, destinationWidth ) );
+	if ( pPool && destinationHeight > grainSize )
+	{
+		pPool->ParallelFor( destinationHeight, grainSize, FilterRows );
+	}
+	else
+	{
+		FilterRows( 0, destinationHeight );
+	}
+}
@@ -0,0 +1,99 @@
+#include "NullCommandBackend.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	class NullCommandAllocator : public ICommandAllocator
+	{
+	public:
+		explicit NullCommandAllocator( NullCommandBackend& kBackend ) : m_kBackend( kBackend ) {}
+
+		void Reset() override
+		{
+			if ( m_kBackend.GetCompletedValue() < m_pendingValue )
+			{
+				throw std::runtime_error( "Command allocator reset while the GPU may still be reading it." );
+			}
+		}
+
+		NullCommandBackend& m_kBackend;
+		uint64_t m_pendingValue = 0;
+	};
+
+	class NullCommandList : public ICommandList
+	{
+	public:
+		void Reset( ICommandAllocator& kAllocator ) override
+		{
+			if ( m_bOpen )
+			{
+				throw std::runtime_error( "Command list reset while it is still open." );
+			}
+			m_pAllocator = static_cast< NullCommandAllocator* >( &kAllocator );
+			m_tokens.clear();
+			m_bOpen = true;
+		}
+
+		void Close() override
+		{
+			if ( !m_bOpen )
+			{
+				throw std::runtime_error( "Command list closed twice." );
+			}
+			m_bOpen = false;
+		}
+
+		NullCommandAllocator* m_pAllocator = nullptr;
+		std::vector< uint32_t > m_tokens;
+		bool m_bOpen = false;
+	};
+}
+
+void NullCommandBackend::Write( ICommandList& kList, uint32_t token )
+{
+	NullCommandList& kNullList = static_cast< NullCommandList& >( kList );
+	if ( !kNullList.m_bOpen )
+	{
+		throw std::runtime_error( "Recording into a closed command list." );
+	}
+	kNullList.m_tokens.push_back( token );
+}
+
+std::unique_ptr< ICommandAllocator > NullCommandBackend::CreateAllocator()
+{
+	return std::make_unique< NullCommandAllocator >( *this );
+}
+
+std::unique_ptr< ICommandList > NullCommandBackend::CreateCommandList( ICommandAllocator& kAllocator )
+{
+	auto spList = std::make_unique< NullCommandList >();
+	spList->m_pAllocator = static_cast< NullCommandAllocator* >( &kAllocator );
+	return spList;
+}
+
+void NullCommandBackend::Execute( ICommandList* const* ppLists, uint32_t count, uint64_t fenceValue )
+{
+	for ( uint32_t n = 0; n < count; ++n )
+	{
+		NullCommandList& kList = static_cast< NullCommandList& >( *ppLists[ n ] );
+		if ( kList.m_bOpen )
+		{
+			throw std::runtime_error( "Executing a command list that was not closed." );
+		}
+		m_executedTokens.insert( m_executedTokens.end(), kList.m_tokens.begin(), kList.m_tokens.end() );
+		kList.m_pAllocator->m_pendingValue = std::max( kList.m_pAllocator->m_pendingValue, fenceValue );
+	}
+	++m_executeCount;
+}
+
+void NullCommandBackend::WaitForFence( uint64_t fenceValue )
+{
+	++m_waitCount;
+	Complete( fenceValue );
+}
+
+void NullCommandBackend::Complete( uint64_t fenceValue )
+{
+	m_completedValue = std::max( m_completedValue, fenceValue );
+}
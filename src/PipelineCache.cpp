@@ -0,0 +1,243 @@
+#include "PipelineCache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include "ThreadPool.hpp"
+
+namespace
+{
+	struct PipelineCacheFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		PipelineCacheIdentity kIdentity;
+		uint32_t entryCount;
+		uint32_t reserved;
+		uint64_t payloadSize;	// everything after the header.
+		uint64_t payloadHash;	// Hasher over the payload bytes.
+	};
+	static_assert( sizeof( PipelineCacheFileHeader ) == 56, "PipelineCacheFileHeader is part of the file format" );
+
+	struct PipelineCacheFileEntry
+	{
+		uint64_t hash;
+		uint64_t blobSize;		// the blob follows right after.
+	};
+	static_assert( sizeof( PipelineCacheFileEntry ) == 16, "PipelineCacheFileEntry is part of the file format" );
+
+	bool SameIdentity( const PipelineCacheIdentity& kFirst, const PipelineCacheIdentity& kSecond )
+	{
+		return kFirst.vendorId == kSecond.vendorId && kFirst.deviceId == kSecond.deviceId && kFirst.subSysId == kSecond.subSysId &&
+			kFirst.revision == kSecond.revision && kFirst.driverVersion == kSecond.driverVersion;
+	}
+
+	uint64_t HashPayload( const uint8_t* pData, size_t size )
+	{
+		Hasher kHasher;
+		kHasher.AddBlob( pData, size );
+		return kHasher.GetHash();
+	}
+}
+
+PipelineCache::PipelineCache( const PipelineCacheIdentity& kIdentity ) :
+	m_kIdentity( kIdentity )
+{
+}
+
+PipelineCacheLoad PipelineCache::Load( const std::filesystem::path& path )
+{
+	{
+		std::lock_guard< std::mutex > kLock( m_mutex );
+		m_blobs.clear();
+		m_bDirty = false;
+	}
+
+	std::ifstream in( path, std::ios::binary | std::ios::ate );
+	if ( !in )
+	{
+		return PipelineCacheLoad::Missing;
+	}
+	std::vector< uint8_t > file( static_cast< size_t >( in.tellg() ) );
+	in.seekg( 0 );
+	in.read( reinterpret_cast< char* >( file.data() ), static_cast< std::streamsize >( file.size() ) );
+	if ( !in )
+	{
+		throw std::runtime_error( "Failed to read " + path.string() );
+	}
+
+	PipelineCacheFileHeader kHeader = {};
+	if ( file.size() < sizeof( kHeader ) )
+	{
+		return PipelineCacheLoad::Corrupt;
+	}
+	memcpy( &kHeader, file.data(), sizeof( kHeader ) );
+	if ( kHeader.magic != uMagic || kHeader.reserved != 0 )
+	{
+		return PipelineCacheLoad::Corrupt;
+	}
+	if ( kHeader.version != uVersion || !SameIdentity( kHeader.kIdentity, m_kIdentity ) )
+	{
+		return PipelineCacheLoad::Invalidated;
+	}
+
+	const uint8_t* pPayload = file.data() + sizeof( kHeader );
+	const size_t payloadSize = file.size() - sizeof( kHeader );
+	if ( kHeader.payloadSize != payloadSize || kHeader.payloadHash != HashPayload( pPayload, payloadSize ) )
+	{
+		return PipelineCacheLoad::Corrupt;
+	}
+
+	std::unordered_map< uint64_t, Blob > blobs;
+	size_t offset = 0;
+	for ( uint32_t n = 0; n < kHeader.entryCount; ++n )
+	{
+		PipelineCacheFileEntry kEntry = {};
+		if ( payloadSize - offset < sizeof( kEntry ) )
+		{
+			return PipelineCacheLoad::Corrupt;
+		}
+		memcpy( &kEntry, pPayload + offset, sizeof( kEntry ) );
+		offset += sizeof( kEntry );
+		if ( kEntry.blobSize == 0 || kEntry.blobSize > payloadSize - offset )
+		{
+			return PipelineCacheLoad::Corrupt;
+		}
+
+		const uint8_t* pBlob = pPayload + offset;
+		offset += static_cast< size_t >( kEntry.blobSize );
+		if ( !blobs.emplace( kEntry.hash, std::make_shared< const std::vector< uint8_t > >( pBlob, pBlob + kEntry.blobSize ) ).second )
+		{
+			return PipelineCacheLoad::Corrupt;
+		}
+	}
+	if ( offset != payloadSize )
+	{
+		return PipelineCacheLoad::Corrupt;
+	}
+
+	std::lock_guard< std::mutex > kLock( m_mutex );
+	m_blobs = std::move( blobs );
+	return PipelineCacheLoad::Loaded;
+}
+
+void PipelineCache::Save( const std::filesystem::path& path )
+{
+	// Sorted, so the same blobs always make the same file.
+	std::vector< std::pair< uint64_t, Blob > > entries;
+	{
+		std::lock_guard< std::mutex > kLock( m_mutex );
+		entries.assign( m_blobs.begin(), m_blobs.end() );
+		m_bDirty = false;
+	}
+	std::sort( entries.begin(), entries.end(), []( const auto& kFirst, const auto& kSecond ) { return kFirst.first < kSecond.first; } );
+
+	size_t fileSize = sizeof( PipelineCacheFileHeader );
+	for ( const auto& kEntry : entries )
+	{
+		fileSize += sizeof( PipelineCacheFileEntry ) + kEntry.second->size();
+	}
+	std::vector< uint8_t > file( fileSize );
+	size_t offset = sizeof( PipelineCacheFileHeader );
+	for ( const auto& kEntry : entries )
+	{
+		const PipelineCacheFileEntry kFileEntry = { kEntry.first, kEntry.second->size() };
+		memcpy( file.data() + offset, &kFileEntry, sizeof( kFileEntry ) );
+		offset += sizeof( kFileEntry );
+		memcpy( file.data() + offset, kEntry.second->data(), kEntry.second->size() );
+		offset += kEntry.second->size();
+	}
+
+	PipelineCacheFileHeader kHeader = {};
+	kHeader.magic = uMagic;
+	kHeader.version = uVersion;
+	kHeader.kIdentity = m_kIdentity;
+	kHeader.entryCount = static_cast< uint32_t >( entries.size() );
+	kHeader.payloadSize = fileSize - sizeof( kHeader );
+	kHeader.payloadHash = HashPayload( file.data() + sizeof( kHeader ), fileSize - sizeof( kHeader ) );
+	memcpy( file.data(), &kHeader, sizeof( kHeader ) );
+
+	if ( path.has_parent_path() )
+	{
+		std::filesystem::create_directories( path.parent_path() );
+	}
+	std::filesystem::path temporaryPath = path;
+	temporaryPath += ".tmp";
+	{
+		std::ofstream out( temporaryPath, std::ios::binary | std::ios::trunc );
+		if ( !out )
+		{
+			throw std::runtime_error( "Failed to create " + temporaryPath.string() );
+		}
+		out.write( reinterpret_cast< const char* >( file.data() ), static_cast< std::streamsize >( file.size() ) );
+		if ( !out )
+		{
+			throw std::runtime_error( "Failed to write " + temporaryPath.string() );
+		}
+	}
+	std::filesystem::rename( temporaryPath, path );
+}
+
+bool PipelineCache::IsDirty() const
+{
+	std::lock_guard< std::mutex > kLock( m_mutex );
+	return m_bDirty;
+}
+
+void PipelineCache::Create( ICachedPipeline& kPipeline )
+{
+	const uint64_t hash = kPipeline.GetHash();
+	Blob spBlob;
+	{
+		std::lock_guard< std::mutex > kLock( m_mutex );
+		const auto it = m_blobs.find( hash );
+		if ( it != m_blobs.end() )
+		{
+			spBlob = it->second;
+		}
+	}
+
+	// The driver checks the blob against the description, so even a hash collision only costs a compile.
+	if ( spBlob && kPipeline.Create( spBlob->data(), spBlob->size() ) )
+	{
+		std::lock_guard< std::mutex > kLock( m_mutex );
+		++m_kStats.hits;
+		return;
+	}
+	if ( !kPipeline.Create( nullptr, 0 ) )
+	{
+		throw std::runtime_error( "Pipeline creation failed without a cached blob" );
+	}
+	std::vector< uint8_t > blob = kPipeline.GetCachedBlob();
+
+	std::lock_guard< std::mutex > kLock( m_mutex );
+	++( spBlob ? m_kStats.rejected : m_kStats.misses );
+	if ( blob.empty() )
+	{
+		m_bDirty |= m_blobs.erase( hash ) != 0;
+	}
+	else
+	{
+		m_blobs[ hash ] = std::make_shared< const std::vector< uint8_t > >( std::move( blob ) );
+		m_bDirty = true;
+	}
+}
+
+void PipelineCache::CreateAsync( ICachedPipeline& kPipeline, ThreadPool& kPool, JobCounter& kCounter )
+{
+	kPool.Run( [ this, &kPipeline ]() { Create( kPipeline ); }, &kCounter );
+}
+
+PipelineCacheStats PipelineCache::GetStats() const
+{
+	std::lock_guard< std::mutex > kLock( m_mutex );
+	PipelineCacheStats kStats = m_kStats;
+	kStats.entries = static_cast< uint32_t >( m_blobs.size() );
+	kStats.blobBytes = 0;
+	for ( const auto& kEntry : m_blobs )
+	{
+		kStats.blobBytes += kEntry.second->size();
+	}
+	return kStats;
+}
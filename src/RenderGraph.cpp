@@ -0,0 +1,387 @@
+#include "RenderGraph.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	uint64_t AlignUp( uint64_t value, uint64_t alignment )
+	{
+		return ( value + alignment - 1 ) & ~( alignment - 1 );
+	}
+
+	bool LifetimesOverlap( const RenderGraphPlacement& kFirst, const RenderGraphPlacement& kSecond )
+	{
+		return kFirst.firstPass <= kSecond.lastPass && kSecond.firstPass <= kFirst.lastPass;
+	}
+
+	bool MemoryOverlaps( const RenderGraphPlacement& kFirst, const RenderGraphPlacement& kSecond )
+	{
+		return kFirst.offset < kSecond.offset + kSecond.sizeBytes && kSecond.offset < kFirst.offset + kFirst.sizeBytes;
+	}
+}
+
+void RenderGraph::Reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_compiledPasses.clear();
+	std::fill( std::begin( m_heaps ), std::end( m_heaps ), RenderGraphHeapLayout() );
+	m_kStats = {};
+}
+
+uint32_t RenderGraph::Import( std::string name, void* pResource, uint32_t initialState, uint32_t finalState )
+{
+	Resource kResource;
+	kResource.name = std::move( name );
+	kResource.pImported = pResource;
+	kResource.bImported = true;
+	kResource.initialState = initialState;
+	kResource.finalState = finalState;
+	m_resources.push_back( std::move( kResource ) );
+	return static_cast< uint32_t >( m_resources.size() - 1 );
+}
+
+uint32_t RenderGraph::Create( std::string name, const RenderGraphResourceDesc& kDesc )
+{
+	if ( kDesc.sizeBytes == 0 || kDesc.alignment == 0 || ( kDesc.alignment & ( kDesc.alignment - 1 ) ) != 0 )
+	{
+		throw std::runtime_error( "transient resources need a size and a power of two alignment" );
+	}
+
+	Resource kResource;
+	kResource.name = std::move( name );
+	kResource.kDesc = kDesc;
+	m_resources.push_back( std::move( kResource ) );
+	return static_cast< uint32_t >( m_resources.size() - 1 );
+}
+
+uint32_t RenderGraph::AddPass( std::string name, ExecuteFunction execute, bool bSideEffects )
+{
+	Pass kPass;
+	kPass.name = std::move( name );
+	kPass.execute = std::move( execute );
+	kPass.bSideEffects = bSideEffects;
+	m_passes.push_back( std::move( kPass ) );
+	return static_cast< uint32_t >( m_passes.size() - 1 );
+}
+
+void RenderGraph::Read( uint32_t pass, uint32_t resource, uint32_t state, bool bUnorderedAccess )
+{
+	AddAccess( pass, resource, state, false, bUnorderedAccess );
+}
+
+void RenderGraph::Write( uint32_t pass, uint32_t resource, uint32_t state, bool bUnorderedAccess )
+{
+	AddAccess( pass, resource, state, true, bUnorderedAccess );
+}
+
+void RenderGraph::AddAccess( uint32_t pass, uint32_t resource, uint32_t state, bool bWrite, bool bUnorderedAccess )
+{
+	if ( pass >= m_passes.size() || resource >= m_resources.size() )
+	{
+		throw std::runtime_error( "unknown render graph pass or resource" );
+	}
+	m_passes[ pass ].accesses.push_back( { resource, state, bWrite, bUnorderedAccess } );
+}
+
+void RenderGraph::Compile()
+{
+	m_compiledPasses.clear();
+	std::fill( std::begin( m_heaps ), std::end( m_heaps ), RenderGraphHeapLayout() );
+	m_kStats = {};
+	m_kStats.passes = static_cast< uint32_t >( m_passes.size() );
+	for ( Resource& kResource : m_resources )
+	{
+		kResource.kPlacement = {};
+		kResource.aliasedFrom = uInvalidIndex;
+	}
+
+	const std::vector< uint32_t > keptPasses = CullPasses();
+	m_kStats.culledPasses = m_kStats.passes - static_cast< uint32_t >( keptPasses.size() );
+
+	// One state per resource and pass, and the lifetime of every resource from its first to its last kept pass.
+	std::vector< std::vector< Access > > uses( keptPasses.size() );
+	for ( uint32_t index = 0; index < keptPasses.size(); ++index )
+	{
+		for ( const Access& kAccess : m_passes[ keptPasses[ index ] ].accesses )
+		{
+			const auto it = std::find_if( uses[ index ].begin(), uses[ index ].end(), [ &kAccess ]( const Access& kUse ) { return kUse.resource == kAccess.resource; } );
+			if ( it == uses[ index ].end() )
+			{
+				uses[ index ].push_back( kAccess );
+				continue;
+			}
+
+			it->bUnorderedAccess |= kAccess.bUnorderedAccess;
+			if ( it->bWrite || kAccess.bWrite )
+			{
+				if ( it->state != kAccess.state )
+				{
+					throw std::runtime_error( "pass " + m_passes[ keptPasses[ index ] ].name + " writes " + m_resources[ kAccess.resource ].name + " and uses it in another state" );
+				}
+				it->bWrite = true;
+			}
+			else
+			{
+				it->state |= kAccess.state;
+			}
+		}
+
+		for ( const Access& kUse : uses[ index ] )
+		{
+			RenderGraphPlacement& kPlacement = m_resources[ kUse.resource ].kPlacement;
+			if ( !kPlacement.bUsed )
+			{
+				if ( !m_resources[ kUse.resource ].bImported && !kUse.bWrite )
+				{
+					throw std::runtime_error( "pass " + m_passes[ keptPasses[ index ] ].name + " reads " + m_resources[ kUse.resource ].name + " before anything wrote it" );
+				}
+				kPlacement.bUsed = true;
+				kPlacement.firstPass = index;
+				kPlacement.initialState = kUse.state;
+			}
+			kPlacement.lastPass = index;
+		}
+	}
+
+	for ( uint32_t heap = 0; heap < static_cast< uint32_t >( RenderGraphHeap::Count ); ++heap )
+	{
+		PlaceResources( static_cast< RenderGraphHeap >( heap ) );
+		m_kStats.heapBytes += m_heaps[ heap ].sizeBytes;
+	}
+	for ( const Resource& kResource : m_resources )
+	{
+		if ( !kResource.bImported )
+		{
+			m_kStats.transientResources += kResource.kPlacement.bUsed ? 1 : 0;
+			m_kStats.culledResources += kResource.kPlacement.bUsed ? 0 : 1;
+			m_kStats.transientBytes += kResource.kPlacement.bUsed ? kResource.kDesc.sizeBytes : 0;
+		}
+	}
+
+	// Imported resources start where the frame before left them, transient ones where their last frame did.
+	std::vector< uint32_t > states( m_resources.size() );
+	for ( uint32_t resource = 0; resource < m_resources.size(); ++resource )
+	{
+		const Resource& kResource = m_resources[ resource ];
+		states[ resource ] = kResource.bImported ? kResource.initialState : kResource.kPlacement.initialState;
+	}
+
+	// Whether a kept pass used the resource before, and whether the last one that did wrote it.
+	std::vector< bool > bUsedBefore( m_resources.size() );
+	std::vector< bool > bWrittenLast( m_resources.size() );
+
+	m_compiledPasses.resize( keptPasses.size() );
+	for ( uint32_t index = 0; index < keptPasses.size(); ++index )
+	{
+		RenderGraphCompiledPass& kCompiled = m_compiledPasses[ index ];
+		kCompiled.pass = keptPasses[ index ];
+
+		// Memory that changes hands first, then the transitions and UAV barriers, all in one batch in front of the pass.
+		for ( const Access& kUse : uses[ index ] )
+		{
+			const Resource& kResource = m_resources[ kUse.resource ];
+			if ( kResource.kPlacement.bAliased && kResource.kPlacement.firstPass == index )
+			{
+				kCompiled.barriersBefore.push_back( { RenderGraphBarrierType::Aliasing, kUse.resource, kResource.aliasedFrom, 0 } );
+				++m_kStats.aliasingBarriers;
+			}
+		}
+		for ( const Access& kUse : uses[ index ] )
+		{
+			if ( states[ kUse.resource ] != kUse.state )
+			{
+				kCompiled.barriersBefore.push_back( { RenderGraphBarrierType::Transition, kUse.resource, states[ kUse.resource ], kUse.state } );
+				states[ kUse.resource ] = kUse.state;
+				++m_kStats.transitions;
+			}
+			else if ( kUse.bUnorderedAccess && bUsedBefore[ kUse.resource ] && ( kUse.bWrite || bWrittenLast[ kUse.resource ] ) )
+			{
+				kCompiled.barriersBefore.push_back( { RenderGraphBarrierType::Uav, kUse.resource, kUse.state, kUse.state } );
+				++m_kStats.uavBarriers;
+			}
+			bUsedBefore[ kUse.resource ] = true;
+			bWrittenLast[ kUse.resource ] = kUse.bWrite;
+		}
+
+		// After its last pass a resource goes back to the state the next frame expects, before anything else takes
+		// over its memory.
+		for ( const Access& kUse : uses[ index ] )
+		{
+			const Resource& kResource = m_resources[ kUse.resource ];
+			const uint32_t finalState = kResource.bImported ? kResource.finalState : kResource.kPlacement.initialState;
+			if ( kResource.kPlacement.lastPass == index && states[ kUse.resource ] != finalState )
+			{
+				kCompiled.barriersAfter.push_back( { RenderGraphBarrierType::Transition, kUse.resource, states[ kUse.resource ], finalState } );
+				states[ kUse.resource ] = finalState;
+				++m_kStats.transitions;
+			}
+		}
+	}
+
+	// Imported resources no kept pass used still have to end up in their final state.
+	for ( uint32_t resource = 0; resource < m_resources.size() && !m_compiledPasses.empty(); ++resource )
+	{
+		const Resource& kResource = m_resources[ resource ];
+		if ( kResource.bImported && !kResource.kPlacement.bUsed && kResource.initialState != kResource.finalState )
+		{
+			m_compiledPasses.back().barriersAfter.push_back( { RenderGraphBarrierType::Transition, resource, kResource.initialState, kResource.finalState } );
+			++m_kStats.transitions;
+		}
+	}
+}
+
+void RenderGraph::ExecutePass( uint32_t pass, ICommandList& kList ) const
+{
+	const Pass& kPass = m_passes.at( pass );
+	if ( kPass.execute )
+	{
+		kPass.execute( kList );
+	}
+}
+
+std::vector< uint32_t > RenderGraph::CullPasses() const
+{
+	// Backwards from the outputs: a pass is needed when it writes something needed, and then needs everything it
+	// uses. Writes keep the contents, so what a kept pass only writes, e.g. a depth buffer it tests against, needs
+	// the passes that wrote it before as much as what it reads, like the clear.
+	std::vector< bool > needed( m_resources.size() );
+	for ( uint32_t resource = 0; resource < m_resources.size(); ++resource )
+	{
+		needed[ resource ] = m_resources[ resource ].bImported;
+	}
+
+	std::vector< uint32_t > keptPasses;
+	for ( uint32_t pass = static_cast< uint32_t >( m_passes.size() ); pass-- > 0; )
+	{
+		const Pass& kPass = m_passes[ pass ];
+		const bool bKeep = kPass.bSideEffects || std::any_of( kPass.accesses.begin(), kPass.accesses.end(), [ &needed ]( const Access& kAccess )
+		{
+			return kAccess.bWrite && needed[ kAccess.resource ];
+		} );
+		if ( !bKeep )
+		{
+			continue;
+		}
+
+		keptPasses.push_back( pass );
+		for ( const Access& kAccess : kPass.accesses )
+		{
+			needed[ kAccess.resource ] = true;
+		}
+	}
+	std::reverse( keptPasses.begin(), keptPasses.end() );
+	return keptPasses;
+}
+
+void RenderGraph::PlaceResources( RenderGraphHeap heap )
+{
+	std::vector< uint32_t > order;
+	for ( uint32_t resource = 0; resource < m_resources.size(); ++resource )
+	{
+		const Resource& kResource = m_resources[ resource ];
+		if ( !kResource.bImported && kResource.kPlacement.bUsed && kResource.kDesc.heap == heap )
+		{
+			order.push_back( resource );
+		}
+	}
+
+	// Largest first, the small ones fill the gaps. Ties go by first use and index, so the layout never changes
+	// between runs.
+	std::sort( order.begin(), order.end(), [ this ]( uint32_t first, uint32_t second )
+	{
+		const Resource& kFirst = m_resources[ first ];
+		const Resource& kSecond = m_resources[ second ];
+		if ( kFirst.kDesc.sizeBytes != kSecond.kDesc.sizeBytes )
+		{
+			return kFirst.kDesc.sizeBytes > kSecond.kDesc.sizeBytes;
+		}
+		if ( kFirst.kPlacement.firstPass != kSecond.kPlacement.firstPass )
+		{
+			return kFirst.kPlacement.firstPass < kSecond.kPlacement.firstPass;
+		}
+		return first < second;
+	} );
+
+	// Every resource goes to the lowest offset where it does not overlap anything alive at the same time. Only the
+	// start of the heap and the ends of those resources can be that offset.
+	RenderGraphHeapLayout& kLayout = m_heaps[ static_cast< uint32_t >( heap ) ];
+	std::vector< uint32_t > placed;
+	std::vector< uint64_t > candidates;
+	for ( uint32_t resource : order )
+	{
+		Resource& kResource = m_resources[ resource ];
+		RenderGraphPlacement& kPlacement = kResource.kPlacement;
+		kPlacement.sizeBytes = kResource.kDesc.sizeBytes;
+
+		candidates.assign( 1, 0 );
+		for ( uint32_t other : placed )
+		{
+			const RenderGraphPlacement& kOther = m_resources[ other ].kPlacement;
+			if ( LifetimesOverlap( kPlacement, kOther ) )
+			{
+				candidates.push_back( AlignUp( kOther.offset + kOther.sizeBytes, kResource.kDesc.alignment ) );
+			}
+		}
+		std::sort( candidates.begin(), candidates.end() );
+
+		for ( uint64_t offset : candidates )
+		{
+			kPlacement.offset = offset;
+			const bool bFits = std::none_of( placed.begin(), placed.end(), [ this, &kPlacement ]( uint32_t other )
+			{
+				const RenderGraphPlacement& kOther = m_resources[ other ].kPlacement;
+				return LifetimesOverlap( kPlacement, kOther ) && MemoryOverlaps( kPlacement, kOther );
+			} );
+			if ( bFits )
+			{
+				break;
+			}
+		}
+		placed.push_back( resource );
+		kLayout.sizeBytes = std::max( kLayout.sizeBytes, kPlacement.offset + kPlacement.sizeBytes );
+		kLayout.alignment = std::max( kLayout.alignment, kResource.kDesc.alignment );
+	}
+
+	// The aliasing barrier names the resource that had the memory before when there is exactly one, otherwise
+	// any of them could have been active.
+	for ( uint32_t resource : placed )
+	{
+		Resource& kResource = m_resources[ resource ];
+		uint32_t earlierCount = 0;
+		for ( uint32_t other : placed )
+		{
+			const RenderGraphPlacement& kOther = m_resources[ other ].kPlacement;
+			if ( other == resource || !MemoryOverlaps( kResource.kPlacement, kOther ) )
+			{
+				continue;
+			}
+			kResource.kPlacement.bAliased = true;
+			if ( kOther.lastPass < kResource.kPlacement.firstPass )
+			{
+				kResource.aliasedFrom = other;
+				++earlierCount;
+			}
+		}
+		if ( earlierCount != 1 )
+		{
+			kResource.aliasedFrom = uInvalidIndex;
+		}
+	}
+
+	// The lower bound: the most memory alive in any one pass.
+	uint64_t peakBytes = 0;
+	for ( uint32_t resource : placed )
+	{
+		// The peak is always at some resource's first pass.
+		const uint32_t index = m_resources[ resource ].kPlacement.firstPass;
+		uint64_t liveBytes = 0;
+		for ( uint32_t other : placed )
+		{
+			const RenderGraphPlacement& kOther = m_resources[ other ].kPlacement;
+			liveBytes += ( kOther.firstPass <= index && index <= kOther.lastPass ) ? kOther.sizeBytes : 0;
+		}
+		peakBytes = std::max( peakBytes, liveBytes );
+	}
+	m_kStats.peakLiveBytes += peakBytes;
+}
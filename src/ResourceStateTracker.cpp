@@ -0,0 +1,241 @@
+#include "ResourceStateTracker.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+void ResourceStateCache::Register( const void* pResource, uint32_t subresourceCount, uint32_t state )
+{
+	m_states[ pResource ].assign( std::max( subresourceCount, 1u ), state );
+}
+
+void ResourceStateCache::Unregister( const void* pResource )
+{
+	m_states.erase( pResource );
+}
+
+uint32_t ResourceStateCache::GetSubresourceCount( const void* pResource ) const
+{
+	return static_cast< uint32_t >( GetStates( pResource ).size() );
+}
+
+uint32_t ResourceStateCache::GetState( const void* pResource, uint32_t subresource ) const
+{
+	const std::vector< uint32_t >& states = GetStates( pResource );
+	if ( subresource >= states.size() )
+	{
+		throw std::runtime_error( "subresource out of range" );
+	}
+	return states[ subresource ];
+}
+
+const std::vector< uint32_t >& ResourceStateCache::GetStates( const void* pResource ) const
+{
+	const auto it = m_states.find( pResource );
+	if ( it == m_states.end() )
+	{
+		throw std::runtime_error( "resource state is not tracked, register the resource first" );
+	}
+	return it->second;
+}
+
+ResourceStateTracker::ResourceStateTracker( ResourceStateCache& kCache ) :
+	m_kCache( kCache )
+{
+}
+
+void ResourceStateTracker::Begin( bool bKnownStart )
+{
+	m_resources.clear();
+	m_pending.clear();
+	m_bKnownStart = bKnownStart;
+	m_kStats = {};
+}
+
+void ResourceStateTracker::Transition( const void* pResource, uint32_t state, uint32_t subresource )
+{
+	++m_kStats.transitions;
+	TrackedResource& kResource = GetResource( pResource );
+	const uint32_t subresourceCount = static_cast< uint32_t >( kResource.current.size() );
+	if ( subresource != uAllSubresources )
+	{
+		if ( subresource >= subresourceCount )
+		{
+			throw std::runtime_error( "subresource out of range" );
+		}
+		TransitionSubresource( pResource, kResource, subresource, state );
+		return;
+	}
+
+	// One barrier for the whole resource when every subresource makes the same change, the usual case.
+	const uint32_t before = kResource.current[ 0 ];
+	const bool bUniform = before != uUnknownState && before != state &&
+		std::all_of( kResource.current.begin(), kResource.current.end(), [ before ]( uint32_t current ) { return current == before; } );
+	if ( bUniform )
+	{
+		QueueBarrier( pResource, subresourceCount, uAllSubresources, before, state );
+		std::fill( kResource.current.begin(), kResource.current.end(), state );
+		return;
+	}
+
+	const uint32_t elided = m_kStats.elided;
+	for ( uint32_t n = 0; n < subresourceCount; ++n )
+	{
+		TransitionSubresource( pResource, kResource, n, state );
+	}
+	// The whole call counts once.
+	m_kStats.elided = std::min( m_kStats.elided, elided + 1 );
+}
+
+void ResourceStateTracker::FlushBarriers( IBarrierSink& kSink )
+{
+	if ( m_pending.empty() )
+	{
+		return;
+	}
+	kSink.ResourceBarriers( m_pending.data(), static_cast< uint32_t >( m_pending.size() ) );
+	m_kStats.barriers += static_cast< uint32_t >( m_pending.size() );
+	++m_kStats.batches;
+	m_pending.clear();
+}
+
+const std::vector< ResourceBarrierDesc >& ResourceStateTracker::Resolve()
+{
+	if ( !m_pending.empty() )
+	{
+		throw std::runtime_error( "the list was closed with transitions that were never flushed" );
+	}
+
+	m_fixups.clear();
+	for ( auto& kEntry : m_resources )
+	{
+		const void* pResource = kEntry.first;
+		const TrackedResource& kResource = kEntry.second;
+		std::vector< uint32_t >& states = m_kCache.m_states.at( pResource );
+		if ( states.size() != kResource.current.size() )
+		{
+			throw std::runtime_error( "resource was registered again while a list was using it" );
+		}
+
+		const size_t firstFixup = m_fixups.size();
+		for ( uint32_t n = 0; n < states.size(); ++n )
+		{
+			if ( kResource.required[ n ] != uUnknownState && kResource.required[ n ] != states[ n ] )
+			{
+				m_fixups.push_back( { pResource, n, states[ n ], kResource.required[ n ] } );
+			}
+			if ( kResource.current[ n ] != uUnknownState )
+			{
+				states[ n ] = kResource.current[ n ];
+			}
+		}
+
+		// Every subresource making the same change collapses into one barrier.
+		const size_t fixupCount = m_fixups.size() - firstFixup;
+		if ( fixupCount > 0 && fixupCount == states.size() )
+		{
+			const ResourceBarrierDesc kFirst = m_fixups[ firstFixup ];
+			const bool bUniform = std::all_of( m_fixups.begin() + firstFixup, m_fixups.end(), [ &kFirst ]( const ResourceBarrierDesc& kFixup )
+			{
+				return kFixup.before == kFirst.before && kFixup.after == kFirst.after;
+			} );
+			if ( bUniform )
+			{
+				m_fixups.resize( firstFixup );
+				m_fixups.push_back( { pResource, uAllSubresources, kFirst.before, kFirst.after } );
+			}
+		}
+	}
+	m_kStats.fixups = static_cast< uint32_t >( m_fixups.size() );
+	return m_fixups;
+}
+
+ResourceStateTracker::TrackedResource& ResourceStateTracker::GetResource( const void* pResource )
+{
+	auto it = m_resources.find( pResource );
+	if ( it != m_resources.end() )
+	{
+		return it->second;
+	}
+
+	// The cache is only read here, and only changes on the submitting thread while nothing is recorded.
+	const std::vector< uint32_t >& states = m_kCache.GetStates( pResource );
+	TrackedResource& kResource = m_resources[ pResource ];
+	kResource.required.assign( states.size(), uUnknownState );
+	if ( m_bKnownStart )
+	{
+		kResource.current = states;
+	}
+	else
+	{
+		kResource.current.assign( states.size(), uUnknownState );
+	}
+	return kResource;
+}
+
+void ResourceStateTracker::TransitionSubresource( const void* pResource, TrackedResource& kResource, uint32_t subresource, uint32_t state )
+{
+	uint32_t& current = kResource.current[ subresource ];
+	if ( current == uUnknownState )
+	{
+		// First use without a known start, the state is only needed, Resolve puts the barrier in front of the list.
+		kResource.required[ subresource ] = state;
+		current = state;
+	}
+	else if ( current == state )
+	{
+		++m_kStats.elided;
+	}
+	else
+	{
+		QueueBarrier( pResource, static_cast< uint32_t >( kResource.current.size() ), subresource, current, state );
+		current = state;
+	}
+}
+
+void ResourceStateTracker::QueueBarrier( const void* pResource, uint32_t subresourceCount, uint32_t subresource, uint32_t before, uint32_t after )
+{
+	// A whole-resource barrier and one for a single subresource of it can not share a batch, the whole one is
+	// split up instead, so every subresource has at most one barrier waiting.
+	for ( size_t n = 0; n < m_pending.size(); ++n )
+	{
+		const ResourceBarrierDesc kPending = m_pending[ n ];
+		if ( kPending.pResource != pResource || ( kPending.subresource == uAllSubresources ) == ( subresource == uAllSubresources ) )
+		{
+			continue;
+		}
+		if ( kPending.subresource == uAllSubresources )
+		{
+			m_pending.erase( m_pending.begin() + n );
+			for ( uint32_t split = 0; split < subresourceCount; ++split )
+			{
+				m_pending.push_back( { pResource, split, kPending.before, kPending.after } );
+			}
+		}
+		else
+		{
+			for ( uint32_t split = 0; split < subresourceCount; ++split )
+			{
+				QueueBarrier( pResource, subresourceCount, split, before, after );
+			}
+			return;
+		}
+		break;
+	}
+
+	const auto it = std::find_if( m_pending.begin(), m_pending.end(), [ pResource, subresource ]( const ResourceBarrierDesc& kPending )
+	{
+		return kPending.pResource == pResource && kPending.subresource == subresource;
+	} );
+	if ( it == m_pending.end() )
+	{
+		m_pending.push_back( { pResource, subresource, before, after } );
+		return;
+	}
+
+	// Chains A -> B -> C into A -> C, and drops A -> B -> A altogether.
+	++m_kStats.merged;
+	it->after = after;
+	if ( it->before == it->after )
+	{
+		m_pending.erase( it );
+	}
+}
@@ -0,0 +1,98 @@
+#include "RingAllocator.hpp"
+
+RingAllocator::RingAllocator( uint64_t size ) :
+	m_head( 0 ),
+	m_tail( 0 ),
+	m_size( size ),
+	m_usedSize( 0 ),
+	m_currentFrameSize( 0 )
+{
+}
+
+void RingAllocator::Reset( uint64_t size )
+{
+	m_pendingFrames.clear();
+	m_head = 0;
+	m_tail = 0;
+	m_size = size;
+	m_usedSize = 0;
+	m_currentFrameSize = 0;
+}
+
+uint64_t RingAllocator::Allocate( uint64_t size, uint64_t alignment )
+{
+	if ( size == 0 || size > m_size || IsFull() )
+	{
+		return uInvalidOffset;
+	}
+
+	const uint64_t alignedTail = AlignUp( m_tail, alignment );
+
+	if ( m_tail >= m_head )
+	{
+		//     head             tail
+		//     |                |
+		// [   xxxxxxxxxxxxxxxxx.........]
+		if ( alignedTail + size <= m_size )
+		{
+			const uint64_t used = ( alignedTail - m_tail ) + size;
+			m_tail = alignedTail + size;
+			m_usedSize += used;
+			m_currentFrameSize += used;
+			return alignedTail;
+		}
+
+		// Not enough room at the end, wrap around and waste the rest of the buffer.
+		// Offset 0 satisfies every alignment.
+		if ( size <= m_head )
+		{
+			const uint64_t used = ( m_size - m_tail ) + size;
+			m_tail = size;
+			m_usedSize += used;
+			m_currentFrameSize += used;
+			return 0;
+		}
+	}
+	else if ( alignedTail + size <= m_head )
+	{
+		//     tail             head
+		//     |                |
+		// [xxx.................xxxxxxxxx]
+		const uint64_t used = ( alignedTail - m_tail ) + size;
+		m_tail = alignedTail + size;
+		m_usedSize += used;
+		m_currentFrameSize += used;
+		return alignedTail;
+	}
+
+	return uInvalidOffset;
+}
+
+void RingAllocator::FinishFrame( uint64_t fenceValue )
+{
+	if ( m_currentFrameSize == 0 )
+	{
+		return;
+	}
+
+	m_pendingFrames.push_back( { fenceValue, m_tail, m_currentFrameSize } );
+	m_currentFrameSize = 0;
+}
+
+void RingAllocator::ReleaseCompletedFrames( uint64_t completedFenceValue )
+{
+	while ( !m_pendingFrames.empty() && m_pendingFrames.front().fenceValue <= completedFenceValue )
+	{
+		const PendingFrame& kFrame = m_pendingFrames.front();
+		m_head = kFrame.tail;
+		m_usedSize -= kFrame.size;
+		m_pendingFrames.pop_front();
+	}
+
+	// Once everything has retired start over from the beginning, so big allocations don't have to wrap.
+	if ( m_usedSize == 0 )
+	{
+		m_head = 0;
+		m_tail = 0;
+	}
+}
@@ -0,0 +1,353 @@
+#include "ShaderCache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include "Hash.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+	struct ShaderFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t bindingCount;
+		uint32_t stringBytes;		// names of the bindings, right after them.
+		uint64_t key;
+		uint64_t bytecodeOffset;	// from the start of the file, 16-byte aligned.
+		uint64_t bytecodeSize;
+		uint64_t bytecodeHash;
+	};
+	static_assert( sizeof( ShaderFileHeader ) == 48, "ShaderFileHeader is part of the file format" );
+
+	struct ShaderFileBinding
+	{
+		uint32_t nameOffset;		// into the names.
+		uint32_t nameLength;
+		uint32_t type;
+		uint32_t bindPoint;
+		uint32_t bindCount;
+		uint32_t space;
+		uint32_t size;
+		uint32_t reserved;
+	};
+	static_assert( sizeof( ShaderFileBinding ) == 32, "ShaderFileBinding is part of the file format" );
+
+	struct ShaderManifestHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t fileCount;
+		uint32_t reserved;
+		uint64_t descKey;			// the manifest's own name.
+		uint64_t key;				// the .ldsh it compiled to.
+	};
+	static_assert( sizeof( ShaderManifestHeader ) == 32, "ShaderManifestHeader is part of the file format" );
+
+	struct ShaderManifestFile
+	{
+		uint64_t size;
+		uint64_t hash;
+		uint32_t pathLength;		// the path follows right after, UTF-8.
+		uint32_t reserved;
+	};
+	static_assert( sizeof( ShaderManifestFile ) == 24, "ShaderManifestFile is part of the file format" );
+
+	void AddString( Hasher& kHasher, const std::string& text )
+	{
+		kHasher.AddBlob( text.data(), text.size() );
+	}
+
+	uint64_t HashDesc( const ShaderCompileDesc& kDesc, uint64_t compilerVersion )
+	{
+		Hasher kHasher;
+		kHasher.Add( ShaderCache::uVersion );
+		kHasher.Add( compilerVersion );
+		AddString( kHasher, kDesc.sourcePath.lexically_normal().generic_u8string() );
+		AddString( kHasher, kDesc.entryPoint );
+		AddString( kHasher, kDesc.target );
+		kHasher.Add( static_cast< uint64_t >( kDesc.defines.size() ) );
+		for ( const ShaderDefine& kDefine : kDesc.defines )
+		{
+			AddString( kHasher, kDefine.name );
+			AddString( kHasher, kDefine.value );
+		}
+		kHasher.Add( kDesc.flags );
+		return kHasher.GetHash();
+	}
+
+	// The defines are in the source by now, two descriptions that preprocess the same share the bytecode.
+	uint64_t HashPreprocessed( const ShaderCompileDesc& kDesc, const std::string& source, uint64_t compilerVersion )
+	{
+		Hasher kHasher;
+		kHasher.Add( ShaderCache::uVersion );
+		kHasher.Add( compilerVersion );
+		AddString( kHasher, source );
+		AddString( kHasher, kDesc.entryPoint );
+		AddString( kHasher, kDesc.target );
+		kHasher.Add( kDesc.flags );
+		return kHasher.GetHash();
+	}
+
+	template< typename T >
+	void Append( std::vector< uint8_t >& file, const T& kValue )
+	{
+		const uint8_t* p = reinterpret_cast< const uint8_t* >( &kValue );
+		file.insert( file.end(), p, p + sizeof( kValue ) );
+	}
+}
+
+ShaderCache::ShaderCache( std::filesystem::path directory, IShaderCompiler& kCompiler ) :
+	m_directory( std::move( directory ) ),
+	m_kCompiler( kCompiler )
+{
+}
+
+std::shared_ptr< const CompiledShader > ShaderCache::Get( const ShaderCompileDesc& kDesc )
+{
+	const uint64_t compilerVersion = m_kCompiler.GetVersion();
+	const uint64_t descKey = HashDesc( kDesc, compilerVersion );
+	{
+		MappedFile kManifest;
+		uint64_t key = 0;
+		if ( kManifest.Open( GetPath( descKey, ".ldsm" ) ) && !SourcesChanged( kManifest, descKey, key ) )
+		{
+			std::shared_ptr< CompiledShader > spShader = LoadShader( key );
+			if ( spShader )
+			{
+				std::lock_guard< std::mutex > kLock( m_mutex );
+				++m_kStats.hits;
+				return spShader;
+			}
+		}
+	}
+
+	const PreprocessedShader kPreprocessed = m_kCompiler.Preprocess( kDesc );
+	const uint64_t key = HashPreprocessed( kDesc, kPreprocessed.source, compilerVersion );
+	std::shared_ptr< CompiledShader > spShader = LoadShader( key );
+	if ( spShader )
+	{
+		std::lock_guard< std::mutex > kLock( m_mutex );
+		++m_kStats.preprocessedHits;
+	}
+	else
+	{
+		std::vector< uint8_t > bytecode;
+		std::vector< ShaderBinding > bindings;
+		m_kCompiler.Compile( kDesc, kPreprocessed.source, bytecode, bindings );
+		spShader = StoreShader( key, std::move( bytecode ), std::move( bindings ) );
+		std::lock_guard< std::mutex > kLock( m_mutex );
+		++m_kStats.compiles;
+	}
+	StoreManifest( descKey, kPreprocessed.files, key );
+	return spShader;
+}
+
+std::future< std::shared_ptr< const CompiledShader > > ShaderCache::GetAsync( ShaderCompileDesc kDesc, ThreadPool& kPool )
+{
+	return kPool.Submit( [ this, kDesc = std::move( kDesc ) ]() { return Get( kDesc ); } );
+}
+
+ShaderCacheStats ShaderCache::GetStats() const
+{
+	std::lock_guard< std::mutex > kLock( m_mutex );
+	return m_kStats;
+}
+
+uint64_t ShaderCache::HashContents( const void* pData, size_t size )
+{
+	Hasher kHasher;
+	kHasher.AddBlob( pData, size );
+	return kHasher.GetHash();
+}
+
+std::filesystem::path ShaderCache::GetPath( uint64_t key, const char* pExtension ) const
+{
+	char name[ 32 ] = {};
+	snprintf( name, sizeof( name ), "%016llx%s", static_cast< unsigned long long >( key ), pExtension );
+	return m_directory / name;
+}
+
+bool ShaderCache::SourcesChanged( const MappedFile& kManifest, uint64_t descKey, uint64_t& key ) const
+{
+	// A damaged manifest counts as changed sources, the shader is preprocessed and the manifest written again.
+	const uint8_t* pData = kManifest.GetData();
+	const uint64_t size = kManifest.GetSize();
+	ShaderManifestHeader kHeader = {};
+	if ( size < sizeof( kHeader ) )
+	{
+		return true;
+	}
+	memcpy( &kHeader, pData, sizeof( kHeader ) );
+	if ( kHeader.magic != uManifestMagic || kHeader.version != uVersion || kHeader.descKey != descKey || kHeader.fileCount == 0 )
+	{
+		return true;
+	}
+
+	uint64_t offset = sizeof( kHeader );
+	for ( uint32_t n = 0; n < kHeader.fileCount; ++n )
+	{
+		ShaderManifestFile kFile = {};
+		if ( size - offset < sizeof( kFile ) )
+		{
+			return true;
+		}
+		memcpy( &kFile, pData + offset, sizeof( kFile ) );
+		offset += sizeof( kFile );
+		if ( kFile.pathLength > size - offset )
+		{
+			return true;
+		}
+		const std::string path( reinterpret_cast< const char* >( pData + offset ), kFile.pathLength );
+		offset += kFile.pathLength;
+
+		std::ifstream in( std::filesystem::u8path( path ), std::ios::binary );
+		if ( !in )
+		{
+			return true;
+		}
+		const std::vector< char > contents( ( std::istreambuf_iterator< char >( in ) ), std::istreambuf_iterator< char >() );
+		if ( contents.size() != kFile.size || HashContents( contents.data(), contents.size() ) != kFile.hash )
+		{
+			return true;
+		}
+	}
+	if ( offset != size )
+	{
+		return true;
+	}
+	key = kHeader.key;
+	return false;
+}
+
+std::shared_ptr< CompiledShader > ShaderCache::LoadShader( uint64_t key ) const
+{
+	std::shared_ptr< CompiledShader > spShader = std::make_shared< CompiledShader >();
+	MappedFile& kFile = spShader->m_kFile;
+	if ( !kFile.Open( GetPath( key, ".ldsh" ) ) || kFile.GetSize() < sizeof( ShaderFileHeader ) )
+	{
+		return nullptr;
+	}
+
+	// Anything that does not add up is compiled again and overwritten.
+	const uint8_t* pData = kFile.GetData();
+	const uint64_t size = kFile.GetSize();
+	ShaderFileHeader kHeader = {};
+	memcpy( &kHeader, pData, sizeof( kHeader ) );
+	const uint64_t namesOffset = sizeof( kHeader ) + static_cast< uint64_t >( kHeader.bindingCount ) * sizeof( ShaderFileBinding );
+	if ( kHeader.magic != uMagic || kHeader.version != uVersion || kHeader.key != key || kHeader.bytecodeSize == 0 ||
+		 namesOffset + kHeader.stringBytes > kHeader.bytecodeOffset || kHeader.bytecodeOffset % 16 != 0 ||
+		 kHeader.bytecodeOffset > size || kHeader.bytecodeSize > size - kHeader.bytecodeOffset ||
+		 HashContents( pData + kHeader.bytecodeOffset, static_cast< size_t >( kHeader.bytecodeSize ) ) != kHeader.bytecodeHash )
+	{
+		return nullptr;
+	}
+
+	const char* pNames = reinterpret_cast< const char* >( pData + namesOffset );
+	spShader->m_bindings.resize( kHeader.bindingCount );
+	for ( uint32_t n = 0; n < kHeader.bindingCount; ++n )
+	{
+		ShaderFileBinding kBinding = {};
+		memcpy( &kBinding, pData + sizeof( kHeader ) + n * sizeof( kBinding ), sizeof( kBinding ) );
+		if ( kBinding.nameOffset > kHeader.stringBytes || kBinding.nameLength > kHeader.stringBytes - kBinding.nameOffset )
+		{
+			return nullptr;
+		}
+		spShader->m_bindings[ n ] = { std::string( pNames + kBinding.nameOffset, kBinding.nameLength ), kBinding.type,
+									  kBinding.bindPoint, kBinding.bindCount, kBinding.space, kBinding.size };
+	}
+
+	spShader->m_pBytecode = pData + kHeader.bytecodeOffset;
+	spShader->m_bytecodeSize = static_cast< size_t >( kHeader.bytecodeSize );
+	spShader->m_key = key;
+	return spShader;
+}
+
+std::shared_ptr< CompiledShader > ShaderCache::StoreShader( uint64_t key, std::vector< uint8_t > bytecode, std::vector< ShaderBinding > bindings )
+{
+	std::string names;
+	std::vector< uint8_t > file( sizeof( ShaderFileHeader ) );
+	for ( const ShaderBinding& kBinding : bindings )
+	{
+		const ShaderFileBinding kFileBinding = { static_cast< uint32_t >( names.size() ), static_cast< uint32_t >( kBinding.name.size() ), kBinding.type,
+												 kBinding.bindPoint, kBinding.bindCount, kBinding.space, kBinding.size, 0 };
+		Append( file, kFileBinding );
+		names += kBinding.name;
+	}
+	file.insert( file.end(), names.begin(), names.end() );
+	file.resize( ( file.size() + 15 ) & ~static_cast< size_t >( 15 ) );
+
+	ShaderFileHeader kHeader = {};
+	kHeader.magic = uMagic;
+	kHeader.version = uVersion;
+	kHeader.bindingCount = static_cast< uint32_t >( bindings.size() );
+	kHeader.stringBytes = static_cast< uint32_t >( names.size() );
+	kHeader.key = key;
+	kHeader.bytecodeOffset = file.size();
+	kHeader.bytecodeSize = bytecode.size();
+	kHeader.bytecodeHash = HashContents( bytecode.data(), bytecode.size() );
+	memcpy( file.data(), &kHeader, sizeof( kHeader ) );
+	file.insert( file.end(), bytecode.begin(), bytecode.end() );
+
+	// Another thread may have just written the same file, what is there is as good as ours.
+	WriteFile( GetPath( key, ".ldsh" ), file );
+	std::shared_ptr< CompiledShader > spShader = LoadShader( key );
+	if ( spShader )
+	{
+		return spShader;
+	}
+
+	spShader = std::make_shared< CompiledShader >();
+	spShader->m_bytecode = std::move( bytecode );
+	spShader->m_pBytecode = spShader->m_bytecode.data();
+	spShader->m_bytecodeSize = spShader->m_bytecode.size();
+	spShader->m_bindings = std::move( bindings );
+	spShader->m_key = key;
+	std::lock_guard< std::mutex > kLock( m_mutex );
+	++m_kStats.unwritten;
+	return spShader;
+}
+
+void ShaderCache::StoreManifest( uint64_t descKey, const std::vector< ShaderSourceFile >& files, uint64_t key )
+{
+	std::vector< uint8_t > file;
+	Append( file, ShaderManifestHeader{ uManifestMagic, uVersion, static_cast< uint32_t >( files.size() ), 0, descKey, key } );
+	for ( const ShaderSourceFile& kFile : files )
+	{
+		const std::string path = kFile.path.u8string();
+		Append( file, ShaderManifestFile{ kFile.size, kFile.hash, static_cast< uint32_t >( path.size() ), 0 } );
+		file.insert( file.end(), path.begin(), path.end() );
+	}
+	// Without a manifest the next lookup preprocesses again, that is all.
+	WriteFile( GetPath( descKey, ".ldsm" ), file );
+}
+
+bool ShaderCache::WriteFile( const std::filesystem::path& path, const std::vector< uint8_t >& file )
+{
+	std::error_code kError;
+	std::filesystem::create_directories( m_directory, kError );
+
+	// Unique per write, two threads can write the same file at once.
+	std::filesystem::path temporaryPath = path;
+	temporaryPath += "." + std::to_string( m_nextTemporary++ ) + ".tmp";
+	{
+		std::ofstream out( temporaryPath, std::ios::binary | std::ios::trunc );
+		out.write( reinterpret_cast< const char* >( file.data() ), static_cast< std::streamsize >( file.size() ) );
+		if ( !out )
+		{
+			out.close();
+			std::filesystem::remove( temporaryPath, kError );
+			return false;
+		}
+	}
+	// Fails on Windows while the file is mapped, it then already has the same contents.
+	std::filesystem::rename( temporaryPath, path, kError );
+	if ( kError )
+	{
+		std::filesystem::remove( temporaryPath, kError );
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,50 @@
+#include "SoftwareFence.hpp"
+#include <algorithm>
+
+SoftwareFence::SoftwareFence( uint64_t initialValue ) :
+	m_value( initialValue )
+{
+}
+
+void SoftwareFence::Signal( uint64_t value )
+{
+	std::vector< FenceEvent* > toSet;
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		if ( value <= m_value.load() )
+		{
+			return;
+		}
+		m_value.store( value );
+
+		const auto it = std::partition( m_events.begin(), m_events.end(), [ value ]( const std::pair< uint64_t, FenceEvent* >& kEntry ) { return kEntry.first > value; } );
+		for ( auto entry = it; entry != m_events.end(); ++entry )
+		{
+			toSet.push_back( entry->second );
+		}
+		m_events.erase( it, m_events.end() );
+	}
+
+	for ( FenceEvent* pEvent : toSet )
+	{
+		pEvent->Set();
+	}
+}
+
+uint64_t SoftwareFence::GetCompletedValue()
+{
+	return m_value.load();
+}
+
+void SoftwareFence::SetEventOnCompletion( uint64_t value, FenceEvent& kEvent )
+{
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		if ( value > m_value.load() )
+		{
+			m_events.emplace_back( value, &kEvent );
+			return;
+		}
+	}
+	kEvent.Set();
+}
@@ -1,26 +1,293 @@
 #include "Texture.hpp"
 #include "DXSampleHelper.hpp"
+#include "Clock.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cstring>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-Texture2DPtr TextureManager::CreateTexture2D( const std::wstring& filename )
+std::atomic< uint64_t > TextureManager::s_decodedImages( 0 );
+std::atomic< uint64_t > TextureManager::s_decodedBytes( 0 );
+std::atomic< uint64_t > TextureManager::s_decodeNanoseconds( 0 );
+std::atomic< uint64_t > TextureManager::s_mipNanoseconds( 0 );
+std::atomic< uint64_t > TextureManager::s_compressNanoseconds( 0 );
+std::atomic< uint64_t > TextureManager::s_copiedBytes( 0 );
+
+Texture2DPtr TextureManager::CreateTexture2D( const std::wstring& filename, const TextureLoadOptions& kOptions, ThreadPool* pJobs )
 {
 	int width = 0, height = 0, channels = 4;
-	// stbi_set_flip_vertically_on_load( true );
+	// stbi_set_flip_vertically_on_load( true ); NOTE: this is a global flag, it is not safe to change while decodes are running.
 
 	const auto filenameStr = WstrToStr( filename );
 
+	HighResolutionClock kClock;
+	const uint64_t begin = kClock.GetCounter();
+
 	unsigned char* bitmap = stbi_load( filenameStr.c_str(), &width, &height, &channels, STBI_rgb_alpha );
+	if ( !bitmap )
+	{
+		throw std::runtime_error( "Failed to load texture " + filenameStr + ": " + stbi_failure_reason() );
+	}
+
+	const uint64_t elapsed = kClock.GetCounter() - begin;
 
 	Texture2DPtr spTexture = std::make_shared< Texture2D >();
 	spTexture->width = width;
 	spTexture->height = height;
 	spTexture->pixelSize = 4;
 	spTexture->data = bitmap;
+
+	Texture2DMip kTop;
+	kTop.width = spTexture->width;
+	kTop.height = spTexture->height;
+	kTop.rowPitch = spTexture->width * spTexture->pixelSize;
+	kTop.slicePitch = kTop.rowPitch * spTexture->height;
+	kTop.pData = bitmap;
+	spTexture->mips.push_back( kTop );
+
+	uint64_t mipElapsed = 0;
+	if ( kOptions.generateMips )
+	{
+		// Rows of a level are split over the job system, the calling worker takes part so this is fine from inside a job.
+		const uint64_t mipBegin = kClock.GetCounter();
+		const auto levels = MipGenerator::Generate( bitmap, static_cast< uint32_t >( width ), static_cast< uint32_t >( height ), kTop.rowPitch, kOptions.mipOptions, spTexture->mipChain, pJobs );
+		for ( const MipLevel& kLevel : levels )
+		{
+			Texture2DMip kMip;
+			kMip.width = kLevel.width;
+			kMip.height = kLevel.height;
+			kMip.rowPitch = kLevel.rowPitch;
+			kMip.slicePitch = kLevel.rowPitch * kLevel.height;
+			kMip.pData = spTexture->mipChain.data() + kLevel.offset;
+			spTexture->mips.push_back( kMip );
+		}
+		mipElapsed = kClock.GetCounter() - mipBegin;
+	}
+
+	uint64_t compressElapsed = 0;
+	if ( kOptions.compress && width % 4 == 0 && height % 4 == 0 )
+	{
+		const uint64_t compressBegin = kClock.GetCounter();
+		const BlockFormat format = kOptions.compressOptions.format;
+
+		size_t totalSize = 0;
+		for ( const Texture2DMip& kMip : spTexture->mips )
+		{
+			totalSize += BlockCompressor::GetCompressedSize( format, static_cast< uint32_t >( kMip.width ), static_cast< uint32_t >( kMip.height ) );
+		}
+		spTexture->compressedData.resize( totalSize );
+
+		size_t offset = 0;
+		for ( Texture2DMip& kMip : spTexture->mips )
+		{
+			const uint32_t mipWidth = static_cast< uint32_t >( kMip.width );
+			const uint32_t mipHeight = static_cast< uint32_t >( kMip.height );
+			uint8_t* pBlocks = spTexture->compressedData.data() + offset;
+			const size_t blockRowPitch = BlockCompressor::GetRowPitch( format, mipWidth );
+			BlockCompressor::Compress( kMip.pData, mipWidth, mipHeight, kMip.rowPitch, kOptions.compressOptions, pBlocks, blockRowPitch, pJobs );
+
+			kMip.rowPitch = blockRowPitch;
+			kMip.slicePitch = BlockCompressor::GetCompressedSize( format, mipWidth, mipHeight );
+			kMip.pData = pBlocks;
+			offset += kMip.slicePitch;
+		}
+
+		spTexture->compressed = true;
+		spTexture->blockFormat = format;
+
+		// The uncompressed levels below the top are not needed any more.
+		std::vector< uint8_t >().swap( spTexture->mipChain );
+		compressElapsed = kClock.GetCounter() - compressBegin;
+	}
+
+	s_decodedImages.fetch_add( 1, std::memory_order_relaxed );
+	s_decodedBytes.fetch_add( spTexture->width * spTexture->height * spTexture->pixelSize, std::memory_order_relaxed );
+	s_decodeNanoseconds.fetch_add( elapsed * 1000000000ull / kClock.GetFrequency(), std::memory_order_relaxed );
+	s_mipNanoseconds.fetch_add( mipElapsed * 1000000000ull / kClock.GetFrequency(), std::memory_order_relaxed );
+	s_compressNanoseconds.fetch_add( compressElapsed * 1000000000ull / kClock.GetFrequency(), std::memory_order_relaxed );
 	return spTexture;
 }
 
+std::future< Texture2DPtr > TextureManager::CreateTexture2DAsync( const std::wstring& filename, ThreadPool& kJobs, const TextureLoadOptions& kOptions )
+{
+	return kJobs.Submit( [ filename, kOptions, pJobs = &kJobs ]() { return CreateTexture2D( filename, kOptions, pJobs ); } );
+}
+
+std::vector< Texture2DPtr > TextureManager::CreateTextures2D( const std::vector< std::wstring >& filenames, ThreadPool& kJobs, const TextureLoadOptions& kOptions )
+{
+	std::vector< std::future< Texture2DPtr > > pending;
+	pending.reserve( filenames.size() );
+	for ( const auto& filename : filenames )
+	{
+		pending.push_back( CreateTexture2DAsync( filename, kJobs, kOptions ) );
+	}
+
+	std::vector< Texture2DPtr > textures;
+	textures.reserve( pending.size() );
+	for ( auto& future : pending )
+	{
+		textures.push_back( future.get() );
+	}
+	return textures;
+}
+
+Texture2DInfo TextureManager::GetTexture2DInfo( const std::wstring& filename, const TextureLoadOptions& kOptions )
+{
+	const auto filenameStr = WstrToStr( filename );
+	int width = 0, height = 0, channels = 0;
+	if ( !stbi_info( filenameStr.c_str(), &width, &height, &channels ) )
+	{
+		throw std::runtime_error( "Failed to load texture " + filenameStr + ": " + stbi_failure_reason() );
+	}
+
+	// The same decisions CreateTexture2D makes after decoding.
+	Texture2DInfo kInfo;
+	kInfo.width = static_cast< uint32_t >( width );
+	kInfo.height = static_cast< uint32_t >( height );
+	kInfo.mipCount = kOptions.generateMips ? MipGenerator::CountMipLevels( kInfo.width, kInfo.height ) : 1;
+	kInfo.compressed = kOptions.compress && width % 4 == 0 && height % 4 == 0;
+	kInfo.blockFormat = kOptions.compressOptions.format;
+	return kInfo;
+}
+
+void TextureManager::DecodeTexture2DInto( const std::wstring& filename, const Texture2DInfo& kInfo, const std::vector< Texture2DDestination >& destinations,
+										  const TextureLoadOptions& kOptions, ThreadPool* pJobs )
+{
+	const auto filenameStr = WstrToStr( filename );
+	if ( destinations.size() != kInfo.mipCount )
+	{
+		throw std::runtime_error( "Texture " + filenameStr + " needs one destination per mip level" );
+	}
+
+	HighResolutionClock kClock;
+	const uint64_t begin = kClock.GetCounter();
+
+	int width = 0, height = 0, channels = 4;
+	std::unique_ptr< stbi_uc, void ( * )( void* ) > spBitmap( stbi_load( filenameStr.c_str(), &width, &height, &channels, STBI_rgb_alpha ), stbi_image_free );
+	if ( !spBitmap )
+	{
+		throw std::runtime_error( "Failed to load texture " + filenameStr + ": " + stbi_failure_reason() );
+	}
+	if ( static_cast< uint32_t >( width ) != kInfo.width || static_cast< uint32_t >( height ) != kInfo.height )
+	{
+		throw std::runtime_error( "Texture " + filenameStr + " changed since its header was read" );
+	}
+
+	const uint64_t elapsed = kClock.GetCounter() - begin;
+	const size_t rowPitch = static_cast< size_t >( width ) * 4;
+	uint64_t mipElapsed = 0;
+	uint64_t compressElapsed = 0;
+	uint64_t copiedBytes = 0;
+
+	if ( kInfo.compressed )
+	{
+		// Every level is compressed as soon as it exists, only the one the next is filtered from stays around.
+		std::vector< uint8_t > scratch[ 2 ];
+		const uint8_t* pLevel = spBitmap.get();
+		uint32_t levelWidth = kInfo.width;
+		uint32_t levelHeight = kInfo.height;
+		size_t levelRowPitch = rowPitch;
+		for ( uint32_t n = 0; n < kInfo.mipCount; ++n )
+		{
+			if ( n > 0 )
+			{
+				const uint32_t sourceWidth = levelWidth;
+				const uint32_t sourceHeight = levelHeight;
+				const size_t sourceRowPitch = levelRowPitch;
+				levelWidth = std::max( 1u, levelWidth / 2 );
+				levelHeight = std::max( 1u, levelHeight / 2 );
+				levelRowPitch = static_cast< size_t >( levelWidth ) * 4;
+
+				const uint64_t mipBegin = kClock.GetCounter();
+				scratch[ n % 2 ].resize( levelRowPitch * levelHeight );
+				MipGenerator::Downsample( pLevel, sourceWidth, sourceHeight, sourceRowPitch, scratch[ n % 2 ].data(), levelWidth, levelHeight, levelRowPitch, kOptions.mipOptions, pJobs );
+				pLevel = scratch[ n % 2 ].data();
+				mipElapsed += kClock.GetCounter() - mipBegin;
+				if ( n == 1 )
+				{
+					spBitmap.reset();
+				}
+			}
+
+			const uint64_t compressBegin = kClock.GetCounter();
+			BlockCompressor::Compress( pLevel, levelWidth, levelHeight, levelRowPitch, kOptions.compressOptions, destinations[ n ].pData, destinations[ n ].rowPitch, pJobs );
+			compressElapsed += kClock.GetCounter() - compressBegin;
+		}
+	}
+	else
+	{
+		// stb_image has no pitched output, the top level is the one copy this path makes.
+		for ( uint32_t y = 0; y < kInfo.height; ++y )
+		{
+			memcpy( destinations[ 0 ].pData + y * destinations[ 0 ].rowPitch, spBitmap.get() + y * rowPitch, rowPitch );
+		}
+		copiedBytes += rowPitch * kInfo.height;
+
+		if ( kInfo.mipCount > 1 )
+		{
+			const uint64_t mipBegin = kClock.GetCounter();
+			std::vector< MipDestination > levels( kInfo.mipCount - 1 );
+			for ( uint32_t n = 1; n < kInfo.mipCount; ++n )
+			{
+				levels[ n - 1 ].pData = destinations[ n ].pData;
+				levels[ n - 1 ].rowPitch = destinations[ n ].rowPitch;
+			}
+			MipGenerator::GenerateInto( spBitmap.get(), kInfo.width, kInfo.height, rowPitch, kOptions.mipOptions, levels.data(), kInfo.mipCount, pJobs );
+			mipElapsed = kClock.GetCounter() - mipBegin;
+
+			// Every level but the last is copied over from where the next one is filtered from.
+			uint32_t levelWidth = kInfo.width;
+			uint32_t levelHeight = kInfo.height;
+			for ( uint32_t n = 1; n + 1 < kInfo.mipCount; ++n )
+			{
+				levelWidth = std::max( 1u, levelWidth / 2 );
+				levelHeight = std::max( 1u, levelHeight / 2 );
+				copiedBytes += static_cast< uint64_t >( levelWidth ) * levelHeight * 4;
+			}
+		}
+	}
+
+	s_decodedImages.fetch_add( 1, std::memory_order_relaxed );
+	s_decodedBytes.fetch_add( rowPitch * kInfo.height, std::memory_order_relaxed );
+	s_decodeNanoseconds.fetch_add( elapsed * 1000000000ull / kClock.GetFrequency(), std::memory_order_relaxed );
+	s_mipNanoseconds.fetch_add( mipElapsed * 1000000000ull / kClock.GetFrequency(), std::memory_order_relaxed );
+	s_compressNanoseconds.fetch_add( compressElapsed * 1000000000ull / kClock.GetFrequency(), std::memory_order_relaxed );
+	s_copiedBytes.fetch_add( copiedBytes, std::memory_order_relaxed );
+}
+
+std::future< void > TextureManager::DecodeTexture2DIntoAsync( const std::wstring& filename, const Texture2DInfo& kInfo, std::vector< Texture2DDestination > destinations,
+															  ThreadPool& kJobs, const TextureLoadOptions& kOptions )
+{
+	return kJobs.Submit( [ filename, kInfo, destinations = std::move( destinations ), kOptions, pJobs = &kJobs ]()
+	{
+		DecodeTexture2DInto( filename, kInfo, destinations, kOptions, pJobs );
+	} );
+}
+
+TextureDecodeStats TextureManager::GetDecodeStats()
+{
+	TextureDecodeStats kStats;
+	kStats.imageCount = s_decodedImages.load( std::memory_order_relaxed );
+	kStats.decodedBytes = s_decodedBytes.load( std::memory_order_relaxed );
+	kStats.decodeSeconds = static_cast< double >( s_decodeNanoseconds.load( std::memory_order_relaxed ) ) / 1000000000.0;
+	kStats.mipSeconds = static_cast< double >( s_mipNanoseconds.load( std::memory_order_relaxed ) ) / 1000000000.0;
+	kStats.compressSeconds = static_cast< double >( s_compressNanoseconds.load( std::memory_order_relaxed ) ) / 1000000000.0;
+	kStats.copiedBytes = s_copiedBytes.load( std::memory_order_relaxed );
+	return kStats;
+}
+
+void TextureManager::ResetDecodeStats()
+{
+	s_decodedImages.store( 0, std::memory_order_relaxed );
+	s_decodedBytes.store( 0, std::memory_order_relaxed );
+	s_decodeNanoseconds.store( 0, std::memory_order_relaxed );
+	s_mipNanoseconds.store( 0, std::memory_order_relaxed );
+	s_compressNanoseconds.store( 0, std::memory_order_relaxed );
+	s_copiedBytes.store( 0, std::memory_order_relaxed );
+}
+
 Texture2D::Texture2D() : 
 	width( 0 ), 
 	height( 0 ), 
@@ -0,0 +1,148 @@
+#include "TextureContainer.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	inline uint64_t AlignUp( uint64_t value, uint64_t alignment )
+	{
+		return ( value + alignment - 1 ) & ~( alignment - 1 );
+	}
+}
+
+uint32_t TextureContainer::GetBytesPerUnit( TextureFileFormat format )
+{
+	switch ( format )
+	{
+		case TextureFileFormat::RGBA8: return 4;
+		case TextureFileFormat::BC1: return 8;
+		case TextureFileFormat::BC3: return 16;
+		case TextureFileFormat::BC5: return 16;
+		case TextureFileFormat::BC7: return 16;
+	}
+	throw std::runtime_error( "Unknown texture file format" );
+}
+
+void TextureContainer::Write( const std::filesystem::path& path, TextureFileFormat format, uint32_t mipCount, uint32_t arraySize,
+							  const std::vector< TextureFileLevel >& levels )
+{
+	if ( levels.empty() || levels.size() != static_cast< size_t >( mipCount ) * arraySize )
+	{
+		throw std::runtime_error( "Texture file needs mipCount * arraySize levels" );
+	}
+
+	const bool bBlocks = IsBlockCompressed( format );
+	const uint32_t bytesPerUnit = GetBytesPerUnit( format );
+
+	std::vector< TextureFileSubresource > table( levels.size() );
+	uint64_t payloadSize = 0;
+	for ( size_t n = 0; n < levels.size(); ++n )
+	{
+		TextureFileSubresource& kEntry = table[ n ];
+		kEntry = {};
+		kEntry.width = levels[ n ].width;
+		kEntry.height = levels[ n ].height;
+		kEntry.rowCount = bBlocks ? ( kEntry.height + 3 ) / 4 : kEntry.height;
+		kEntry.rowBytes = ( bBlocks ? ( kEntry.width + 3 ) / 4 : kEntry.width ) * bytesPerUnit;
+		kEntry.rowPitch = static_cast< uint32_t >( AlignUp( kEntry.rowBytes, uRowPitchAlignment ) );
+		kEntry.offset = AlignUp( payloadSize, uPlacementAlignment );
+		kEntry.size = static_cast< uint64_t >( kEntry.rowPitch ) * kEntry.rowCount;
+		payloadSize = kEntry.offset + kEntry.size;
+	}
+
+	TextureFileHeader kHeader = {};
+	kHeader.magic = uMagic;
+	kHeader.version = uVersion;
+	kHeader.format = format;
+	kHeader.width = levels[ 0 ].width;
+	kHeader.height = levels[ 0 ].height;
+	kHeader.mipCount = mipCount;
+	kHeader.arraySize = arraySize;
+	kHeader.payloadOffset = AlignUp( sizeof( TextureFileHeader ) + sizeof( TextureFileSubresource ) * table.size(), uPlacementAlignment );
+	kHeader.payloadSize = payloadSize;
+
+	// Build the whole file in memory, the padding between rows has to be written anyway.
+	std::vector< uint8_t > file( static_cast< size_t >( kHeader.payloadOffset + payloadSize ), 0 );
+	memcpy( file.data(), &kHeader, sizeof( kHeader ) );
+	memcpy( file.data() + sizeof( kHeader ), table.data(), sizeof( TextureFileSubresource ) * table.size() );
+	for ( size_t n = 0; n < levels.size(); ++n )
+	{
+		const TextureFileSubresource& kEntry = table[ n ];
+		uint8_t* pDestination = file.data() + kHeader.payloadOffset + kEntry.offset;
+		for ( uint32_t row = 0; row < kEntry.rowCount; ++row )
+		{
+			memcpy( pDestination + static_cast< size_t >( row ) * kEntry.rowPitch, levels[ n ].pData + row * levels[ n ].rowPitch, kEntry.rowBytes );
+		}
+	}
+
+	std::ofstream out( path, std::ios::binary | std::ios::trunc );
+	if ( !out )
+	{
+		throw std::runtime_error( "Failed to create " + path.string() );
+	}
+	out.write( reinterpret_cast< const char* >( file.data() ), static_cast< std::streamsize >( file.size() ) );
+	if ( !out )
+	{
+		throw std::runtime_error( "Failed to write " + path.string() );
+	}
+}
+
+bool MappedTextureFile::Open( const std::filesystem::path& path )
+{
+	if ( !m_kFile.Open( path ) )
+	{
+		return false;
+	}
+
+	try
+	{
+		Validate();
+	}
+	catch ( ... )
+	{
+		Close();
+		throw;
+	}
+	return true;
+}
+
+const TextureFileSubresource& MappedTextureFile::GetSubresource( uint32_t index ) const
+{
+	return reinterpret_cast< const TextureFileSubresource* >( m_kFile.GetData() + sizeof( TextureFileHeader ) )[ index ];
+}
+
+void MappedTextureFile::Validate() const
+{
+	if ( m_kFile.GetSize() < sizeof( TextureFileHeader ) )
+	{
+		throw std::runtime_error( "Texture file is truncated" );
+	}
+
+	const TextureFileHeader& kHeader = GetHeader();
+	if ( kHeader.magic != TextureContainer::uMagic || kHeader.version != TextureContainer::uVersion )
+	{
+		throw std::runtime_error( "Not a texture file, or an unsupported version" );
+	}
+	TextureContainer::GetBytesPerUnit( kHeader.format );
+
+	const uint64_t subresourceCount = static_cast< uint64_t >( kHeader.mipCount ) * kHeader.arraySize;
+	const uint64_t tableEnd = sizeof( TextureFileHeader ) + sizeof( TextureFileSubresource ) * subresourceCount;
+	if ( subresourceCount == 0 || tableEnd > kHeader.payloadOffset || kHeader.payloadOffset % TextureContainer::uPlacementAlignment != 0 ||
+		 kHeader.payloadOffset > m_kFile.GetSize() || kHeader.payloadSize > m_kFile.GetSize() - kHeader.payloadOffset )
+	{
+		throw std::runtime_error( "Texture file header is corrupt" );
+	}
+
+	for ( uint32_t n = 0; n < subresourceCount; ++n )
+	{
+		const TextureFileSubresource& kEntry = GetSubresource( n );
+		if ( kEntry.offset % TextureContainer::uPlacementAlignment != 0 || kEntry.rowPitch % TextureContainer::uRowPitchAlignment != 0 ||
+			 kEntry.rowBytes > kEntry.rowPitch || kEntry.size != static_cast< uint64_t >( kEntry.rowPitch ) * kEntry.rowCount ||
+			 kEntry.offset > kHeader.payloadSize || kEntry.size > kHeader.payloadSize - kEntry.offset )
+		{
+			throw std::runtime_error( "Texture file subresource " + std::to_string( n ) + " is corrupt" );
+		}
+	}
+}
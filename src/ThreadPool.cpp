@@ -0,0 +1,428 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+struct PoolJob
+{
+	std::function< void() > task;
+	JobCounter* pCounter;
+	ThreadPool* pPool;
+};
+
+// Chase-Lev deque ( Le, Pop, Cohen, Zappa Nardelli 2013 ) on a fixed ring, Push returns false once it is full.
+struct ThreadPool::WorkQueue
+{
+	static constexpr int64_t uCapacity = 4096;
+
+	// Owner only.
+	bool Push( PoolJob* pJob )
+	{
+		const int64_t bottom = m_bottom.load( std::memory_order_relaxed );
+		const int64_t top = m_top.load( std::memory_order_acquire );
+		if ( bottom - top >= uCapacity )
+		{
+			return false;
+		}
+		m_jobs[ bottom & ( uCapacity - 1 ) ].store( pJob, std::memory_order_relaxed );
+		m_bottom.store( bottom + 1, std::memory_order_release );
+		return true;
+	}
+
+	// Owner only, newest job first.
+	PoolJob* Pop()
+	{
+		const int64_t bottom = m_bottom.load( std::memory_order_relaxed ) - 1;
+		m_bottom.store( bottom, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		int64_t top = m_top.load( std::memory_order_relaxed );
+
+		PoolJob* pJob = nullptr;
+		if ( top <= bottom )
+		{
+			pJob = m_jobs[ bottom & ( uCapacity - 1 ) ].load( std::memory_order_relaxed );
+			if ( top == bottom )
+			{
+				// Last job, race the thieves for it.
+				if ( !m_top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+				{
+					pJob = nullptr;
+				}
+				m_bottom.store( bottom + 1, std::memory_order_relaxed );
+			}
+		}
+		else
+		{
+			m_bottom.store( bottom + 1, std::memory_order_relaxed );
+		}
+		return pJob;
+	}
+
+	// Any thread, oldest job first. Also returns nullptr when it lost a race, the caller just moves on.
+	PoolJob* Steal()
+	{
+		int64_t top = m_top.load( std::memory_order_acquire );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		const int64_t bottom = m_bottom.load( std::memory_order_acquire );
+		if ( top >= bottom )
+		{
+			return nullptr;
+		}
+
+		PoolJob* pJob = m_jobs[ top & ( uCapacity - 1 ) ].load( std::memory_order_relaxed );
+		if ( !m_top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+		{
+			return nullptr;
+		}
+		return pJob;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_top.load( std::memory_order_acquire ) >= m_bottom.load( std::memory_order_acquire );
+	}
+
+	// Thieves and the owner work on opposite ends, keep the two counters on separate cache lines.
+	alignas( 64 ) std::atomic< int64_t > m_top{ 0 };
+	alignas( 64 ) std::atomic< int64_t > m_bottom{ 0 };
+	alignas( 64 ) std::atomic< PoolJob* > m_jobs[ uCapacity ];
+};
+
+namespace
+{
+	// Which pool and queue the current thread works for, only set on worker threads.
+	thread_local const ThreadPool* s_pWorkerPool = nullptr;
+	thread_local uint32_t s_workerQueueIndex = 0;
+}
+
+ThreadPool::ThreadPool( uint32_t threadCount ) :
+	m_ownerThread( std::this_thread::get_id() ),
+	m_bStopping( false )
+{
+	if ( threadCount == 0 )
+	{
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if ( threadCount == 0 )
+	{
+		threadCount = 1;
+	}
+
+	m_queues.reserve( threadCount + 1 );
+	for ( uint32_t n = 0; n <= threadCount; ++n )
+	{
+		m_queues.push_back( std::make_unique< WorkQueue >() );
+	}
+
+	m_workers.reserve( threadCount );
+	for ( uint32_t n = 0; n < threadCount; ++n )
+	{
+		m_workers.emplace_back( &ThreadPool::WorkerLoop, this, n + 1 );
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_bStopping = true;
+	}
+	m_condition.notify_all();
+
+	// Workers drain whatever is still queued before they exit.
+	for ( auto& worker : m_workers )
+	{
+		worker.join();
+	}
+}
+
+ThreadPool::WorkQueue* ThreadPool::GetLocalQueue() const
+{
+	if ( s_pWorkerPool == this )
+	{
+		return m_queues[ s_workerQueueIndex ].get();
+	}
+	if ( std::this_thread::get_id() == m_ownerThread )
+	{
+		return m_queues[ 0 ].get();
+	}
+	return nullptr;
+}
+
+void ThreadPool::Run( std::function< void() > task, JobCounter* pCounter, JobCounter* pDependency )
+{
+	PoolJob* pJob = new PoolJob{ std::move( task ), pCounter, this };
+	if ( pCounter )
+	{
+		pCounter->m_pending.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	if ( pDependency )
+	{
+		// The last decrement happens under this lock, so the job is either parked here or the dependency is done.
+		std::lock_guard< std::mutex > lock( pDependency->m_mutex );
+		if ( pDependency->m_pending.load( std::memory_order_acquire ) != 0 )
+		{
+			pDependency->m_waiting.push_back( pJob );
+			return;
+		}
+	}
+	Push( pJob );
+}
+
+void ThreadPool::Push( PoolJob* pJob )
+{
+	WorkQueue* pLocal = GetLocalQueue();
+	if ( pLocal && pLocal->Push( pJob ) )
+	{
+		// Pairs with the fence in WorkerLoop: either we see the sleeper or it sees the job.
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if ( m_sleeping.load( std::memory_order_relaxed ) > 0 )
+		{
+			std::lock_guard< std::mutex > lock( m_mutex );
+			m_condition.notify_one();
+		}
+		return;
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_injected.push_back( pJob );
+		m_injectedCount.fetch_add( 1, std::memory_order_relaxed );
+	}
+	m_condition.notify_one();
+}
+
+PoolJob* ThreadPool::FindJob( WorkQueue* pLocal, uint32_t& victim )
+{
+	if ( pLocal )
+	{
+		if ( PoolJob* pJob = pLocal->Pop() )
+		{
+			return pJob;
+		}
+	}
+
+	if ( m_injectedCount.load( std::memory_order_relaxed ) > 0 )
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		if ( !m_injected.empty() )
+		{
+			PoolJob* pJob = m_injected.front();
+			m_injected.pop_front();
+			m_injectedCount.fetch_sub( 1, std::memory_order_relaxed );
+			return pJob;
+		}
+	}
+
+	// Go round the other queues, starting after the one we last stole from.
+	const uint32_t queueCount = static_cast< uint32_t >( m_queues.size() );
+	for ( uint32_t n = 0; n < queueCount; ++n )
+	{
+		victim = ( victim + 1 ) % queueCount;
+		WorkQueue* pVictim = m_queues[ victim ].get();
+		if ( pVictim == pLocal )
+		{
+			continue;
+		}
+		if ( PoolJob* pJob = pVictim->Steal() )
+		{
+			return pJob;
+		}
+	}
+	return nullptr;
+}
+
+bool ThreadPool::HasWork() const
+{
+	if ( m_injectedCount.load( std::memory_order_relaxed ) > 0 )
+	{
+		return true;
+	}
+	for ( const auto& spQueue : m_queues )
+	{
+		if ( !spQueue->IsEmpty() )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::Execute( PoolJob* pJob )
+{
+	JobCounter* pCounter = pJob->pCounter;
+	try
+	{
+		pJob->task();
+	}
+	catch ( ... )
+	{
+		if ( !pCounter )
+		{
+			throw;
+		}
+		std::lock_guard< std::mutex > lock( pCounter->m_mutex );
+		if ( !pCounter->m_exception )
+		{
+			pCounter->m_exception = std::current_exception();
+		}
+	}
+	delete pJob;
+
+	if ( pCounter )
+	{
+		Finish( *pCounter );
+	}
+}
+
+void ThreadPool::Finish( JobCounter& kCounter )
+{
+	// Anything but the last job only needs the atomic.
+	uint32_t pending = kCounter.m_pending.load( std::memory_order_relaxed );
+	while ( pending > 1 )
+	{
+		if ( kCounter.m_pending.compare_exchange_weak( pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed ) )
+		{
+			return;
+		}
+	}
+
+	// Maybe the last one: release the dependent jobs under the lock, Wait takes it too before it lets the counter go.
+	std::vector< PoolJob* > ready;
+	{
+		std::lock_guard< std::mutex > lock( kCounter.m_mutex );
+		if ( kCounter.m_pending.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+		{
+			ready.swap( kCounter.m_waiting );
+		}
+	}
+	for ( PoolJob* pJob : ready )
+	{
+		pJob->pPool->Push( pJob );
+	}
+}
+
+void ThreadPool::Wait( JobCounter& kCounter )
+{
+	WorkQueue* pLocal = GetLocalQueue();
+	uint32_t victim = 0;
+	while ( !kCounter.IsDone() )
+	{
+		if ( PoolJob* pJob = FindJob( pLocal, victim ) )
+		{
+			Execute( pJob );
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	std::exception_ptr exception;
+	{
+		std::lock_guard< std::mutex > lock( kCounter.m_mutex );
+		exception.swap( kCounter.m_exception );
+	}
+	if ( exception )
+	{
+		std::rethrow_exception( exception );
+	}
+}
+
+void ThreadPool::ParallelFor( uint32_t count, uint32_t grainSize, const std::function< void( uint32_t, uint32_t ) >& body )
+{
+	if ( count == 0 )
+	{
+		return;
+	}
+	if ( grainSize == 0 )
+	{
+		grainSize = 1;
+	}
+
+	// Helpers and the caller keep claiming chunks until none are left. Everything lives on this stack frame,
+	// Wait only returns after the last helper has finished.
+	std::atomic< uint32_t > next{ 0 };
+	std::mutex errorMutex;
+	std::exception_ptr error;
+	auto RunChunks = [ & ]()
+	{
+		for ( ;; )
+		{
+			const uint32_t begin = next.fetch_add( grainSize );
+			if ( begin >= count )
+			{
+				return;
+			}
+
+			const uint32_t end = std::min( begin + grainSize, count );
+			try
+			{
+				body( begin, end );
+			}
+			catch ( ... )
+			{
+				std::lock_guard< std::mutex > lock( errorMutex );
+				if ( !error )
+				{
+					error = std::current_exception();
+				}
+			}
+		}
+	};
+
+	const uint32_t chunkCount = ( count - 1 ) / grainSize + 1;
+	const uint32_t helperCount = std::min( GetThreadCount(), chunkCount - 1 );
+	JobCounter kCounter;
+	for ( uint32_t n = 0; n < helperCount; ++n )
+	{
+		Run( RunChunks, &kCounter );
+	}
+
+	RunChunks();
+	Wait( kCounter );
+	if ( error )
+	{
+		std::rethrow_exception( error );
+	}
+}
+
+void ThreadPool::WorkerLoop( uint32_t queueIndex )
+{
+	WorkQueue* pLocal = m_queues[ queueIndex ].get();
+	s_pWorkerPool = this;
+	s_workerQueueIndex = queueIndex;
+
+	uint32_t victim = queueIndex;
+	uint32_t idleRounds = 0;
+	for ( ;; )
+	{
+		if ( PoolJob* pJob = FindJob( pLocal, victim ) )
+		{
+			Execute( pJob );
+			idleRounds = 0;
+			continue;
+		}
+
+		// Jobs often come in bursts, look around a few more times before going to sleep.
+		if ( ++idleRounds < 64 )
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		idleRounds = 0;
+
+		std::unique_lock< std::mutex > lock( m_mutex );
+		m_sleeping.fetch_add( 1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if ( !HasWork() )
+		{
+			if ( m_bStopping )
+			{
+				m_sleeping.fetch_sub( 1, std::memory_order_relaxed );
+				return;
+			}
+			m_condition.wait( lock );
+		}
+		m_sleeping.fetch_sub( 1, std::memory_order_relaxed );
+	}
+}
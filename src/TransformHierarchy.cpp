@@ -0,0 +1,253 @@
+#include "TransformHierarchy.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+using namespace DirectX;
+
+void TransformHierarchy::Clear()
+{
+	m_translation.clear();
+	m_rotation.clear();
+	m_scale.clear();
+	m_parentSlot.clear();
+	m_nodeOfSlot.clear();
+	m_dirty.clear();
+	m_world.clear();
+	m_slotOfNode.clear();
+	m_depth.clear();
+	m_levelBegin.assign( 1, 0 );
+	m_levelDirty.clear();
+	m_bSorted = true;
+}
+
+void TransformHierarchy::Reserve( uint32_t count )
+{
+	m_translation.reserve( count );
+	m_rotation.reserve( count );
+	m_scale.reserve( count );
+	m_parentSlot.reserve( count );
+	m_nodeOfSlot.reserve( count );
+	m_dirty.reserve( count );
+	m_world.reserve( count );
+	m_slotOfNode.reserve( count );
+	m_depth.reserve( count );
+}
+
+uint32_t TransformHierarchy::AddNode( uint32_t parent, const XMFLOAT3& kTranslation, const XMFLOAT4& kRotation, const XMFLOAT3& kScale )
+{
+	const uint32_t node = GetNodeCount();
+	if ( parent != uInvalidNode && parent >= node )
+	{
+		throw std::runtime_error( "Transform parent has to be added before its children." );
+	}
+
+	const uint32_t depth = ( parent == uInvalidNode ) ? 0 : m_depth[ parent ] + 1;
+	const uint32_t slot = node;
+	m_translation.push_back( kTranslation );
+	m_rotation.push_back( kRotation );
+	m_scale.push_back( kScale );
+	m_parentSlot.push_back( ( parent == uInvalidNode ) ? uInvalidNode : m_slotOfNode[ parent ] );
+	m_nodeOfSlot.push_back( node );
+	m_dirty.push_back( 1 );
+	m_world.emplace_back();
+	m_slotOfNode.push_back( slot );
+	m_depth.push_back( depth );
+
+	// Appending stays sorted as long as the node goes on the deepest level or starts a new one,
+	// anything else is sorted once in the next Update.
+	const uint32_t depthCount = GetDepthCount();
+	if ( m_bSorted && depth == depthCount )
+	{
+		m_levelBegin.push_back( slot + 1 );
+		m_levelDirty.push_back( 1 );
+	}
+	else if ( m_bSorted && depth + 1 == depthCount )
+	{
+		m_levelBegin.back() = slot + 1;
+		m_levelDirty.back() = 1;
+	}
+	else
+	{
+		m_bSorted = false;
+	}
+	return node;
+}
+
+uint32_t TransformHierarchy::AddNode( uint32_t parent )
+{
+	return AddNode( parent, XMFLOAT3( 0.0f, 0.0f, 0.0f ), XMFLOAT4( 0.0f, 0.0f, 0.0f, 1.0f ), XMFLOAT3( 1.0f, 1.0f, 1.0f ) );
+}
+
+void TransformHierarchy::SetLocal( uint32_t node, const XMFLOAT3& kTranslation, const XMFLOAT4& kRotation, const XMFLOAT3& kScale )
+{
+	const uint32_t slot = m_slotOfNode[ node ];
+	m_translation[ slot ] = kTranslation;
+	m_rotation[ slot ] = kRotation;
+	m_scale[ slot ] = kScale;
+	MarkDirty( slot );
+}
+
+void TransformHierarchy::SetTranslation( uint32_t node, const XMFLOAT3& kTranslation )
+{
+	const uint32_t slot = m_slotOfNode[ node ];
+	m_translation[ slot ] = kTranslation;
+	MarkDirty( slot );
+}
+
+void TransformHierarchy::SetRotation( uint32_t node, const XMFLOAT4& kRotation )
+{
+	const uint32_t slot = m_slotOfNode[ node ];
+	m_rotation[ slot ] = kRotation;
+	MarkDirty( slot );
+}
+
+void TransformHierarchy::SetScale( uint32_t node, const XMFLOAT3& kScale )
+{
+	const uint32_t slot = m_slotOfNode[ node ];
+	m_scale[ slot ] = kScale;
+	MarkDirty( slot );
+}
+
+void TransformHierarchy::MarkDirty( uint32_t slot )
+{
+	m_dirty[ slot ] = 1;
+	if ( m_bSorted )
+	{
+		m_levelDirty[ m_depth[ m_nodeOfSlot[ slot ] ] ] = 1;
+	}
+}
+
+void TransformHierarchy::SortByDepth()
+{
+	const uint32_t nodeCount = GetNodeCount();
+	const uint32_t depthCount = *std::max_element( m_depth.begin(), m_depth.end() ) + 1;
+
+	// Counting sort, stable so nodes of one level keep the order they were added in.
+	m_levelBegin.assign( depthCount + 1, 0 );
+	for ( uint32_t node = 0; node < nodeCount; ++node )
+	{
+		++m_levelBegin[ m_depth[ node ] + 1 ];
+	}
+	for ( uint32_t depth = 0; depth < depthCount; ++depth )
+	{
+		m_levelBegin[ depth + 1 ] += m_levelBegin[ depth ];
+	}
+
+	std::vector< uint32_t > next( m_levelBegin.begin(), m_levelBegin.end() - 1 );
+	std::vector< uint32_t > newSlotOfSlot( nodeCount );
+	for ( uint32_t slot = 0; slot < nodeCount; ++slot )
+	{
+		newSlotOfSlot[ slot ] = next[ m_depth[ m_nodeOfSlot[ slot ] ] ]++;
+	}
+
+	std::vector< XMFLOAT3 > translation( nodeCount );
+	std::vector< XMFLOAT4 > rotation( nodeCount );
+	std::vector< XMFLOAT3 > scale( nodeCount );
+	std::vector< uint32_t > parentSlot( nodeCount );
+	std::vector< uint32_t > nodeOfSlot( nodeCount );
+	for ( uint32_t slot = 0; slot < nodeCount; ++slot )
+	{
+		const uint32_t newSlot = newSlotOfSlot[ slot ];
+		translation[ newSlot ] = m_translation[ slot ];
+		rotation[ newSlot ] = m_rotation[ slot ];
+		scale[ newSlot ] = m_scale[ slot ];
+		parentSlot[ newSlot ] = ( m_parentSlot[ slot ] == uInvalidNode ) ? uInvalidNode : newSlotOfSlot[ m_parentSlot[ slot ] ];
+		nodeOfSlot[ newSlot ] = m_nodeOfSlot[ slot ];
+		m_slotOfNode[ m_nodeOfSlot[ slot ] ] = newSlot;
+	}
+	m_translation.swap( translation );
+	m_rotation.swap( rotation );
+	m_scale.swap( scale );
+	m_parentSlot.swap( parentSlot );
+	m_nodeOfSlot.swap( nodeOfSlot );
+
+	// Cheaper than moving the world matrices around, this only happens after nodes were added out of order.
+	m_dirty.assign( nodeCount, 1 );
+	m_levelDirty.assign( depthCount, 1 );
+	m_bSorted = true;
+}
+
+uint32_t TransformHierarchy::UpdateRange( uint32_t begin, uint32_t end, bool bCheckDirty, uint8_t* pTransposedOut, size_t stride )
+{
+	uint32_t recomputed = 0;
+	for ( uint32_t slot = begin; slot < end; ++slot )
+	{
+		const uint32_t parentSlot = m_parentSlot[ slot ];
+		// The parent level is finished by now, its flag says whether the parent world matrix changed.
+		if ( bCheckDirty && ( m_dirty[ slot ] || ( parentSlot != uInvalidNode && m_dirty[ parentSlot ] ) ) )
+		{
+			XMMATRIX world = XMMatrixAffineTransformation( XMLoadFloat3( &m_scale[ slot ] ), XMVectorZero(), XMLoadFloat4( &m_rotation[ slot ] ), XMLoadFloat3( &m_translation[ slot ] ) );
+			if ( parentSlot != uInvalidNode )
+			{
+				world = XMMatrixMultiply( world, XMLoadFloat4x4( &m_world[ parentSlot ] ) );
+			}
+			XMStoreFloat4x4( &m_world[ slot ], world );
+			m_dirty[ slot ] = 1;
+			++recomputed;
+		}
+
+		if ( pTransposedOut )
+		{
+			XMFLOAT4X4* pDest = reinterpret_cast< XMFLOAT4X4* >( pTransposedOut + m_nodeOfSlot[ slot ] * stride );
+			XMStoreFloat4x4( pDest, XMMatrixTranspose( XMLoadFloat4x4( &m_world[ slot ] ) ) );
+		}
+	}
+	return recomputed;
+}
+
+uint32_t TransformHierarchy::Update( ThreadPool* pPool, void* pTransposedOut, size_t stride, const TransformUpdateOptions& kOptions )
+{
+	if ( !m_bSorted )
+	{
+		SortByDepth();
+	}
+
+	uint8_t* pOut = static_cast< uint8_t* >( pTransposedOut );
+	const uint32_t depthCount = GetDepthCount();
+	uint32_t recomputed = 0;
+	uint32_t firstChangedLevel = depthCount;
+	bool bParentLevelChanged = false;
+	for ( uint32_t depth = 0; depth < depthCount; ++depth )
+	{
+		// A level is only looked at when something in it was set or its parent level changed,
+		// or when every matrix has to be written out anyway.
+		const bool bCheckDirty = m_levelDirty[ depth ] || bParentLevelChanged;
+		if ( !bCheckDirty && !pOut )
+		{
+			continue;
+		}
+		if ( bCheckDirty )
+		{
+			firstChangedLevel = std::min( firstChangedLevel, depth );
+		}
+
+		const uint32_t begin = m_levelBegin[ depth ];
+		const uint32_t count = m_levelBegin[ depth + 1 ] - begin;
+		uint32_t levelRecomputed = 0;
+		if ( !pPool || count < kOptions.parallelThreshold )
+		{
+			levelRecomputed = UpdateRange( begin, begin + count, bCheckDirty, pOut, stride );
+		}
+		else
+		{
+			std::atomic< uint32_t > total( 0 );
+			pPool->ParallelFor( count, std::max( kOptions.grainSize, 1u ), [ & ]( uint32_t rangeBegin, uint32_t rangeEnd )
+			{
+				total.fetch_add( UpdateRange( begin + rangeBegin, begin + rangeEnd, bCheckDirty, pOut, stride ), std::memory_order_relaxed );
+			} );
+			levelRecomputed = total.load();
+		}
+		recomputed += levelRecomputed;
+		bParentLevelChanged = levelRecomputed > 0;
+	}
+
+	// Levels above the first changed one were never flagged.
+	if ( firstChangedLevel < depthCount )
+	{
+		std::fill( m_dirty.begin() + m_levelBegin[ firstChangedLevel ], m_dirty.end(), static_cast< uint8_t >( 0 ) );
+		std::fill( m_levelDirty.begin() + firstChangedLevel, m_levelDirty.end(), static_cast< uint8_t >( 0 ) );
+	}
+	return recomputed;
+}
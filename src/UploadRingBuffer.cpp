@@ -0,0 +1,60 @@
+#include "stdafx.hpp"
+#include "UploadRingBuffer.hpp"
+#include "DXSampleHelper.hpp"
+
+UploadRingBuffer::~UploadRingBuffer()
+{
+	Destroy();
+}
+
+void UploadRingBuffer::Create( ID3D12Device* pDevice, uint64_t size )
+{
+	Destroy();
+
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer( size );
+	ThrowIfFailed( pDevice->CreateCommittedResource(
+		HeapPropertiesFactory::GetUploadHeapProperties(),
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS( m_spBuffer.ReleaseAndGetAddressOf() )
+	) );
+	m_spBuffer->SetName( L"Upload Ring Buffer" );
+
+	// Keep it mapped for the lifetime of the resource, upload heaps are write-combined anyway.
+	CD3DX12_RANGE readRange( 0, 0 ); // we do not intend to read from this resource on the CPU.
+	ThrowIfFailed( m_spBuffer->Map( 0, &readRange, reinterpret_cast< void** >( &m_pMappedData ) ) );
+	m_gpuAddress = m_spBuffer->GetGPUVirtualAddress();
+
+	m_kAllocator.Reset( size );
+}
+
+void UploadRingBuffer::Destroy()
+{
+	if ( m_spBuffer && m_pMappedData )
+	{
+		m_spBuffer->Unmap( 0, nullptr );
+	}
+
+	m_spBuffer.Reset();
+	m_pMappedData = nullptr;
+	m_gpuAddress = 0;
+	m_kAllocator.Reset( 0 );
+}
+
+UploadAllocation UploadRingBuffer::Allocate( uint64_t size, uint64_t alignment )
+{
+	const uint64_t offset = m_kAllocator.Allocate( size, alignment );
+	if ( offset == RingAllocator::uInvalidOffset )
+	{
+		throw std::runtime_error( "Upload ring buffer is out of memory" );
+	}
+
+	UploadAllocation kAllocation;
+	kAllocation.pResource = m_spBuffer.Get();
+	kAllocation.offset = offset;
+	kAllocation.pCpuAddress = m_pMappedData + offset;
+	kAllocation.gpuAddress = m_gpuAddress + offset;
+	return kAllocation;
+}
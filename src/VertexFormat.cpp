@@ -0,0 +1,152 @@
+#include "VertexFormat.hpp"
+#include <algorithm>
+#include <cmath>
+
+QuantizationBounds VertexQuantizer::ComputeBounds( const std::vector< MeshVertex >& vertices )
+{
+	QuantizationBounds kBounds;
+	if ( vertices.empty() )
+	{
+		return kBounds;
+	}
+
+	float minimum[ 3 ], maximum[ 3 ];
+	for ( uint32_t n = 0; n < 3; ++n )
+	{
+		minimum[ n ] = maximum[ n ] = vertices[ 0 ].position[ n ];
+	}
+	for ( const MeshVertex& kVertex : vertices )
+	{
+		for ( uint32_t n = 0; n < 3; ++n )
+		{
+			minimum[ n ] = std::min( minimum[ n ], kVertex.position[ n ] );
+			maximum[ n ] = std::max( maximum[ n ], kVertex.position[ n ] );
+		}
+	}
+
+	for ( uint32_t n = 0; n < 3; ++n )
+	{
+		kBounds.center[ n ] = ( minimum[ n ] + maximum[ n ] ) * 0.5f;
+		// Flat along this axis, any scale works, just do not divide by zero.
+		const float extent = ( maximum[ n ] - minimum[ n ] ) * 0.5f;
+		kBounds.extent[ n ] = extent > 0.0f ? extent : 1.0f;
+	}
+	return kBounds;
+}
+
+uint16_t VertexQuantizer::FloatToHalf( float value )
+{
+	uint32_t bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	const uint32_t sign = ( bits >> 16 ) & 0x8000;
+	const uint32_t absolute = bits & 0x7FFFFFFF;
+
+	// NaN stays NaN, infinity and anything that rounds past 65504 become infinity.
+	if ( absolute >= 0x7F800000 )
+	{
+		return static_cast< uint16_t >( sign | 0x7C00 | ( absolute > 0x7F800000 ? 0x200 : 0 ) );
+	}
+	if ( absolute >= 0x477FF000 )
+	{
+		return static_cast< uint16_t >( sign | 0x7C00 );
+	}
+
+	uint32_t half;
+	uint32_t remainder;
+	uint32_t halfway;
+	if ( absolute < 0x38800000 )
+	{
+		// Denormal, shift the mantissa with its implicit bit down to units of 2^-24.
+		const uint32_t shift = 126 - ( absolute >> 23 );
+		if ( shift > 24 )
+		{
+			return static_cast< uint16_t >( sign );
+		}
+		const uint32_t mantissa = ( absolute & 0x7FFFFF ) | 0x800000;
+		half = mantissa >> shift;
+		remainder = mantissa & ( ( 1u << shift ) - 1 );
+		halfway = 1u << ( shift - 1 );
+	}
+	else
+	{
+		// Rebias the exponent from 127 to 15, a carry out of the mantissa bumps the exponent, which is what we want.
+		half = ( absolute - 0x38000000 ) >> 13;
+		remainder = absolute & 0x1FFF;
+		halfway = 0x1000;
+	}
+
+	if ( remainder > halfway || ( remainder == halfway && ( half & 1 ) ) )
+	{
+		++half;
+	}
+	return static_cast< uint16_t >( sign | half );
+}
+
+float VertexQuantizer::HalfToFloat( uint16_t value )
+{
+	const uint32_t sign = static_cast< uint32_t >( value & 0x8000 ) << 16;
+	const uint32_t exponent = ( value >> 10 ) & 0x1F;
+	const uint32_t mantissa = value & 0x3FF;
+
+	if ( exponent == 0 )
+	{
+		const float magnitude = ldexpf( static_cast< float >( mantissa ), -24 );
+		return sign ? -magnitude : magnitude;
+	}
+
+	const uint32_t bits = exponent == 31 ? ( sign | 0x7F800000 | ( mantissa << 13 ) )
+										 : ( sign | ( ( exponent + 112 ) << 23 ) | ( mantissa << 13 ) );
+	float result;
+	memcpy( &result, &bits, sizeof( result ) );
+	return result;
+}
+
+int16_t VertexQuantizer::FloatToSnorm16( float value )
+{
+	value = std::min( std::max( value, -1.0f ), 1.0f );
+	return static_cast< int16_t >( lrintf( value * 32767.0f ) );
+}
+
+uint8_t VertexQuantizer::FloatToUnorm8( float value )
+{
+	value = std::min( std::max( value, 0.0f ), 1.0f );
+	return static_cast< uint8_t >( lrintf( value * 255.0f ) );
+}
+
+void VertexQuantizer::EncodeOctahedral( const float normal[ 3 ], float encoded[ 2 ] )
+{
+	const float length = fabsf( normal[ 0 ] ) + fabsf( normal[ 1 ] ) + fabsf( normal[ 2 ] );
+	if ( length <= 0.0f )
+	{
+		encoded[ 0 ] = encoded[ 1 ] = 0.0f;
+		return;
+	}
+
+	const float x = normal[ 0 ] / length;
+	const float y = normal[ 1 ] / length;
+	if ( normal[ 2 ] >= 0.0f )
+	{
+		encoded[ 0 ] = x;
+		encoded[ 1 ] = y;
+	}
+	else
+	{
+		encoded[ 0 ] = ( 1.0f - fabsf( y ) ) * ( x >= 0.0f ? 1.0f : -1.0f );
+		encoded[ 1 ] = ( 1.0f - fabsf( x ) ) * ( y >= 0.0f ? 1.0f : -1.0f );
+	}
+}
+
+void VertexQuantizer::DecodeOctahedral( const float encoded[ 2 ], float normal[ 3 ] )
+{
+	float x = encoded[ 0 ];
+	float y = encoded[ 1 ];
+	const float z = 1.0f - fabsf( x ) - fabsf( y );
+	const float fold = std::max( -z, 0.0f );
+	x += x >= 0.0f ? -fold : fold;
+	y += y >= 0.0f ? -fold : fold;
+
+	const float length = sqrtf( x * x + y * y + z * z );
+	normal[ 0 ] = x / length;
+	normal[ 1 ] = y / length;
+	normal[ 2 ] = z / length;
+}
@@ -1,6 +1,7 @@
 #include "stdafx.hpp"
 #include "Win32App.hpp"
 #include "DXSample.hpp"
+#include "HeadlessApp.hpp"
 
 #define MIN_WIDTH 400
 #define MIN_HEIGHT 300
@@ -17,6 +18,12 @@ int Win32App::Run( DXSample* pSample, HINSTANCE hInstance, int nCmdShow )
 	pSample->ParseCommandLineArgs( argv, argc );
 	LocalFree( argv );
 
+	// benchmark runs don't need a window at all.
+	if ( pSample->IsHeadless() )
+	{
+		return HeadlessApp::Run( pSample );
+	}
+
 	// Initialize the window class.
 	WNDCLASSEX windowClass = { 0 };
 	windowClass.cbSize = sizeof( WNDCLASSEX );
@@ -0,0 +1,354 @@
+// Resource state tracking against a recording sink: fixed cases for elision, merging, batching, subresources and
+// cross-list fixups, then random lists replayed on a simulated device that checks every barrier's before state and
+// that every use sees the state it asked for. Reports how many ResourceBarrier calls the tracker saves.
+// usage: barrierbench [--frames N] [--lists N] [--resources N]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Clock.hpp"
+#include "ResourceStateTracker.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: barrierbench [--frames N] [--lists N] [--resources N]\n" );
+		return 1;
+	}
+
+	const uint32_t uAll = ResourceStateTracker::uAllSubresources;
+
+	// Stand-ins for D3D12 states, only their values matter.
+	const uint32_t s_states[] = { 0x1, 0x2, 0x4, 0x8, 0x10 };
+
+	bool Check( bool bCondition, const char* pName )
+	{
+		if ( !bCondition )
+		{
+			fprintf( stderr, "failed: %s\n", pName );
+		}
+		return bCondition;
+	}
+
+	bool SameBarrier( const ResourceBarrierDesc& kBarrier, const void* pResource, uint32_t subresource, uint32_t before, uint32_t after )
+	{
+		return kBarrier.pResource == pResource && kBarrier.subresource == subresource && kBarrier.before == before && kBarrier.after == after;
+	}
+
+	bool CheckFixedCases()
+	{
+		int resources[ 8 ] = {};
+		ResourceStateCache kCache;
+		for ( int& kResource : resources )
+		{
+			kCache.Register( &kResource, 1, 0x1 );
+		}
+		ResourceStateTracker kTracker( kCache );
+		RecordingBarrierSink kSink;
+		bool bPassed = true;
+
+		// Already in the state: nothing at all.
+		kTracker.Begin( true );
+		kTracker.Transition( &resources[ 0 ], 0x1 );
+		kTracker.FlushBarriers( kSink );
+		bPassed &= Check( kSink.GetBatches().empty() && kTracker.GetStats().elided == 1, "redundant transition" );
+
+		// A -> B -> C is one barrier, A -> B -> A none.
+		kTracker.Transition( &resources[ 0 ], 0x2 );
+		kTracker.Transition( &resources[ 0 ], 0x4 );
+		kTracker.Transition( &resources[ 1 ], 0x2 );
+		kTracker.Transition( &resources[ 1 ], 0x1 );
+		kTracker.FlushBarriers( kSink );
+		bPassed &= Check( kSink.GetBatches().size() == 1 && kSink.GetBatches()[ 0 ].size() == 1 &&
+						  SameBarrier( kSink.GetBatches()[ 0 ][ 0 ], &resources[ 0 ], uAll, 0x1, 0x4 ), "merged chain" );
+
+		// Everything queued goes out in one call.
+		kSink.Clear();
+		for ( int& kResource : resources )
+		{
+			kTracker.Transition( &kResource, 0x8 );
+		}
+		kTracker.FlushBarriers( kSink );
+		bPassed &= Check( kSink.GetBatches().size() == 1 && kSink.GetBatches()[ 0 ].size() == 8, "one batch" );
+		kTracker.Resolve();
+		bPassed &= Check( kCache.GetState( &resources[ 0 ], 0 ) == 0x8, "cache updated" );
+
+		// A single mip first, then the whole texture: the whole-resource barrier is split so each mip has one.
+		int texture = 0;
+		kCache.Register( &texture, 4, 0x1 );
+		kSink.Clear();
+		kTracker.Begin( true );
+		kTracker.Transition( &texture, 0x2, 1 );
+		kTracker.Transition( &texture, 0x4 );
+		kTracker.FlushBarriers( kSink );
+		bool bSplit = kSink.GetBatches().size() == 1 && kSink.GetBatches()[ 0 ].size() == 4;
+		for ( uint32_t n = 0; bSplit && n < 4; ++n )
+		{
+			bSplit = std::any_of( kSink.GetBatches()[ 0 ].begin(), kSink.GetBatches()[ 0 ].end(), [ & ]( const ResourceBarrierDesc& kBarrier )
+			{
+				return SameBarrier( kBarrier, &texture, n, 0x1, 0x4 );
+			} );
+		}
+		bPassed &= Check( bSplit, "subresource split" );
+
+		// Uniform again, so the next change is a single barrier for all of them.
+		kSink.Clear();
+		kTracker.Transition( &texture, 0x8 );
+		kTracker.FlushBarriers( kSink );
+		bPassed &= Check( kSink.GetBatches().size() == 1 && kSink.GetBatches()[ 0 ].size() == 1 &&
+						  SameBarrier( kSink.GetBatches()[ 0 ][ 0 ], &texture, uAll, 0x4, 0x8 ), "whole resource" );
+		kTracker.Resolve();
+
+		// Two lists recorded without knowing about each other, the fixups chain them up at submit.
+		ResourceStateTracker kSecond( kCache );
+		kSink.Clear();
+		kTracker.Begin( false );
+		kSecond.Begin( false );
+		kTracker.Transition( &texture, 0x2 );
+		kSecond.Transition( &texture, 0x10, 2 );
+		const std::vector< ResourceBarrierDesc > firstFixups = kTracker.Resolve();
+		const std::vector< ResourceBarrierDesc > secondFixups = kSecond.Resolve();
+		bPassed &= Check( kSink.GetBatches().empty(), "first uses record no barrier" );
+		bPassed &= Check( firstFixups.size() == 1 && SameBarrier( firstFixups[ 0 ], &texture, uAll, 0x8, 0x2 ), "first list fixup" );
+		bPassed &= Check( secondFixups.size() == 1 && SameBarrier( secondFixups[ 0 ], &texture, 2, 0x2, 0x10 ), "second list fixup" );
+		bPassed &= Check( kCache.GetState( &texture, 2 ) == 0x10 && kCache.GetState( &texture, 1 ) == 0x2, "cache after fixups" );
+		return bPassed;
+	}
+
+	// What the list did, in recording order: a barrier batch, or a draw that needs a subresource in a state.
+	struct Event
+	{
+		bool bUse;
+		std::vector< ResourceBarrierDesc > barriers;
+		ResourceBarrierDesc use;	// after is the state the use needs.
+	};
+
+	class EventSink : public IBarrierSink
+	{
+	public:
+		explicit EventSink( std::vector< Event >& events ) : m_events( events ) {}
+
+		void ResourceBarriers( const ResourceBarrierDesc* pBarriers, uint32_t count ) override
+		{
+			m_events.push_back( { false, std::vector< ResourceBarrierDesc >( pBarriers, pBarriers + count ), {} } );
+		}
+
+	private:
+		std::vector< Event >& m_events;
+	};
+
+	// The simulated GPU: one state per subresource, barriers must start from the real state.
+	struct Device
+	{
+		std::vector< std::vector< uint32_t > > states;
+		const std::vector< int >* pResources = nullptr;
+		bool bValid = true;
+
+		std::vector< uint32_t >& GetStates( const void* pResource )
+		{
+			return states[ static_cast< const int* >( pResource ) - pResources->data() ];
+		}
+
+		void Apply( const std::vector< ResourceBarrierDesc >& barriers )
+		{
+			for ( const ResourceBarrierDesc& kBarrier : barriers )
+			{
+				std::vector< uint32_t >& subresources = GetStates( kBarrier.pResource );
+				for ( uint32_t n = 0; n < subresources.size(); ++n )
+				{
+					if ( kBarrier.subresource == uAll || kBarrier.subresource == n )
+					{
+						bValid &= subresources[ n ] == kBarrier.before;
+						subresources[ n ] = kBarrier.after;
+					}
+				}
+			}
+		}
+
+		void Use( const ResourceBarrierDesc& kUse )
+		{
+			std::vector< uint32_t >& subresources = GetStates( kUse.pResource );
+			for ( uint32_t n = 0; n < subresources.size(); ++n )
+			{
+				bValid &= ( kUse.subresource != uAll && kUse.subresource != n ) || subresources[ n ] == kUse.after;
+			}
+		}
+	};
+
+	struct RandomResult
+	{
+		bool bPassed = true;
+		uint64_t transitions = 0;
+		uint64_t naiveCalls = 0;		// one ResourceBarrier per transition that changes a state.
+		uint64_t barriers = 0;
+		uint64_t batches = 0;
+		uint64_t fixups = 0;
+		uint64_t fixupLists = 0;
+		uint64_t elided = 0;
+		uint64_t merged = 0;
+		double nanosecondsPerTransition = 0.0;
+	};
+
+	RandomResult RunRandom( uint32_t frameCount, uint32_t listCount, uint32_t resourceCount )
+	{
+		uint32_t seed = 12345;
+		auto Random = [ &seed ]( uint32_t range )
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return ( seed >> 8 ) % range;
+		};
+
+		std::vector< int > resources( resourceCount );
+		ResourceStateCache kCache;
+		Device kDevice;
+		kDevice.pResources = &resources;
+		for ( int& kResource : resources )
+		{
+			const uint32_t subresourceCount = ( Random( 3 ) == 0 ) ? 1 + Random( 6 ) : 1;
+			const uint32_t state = s_states[ Random( 5 ) ];
+			kCache.Register( &kResource, subresourceCount, state );
+			kDevice.states.emplace_back( subresourceCount, state );
+		}
+
+		std::vector< ResourceStateTracker > trackers( listCount, ResourceStateTracker( kCache ) );
+		std::vector< std::vector< Event > > events( listCount );
+		std::vector< ResourceBarrierDesc > uses;
+		// The naive count follows each list's own view, known only after its first use like the tracker's.
+		std::vector< std::vector< uint32_t > > naiveStates;
+
+		RandomResult kResult;
+		HighResolutionClock kClock;
+		uint64_t recordCounter = 0;
+		for ( uint32_t frame = 0; frame < frameCount; ++frame )
+		{
+			// Recording: sequential here, every list only talks to its own tracker so the order does not matter.
+			const uint64_t startCounter = kClock.GetCounter();
+			for ( uint32_t list = 0; list < listCount; ++list )
+			{
+				ResourceStateTracker& kTracker = trackers[ list ];
+				EventSink kSink( events[ list ] );
+				events[ list ].clear();
+				kTracker.Begin( list == 0 );
+				uses.clear();
+
+				const uint32_t drawCount = 1 + Random( 8 );
+				for ( uint32_t draw = 0; draw < drawCount; ++draw )
+				{
+					const uint32_t transitionCount = 1 + Random( 4 );
+					for ( uint32_t n = 0; n < transitionCount; ++n )
+					{
+						const void* pResource = &resources[ Random( resourceCount ) ];
+						const uint32_t subresourceCount = kCache.GetSubresourceCount( pResource );
+						const uint32_t subresource = ( subresourceCount > 1 && Random( 2 ) == 0 ) ? Random( subresourceCount ) : uAll;
+						const uint32_t state = s_states[ Random( 5 ) ];
+						kTracker.Transition( pResource, state, subresource );
+						uses.push_back( { pResource, subresource, 0, state } );
+					}
+					kTracker.FlushBarriers( kSink );
+
+					// Later transitions in the same batch win, so only the uses still valid at the draw are checked.
+					for ( size_t n = 0; n < uses.size(); ++n )
+					{
+						const bool bOverwritten = std::any_of( uses.begin() + n + 1, uses.end(), [ & ]( const ResourceBarrierDesc& kLater )
+						{
+							return kLater.pResource == uses[ n ].pResource &&
+								( kLater.subresource == uAll || uses[ n ].subresource == uAll || kLater.subresource == uses[ n ].subresource );
+						} );
+						if ( !bOverwritten )
+						{
+							events[ list ].push_back( { true, {}, uses[ n ] } );
+						}
+					}
+					uses.clear();
+				}
+				kResult.transitions += kTracker.GetStats().transitions;
+			}
+			recordCounter += kClock.GetCounter() - startCounter;
+
+			// Submit: resolve in order and replay on the device, fixups first.
+			for ( uint32_t list = 0; list < listCount; ++list )
+			{
+				const std::vector< ResourceBarrierDesc >& fixups = trackers[ list ].Resolve();
+				kDevice.Apply( fixups );
+				kResult.fixupLists += fixups.empty() ? 0 : 1;
+				for ( const Event& kEvent : events[ list ] )
+				{
+					if ( kEvent.bUse )
+					{
+						kDevice.Use( kEvent.use );
+					}
+					else
+					{
+						kDevice.Apply( kEvent.barriers );
+					}
+				}
+
+				const ResourceStateTrackerStats& kStats = trackers[ list ].GetStats();
+				kResult.barriers += kStats.barriers;
+				kResult.batches += kStats.batches;
+				kResult.fixups += kStats.fixups;
+				kResult.elided += kStats.elided;
+				kResult.merged += kStats.merged;
+			}
+
+			// The cache has to end up where the device is.
+			for ( uint32_t n = 0; n < resourceCount; ++n )
+			{
+				for ( uint32_t sub = 0; sub < kDevice.states[ n ].size(); ++sub )
+				{
+					kResult.bPassed &= kCache.GetState( &resources[ n ], sub ) == kDevice.states[ n ][ sub ];
+				}
+			}
+		}
+		kResult.bPassed &= kDevice.bValid;
+		kResult.naiveCalls = kResult.transitions - kResult.elided;
+		kResult.nanosecondsPerTransition = static_cast< double >( recordCounter ) * 1e9 / kClock.GetFrequency() / std::max< uint64_t >( kResult.transitions, 1 );
+		return kResult;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t frameCount = 2000;
+	uint32_t listCount = 4;
+	uint32_t resourceCount = 16;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--frames" ) == 0 && hasValue )
+		{
+			frameCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--lists" ) == 0 && hasValue )
+		{
+			listCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--resources" ) == 0 && hasValue )
+		{
+			resourceCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	int result = CheckFixedCases() ? 0 : 1;
+
+	const RandomResult kResult = RunRandom( frameCount, listCount, resourceCount );
+	printf( "%u frames x %u lists: %llu transitions, %llu elided, %llu merged\n", frameCount, listCount,
+			static_cast< unsigned long long >( kResult.transitions ), static_cast< unsigned long long >( kResult.elided ),
+			static_cast< unsigned long long >( kResult.merged ) );
+	printf( "ResourceBarrier calls: %llu one by one, %llu batched ( %llu barriers ) + %llu fixup lists ( %llu barriers ), %.1f ns per transition\n",
+			static_cast< unsigned long long >( kResult.naiveCalls ), static_cast< unsigned long long >( kResult.batches ),
+			static_cast< unsigned long long >( kResult.barriers ), static_cast< unsigned long long >( kResult.fixupLists ),
+			static_cast< unsigned long long >( kResult.fixups ), kResult.nanosecondsPerTransition );
+	if ( !kResult.bPassed )
+	{
+		fprintf( stderr, "a barrier started from the wrong state, or a draw saw the wrong one\n" );
+		result = 1;
+	}
+	return result;
+}
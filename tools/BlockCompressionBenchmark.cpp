@@ -0,0 +1,187 @@
+// PSNR and throughput of every BC format at both quality presets, to pick the presets with: scalar and SIMD on one
+// thread, and SIMD with the block rows spread over the job system. Runs on an image stb_image reads, or on a built-in
+// test pattern with gradients, hard edges, noise and an alpha ramp. Also checks that the pool gives the same blocks.
+// usage: bcbench [image] [--threads N] [--repeat N]
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "BlockCompressor.hpp"
+#include "Clock.hpp"
+#include "ThreadPool.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: bcbench [image] [--threads N] [--repeat N]\n" );
+		return 1;
+	}
+
+	// Four quadrants that stress different parts of the encoders.
+	std::vector< uint8_t > MakeTestPattern( uint32_t size )
+	{
+		std::vector< uint8_t > image( static_cast< size_t >( size ) * size * 4 );
+		std::mt19937 kRandom( 1234 );
+		for ( uint32_t y = 0; y < size; ++y )
+		{
+			for ( uint32_t x = 0; x < size; ++x )
+			{
+				uint8_t* pTexel = image.data() + ( static_cast< size_t >( y ) * size + x ) * 4;
+				const bool bRight = x >= size / 2;
+				const bool bBottom = y >= size / 2;
+				if ( !bRight && !bBottom )
+				{
+					// smooth colour gradients.
+					pTexel[ 0 ] = static_cast< uint8_t >( x * 511 / size );
+					pTexel[ 1 ] = static_cast< uint8_t >( y * 511 / size );
+					pTexel[ 2 ] = static_cast< uint8_t >( ( x + y ) * 255 / size );
+				}
+				else if ( bRight && !bBottom )
+				{
+					// hard edged shapes in saturated colours.
+					const bool bInside = ( ( x / 24 ) + ( y / 24 ) ) % 3 == 0;
+					pTexel[ 0 ] = bInside ? 230 : 20;
+					pTexel[ 1 ] = ( ( x / 40 ) % 2 ) ? 200 : 40;
+					pTexel[ 2 ] = bInside ? 30 : 220;
+				}
+				else if ( !bRight )
+				{
+					// noise around a mid tone.
+					pTexel[ 0 ] = static_cast< uint8_t >( 96 + kRandom() % 64 );
+					pTexel[ 1 ] = static_cast< uint8_t >( 128 + kRandom() % 64 );
+					pTexel[ 2 ] = static_cast< uint8_t >( 64 + kRandom() % 64 );
+				}
+				else
+				{
+					// a sine pattern, like the detail of a normal map.
+					pTexel[ 0 ] = static_cast< uint8_t >( 127.5 + 127.0 * std::sin( x * 0.15 ) );
+					pTexel[ 1 ] = static_cast< uint8_t >( 127.5 + 127.0 * std::cos( y * 0.11 ) );
+					pTexel[ 2 ] = 255;
+				}
+				pTexel[ 3 ] = static_cast< uint8_t >( ( x + y ) * 255 / ( 2 * size - 2 ) );
+			}
+		}
+		return image;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	const char* pImagePath = nullptr;
+	uint32_t threadCount = 0;
+	uint32_t repeat = 3;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--threads" ) == 0 && hasValue )
+		{
+			threadCount = static_cast< uint32_t >( std::max( 0, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--repeat" ) == 0 && hasValue )
+		{
+			repeat = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( argv[ i ][ 0 ] != '-' && !pImagePath )
+		{
+			pImagePath = argv[ i ];
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	uint32_t width = 1024;
+	uint32_t height = 1024;
+	std::vector< uint8_t > image;
+	if ( pImagePath )
+	{
+		int imageWidth = 0, imageHeight = 0, channels = 0;
+		stbi_uc* pPixels = stbi_load( pImagePath, &imageWidth, &imageHeight, &channels, STBI_rgb_alpha );
+		if ( !pPixels )
+		{
+			fprintf( stderr, "can not load %s: %s\n", pImagePath, stbi_failure_reason() );
+			return 1;
+		}
+		width = static_cast< uint32_t >( imageWidth );
+		height = static_cast< uint32_t >( imageHeight );
+		image.assign( pPixels, pPixels + static_cast< size_t >( width ) * height * 4 );
+		stbi_image_free( pPixels );
+	}
+	else
+	{
+		image = MakeTestPattern( width );
+	}
+
+	HighResolutionClock kClock;
+	const double frequency = static_cast< double >( kClock.GetFrequency() );
+	ThreadPool kPool( threadCount );
+	const size_t rowPitch = static_cast< size_t >( width ) * 4;
+	const double megapixels = static_cast< double >( width ) * height / 1000000.0;
+
+	struct Format
+	{
+		BlockFormat format;
+		const char* name;
+		uint32_t channelCount;
+	};
+	const Format formats[] =
+	{
+		{ BlockFormat::BC1, "bc1", 3 },
+		{ BlockFormat::BC3, "bc3", 4 },
+		{ BlockFormat::BC5, "bc5", 2 },
+		{ BlockFormat::BC7, "bc7", 4 },
+	};
+
+	printf( "%s, %ux%u, %u workers\n", pImagePath ? pImagePath : "test pattern", width, height, kPool.GetThreadCount() );
+	printf( "%-6s %-7s %8s %14s %14s %14s\n", "format", "quality", "psnr dB", "scalar MP/s", "simd MP/s", "pool MP/s" );
+	bool bPassed = true;
+	std::vector< uint8_t > decoded( rowPitch * height );
+	for ( const Format& kFormat : formats )
+	{
+		const size_t blockRowPitch = BlockCompressor::GetRowPitch( kFormat.format, width );
+		std::vector< uint8_t > blocks( BlockCompressor::GetCompressedSize( kFormat.format, width, height ) );
+		std::vector< uint8_t > pooledBlocks( blocks.size() );
+		for ( BlockQuality quality : { BlockQuality::Fast, BlockQuality::High } )
+		{
+			BlockCompressOptions kOptions;
+			kOptions.format = kFormat.format;
+			kOptions.quality = quality;
+
+			// Best of `repeat` runs, scalar first so the SIMD blocks are the ones left for the PSNR.
+			double seconds[ 3 ] = { 1e30, 1e30, 1e30 };
+			for ( uint32_t run = 0; run < 3; ++run )
+			{
+				kOptions.useSimd = run != 0;
+				for ( uint32_t r = 0; r < repeat; ++r )
+				{
+					const uint64_t begin = kClock.GetCounter();
+					BlockCompressor::Compress( image.data(), width, height, rowPitch, kOptions, run == 2 ? pooledBlocks.data() : blocks.data(), blockRowPitch,
+											   run == 2 ? &kPool : nullptr );
+					seconds[ run ] = std::min( seconds[ run ], static_cast< double >( kClock.GetCounter() - begin ) / frequency );
+				}
+			}
+			bPassed &= pooledBlocks == blocks;
+
+			BlockCompressor::Decompress( blocks.data(), blockRowPitch, kFormat.format, width, height, decoded.data(), rowPitch );
+			const double psnr = BlockCompressor::ComputePsnr( image.data(), decoded.data(), width, height, rowPitch, kFormat.channelCount );
+
+			printf( "%-6s %-7s %8.2f %14.2f %14.2f %14.2f\n", kFormat.name, quality == BlockQuality::Fast ? "fast" : "high", psnr,
+					megapixels / seconds[ 0 ], megapixels / seconds[ 1 ], megapixels / seconds[ 2 ] );
+		}
+	}
+
+	if ( !bPassed )
+	{
+		fprintf( stderr, "compressing on the pool gave different blocks than on one thread\n" );
+		return 1;
+	}
+	return 0;
+}
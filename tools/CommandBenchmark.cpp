@@ -0,0 +1,232 @@
+// Parallel command list recording against the null backend: checks submission order, fixup lists and allocator reuse,
+// runs the allocator pool against a randomly advancing fence, and times recording on 1 thread against the pool.
+// usage: cmdbench [--lists N] [--draws N] [--frames N] [--frames-in-flight N]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Clock.hpp"
+#include "CommandAllocatorPool.hpp"
+#include "CommandRecorder.hpp"
+#include "NullCommandBackend.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: cmdbench [--lists N] [--draws N] [--frames N] [--frames-in-flight N]\n" );
+		return 1;
+	}
+
+	// Roughly what validating and encoding one draw costs on the CPU.
+	uint32_t SimulateDraw( uint32_t seed )
+	{
+		for ( uint32_t n = 0; n < 200; ++n )
+		{
+			seed = seed * 1664525u + 1013904223u;
+		}
+		return seed;
+	}
+
+	// Random list counts and GPU progress. The null allocators throw when one is reset while in flight,
+	// on top of that the pool must only wait when nothing was idle, and never grow past its limit.
+	bool CheckAllocatorPool( uint32_t maxAllocators )
+	{
+		NullCommandBackend kBackend;
+		CommandAllocatorPoolOptions kOptions;
+		kOptions.maxAllocators = maxAllocators;
+		CommandAllocatorPool kPool( kBackend, kOptions );
+		CommandRecorder kRecorder( kBackend, kPool );
+
+		uint32_t seed = 12345;
+		auto Random = [ &seed ]( uint32_t range )
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return ( seed >> 8 ) % range;
+		};
+
+		bool bPassed = true;
+		for ( uint64_t fenceValue = 1; fenceValue <= 2000; ++fenceValue )
+		{
+			const uint32_t count = 1 + Random( 4 );
+			const CommandAllocatorPoolStats kBefore = kPool.GetStats();
+			const bool bCanGrow = ( maxAllocators == 0 ) || ( kBefore.live + count <= maxAllocators );
+			kRecorder.Record( count, []( uint32_t index, ICommandList& kList ) { NullCommandBackend::Write( kList, index ); } );
+			kRecorder.Submit( fenceValue );
+
+			const CommandAllocatorPoolStats kAfter = kPool.GetStats();
+			const bool bStalled = kAfter.stalls != kBefore.stalls;
+			bPassed &= !bStalled || ( kBefore.idle < count && !bCanGrow );
+			bPassed &= ( maxAllocators == 0 ) || ( kAfter.live <= maxAllocators );
+			bPassed &= kAfter.idle + kAfter.inFlight == kAfter.live;
+
+			// The GPU sometimes falls behind by a few frames, then catches up in one go.
+			if ( Random( 3 ) != 0 )
+			{
+				kBackend.Complete( fenceValue - std::min< uint64_t >( fenceValue, Random( 6 ) ) );
+			}
+		}
+		bPassed &= ( maxAllocators != 0 ) || ( kPool.GetStats().stalls == 0 );
+		return bPassed;
+	}
+
+	// Fixup lists go right before the list they were recorded for, and only exist when the fixup asked for one.
+	bool CheckFixupLists()
+	{
+		NullCommandBackend kBackend;
+		CommandAllocatorPool kPool( kBackend );
+		CommandRecorder kRecorder( kBackend, kPool );
+		kRecorder.Record( 4, []( uint32_t index, ICommandList& kList ) { NullCommandBackend::Write( kList, 10 * index + 10 ); } );
+		kRecorder.Submit( 1, []( uint32_t index, const std::function< ICommandList&() >& getList )
+		{
+			if ( index % 2 == 1 )
+			{
+				NullCommandBackend::Write( getList(), 10 * index + 9 );
+				NullCommandBackend::Write( getList(), 10 * index + 9 );
+			}
+		} );
+		const std::vector< uint32_t > expected = { 10, 19, 19, 20, 30, 39, 39, 40 };
+		return kBackend.GetExecutedTokens() == expected && kRecorder.GetStats().fixupLists == 2 && kPool.GetStats().live == 6;
+	}
+
+	struct RunResult
+	{
+		double seconds = 0.0;
+		uint32_t listCount = 0;
+		uint32_t allocatorCount = 0;
+		uint32_t stalls = 0;
+		uint32_t checksum = 0;
+		bool bOrdered = true;
+	};
+
+	// The simulated GPU finishes a frame `gpuLatency` frames after it was submitted, the allocator pool
+	// is capped at what `framesInFlight` frames need.
+	RunResult Run( uint32_t listsPerFrame, uint32_t drawsPerList, uint32_t frameCount, uint32_t framesInFlight, uint32_t gpuLatency, ThreadPool* pPool )
+	{
+		NullCommandBackend kBackend;
+		CommandAllocatorPoolOptions kOptions;
+		kOptions.maxAllocators = framesInFlight * listsPerFrame;
+		CommandAllocatorPool kAllocatorPool( kBackend, kOptions );
+		CommandRecorder kRecorder( kBackend, kAllocatorPool );
+		HighResolutionClock kClock;
+		std::vector< uint32_t > expected( listsPerFrame * drawsPerList );
+		for ( uint32_t n = 0; n < expected.size(); ++n )
+		{
+			expected[ n ] = n;
+		}
+		std::vector< uint32_t > checksums( listsPerFrame );
+		RunResult kResult;
+
+		const uint64_t begin = kClock.GetCounter();
+		for ( uint32_t frame = 0; frame < frameCount; ++frame )
+		{
+			kRecorder.Record( listsPerFrame, [ & ]( uint32_t index, ICommandList& kList )
+			{
+				uint32_t checksum = 0;
+				for ( uint32_t draw = 0; draw < drawsPerList; ++draw )
+				{
+					// The token only depends on where the draw belongs, never on the thread that recorded it.
+					const uint32_t token = index * drawsPerList + draw;
+					checksum ^= SimulateDraw( token );
+					NullCommandBackend::Write( kList, token );
+				}
+				checksums[ index ] = checksum;
+			}, pPool );
+			for ( const uint32_t checksum : checksums )
+			{
+				kResult.checksum ^= checksum + frame;
+			}
+			const uint64_t fenceValue = frame + 1;
+			kRecorder.Submit( fenceValue );
+			if ( fenceValue > gpuLatency )
+			{
+				kBackend.Complete( fenceValue - gpuLatency );
+			}
+
+			kResult.bOrdered &= kBackend.GetExecutedTokens() == expected;
+			kBackend.ClearExecutedTokens();
+		}
+		kResult.seconds = static_cast< double >( kClock.GetCounter() - begin ) / static_cast< double >( kClock.GetFrequency() );
+		kResult.listCount = kRecorder.GetStats().listCount;
+		kResult.allocatorCount = kAllocatorPool.GetStats().live;
+		kResult.stalls = kAllocatorPool.GetStats().stalls;
+		kResult.bOrdered &= kBackend.GetExecuteCount() == frameCount;
+		return kResult;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t listsPerFrame = 16;
+	uint32_t drawsPerList = 512;
+	uint32_t frameCount = 200;
+	uint32_t framesInFlight = 3;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--lists" ) == 0 && hasValue )
+		{
+			listsPerFrame = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--draws" ) == 0 && hasValue )
+		{
+			drawsPerList = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--frames" ) == 0 && hasValue )
+		{
+			frameCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--frames-in-flight" ) == 0 && hasValue )
+		{
+			framesInFlight = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	int result = ( CheckAllocatorPool( 0 ) && CheckAllocatorPool( 8 ) ) ? 0 : 1;
+	if ( result != 0 )
+	{
+		fprintf( stderr, "the command allocator pool handed out an allocator too early or waited without need\n" );
+	}
+	if ( !CheckFixupLists() )
+	{
+		fprintf( stderr, "fixup lists were missing, out of order or created without need\n" );
+		result = 1;
+	}
+
+	ThreadPool kPool;
+	uint32_t checksum = 0;
+	printf( "%u lists x %u draws per frame, %u frames, %u frames in flight, pool of %u + 1 threads\n",
+			listsPerFrame, drawsPerList, frameCount, framesInFlight, kPool.GetThreadCount() );
+	printf( "%11s %8s %12s %12s %8s %11s %8s\n", "gpu latency", "threads", "ms / frame", "draws / ms", "lists", "allocators", "stalls" );
+	for ( uint32_t gpuLatency = 0; gpuLatency <= framesInFlight; ++gpuLatency )
+	{
+		for ( ThreadPool* pPool : { static_cast< ThreadPool* >( nullptr ), &kPool } )
+		{
+			const RunResult kResult = Run( listsPerFrame, drawsPerList, frameCount, framesInFlight, gpuLatency, pPool );
+			const double msPerFrame = kResult.seconds * 1e3 / frameCount;
+			printf( "%11u %8u %12.3f %12.1f %8u %11u %8u%s\n", gpuLatency, pPool ? pPool->GetThreadCount() + 1 : 1, msPerFrame,
+					listsPerFrame * drawsPerList / msPerFrame, kResult.listCount, kResult.allocatorCount, kResult.stalls, kResult.bOrdered ? "" : "  OUT OF ORDER" );
+
+			// Lists are reset right after they were executed, allocators only grow to what the GPU still holds.
+			const uint32_t framesHeld = std::min( { gpuLatency + 1, framesInFlight, frameCount } );
+			const bool bRecycled = ( kResult.listCount == listsPerFrame ) && ( kResult.allocatorCount == framesHeld * listsPerFrame );
+			// Waiting only makes sense once the GPU is more frames behind than the pool may hold.
+			const bool bStallsExpected = ( gpuLatency >= framesInFlight && frameCount > framesInFlight ) == ( kResult.stalls > 0 );
+			// Same work whatever recorded it.
+			checksum = pPool ? checksum : kResult.checksum;
+			result |= ( kResult.bOrdered && bRecycled && bStallsExpected && kResult.checksum == checksum ) ? 0 : 1;
+		}
+	}
+
+	if ( result != 0 )
+	{
+		fprintf( stderr, "command recording gave a wrong result\n" );
+	}
+	return result;
+}
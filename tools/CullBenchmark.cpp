@@ -0,0 +1,164 @@
+// Frustum culling throughput on random objects, scalar against SIMD against SIMD on the thread pool.
+// usage: cullbench [--objects N] [--repeat N]
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Clock.hpp"
+#include "FrustumCuller.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: cullbench [--objects N] [--repeat N]\n" );
+		return 1;
+	}
+
+	// Same matrices XMMatrixLookAtLH( eye, eye + z, y ) and XMMatrixPerspectiveFovLH build, multiplied, row vectors.
+	void BuildViewProj( float fovY, float aspect, float nearZ, float farZ, float eyeZ, float viewProj[ 16 ] )
+	{
+		const float yScale = 1.0f / tanf( fovY * 0.5f );
+		const float xScale = yScale / aspect;
+		const float range = farZ / ( farZ - nearZ );
+		const float proj[ 16 ] =
+		{
+			xScale, 0.0f, 0.0f, 0.0f,
+			0.0f, yScale, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 1.0f,
+			0.0f, 0.0f, -range * nearZ, 0.0f,
+		};
+		// Looking down +z from ( 0, 0, eyeZ ), the view matrix is a translation.
+		const float view[ 16 ] =
+		{
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, -eyeZ, 1.0f,
+		};
+		for ( uint32_t row = 0; row < 4; ++row )
+		{
+			for ( uint32_t column = 0; column < 4; ++column )
+			{
+				float sum = 0.0f;
+				for ( uint32_t k = 0; k < 4; ++k )
+				{
+					sum += view[ row * 4 + k ] * proj[ k * 4 + column ];
+				}
+				viewProj[ row * 4 + column ] = sum;
+			}
+		}
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t objectCount = 1u << 20;
+	uint32_t repeat = 20;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--objects" ) == 0 && hasValue )
+		{
+			objectCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--repeat" ) == 0 && hasValue )
+		{
+			repeat = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	// Objects scattered in a 200 unit cube in front of a camera looking down +z, about a third end up visible.
+	FrustumCuller kCuller;
+	kCuller.Reserve( objectCount );
+	std::mt19937 kRandom( 42 );
+	std::uniform_real_distribution< float > kPosition( -100.0f, 100.0f );
+	std::uniform_real_distribution< float > kSize( 0.1f, 2.0f );
+	for ( uint32_t n = 0; n < objectCount; ++n )
+	{
+		const float center[ 3 ] = { kPosition( kRandom ), kPosition( kRandom ), kPosition( kRandom ) };
+		const float extent[ 3 ] = { kSize( kRandom ), kSize( kRandom ), kSize( kRandom ) };
+		const float boxMin[ 3 ] = { center[ 0 ] - extent[ 0 ], center[ 1 ] - extent[ 1 ], center[ 2 ] - extent[ 2 ] };
+		const float boxMax[ 3 ] = { center[ 0 ] + extent[ 0 ], center[ 1 ] + extent[ 1 ], center[ 2 ] + extent[ 2 ] };
+		kCuller.AddObject( boxMin, boxMax );
+	}
+
+	float viewProj[ 16 ];
+	BuildViewProj( 3.14159265f / 4.0f, 16.0f / 9.0f, 0.1f, 1000.0f, -100.0f, viewProj );
+	const FrustumPlanes kFrustum = FrustumCuller::ExtractPlanes( viewProj );
+
+	ThreadPool kPool;
+	HighResolutionClock kClock;
+	const double frequency = static_cast< double >( kClock.GetFrequency() );
+
+	FrustumCullOptions kScalar;
+	kScalar.useSimd = false;
+	const FrustumCullOptions kSimd;
+
+	struct Run
+	{
+		const char* name;
+		bool bBoxes;
+		const FrustumCullOptions* pOptions;
+		ThreadPool* pPool;
+	};
+	const Run kRuns[] =
+	{
+		{ "spheres scalar", false, &kScalar, nullptr },
+		{ "spheres simd", false, &kSimd, nullptr },
+		{ "spheres simd pool", false, &kSimd, &kPool },
+		{ "boxes scalar", true, &kScalar, nullptr },
+		{ "boxes simd", true, &kSimd, nullptr },
+		{ "boxes simd pool", true, &kSimd, &kPool },
+	};
+
+	std::vector< uint32_t > reference[ 2 ];
+	std::vector< uint32_t > visible;
+	int result = 0;
+	for ( const Run& kRun : kRuns )
+	{
+		double best = 1e30;
+		for ( uint32_t n = 0; n < repeat; ++n )
+		{
+			const uint64_t begin = kClock.GetCounter();
+			if ( kRun.bBoxes )
+			{
+				kCuller.CullBoxes( kFrustum, visible, *kRun.pOptions, kRun.pPool );
+			}
+			else
+			{
+				kCuller.CullSpheres( kFrustum, visible, *kRun.pOptions, kRun.pPool );
+			}
+			best = std::min( best, static_cast< double >( kClock.GetCounter() - begin ) / frequency );
+		}
+
+		// Every variant has to agree with the scalar one exactly.
+		std::vector< uint32_t >& kReference = reference[ kRun.bBoxes ? 1 : 0 ];
+		if ( kReference.empty() )
+		{
+			kReference = visible;
+		}
+		const bool bMatch = visible == kReference;
+		result |= bMatch ? 0 : 1;
+
+		const uint32_t threads = kRun.pPool ? kRun.pPool->GetThreadCount() + 1 : 1;
+		printf( "%-18s %8zu visible  %7.3f ms  %8.1f M tests/s  %8.1f M tests/s per thread%s\n", kRun.name, visible.size(), best * 1e3,
+				objectCount / best / 1e6, objectCount / best / 1e6 / threads, bMatch ? "" : "  MISMATCH" );
+	}
+
+	// A box inside the frustum always has its sphere inside too.
+	if ( !std::includes( reference[ 0 ].begin(), reference[ 0 ].end(), reference[ 1 ].begin(), reference[ 1 ].end() ) )
+	{
+		fprintf( stderr, "box culling kept objects sphere culling rejected\n" );
+		result = 1;
+	}
+	return result;
+}
@@ -0,0 +1,171 @@
+// Deferred release queue against a simulated fence: objects of random sizes are pushed every frame while the GPU
+// lags a random number of frames behind. Checks that nothing is released before its fence value, that the limits
+// hold, that the per-frame counts add up and that Flush leaves nothing behind, then times push and collect.
+// usage: releasebench [--frames N] [--objects N] [--max-pending N] [--max-bytes N]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Clock.hpp"
+#include "DeferredReleaseQueue.hpp"
+#include "NullCommandBackend.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: releasebench [--frames N] [--objects N] [--max-pending N] [--max-bytes N]\n" );
+		return 1;
+	}
+
+	struct TrackedObject
+	{
+		uint64_t fenceValue = 0;
+		bool bPending = false;
+	};
+
+	// The release function only gets the object, the fence it checks against comes from here.
+	NullCommandBackend* s_pBackend = nullptr;
+	uint32_t s_earlyReleases = 0;
+	uint32_t s_doubleReleases = 0;
+
+	void ReleaseTracked( void* pObject )
+	{
+		TrackedObject* pTracked = static_cast< TrackedObject* >( pObject );
+		s_earlyReleases += ( s_pBackend->GetCompletedValue() < pTracked->fenceValue ) ? 1 : 0;
+		s_doubleReleases += pTracked->bPending ? 0 : 1;
+		pTracked->bPending = false;
+	}
+
+	struct RunResult
+	{
+		bool bPassed = true;
+		DeferredReleaseStats kStats;
+		uint32_t maxPendingSeen = 0;
+		uint64_t maxPendingBytesSeen = 0;
+		double nanosecondsPerObject = 0.0;
+	};
+
+	RunResult Run( uint32_t frameCount, uint32_t objectsPerFrame, const DeferredReleaseQueueOptions& kOptions )
+	{
+		NullCommandBackend kBackend;
+		s_pBackend = &kBackend;
+		s_earlyReleases = 0;
+		s_doubleReleases = 0;
+
+		uint32_t seed = 12345;
+		auto Random = [ &seed ]( uint32_t range )
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return ( seed >> 8 ) % range;
+		};
+
+		// Each object is pushed once, so the tracking never aliases.
+		std::vector< TrackedObject > objects( static_cast< size_t >( frameCount ) * ( objectsPerFrame + 1 ) );
+		size_t nextObject = 0;
+
+		RunResult kResult;
+		HighResolutionClock kClock;
+		const uint64_t startCounter = kClock.GetCounter();
+		{
+			DeferredReleaseQueue kQueue( kBackend, kOptions );
+			uint64_t releasedPerFrame = 0;
+			uint64_t bytesPerFrame = 0;
+			for ( uint64_t fenceValue = 1; fenceValue <= frameCount; ++fenceValue )
+			{
+				// The GPU is somewhere between 0 and 4 frames behind, everything below fenceValue was signaled.
+				const uint64_t lag = 1 + Random( 5 );
+				kBackend.Complete( ( fenceValue > lag ) ? fenceValue - lag : 0 );
+				releasedPerFrame += kQueue.Collect();
+				bytesPerFrame += kQueue.GetStats().bytesReleasedLastCollect;
+
+				// A burst now and then, like a resize or streaming out a level.
+				const uint32_t count = ( Random( 64 ) == 0 ) ? objectsPerFrame * 8 : Random( objectsPerFrame + 1 );
+				for ( uint32_t n = 0; n < count && nextObject < objects.size(); ++n )
+				{
+					TrackedObject& kObject = objects[ nextObject++ ];
+					kObject.fenceValue = fenceValue;
+					kObject.bPending = true;
+					const uint32_t overflows = kQueue.GetStats().overflows;
+					kQueue.Push( fenceValue, &kObject, &ReleaseTracked, 64ull << Random( 12 ) );
+
+					// The limits may only be passed when everything queued belongs to the frame still being built.
+					const DeferredReleaseStats& kStats = kQueue.GetStats();
+					const bool bOverCount = kOptions.maxPending != 0 && kStats.pending > kOptions.maxPending;
+					const bool bOverBytes = kOptions.maxPendingBytes != 0 && kStats.pendingBytes > kOptions.maxPendingBytes;
+					kResult.bPassed &= !( bOverCount || bOverBytes ) || kStats.overflows != overflows;
+				}
+				kResult.maxPendingSeen = std::max( kResult.maxPendingSeen, kQueue.GetStats().pending );
+				kResult.maxPendingBytesSeen = std::max( kResult.maxPendingBytesSeen, kQueue.GetStats().pendingBytes );
+			}
+
+			kBackend.Complete( frameCount );
+			kQueue.Flush();
+			kResult.kStats = kQueue.GetStats();
+			// Everything released by a Collect was counted by it, the rest by Push stalls and Flush.
+			kResult.bPassed &= releasedPerFrame <= kResult.kStats.released && bytesPerFrame <= kResult.kStats.releasedBytes;
+		}
+		const double seconds = static_cast< double >( kClock.GetCounter() - startCounter ) / kClock.GetFrequency();
+		kResult.nanosecondsPerObject = ( nextObject > 0 ) ? seconds * 1e9 / nextObject : 0.0;
+
+		const bool bAllReleased = std::none_of( objects.begin(), objects.end(), []( const TrackedObject& kObject ) { return kObject.bPending; } );
+		kResult.bPassed &= bAllReleased && s_earlyReleases == 0 && s_doubleReleases == 0;
+		kResult.bPassed &= kResult.kStats.pending == 0 && kResult.kStats.pendingBytes == 0 && kResult.kStats.released == nextObject;
+		return kResult;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t frameCount = 5000;
+	uint32_t objectsPerFrame = 16;
+	DeferredReleaseQueueOptions kLimited;
+	kLimited.maxPending = 128;
+	kLimited.maxPendingBytes = 4ull << 20;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--frames" ) == 0 && hasValue )
+		{
+			frameCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--objects" ) == 0 && hasValue )
+		{
+			objectsPerFrame = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--max-pending" ) == 0 && hasValue )
+		{
+			kLimited.maxPending = static_cast< uint32_t >( std::max( 0, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--max-bytes" ) == 0 && hasValue )
+		{
+			kLimited.maxPendingBytes = strtoull( argv[ ++i ], nullptr, 10 );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	DeferredReleaseQueueOptions kUnlimited;
+	kUnlimited.maxPending = 0;
+	kUnlimited.maxPendingBytes = 0;
+
+	int result = 0;
+	printf( "%-10s %10s %12s %14s %8s %10s %10s\n", "limits", "released", "max pending", "max pending KB", "stalls", "overflows", "ns/object" );
+	for ( const DeferredReleaseQueueOptions& kOptions : { kUnlimited, kLimited } )
+	{
+		const RunResult kResult = Run( frameCount, objectsPerFrame, kOptions );
+		printf( "%-10s %10llu %12u %14llu %8u %10u %10.1f\n", ( kOptions.maxPending == 0 && kOptions.maxPendingBytes == 0 ) ? "none" : "bounded",
+				static_cast< unsigned long long >( kResult.kStats.released ), kResult.maxPendingSeen,
+				static_cast< unsigned long long >( kResult.maxPendingBytesSeen >> 10 ), kResult.kStats.stalls,
+				kResult.kStats.overflows, kResult.nanosecondsPerObject );
+		if ( !kResult.bPassed )
+		{
+			fprintf( stderr, "an object was released early, twice or never, or the limits did not hold\n" );
+			result = 1;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,231 @@
+// Descriptor index bookkeeping without a device: size classes at their limits, free-list reuse, per-frame rewinding
+// of the transient regions, then random persistent allocations and frees checked against a shadow copy of what is
+// live. Finally times allocate plus free with few and with many live ranges, which should cost the same.
+// usage: descbench [--operations N] [--persistent N]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Clock.hpp"
+#include "DescriptorIndexAllocator.hpp"
+
+namespace
+{
+	constexpr uint32_t uInvalidIndex = DescriptorIndexAllocator::uInvalidIndex;
+
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: descbench [--operations N] [--persistent N]\n" );
+		return 1;
+	}
+
+	bool CheckSizeClasses()
+	{
+		bool bPassed = true;
+		bPassed &= DescriptorIndexAllocator::SizeClass( 1 ) == 0;
+		bPassed &= DescriptorIndexAllocator::SizeClass( 2 ) == 1;
+		bPassed &= DescriptorIndexAllocator::SizeClass( 3 ) == 2;
+		bPassed &= DescriptorIndexAllocator::SizeClass( 1u << 31 ) == 31;
+		bPassed &= DescriptorIndexAllocator::SizeClass( ( 1u << 31 ) + 1 ) == DescriptorIndexAllocator::uSizeClassCount;
+		bPassed &= DescriptorIndexAllocator::SizeClass( ~0u ) == DescriptorIndexAllocator::uSizeClassCount;
+
+		// Too large for any class is refused, and freeing it changes nothing.
+		DescriptorIndexAllocator kAllocator( 1024, 2, 64 );
+		bPassed &= kAllocator.AllocatePersistent( ~0u ) == uInvalidIndex;
+		bPassed &= kAllocator.AllocatePersistent( 0 ) == uInvalidIndex;
+		kAllocator.FreePersistent( 0, ~0u );
+		bPassed &= kAllocator.GetPersistentUsed() == 0;
+		return bPassed;
+	}
+
+	// A freed range goes back to its size class and is the next one that class hands out, other classes and the
+	// untouched part of the heap are not affected. Once the heap is used up only freed ranges come back.
+	bool CheckFreeListReuse()
+	{
+		DescriptorIndexAllocator kAllocator( 64, 2, 16 );
+		bool bPassed = true;
+
+		const uint32_t a = kAllocator.AllocatePersistent( 3 );		// rounded up to 4
+		const uint32_t b = kAllocator.AllocatePersistent( 1 );
+		const uint32_t c = kAllocator.AllocatePersistent( 4 );
+		bPassed &= a == 0 && b == 4 && c == 5 && kAllocator.GetPersistentUsed() == 9;
+
+		kAllocator.FreePersistent( a, 3 );
+		bPassed &= kAllocator.GetPersistentUsed() == 5;
+		bPassed &= kAllocator.AllocatePersistent( 2 ) == 9;			// another class, from the untouched part.
+		bPassed &= kAllocator.AllocatePersistent( 4 ) == a;
+
+		kAllocator.FreePersistent( c, 4 );
+		kAllocator.FreePersistent( a, 4 );
+		bPassed &= kAllocator.AllocatePersistent( 3 ) == a && kAllocator.AllocatePersistent( 3 ) == c;
+
+		// 11 of 64 are bumped, a 64 no longer fits and a 32 fills the heap up to 43.
+		bPassed &= kAllocator.AllocatePersistent( 64 ) == uInvalidIndex;
+		bPassed &= kAllocator.AllocatePersistent( 32 ) == 11;
+		bPassed &= kAllocator.AllocatePersistent( 32 ) == uInvalidIndex;
+		kAllocator.FreePersistent( 11, 32 );
+		bPassed &= kAllocator.AllocatePersistent( 17 ) == 11;
+		return bPassed;
+	}
+
+	// Every frame has its own region after the persistent one, BeginFrame rewinds it and never touches the others.
+	bool CheckTransientFrames()
+	{
+		DescriptorIndexAllocator kAllocator( 100, 3, 16 );
+		bool bPassed = kAllocator.GetCapacity() == 148;
+
+		for ( uint32_t round = 0; round < 2; ++round )
+		{
+			for ( uint32_t frame = 0; frame < 3; ++frame )
+			{
+				kAllocator.BeginFrame( frame );
+				const uint32_t begin = 100 + frame * 16;
+				bPassed &= kAllocator.GetTransientUsed() == 0;
+				bPassed &= kAllocator.AllocateTransient( 5 ) == begin;
+				bPassed &= kAllocator.AllocateTransient( 11 ) == begin + 5;
+				bPassed &= kAllocator.AllocateTransient( 1 ) == uInvalidIndex;
+				bPassed &= kAllocator.AllocateTransient( 0 ) == uInvalidIndex;
+				bPassed &= kAllocator.GetTransientUsed() == 16;
+			}
+		}
+
+		// Transient allocations never come out of the persistent region.
+		kAllocator.BeginFrame( 0 );
+		bPassed &= kAllocator.AllocatePersistent( 64 ) == 0 && kAllocator.AllocatePersistent( 64 ) == uInvalidIndex;
+		bPassed &= kAllocator.AllocateTransient( 16 ) == 100;
+		return bPassed;
+	}
+
+	struct LiveRange
+	{
+		uint32_t index;
+		uint32_t count;
+	};
+
+	// Random allocations and frees against a shadow of every live range: nothing overlaps, nothing leaves the
+	// persistent region, and GetPersistentUsed matches the rounded up sizes.
+	bool CheckRandom( uint32_t persistentCount, uint32_t operations )
+	{
+		DescriptorIndexAllocator kAllocator( persistentCount, 2, 256 );
+		std::vector< uint8_t > owned( persistentCount, 0 );
+		std::vector< LiveRange > live;
+
+		uint32_t seed = 12345;
+		auto Random = [ &seed ]( uint32_t range )
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return ( seed >> 8 ) % range;
+		};
+
+		bool bPassed = true;
+		uint32_t expectedUsed = 0;
+		for ( uint32_t n = 0; n < operations; ++n )
+		{
+			if ( !live.empty() && Random( 2 ) == 0 )
+			{
+				const size_t slot = Random( static_cast< uint32_t >( live.size() ) );
+				const LiveRange kRange = live[ slot ];
+				live[ slot ] = live.back();
+				live.pop_back();
+
+				const uint32_t blockSize = 1u << DescriptorIndexAllocator::SizeClass( kRange.count );
+				std::fill( owned.begin() + kRange.index, owned.begin() + kRange.index + blockSize, 0 );
+				expectedUsed -= blockSize;
+				kAllocator.FreePersistent( kRange.index, kRange.count );
+				continue;
+			}
+
+			// Mostly single descriptors, some small tables.
+			const uint32_t count = ( Random( 4 ) != 0 ) ? 1 : 1 + Random( 24 );
+			const uint32_t index = kAllocator.AllocatePersistent( count );
+			if ( index == uInvalidIndex )
+			{
+				continue;
+			}
+
+			const uint32_t blockSize = 1u << DescriptorIndexAllocator::SizeClass( count );
+			bPassed &= index + blockSize <= persistentCount;
+			if ( index + blockSize <= persistentCount )
+			{
+				bPassed &= std::none_of( owned.begin() + index, owned.begin() + index + blockSize, []( uint8_t b ) { return b != 0; } );
+				std::fill( owned.begin() + index, owned.begin() + index + blockSize, 1 );
+			}
+			expectedUsed += blockSize;
+			live.push_back( { index, count } );
+		}
+
+		bPassed &= kAllocator.GetPersistentUsed() == expectedUsed;
+		return bPassed;
+	}
+
+	// Allocate and free one descriptor while `liveCount` others stay live, in nanoseconds per pair.
+	double TimeAllocateFree( uint32_t liveCount, uint32_t operations )
+	{
+		DescriptorIndexAllocator kAllocator( liveCount + 1024, 1, 0 );
+		for ( uint32_t n = 0; n < liveCount; ++n )
+		{
+			kAllocator.AllocatePersistent( 1 + ( n & 7 ) );
+		}
+
+		HighResolutionClock kClock;
+		uint32_t checksum = 0;
+		const uint64_t begin = kClock.GetCounter();
+		for ( uint32_t n = 0; n < operations; ++n )
+		{
+			const uint32_t count = 1 + ( n & 7 );
+			const uint32_t index = kAllocator.AllocatePersistent( count );
+			checksum += index;
+			kAllocator.FreePersistent( index, count );
+		}
+		const double seconds = static_cast< double >( kClock.GetCounter() - begin ) / kClock.GetFrequency();
+		return ( checksum == 0xFFFFFFFFu ) ? 0.0 : seconds * 1e9 / operations;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t operations = 1000000;
+	uint32_t persistentCount = 4096;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--operations" ) == 0 && hasValue )
+		{
+			operations = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--persistent" ) == 0 && hasValue )
+		{
+			persistentCount = static_cast< uint32_t >( std::max( 64, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	int result = 0;
+	const struct
+	{
+		const char* name;
+		bool bPassed;
+	} checks[] =
+	{
+		{ "size classes", CheckSizeClasses() },
+		{ "free-list reuse", CheckFreeListReuse() },
+		{ "transient frames", CheckTransientFrames() },
+		{ "random allocations", CheckRandom( persistentCount, operations ) },
+	};
+	for ( const auto& kCheck : checks )
+	{
+		printf( "%-20s %s\n", kCheck.name, kCheck.bPassed ? "ok" : "FAILED" );
+		result |= kCheck.bPassed ? 0 : 1;
+	}
+
+	printf( "%12s %16s\n", "live ranges", "ns/alloc+free" );
+	for ( uint32_t liveCount : { 16u, 1024u, 1u << 20 } )
+	{
+		printf( "%12u %16.1f\n", liveCount, TimeAllocateFree( liveCount, operations ) );
+	}
+	return result;
+}
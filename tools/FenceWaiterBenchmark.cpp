@@ -0,0 +1,222 @@
+// FenceWaiter against software fences signaled from other threads: checks that no callback runs before its value
+// was reached, that every fence's callbacks run in value order and that futures, Cancel and destruction behave,
+// then reports how long it took from a signal to its callback.
+// usage: fencebench [--fences N] [--values N]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Clock.hpp"
+#include "FenceWaiter.hpp"
+#include "SoftwareFence.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: fencebench [--fences N] [--values N]\n" );
+		return 1;
+	}
+
+	struct StressResult
+	{
+		bool bPassed = true;
+		uint64_t callbacks = 0;
+		uint64_t wakeups = 0;
+		double p50Microseconds = 0.0;
+		double p99Microseconds = 0.0;
+	};
+
+	// Every value of every fence gets a callback while the fences are being signaled, some of them register
+	// another one from inside the callback.
+	StressResult RunStress( uint32_t fenceCount, uint32_t valueCount )
+	{
+		HighResolutionClock kClock;
+		std::vector< std::unique_ptr< SoftwareFence > > fences;
+		std::vector< std::unique_ptr< std::atomic< uint64_t >[] > > signalCounters;
+		for ( uint32_t n = 0; n < fenceCount; ++n )
+		{
+			fences.push_back( std::make_unique< SoftwareFence >() );
+			signalCounters.push_back( std::make_unique< std::atomic< uint64_t >[] >( valueCount + 1 ) );
+		}
+
+		// Only touched by the waiter's thread.
+		std::vector< uint64_t > lastValues( fenceCount, 0 );
+		std::vector< double > latencies;
+		std::atomic< bool > bFailed{ false };
+		std::atomic< uint64_t > registered{ 0 };
+
+		FenceWaiter kWaiter;
+		// Order is only kept between callbacks that were waiting at the same time, a chained one may come in
+		// after later values already ran, so those are not checked against the previous value.
+		std::function< void( uint32_t, uint64_t, bool ) > Register = [ & ]( uint32_t fence, uint64_t value, bool bChained )
+		{
+			registered.fetch_add( 1 );
+			kWaiter.OnCompletion( *fences[ fence ], value, [ &, fence, value, bChained ]()
+			{
+				if ( fences[ fence ]->GetCompletedValue() < value || ( !bChained && value < lastValues[ fence ] ) )
+				{
+					bFailed = true;
+				}
+				if ( !bChained )
+				{
+					lastValues[ fence ] = value;
+				}
+
+				const uint64_t signalCounter = signalCounters[ fence ][ value ].load();
+				if ( signalCounter != 0 )
+				{
+					latencies.push_back( static_cast< double >( kClock.GetCounter() - signalCounter ) * 1e6 / kClock.GetFrequency() );
+				}
+				if ( value % 16 == 0 && value + 8 <= valueCount )
+				{
+					Register( fence, value + 8, true );
+				}
+			} );
+		};
+
+		std::vector< std::thread > signalers;
+		for ( uint32_t n = 0; n < fenceCount; ++n )
+		{
+			signalers.emplace_back( [ &, n ]()
+			{
+				for ( uint64_t value = 1; value <= valueCount; ++value )
+				{
+					signalCounters[ n ][ value ].store( kClock.GetCounter() );
+					fences[ n ]->Signal( value );
+					std::this_thread::sleep_for( std::chrono::microseconds( ( value % 4 == 0 ) ? 50 : 0 ) );
+				}
+			} );
+		}
+
+		// Registered while the signals come in, so some values passed already and some did not.
+		for ( uint64_t value = 1; value <= valueCount; ++value )
+		{
+			for ( uint32_t n = 0; n < fenceCount; ++n )
+			{
+				Register( n, value, false );
+			}
+		}
+		for ( std::thread& kThread : signalers )
+		{
+			kThread.join();
+		}
+
+		StressResult kResult;
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+		while ( kWaiter.GetStats().callbacksRun < registered.load() && std::chrono::steady_clock::now() < deadline )
+		{
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+		}
+		// Chained registrations only happen inside callbacks, so once the counts matched nothing is added anymore.
+		kResult.callbacks = kWaiter.GetStats().callbacksRun;
+		kResult.wakeups = kWaiter.GetStats().wakeups;
+		kResult.bPassed = !bFailed && kResult.callbacks == registered.load();
+
+		if ( !latencies.empty() )
+		{
+			std::sort( latencies.begin(), latencies.end() );
+			kResult.p50Microseconds = latencies[ latencies.size() / 2 ];
+			kResult.p99Microseconds = latencies[ latencies.size() * 99 / 100 ];
+		}
+		return kResult;
+	}
+
+	bool CheckFutures()
+	{
+		FenceWaiter kWaiter;
+		SoftwareFence kFence( 5 );
+
+		// Already reached, neither may block.
+		kWaiter.Wait( kFence, 5 );
+		bool bPassed = kWaiter.WhenComplete( kFence, 3 ).wait_for( std::chrono::seconds( 10 ) ) == std::future_status::ready;
+
+		std::future< void > throwing = kWaiter.WhenComplete( kFence, 7, []() { throw std::runtime_error( "callback failed" ); } );
+		std::future< void > waiting = kWaiter.WhenComplete( kFence, 8 );
+		kFence.Signal( 7 );
+		try
+		{
+			throwing.get();
+			bPassed = false;
+		}
+		catch ( const std::runtime_error& )
+		{
+		}
+		bPassed &= waiting.wait_for( std::chrono::milliseconds( 20 ) ) == std::future_status::timeout;
+
+		std::thread signaler( [ &kFence ]() { kFence.Signal( 8 ); } );
+		kWaiter.Wait( kFence, 8 );
+		signaler.join();
+		bPassed &= waiting.wait_for( std::chrono::seconds( 10 ) ) == std::future_status::ready;
+		return bPassed;
+	}
+
+	bool CheckCancel()
+	{
+		std::atomic< uint32_t > dropped{ 0 };
+		SoftwareFence kFence;
+		{
+			FenceWaiter kWaiter;
+			kWaiter.OnCompletion( kFence, 2, [ &dropped ]() { ++dropped; } );
+			kWaiter.Cancel( kFence );
+			kFence.Signal( 2 );
+			// The same fence still works after Cancel, and its callbacks run in order, so this one comes last.
+			kWaiter.Wait( kFence, 2 );
+
+			// Destroyed with this one pending, it has to be dropped as well. kFence must not be signaled past 2
+			// afterwards, it still holds on to the waiter's event.
+			kWaiter.OnCompletion( kFence, 3, [ &dropped ]() { ++dropped; } );
+		}
+		return dropped.load() == 0;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t fenceCount = 4;
+	uint32_t valueCount = 2000;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--fences" ) == 0 && hasValue )
+		{
+			fenceCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--values" ) == 0 && hasValue )
+		{
+			valueCount = static_cast< uint32_t >( std::max( 16, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	int result = 0;
+	const StressResult kStress = RunStress( fenceCount, valueCount );
+	printf( "%u fences x %u values: %llu callbacks in %llu wakeups, signal to callback p50 %.1f us, p99 %.1f us\n",
+			fenceCount, valueCount, static_cast< unsigned long long >( kStress.callbacks ), static_cast< unsigned long long >( kStress.wakeups ),
+			kStress.p50Microseconds, kStress.p99Microseconds );
+	if ( !kStress.bPassed )
+	{
+		fprintf( stderr, "a callback ran early, out of order or not at all\n" );
+		result = 1;
+	}
+	if ( !CheckFutures() )
+	{
+		fprintf( stderr, "a future did not resolve or did not pass the exception on\n" );
+		result = 1;
+	}
+	if ( !CheckCancel() )
+	{
+		fprintf( stderr, "a cancelled callback ran\n" );
+		result = 1;
+	}
+	return result;
+}
@@ -0,0 +1,212 @@
+// Frame pacing against a simulated GPU and display: input-to-present latency against frame rate for 1 to 4
+// frames in flight, GPU bound, CPU bound and vsynced, plus the old pacing that only waited on the fence.
+// usage: framepacing [--frames N]
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Clock.hpp"
+#include "FramePacer.hpp"
+#include "NullCommandBackend.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: framepacing [--frames N]\n" );
+		return 1;
+	}
+
+	// Microseconds.
+	const uint64_t s_clockFrequency = 1000000;
+
+	uint64_t Microseconds( double milliseconds )
+	{
+		return static_cast< uint64_t >( milliseconds * 1000.0 );
+	}
+
+	// One queue that runs frames back to back, time only moves when the simulated CPU works or waits.
+	class SimulatedGpu : public NullCommandBackend
+	{
+	public:
+		explicit SimulatedGpu( FakeClock& kClock ) : m_kClock( kClock ) {}
+
+		// Fence values are 1, 2, 3, ... in submission order.
+		void Submit( uint64_t gpuCost )
+		{
+			m_busyUntil = std::max( m_busyUntil, m_kClock.GetCounter() ) + gpuCost;
+			m_finishCounters.push_back( m_busyUntil );
+		}
+
+		uint64_t GetFinishCounter( uint64_t fenceValue ) const { return m_finishCounters[ fenceValue - 1 ]; }
+
+		uint64_t GetCompletedValue() override
+		{
+			const auto it = std::upper_bound( m_finishCounters.begin(), m_finishCounters.end(), m_kClock.GetCounter() );
+			return static_cast< uint64_t >( it - m_finishCounters.begin() );
+		}
+
+		void WaitForFence( uint64_t fenceValue ) override { WaitUntil( GetFinishCounter( fenceValue ) ); }
+
+		void WaitUntil( uint64_t counter )
+		{
+			if ( counter > m_kClock.GetCounter() )
+			{
+				m_kClock.Advance( counter - m_kClock.GetCounter() );
+			}
+		}
+
+	private:
+		FakeClock& m_kClock;
+		std::vector< uint64_t > m_finishCounters;
+		uint64_t m_busyUntil = 0;
+	};
+
+	struct Scenario
+	{
+		const char* name;
+		double cpuMs;
+		double gpuMs;
+		double vsyncMs;		// 0 presents as soon as the GPU is done.
+	};
+
+	struct RunResult
+	{
+		double fps = 0.0;
+		double latencyMs = 0.0;			// input read until the frame is on screen.
+		double measuredLatencyMs = 0.0;	// what FramePacer saw, from the flips reported back to it.
+		double gpuLatencyMs = 0.0;		// input read until FramePacer saw the fence complete.
+		uint32_t fenceWaits = 0;
+	};
+
+	// bWaitable: wait on the frame latency object ( maximum latency = frames in flight ) before the frame starts,
+	// like HelloWindow does. Otherwise the CPU only blocks on the pacer's fence and inside Present, once
+	// DXGI's default of 3 frames is queued.
+	RunResult Run( const Scenario& kScenario, uint32_t framesInFlight, bool bWaitable, uint32_t frameCount )
+	{
+		FakeClock kClock( s_clockFrequency );
+		SimulatedGpu kGpu( kClock );
+		FramePacer kPacer( kGpu, kClock, framesInFlight );
+		const uint32_t maxLatency = bWaitable ? kPacer.GetFramesInFlight() : 3;
+		const uint64_t vsync = Microseconds( kScenario.vsyncMs );
+
+		std::vector< uint64_t > shown;
+		uint32_t reportedCount = 0;
+		const uint32_t warmupFrames = std::min( 20u, frameCount / 2 );
+		double latencySum = 0.0;
+		for ( uint32_t frame = 0; frame < frameCount; ++frame )
+		{
+			// The latency object is signaled every time a queued frame goes on screen.
+			if ( bWaitable && frame >= maxLatency )
+			{
+				kGpu.WaitUntil( shown[ frame - maxLatency ] );
+			}
+
+			// Like DXGI's frame statistics, the flips that already happened are known when the next frame starts.
+			while ( reportedCount < shown.size() && shown[ reportedCount ] <= kClock.GetCounter() )
+			{
+				kPacer.OnFrameShown( reportedCount + 1, shown[ reportedCount ] );
+				++reportedCount;
+			}
+
+			kPacer.BeginFrame();
+			const uint64_t inputCounter = kClock.GetCounter();
+			kClock.Advance( Microseconds( kScenario.cpuMs ) );
+			kGpu.Submit( Microseconds( kScenario.gpuMs ) );
+
+			// Flip at the first vblank after the GPU is done, and at most one frame per vblank.
+			uint64_t shownCounter = kGpu.GetFinishCounter( frame + 1 );
+			if ( !shown.empty() )
+			{
+				shownCounter = std::max( shownCounter, shown.back() + vsync );
+			}
+			if ( vsync != 0 )
+			{
+				shownCounter = ( shownCounter + vsync - 1 ) / vsync * vsync;
+			}
+			shown.push_back( shownCounter );
+
+			// Present blocks while the queue is full.
+			if ( !bWaitable && frame >= maxLatency )
+			{
+				kGpu.WaitUntil( shown[ frame - maxLatency ] );
+			}
+			kPacer.EndFrame( frame + 1, frame + 1 );
+
+			if ( frame >= warmupFrames )
+			{
+				latencySum += static_cast< double >( shownCounter - inputCounter );
+			}
+		}
+
+		RunResult kResult;
+		const uint32_t measuredFrames = frameCount - warmupFrames;
+		const double seconds = static_cast< double >( shown.back() - shown[ warmupFrames ] ) / s_clockFrequency;
+		kResult.fps = ( measuredFrames - 1 ) / seconds;
+		kResult.latencyMs = latencySum / measuredFrames / 1000.0;
+		kResult.measuredLatencyMs = kPacer.GetStats().inputToPresentSeconds * 1000.0;
+		kResult.gpuLatencyMs = kPacer.GetStats().inputToGpuSeconds * 1000.0;
+		kResult.fenceWaits = kPacer.GetStats().fenceWaits;
+		return kResult;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t frameCount = 500;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--frames" ) == 0 && hasValue )
+		{
+			frameCount = static_cast< uint32_t >( std::max( 50, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	const Scenario scenarios[] =
+	{
+		{ "gpu bound", 4.0, 10.0, 0.0 },
+		{ "cpu bound", 10.0, 4.0, 0.0 },
+		{ "vsync 60", 4.0, 6.0, 1000.0 / 60.0 },
+	};
+
+	int result = 0;
+	printf( "%-10s %-9s %7s %8s %11s %12s %12s %11s\n", "scenario", "pacing", "frames", "fps", "latency ms", "measured ms", "to gpu ms", "fence waits" );
+	for ( const Scenario& kScenario : scenarios )
+	{
+		const double bottleneckMs = std::max( kScenario.cpuMs, kScenario.gpuMs );
+		double previousLatency = 0.0;
+		for ( uint32_t framesInFlight = 1; framesInFlight <= FramePacer::uMaxFramesInFlight; ++framesInFlight )
+		{
+			const RunResult kResult = Run( kScenario, framesInFlight, true, frameCount );
+			printf( "%-10s %-9s %7u %8.1f %11.2f %12.2f %12.2f %11u\n", kScenario.name, "waitable", framesInFlight, kResult.fps,
+					kResult.latencyMs, kResult.measuredLatencyMs, kResult.gpuLatencyMs, kResult.fenceWaits );
+
+			// One frame in flight serializes CPU and GPU, two are enough to keep the slower one busy. Vsync caps both.
+			const double serialMs = ( framesInFlight == 1 ) ? kScenario.cpuMs + kScenario.gpuMs : bottleneckMs;
+			const double expectedFps = 1000.0 / std::max( serialMs, kScenario.vsyncMs );
+			result |= ( kScenario.vsyncMs != 0.0 || fabs( kResult.fps - expectedFps ) <= expectedFps * 0.01 ) ? 0 : 1;
+			// More frames queued never lowers latency, and the latency object keeps the fence from ever waiting.
+			result |= ( kResult.latencyMs + 1e-6 >= previousLatency && kResult.fenceWaits == 0 ) ? 0 : 1;
+			// The pacer's own number has to match the timeline once it settled.
+			result |= ( fabs( kResult.measuredLatencyMs - kResult.latencyMs ) <= kResult.latencyMs * 0.02 ) ? 0 : 1;
+			previousLatency = kResult.latencyMs;
+		}
+
+		const RunResult kFenceOnly = Run( kScenario, 2, false, frameCount );
+		printf( "%-10s %-9s %7u %8.1f %11.2f %12.2f %12.2f %11u\n", kScenario.name, "fence", 2u, kFenceOnly.fps,
+				kFenceOnly.latencyMs, kFenceOnly.measuredLatencyMs, kFenceOnly.gpuLatencyMs, kFenceOnly.fenceWaits );
+	}
+
+	if ( result != 0 )
+	{
+		fprintf( stderr, "frame pacing gave an unexpected frame rate or latency\n" );
+	}
+	return result;
+}
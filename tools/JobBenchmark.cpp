@@ -0,0 +1,172 @@
+// Job system scaling from 1 to N workers: parallel for, many tiny jobs, a fork-join tree and chained stages.
+// usage: jobbench [--threads N] [--repeat N]
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Clock.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: jobbench [--threads N] [--repeat N]\n" );
+		return 1;
+	}
+
+	// Something for the cores to chew on that the compiler cannot fold away.
+	double Work( uint32_t begin, uint32_t end )
+	{
+		double sum = 0.0;
+		for ( uint32_t i = begin; i < end; ++i )
+		{
+			sum += sqrt( static_cast< double >( i ) );
+		}
+		return sum;
+	}
+
+	// Every node spawns two children and waits on them, so the tree only finishes quickly when idle threads steal.
+	void Spawn( ThreadPool& kPool, uint32_t depth, std::atomic< uint32_t >& leaves )
+	{
+		if ( depth == 0 )
+		{
+			leaves.fetch_add( ( Work( 0, 2000 ) > 0.0 ) ? 1 : 0, std::memory_order_relaxed );
+			return;
+		}
+		JobCounter kChildren;
+		kPool.Run( [ &kPool, depth, &leaves ]() { Spawn( kPool, depth - 1, leaves ); }, &kChildren );
+		kPool.Run( [ &kPool, depth, &leaves ]() { Spawn( kPool, depth - 1, leaves ); }, &kChildren );
+		kPool.Wait( kChildren );
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t maxThreads = std::max( 1u, std::thread::hardware_concurrency() );
+	uint32_t repeat = 5;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--threads" ) == 0 && hasValue )
+		{
+			maxThreads = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--repeat" ) == 0 && hasValue )
+		{
+			repeat = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	HighResolutionClock kClock;
+	const double frequency = static_cast< double >( kClock.GetFrequency() );
+	auto Measure = [ & ]( auto&& body )
+	{
+		double best = 1e30;
+		for ( uint32_t n = 0; n < repeat; ++n )
+		{
+			const uint64_t begin = kClock.GetCounter();
+			body();
+			best = std::min( best, static_cast< double >( kClock.GetCounter() - begin ) / frequency );
+		}
+		return best;
+	};
+
+	const uint32_t forCount = 1u << 24;
+	const uint32_t tinyJobCount = 1u << 17;
+	const uint32_t treeDepth = 12;
+	const uint32_t stageCount = 16;
+	const uint32_t jobsPerStage = 64;
+
+	// Results are always checked, so the serial runs cannot be optimized into something the pooled ones are not.
+	double expectedSum = 0.0;
+	const double serialFor = Measure( [ & ]() { expectedSum = Work( 0, forCount ); } );
+	uint32_t serialLeaves = 0;
+	const double serialTree = Measure( [ & ]()
+	{
+		for ( uint32_t n = 0; n < ( 1u << treeDepth ); ++n )
+		{
+			serialLeaves += ( Work( 0, 2000 ) > 0.0 ) ? 1 : 0;
+		}
+	} );
+	int result = ( serialLeaves == ( 1u << treeDepth ) * repeat ) ? 0 : 1;
+
+	// The calling thread helps, so N workers means N + 1 threads.
+	printf( "%7s %12s %8s %14s %12s %8s %12s\n", "threads", "for ms", "speedup", "tiny job ns", "tree ms", "speedup", "stages ms" );
+	printf( "%7u %12.3f %8.2f %14s %12.3f %8.2f %12s\n", 1u, serialFor * 1e3, 1.0, "-", serialTree * 1e3, 1.0, "-" );
+	for ( uint32_t workers = 1; workers < maxThreads; workers = std::min( workers * 2, maxThreads - 1 ) )
+	{
+		ThreadPool kPool( workers );
+
+		std::vector< double > partial( ( forCount + ( 1u << 14 ) - 1 ) >> 14 );
+		const double forSeconds = Measure( [ & ]()
+		{
+			kPool.ParallelFor( forCount, 1u << 14, [ & ]( uint32_t begin, uint32_t end ) { partial[ begin >> 14 ] = Work( begin, end ); } );
+		} );
+		double sum = 0.0;
+		for ( const double value : partial )
+		{
+			sum += value;
+		}
+		// Chunk sums added in a different order, only close to the serial one.
+		result |= ( fabs( sum - expectedSum ) <= expectedSum * 1e-9 ) ? 0 : 1;
+
+		std::atomic< uint32_t > tinyDone{ 0 };
+		const double tinySeconds = Measure( [ & ]()
+		{
+			JobCounter kCounter;
+			for ( uint32_t n = 0; n < tinyJobCount; ++n )
+			{
+				kPool.Run( [ &tinyDone ]() { tinyDone.fetch_add( 1, std::memory_order_relaxed ); }, &kCounter );
+			}
+			kPool.Wait( kCounter );
+		} );
+		result |= ( tinyDone.load() == tinyJobCount * repeat ) ? 0 : 1;
+
+		std::atomic< uint32_t > leaves{ 0 };
+		const double treeSeconds = Measure( [ & ]() { Spawn( kPool, treeDepth, leaves ); } );
+		result |= ( leaves.load() == ( 1u << treeDepth ) * repeat ) ? 0 : 1;
+
+		// Stage s only starts once every job of stage s - 1 is done, each job reads what the previous stage wrote.
+		std::vector< uint32_t > values( jobsPerStage );
+		bool bStagesInOrder = true;
+		const double stageSeconds = Measure( [ & ]()
+		{
+			std::fill( values.begin(), values.end(), 0u );
+			std::vector< JobCounter > stages( stageCount );
+			for ( uint32_t stage = 0; stage < stageCount; ++stage )
+			{
+				for ( uint32_t job = 0; job < jobsPerStage; ++job )
+				{
+					kPool.Run( [ &values, job, stage ]()
+					{
+						values[ job ] = ( values[ job ] == stage ) ? stage + 1 : 0xFFFFFFFF;
+					}, &stages[ stage ], ( stage > 0 ) ? &stages[ stage - 1 ] : nullptr );
+				}
+			}
+			kPool.Wait( stages.back() );
+			bStagesInOrder &= std::all_of( values.begin(), values.end(), [ & ]( uint32_t value ) { return value == stageCount; } );
+		} );
+		result |= bStagesInOrder ? 0 : 1;
+
+		printf( "%7u %12.3f %8.2f %14.1f %12.3f %8.2f %12.3f\n", workers + 1, forSeconds * 1e3, serialFor / forSeconds, tinySeconds / tinyJobCount * 1e9,
+				treeSeconds * 1e3, serialTree / treeSeconds, stageSeconds * 1e3 );
+		if ( workers == maxThreads - 1 )
+		{
+			break;
+		}
+	}
+
+	if ( result != 0 )
+	{
+		fprintf( stderr, "a job system run gave a wrong result\n" );
+	}
+	return result;
+}
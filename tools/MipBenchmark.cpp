@@ -0,0 +1,129 @@
+// Scalar against SIMD mip generation on random 1K / 4K / 8K images, box and Kaiser, sRGB and linear, single threaded
+// like the headless --mip-benchmark, plus the SIMD path on the job system. Also checks that one SIMD downsample stays
+// within one step of the scalar reference, both round to 8 bits from slightly different float math.
+// usage: mipbench [--max-size N] [--threads N]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Clock.hpp"
+#include "MipGenerator.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: mipbench [--max-size N] [--threads N]\n" );
+		return 1;
+	}
+
+	int MaxDifference( const std::vector< uint8_t >& a, const std::vector< uint8_t >& b )
+	{
+		int difference = 0;
+		for ( size_t n = 0; n < a.size(); ++n )
+		{
+			difference = std::max( difference, abs( static_cast< int >( a[ n ] ) - static_cast< int >( b[ n ] ) ) );
+		}
+		return difference;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t maxSize = 8192;
+	uint32_t threadCount = 0;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--max-size" ) == 0 && hasValue )
+		{
+			maxSize = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--threads" ) == 0 && hasValue )
+		{
+			threadCount = static_cast< uint32_t >( std::max( 0, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	HighResolutionClock kClock;
+	const double frequency = static_cast< double >( kClock.GetFrequency() );
+	ThreadPool kPool( threadCount );
+
+	// Same seed every run so the numbers are comparable.
+	std::mt19937 kRandom( 1234 );
+
+	bool bPassed = true;
+	printf( "%6s %7s %7s %10s %10s %8s %10s %9s\n", "size", "filter", "space", "scalar ms", "simd ms", "speedup", "pool ms", "max diff" );
+	for ( uint32_t size : { 1024u, 4096u, 8192u } )
+	{
+		if ( size > maxSize )
+		{
+			continue;
+		}
+
+		std::vector< uint8_t > image( static_cast< size_t >( size ) * size * 4 );
+		for ( auto& texel : image )
+		{
+			texel = static_cast< uint8_t >( kRandom() );
+		}
+
+		for ( MipFilter filter : { MipFilter::Box, MipFilter::Kaiser } )
+		{
+			for ( bool bGammaCorrect : { true, false } )
+			{
+				std::vector< uint8_t > chains[ 2 ];
+				double milliseconds[ 2 ] = {};
+				for ( uint32_t simd = 0; simd < 2; ++simd )
+				{
+					MipGenerateOptions kOptions;
+					kOptions.filter = filter;
+					kOptions.gammaCorrect = bGammaCorrect;
+					kOptions.useSimd = simd != 0;
+
+					const uint64_t begin = kClock.GetCounter();
+					MipGenerator::Generate( image.data(), size, size, static_cast< size_t >( size ) * 4, kOptions, chains[ simd ] );
+					milliseconds[ simd ] = static_cast< double >( kClock.GetCounter() - begin ) / frequency * 1000.0;
+				}
+
+				MipGenerateOptions kOptions;
+				kOptions.filter = filter;
+				kOptions.gammaCorrect = bGammaCorrect;
+				std::vector< uint8_t > pooled;
+				const uint64_t begin = kClock.GetCounter();
+				MipGenerator::Generate( image.data(), size, size, static_cast< size_t >( size ) * 4, kOptions, pooled, &kPool );
+				const double poolMilliseconds = static_cast< double >( kClock.GetCounter() - begin ) / frequency * 1000.0;
+				bPassed &= pooled == chains[ 1 ];
+
+				// The first level from the same source, later levels start from sources that already differ.
+				const uint32_t half = size / 2;
+				std::vector< uint8_t > levels[ 2 ];
+				for ( uint32_t simd = 0; simd < 2; ++simd )
+				{
+					kOptions.useSimd = simd != 0;
+					levels[ simd ].resize( static_cast< size_t >( half ) * half * 4 );
+					MipGenerator::Downsample( image.data(), size, size, static_cast< size_t >( size ) * 4, levels[ simd ].data(), half, half,
+											  static_cast< size_t >( half ) * 4, kOptions );
+				}
+				const int difference = MaxDifference( levels[ 0 ], levels[ 1 ] );
+				bPassed &= difference <= 1;
+
+				printf( "%6u %7s %7s %10.2f %10.2f %8.2f %10.2f %9d\n", size, filter == MipFilter::Box ? "box" : "kaiser", bGammaCorrect ? "srgb" : "linear",
+						milliseconds[ 0 ], milliseconds[ 1 ], milliseconds[ 0 ] / milliseconds[ 1 ], poolMilliseconds, difference );
+			}
+		}
+	}
+
+	if ( !bPassed )
+	{
+		fprintf( stderr, "the SIMD filters are more than one step off the scalar ones, or the pool changed the result\n" );
+		return 1;
+	}
+	return 0;
+}
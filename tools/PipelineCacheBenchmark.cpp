@@ -0,0 +1,407 @@
+// Pipeline cache on a fake driver: compiling costs time, loading a blob is cheap but only works on the driver version
+// that wrote it and for the description it came from. Checks the hash (known value, field boundaries, pointers are
+// followed, every field counts), a cold and a warm run through the file, invalidation on a driver or adapter change,
+// blobs the driver turns down, and damaged files. Reports how much faster the warm start is.
+// usage: pipelinecache [--pipelines N] [--threads N]
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "Clock.hpp"
+#include "PipelineCache.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: pipelinecache [--pipelines N] [--threads N]\n" );
+		return 1;
+	}
+
+	bool Check( bool bCondition, const char* pName )
+	{
+		if ( !bCondition )
+		{
+			fprintf( stderr, "failed: %s\n", pName );
+		}
+		return bCondition;
+	}
+
+	uint32_t Random( uint32_t& seed, uint32_t range )
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return ( seed >> 8 ) % range;
+	}
+
+	struct FakeElement
+	{
+		std::string semanticName;
+		uint32_t semanticIndex;
+		uint32_t format;
+		uint32_t offset;
+	};
+
+	// The parts of a D3D12_GRAPHICS_PIPELINE_STATE_DESC that matter here: blobs, an input layout with strings behind
+	// pointers, and fixed state.
+	struct FakeDesc
+	{
+		std::vector< uint8_t > rootSignature;
+		std::vector< uint8_t > vertexShader;
+		std::vector< uint8_t > pixelShader;
+		std::vector< FakeElement > inputLayout;
+		uint32_t cullMode;
+		uint32_t blendEnable;
+		float depthBias;
+		uint32_t renderTargetFormat;
+	};
+
+	// Field by field, the way D3D12GraphicsPipeline hashes the real description. The driver salts it to tell
+	// whether a blob belongs to a description without going through the cache's hash.
+	uint64_t HashDesc( const FakeDesc& kDesc, uint32_t salt = 0 )
+	{
+		Hasher kHasher;
+		kHasher.Add( salt );
+		kHasher.AddBlob( kDesc.rootSignature.data(), kDesc.rootSignature.size() );
+		kHasher.AddBlob( kDesc.vertexShader.data(), kDesc.vertexShader.size() );
+		kHasher.AddBlob( kDesc.pixelShader.data(), kDesc.pixelShader.size() );
+		kHasher.Add( static_cast< uint32_t >( kDesc.inputLayout.size() ) );
+		for ( const FakeElement& kElement : kDesc.inputLayout )
+		{
+			kHasher.AddString( kElement.semanticName.c_str() );
+			kHasher.Add( kElement.semanticIndex );
+			kHasher.Add( kElement.format );
+			kHasher.Add( kElement.offset );
+		}
+		kHasher.Add( kDesc.cullMode );
+		kHasher.Add( kDesc.blendEnable );
+		kHasher.Add( kDesc.depthBias );
+		kHasher.Add( kDesc.renderTargetFormat );
+		return kHasher.GetHash();
+	}
+
+	struct FakeDriver
+	{
+		uint64_t version = 1;
+		uint32_t compileRounds = 32;
+		std::atomic< uint32_t > compiles{ 0 };
+		std::atomic< uint32_t > blobLoads{ 0 };
+	};
+
+	// Blob: driver version, salted description hash, the compiled code, then padding the size of the shaders.
+	class FakePipeline : public ICachedPipeline
+	{
+	public:
+		FakePipeline( FakeDriver& kDriver, const FakeDesc& kDesc ) : m_kDriver( kDriver ), m_kDesc( kDesc ) {}
+
+		uint64_t GetHash() const override { return HashDesc( m_kDesc ); }
+
+		bool Create( const void* pBlob, size_t blobSize ) override
+		{
+			if ( pBlob )
+			{
+				uint64_t header[ 3 ] = {};
+				if ( blobSize < sizeof( header ) )
+				{
+					return false;
+				}
+				memcpy( header, pBlob, sizeof( header ) );
+				if ( header[ 0 ] != m_kDriver.version || header[ 1 ] != HashDesc( m_kDesc, 0x5A17 ) )
+				{
+					return false;
+				}
+				m_code = header[ 2 ];
+				++m_kDriver.blobLoads;
+				return true;
+			}
+
+			// Compiling goes over the shaders many times over.
+			Hasher kCompiler;
+			for ( uint32_t round = 0; round < m_kDriver.compileRounds; ++round )
+			{
+				kCompiler.AddBlob( m_kDesc.vertexShader.data(), m_kDesc.vertexShader.size() );
+				kCompiler.AddBlob( m_kDesc.pixelShader.data(), m_kDesc.pixelShader.size() );
+			}
+			m_code = kCompiler.GetHash() ^ HashDesc( m_kDesc, 0xC0DE );
+			++m_kDriver.compiles;
+			return true;
+		}
+
+		std::vector< uint8_t > GetCachedBlob() const override
+		{
+			const uint64_t header[ 3 ] = { m_kDriver.version, HashDesc( m_kDesc, 0x5A17 ), m_code };
+			std::vector< uint8_t > blob( sizeof( header ) + ( m_kDesc.vertexShader.size() + m_kDesc.pixelShader.size() ) / 4 );
+			memcpy( blob.data(), header, sizeof( header ) );
+			return blob;
+		}
+
+		uint64_t GetCode() const { return m_code; }
+
+	private:
+		FakeDriver& m_kDriver;
+		const FakeDesc& m_kDesc;
+		uint64_t m_code = 0;
+
+	};
+
+	std::vector< uint8_t > RandomBytes( uint32_t& seed, uint32_t minSize, uint32_t maxSize )
+	{
+		std::vector< uint8_t > bytes( minSize + Random( seed, maxSize - minSize + 1 ) );
+		for ( uint8_t& byte : bytes )
+		{
+			byte = static_cast< uint8_t >( Random( seed, 256 ) );
+		}
+		return bytes;
+	}
+
+	FakeDesc RandomDesc( uint32_t& seed )
+	{
+		static const char* s_semantics[] = { "POSITION", "NORMAL", "TEXCOORD", "COLOR", "TANGENT" };
+		FakeDesc kDesc;
+		kDesc.rootSignature = RandomBytes( seed, 64, 256 );
+		kDesc.vertexShader = RandomBytes( seed, 2048, 16384 );
+		kDesc.pixelShader = RandomBytes( seed, 2048, 16384 );
+		const uint32_t elementCount = 1 + Random( seed, 5 );
+		uint32_t offset = 0;
+		for ( uint32_t n = 0; n < elementCount; ++n )
+		{
+			kDesc.inputLayout.push_back( { s_semantics[ Random( seed, 5 ) ], Random( seed, 2 ), 1 + Random( seed, 100 ), offset } );
+			offset += 4 * ( 1 + Random( seed, 4 ) );
+		}
+		kDesc.cullMode = Random( seed, 3 );
+		kDesc.blendEnable = Random( seed, 2 );
+		kDesc.depthBias = static_cast< float >( Random( seed, 4 ) );
+		kDesc.renderTargetFormat = 1 + Random( seed, 100 );
+		return kDesc;
+	}
+
+	bool CheckHasher( uint32_t& seed )
+	{
+		bool bResult = true;
+
+		// 64-bit FNV-1a of "a", the hash must not change from build to build or the cache is lost every time.
+		Hasher kKnown;
+		kKnown.Add( static_cast< uint8_t >( 'a' ) );
+		bResult &= Check( kKnown.GetHash() == 0xAF63DC4C8601EC8Cull, "hash of a known value" );
+
+		Hasher kFirst;
+		kFirst.AddBlob( "ab", 2 );
+		kFirst.AddBlob( "c", 1 );
+		Hasher kSecond;
+		kSecond.AddBlob( "a", 1 );
+		kSecond.AddBlob( "bc", 2 );
+		bResult &= Check( kFirst.GetHash() != kSecond.GetHash(), "blob boundaries count" );
+
+		Hasher kNull;
+		kNull.AddString( nullptr );
+		Hasher kEmpty;
+		kEmpty.AddString( "" );
+		bResult &= Check( kNull.GetHash() == kEmpty.GetHash(), "nullptr hashes like empty" );
+
+		// The same description in other memory hashes the same, any change to it does not.
+		const FakeDesc kDesc = RandomDesc( seed );
+		const FakeDesc kCopy = kDesc;
+		const uint64_t hash = HashDesc( kDesc );
+		bResult &= Check( HashDesc( kCopy ) == hash, "a copy hashes the same" );
+
+		std::vector< FakeDesc > changed( 12, kDesc );
+		changed[ 0 ].rootSignature.back() ^= 1;
+		changed[ 1 ].vertexShader[ changed[ 1 ].vertexShader.size() / 2 ] ^= 0x80;
+		changed[ 2 ].pixelShader.front() ^= 1;
+		changed[ 3 ].inputLayout[ 0 ].semanticName += "X";
+		changed[ 4 ].inputLayout[ 0 ].semanticIndex += 1;
+		changed[ 5 ].inputLayout[ 0 ].format += 1;
+		changed[ 6 ].inputLayout[ 0 ].offset += 4;
+		changed[ 7 ].inputLayout.push_back( { "COLOR", 0, 28, 64 } );
+		changed[ 8 ].cullMode += 1;
+		changed[ 9 ].blendEnable ^= 1;
+		changed[ 10 ].depthBias += 0.5f;
+		changed[ 11 ].renderTargetFormat += 1;
+		std::set< uint64_t > hashes = { hash };
+		for ( const FakeDesc& kChanged : changed )
+		{
+			hashes.insert( HashDesc( kChanged ) );
+		}
+		bResult &= Check( hashes.size() == changed.size() + 1, "every field changes the hash" );
+		return bResult;
+	}
+
+	std::vector< uint8_t > ReadFile( const std::filesystem::path& path )
+	{
+		std::ifstream in( path, std::ios::binary );
+		return std::vector< uint8_t >( std::istreambuf_iterator< char >( in ), std::istreambuf_iterator< char >() );
+	}
+
+	void WriteFile( const std::filesystem::path& path, const std::vector< uint8_t >& bytes, size_t size )
+	{
+		std::ofstream out( path, std::ios::binary | std::ios::trunc );
+		out.write( reinterpret_cast< const char* >( bytes.data() ), static_cast< std::streamsize >( size ) );
+	}
+
+	struct RunResult
+	{
+		double milliseconds = 0.0;
+		std::vector< uint64_t > codes;
+		PipelineCacheStats kStats;
+		uint32_t compiles = 0;
+		uint32_t blobLoads = 0;
+	};
+
+	// Every pipeline at once on the pool, like a load screen.
+	RunResult CreateAll( PipelineCache& kCache, FakeDriver& kDriver, const std::vector< FakeDesc >& descs, ThreadPool& kPool )
+	{
+		kDriver.compiles = 0;
+		kDriver.blobLoads = 0;
+		std::vector< std::unique_ptr< FakePipeline > > pipelines;
+		for ( const FakeDesc& kDesc : descs )
+		{
+			pipelines.push_back( std::make_unique< FakePipeline >( kDriver, kDesc ) );
+		}
+
+		HighResolutionClock kClock;
+		const uint64_t startCounter = kClock.GetCounter();
+		JobCounter kJobs;
+		for ( const std::unique_ptr< FakePipeline >& spPipeline : pipelines )
+		{
+			kCache.CreateAsync( *spPipeline, kPool, kJobs );
+		}
+		kPool.Wait( kJobs );
+
+		RunResult kResult;
+		kResult.milliseconds = static_cast< double >( kClock.GetCounter() - startCounter ) * 1000.0 / kClock.GetFrequency();
+		for ( const std::unique_ptr< FakePipeline >& spPipeline : pipelines )
+		{
+			kResult.codes.push_back( spPipeline->GetCode() );
+		}
+		kResult.kStats = kCache.GetStats();
+		kResult.compiles = kDriver.compiles;
+		kResult.blobLoads = kDriver.blobLoads;
+		return kResult;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t pipelineCount = 256;
+	uint32_t threadCount = 0;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--pipelines" ) == 0 && hasValue )
+		{
+			pipelineCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--threads" ) == 0 && hasValue )
+		{
+			threadCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	uint32_t seed = 12345;
+	int result = CheckHasher( seed ) ? 0 : 1;
+
+	// Distinct descriptions, the way a renderer ends up with permutations.
+	std::vector< FakeDesc > descs;
+	std::set< uint64_t > hashes;
+	while ( descs.size() < pipelineCount )
+	{
+		FakeDesc kDesc = RandomDesc( seed );
+		if ( hashes.insert( HashDesc( kDesc ) ).second )
+		{
+			descs.push_back( std::move( kDesc ) );
+		}
+	}
+
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "pipelinecache";
+	const std::filesystem::path path = directory / "pipelines.ldpc";
+	std::filesystem::remove_all( directory );
+
+	ThreadPool kPool( threadCount );
+	FakeDriver kDriver;
+	PipelineCacheIdentity kIdentity;
+	kIdentity.vendorId = 0x10DE;
+	kIdentity.deviceId = 0x2684;
+	kIdentity.driverVersion = kDriver.version;
+
+	// First run: nothing on disk, everything is compiled and written out.
+	PipelineCache kColdCache( kIdentity );
+	result |= Check( kColdCache.Load( path ) == PipelineCacheLoad::Missing, "no file is missing" ) ? 0 : 1;
+	const RunResult kCold = CreateAll( kColdCache, kDriver, descs, kPool );
+	result |= Check( kCold.kStats.misses == pipelineCount && kCold.compiles == pipelineCount && kCold.kStats.entries == pipelineCount,
+					 "a cold cache compiles everything once" ) ? 0 : 1;
+	result |= Check( kColdCache.IsDirty(), "a cold cache has to be saved" ) ? 0 : 1;
+	kColdCache.Save( path );
+	result |= Check( !kColdCache.IsDirty() && !std::filesystem::exists( directory / "pipelines.ldpc.tmp" ), "saved in place" ) ? 0 : 1;
+	const std::vector< uint8_t > file = ReadFile( path );
+
+	// Second run: every pipeline from its blob, the same pipelines, and nothing to save.
+	PipelineCache kWarmCache( kIdentity );
+	result |= Check( kWarmCache.Load( path ) == PipelineCacheLoad::Loaded, "the saved file loads" ) ? 0 : 1;
+	const RunResult kWarm = CreateAll( kWarmCache, kDriver, descs, kPool );
+	result |= Check( kWarm.kStats.hits == pipelineCount && kWarm.compiles == 0 && kWarm.blobLoads == pipelineCount,
+					 "a warm cache compiles nothing" ) ? 0 : 1;
+	result |= Check( kWarm.codes == kCold.codes, "pipelines from blobs match the compiled ones" ) ? 0 : 1;
+	result |= Check( !kWarmCache.IsDirty(), "a warm cache has nothing to save" ) ? 0 : 1;
+	const std::filesystem::path copyPath = directory / "copy.ldpc";
+	kWarmCache.Save( copyPath );
+	result |= Check( ReadFile( copyPath ) == file, "the same blobs give the same file" ) ? 0 : 1;
+
+	// The identity changes with a driver update or another adapter, the whole file goes.
+	PipelineCacheIdentity kUpdated = kIdentity;
+	kUpdated.driverVersion += 1;
+	PipelineCache kUpdatedCache( kUpdated );
+	result |= Check( kUpdatedCache.Load( path ) == PipelineCacheLoad::Invalidated && kUpdatedCache.GetStats().entries == 0,
+					 "another driver invalidates the file" ) ? 0 : 1;
+	PipelineCacheIdentity kOtherAdapter = kIdentity;
+	kOtherAdapter.deviceId += 1;
+	PipelineCache kOtherCache( kOtherAdapter );
+	result |= Check( kOtherCache.Load( path ) == PipelineCacheLoad::Invalidated, "another adapter invalidates the file" ) ? 0 : 1;
+
+	// A driver that changed without the identity showing it turns every blob down, each is compiled again and replaced.
+	kDriver.version += 1;
+	PipelineCache kStaleCache( kIdentity );
+	kStaleCache.Load( path );
+	const RunResult kStale = CreateAll( kStaleCache, kDriver, descs, kPool );
+	result |= Check( kStale.kStats.rejected == pipelineCount && kStale.compiles == pipelineCount && kStale.codes == kCold.codes,
+					 "rejected blobs are compiled again" ) ? 0 : 1;
+	result |= Check( kStaleCache.IsDirty() && kStaleCache.GetStats().entries == pipelineCount, "rejected blobs are replaced" ) ? 0 : 1;
+	kDriver.version -= 1;
+
+	// Damaged files never load, never throw, and leave the cache empty.
+	bool bDamage = true;
+	bool bTruncate = true;
+	const std::filesystem::path damagedPath = directory / "damaged.ldpc";
+	const size_t step = std::max< size_t >( 1, file.size() / 97 );
+	for ( size_t position = 0; position < file.size(); position += ( position < 64 ) ? 1 : step )
+	{
+		PipelineCache kDamaged( kIdentity );
+		WriteFile( damagedPath, file, position );
+		bTruncate &= kDamaged.Load( damagedPath ) != PipelineCacheLoad::Loaded && kDamaged.GetStats().entries == 0;
+
+		std::vector< uint8_t > damaged = file;
+		damaged[ position ] ^= 0x10;
+		WriteFile( damagedPath, damaged, damaged.size() );
+		bDamage &= kDamaged.Load( damagedPath ) != PipelineCacheLoad::Loaded && kDamaged.GetStats().entries == 0;
+	}
+	result |= Check( bTruncate, "truncated files are thrown away" ) ? 0 : 1;
+	result |= Check( bDamage, "damaged files are thrown away" ) ? 0 : 1;
+	std::filesystem::remove_all( directory );
+
+	printf( "%u pipelines on %u threads: cold %.1f ms ( %u compiled ), warm %.1f ms ( %u from blobs ), %.1fx faster\n",
+			pipelineCount, kPool.GetThreadCount(), kCold.milliseconds, kCold.compiles, kWarm.milliseconds, kWarm.blobLoads,
+			kCold.milliseconds / std::max( kWarm.milliseconds, 0.001 ) );
+	printf( "cache file: %.1f KB for %u entries\n", file.size() / 1024.0, kCold.kStats.entries );
+	return result;
+}
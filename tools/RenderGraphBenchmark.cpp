@@ -0,0 +1,658 @@
+// Render graph compilation: fixed cases for culling, barriers, read combining, aliasing and the errors, then random
+// graphs with many passes. Every random graph is replayed twice, the culled passes must not change what ends up in
+// the outputs, every barrier has to start from the state the resource is in, every use has to see its state, and
+// no two resources alive at the same time may share memory. Reports the transient memory saved by aliasing.
+// usage: graphbench [--graphs N] [--passes N] [--resources N]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "Clock.hpp"
+#include "RenderGraph.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: graphbench [--graphs N] [--passes N] [--resources N]\n" );
+		return 1;
+	}
+
+	// Stand-ins for D3D12 states, only their values matter. Reads can be combined, writes can not.
+	const uint32_t uPresent = 0x0;
+	const uint32_t s_readStates[] = { 0x1, 0x2, 0x8 };
+	const uint32_t s_writeStates[] = { 0x4, 0x10, 0x20 };
+	const uint64_t uBlock = 64 * 1024;
+
+	bool Check( bool bCondition, const char* pName )
+	{
+		if ( !bCondition )
+		{
+			fprintf( stderr, "failed: %s\n", pName );
+		}
+		return bCondition;
+	}
+
+	bool SameBarrier( const RenderGraphBarrier& kBarrier, RenderGraphBarrierType type, uint32_t resource, uint32_t before, uint32_t after )
+	{
+		return kBarrier.type == type && kBarrier.resource == resource && kBarrier.before == before && kBarrier.after == after;
+	}
+
+	RenderGraphResourceDesc MakeDesc( uint64_t blocks, RenderGraphHeap heap = RenderGraphHeap::Textures )
+	{
+		RenderGraphResourceDesc kDesc;
+		kDesc.sizeBytes = blocks * uBlock;
+		kDesc.heap = heap;
+		return kDesc;
+	}
+
+	template< typename Function >
+	bool Throws( Function function )
+	{
+		try
+		{
+			function();
+		}
+		catch ( const std::runtime_error& )
+		{
+			return true;
+		}
+		return false;
+	}
+
+	bool CheckFixedCases()
+	{
+		bool bPassed = true;
+		RenderGraph kGraph;
+
+		// Only what reaches the output is kept, unless the pass has side effects.
+		{
+			kGraph.Reset();
+			const uint32_t output = kGraph.Import( "Output", nullptr, uPresent, uPresent );
+			const uint32_t used = kGraph.Create( "Used", MakeDesc( 1 ) );
+			const uint32_t unused = kGraph.Create( "Unused", MakeDesc( 1 ) );
+			const uint32_t chain = kGraph.Create( "Chain", MakeDesc( 1 ) );
+			const uint32_t query = kGraph.Create( "Query", MakeDesc( 1 ) );
+			const uint32_t producer = kGraph.AddPass( "Producer", nullptr );
+			kGraph.Write( producer, used, 0x4 );
+			const uint32_t dead = kGraph.AddPass( "Dead", nullptr );
+			kGraph.Write( dead, unused, 0x4 );
+			const uint32_t deadChain = kGraph.AddPass( "Dead chain", nullptr );
+			kGraph.Read( deadChain, unused, 0x1 );
+			kGraph.Write( deadChain, chain, 0x4 );
+			const uint32_t consumer = kGraph.AddPass( "Consumer", nullptr );
+			kGraph.Read( consumer, used, 0x1 );
+			kGraph.Write( consumer, output, 0x4 );
+			const uint32_t readback = kGraph.AddPass( "Readback", nullptr, true );
+			kGraph.Write( readback, query, 0x4 );
+			kGraph.Compile();
+
+			const std::vector< RenderGraphCompiledPass >& passes = kGraph.GetCompiledPasses();
+			bPassed &= Check( passes.size() == 3 && passes[ 0 ].pass == producer && passes[ 1 ].pass == consumer && passes[ 2 ].pass == readback,
+							  "culling keeps the outputs and side effects" );
+			bPassed &= Check( kGraph.GetStats().culledPasses == 2 && kGraph.GetStats().culledResources == 2 && kGraph.GetStats().transientResources == 2,
+							  "culled stats" );
+			bPassed &= Check( !kGraph.GetPlacement( unused ).bUsed && !kGraph.GetPlacement( chain ).bUsed, "culled resources take no memory" );
+		}
+
+		// A write keeps the contents, so the clear before a draw stays.
+		{
+			kGraph.Reset();
+			const uint32_t output = kGraph.Import( "Output", nullptr, uPresent, uPresent );
+			const uint32_t scratch = kGraph.Create( "Scratch", MakeDesc( 1 ) );
+			const uint32_t clear = kGraph.AddPass( "Clear", nullptr );
+			kGraph.Write( clear, output, 0x4 );
+			kGraph.Write( clear, scratch, 0x4 );
+			const uint32_t draw = kGraph.AddPass( "Draw", nullptr );
+			kGraph.Write( draw, output, 0x4 );
+			kGraph.Write( draw, scratch, 0x4 );
+			kGraph.Compile();
+			bPassed &= Check( kGraph.GetCompiledPasses().size() == 2, "earlier writers of an output are kept" );
+		}
+
+		// Also when the clear only writes a transient the kept pass only writes as well, like a depth buffer.
+		{
+			kGraph.Reset();
+			const uint32_t output = kGraph.Import( "Output", nullptr, uPresent, uPresent );
+			const uint32_t depth = kGraph.Create( "Depth", MakeDesc( 1 ) );
+			const uint32_t clear = kGraph.AddPass( "Clear depth", nullptr );
+			kGraph.Write( clear, depth, 0x10 );
+			const uint32_t scene = kGraph.AddPass( "Scene", nullptr );
+			kGraph.Write( scene, depth, 0x10 );
+			kGraph.Write( scene, output, 0x4 );
+			kGraph.Compile();
+
+			const std::vector< RenderGraphCompiledPass >& passes = kGraph.GetCompiledPasses();
+			bPassed &= Check( passes.size() == 2 && passes[ 0 ].pass == clear && passes[ 1 ].pass == scene && kGraph.GetStats().culledPasses == 0,
+							  "earlier writers of a write-only transient are kept" );
+		}
+
+		// Transitions before the pass, the output goes back to its final state after its last pass, and a transient
+		// back to the state its next frame starts in.
+		{
+			kGraph.Reset();
+			const uint32_t output = kGraph.Import( "Output", nullptr, uPresent, uPresent );
+			const uint32_t input = kGraph.Import( "Input", nullptr, 0x1, 0x1 );
+			const uint32_t target = kGraph.Create( "Target", MakeDesc( 1 ) );
+			const uint32_t first = kGraph.AddPass( "First", nullptr );
+			kGraph.Write( first, target, 0x4 );
+			kGraph.Read( first, input, 0x1 );
+			const uint32_t second = kGraph.AddPass( "Second", nullptr );
+			kGraph.Read( second, target, 0x2 );
+			kGraph.Read( second, target, 0x8 );
+			kGraph.Write( second, output, 0x10 );
+			kGraph.Compile();
+
+			const std::vector< RenderGraphCompiledPass >& passes = kGraph.GetCompiledPasses();
+			bPassed &= Check( passes[ 0 ].barriersBefore.empty() && passes[ 0 ].barriersAfter.empty(), "nothing to do in the state it starts in" );
+			bPassed &= Check( passes[ 1 ].barriersBefore.size() == 2 &&
+							  SameBarrier( passes[ 1 ].barriersBefore[ 0 ], RenderGraphBarrierType::Transition, target, 0x4, 0xA ) &&
+							  SameBarrier( passes[ 1 ].barriersBefore[ 1 ], RenderGraphBarrierType::Transition, output, uPresent, 0x10 ),
+							  "reads combined into one transition" );
+			bPassed &= Check( passes[ 1 ].barriersAfter.size() == 2 &&
+							  SameBarrier( passes[ 1 ].barriersAfter[ 0 ], RenderGraphBarrierType::Transition, target, 0xA, 0x4 ) &&
+							  SameBarrier( passes[ 1 ].barriersAfter[ 1 ], RenderGraphBarrierType::Transition, output, 0x10, uPresent ),
+							  "final states after the last pass" );
+			bPassed &= Check( kGraph.GetPlacement( target ).initialState == 0x4 && kGraph.GetStats().transitions == 4, "transient initial state" );
+		}
+
+		// Same size, the first and last never alive together: they share memory, the middle one gets its own.
+		{
+			kGraph.Reset();
+			const uint32_t output = kGraph.Import( "Output", nullptr, uPresent, uPresent );
+			const uint32_t resources[] = { kGraph.Create( "A", MakeDesc( 4 ) ), kGraph.Create( "B", MakeDesc( 4 ) ), kGraph.Create( "C", MakeDesc( 4 ) ) };
+			const uint32_t buffer = kGraph.Create( "Buffer", MakeDesc( 4, RenderGraphHeap::Buffers ) );
+			uint32_t previous = RenderGraph::uInvalidIndex;
+			for ( uint32_t n = 0; n < 4; ++n )
+			{
+				const uint32_t pass = kGraph.AddPass( "Pass", nullptr );
+				if ( n < 3 )
+				{
+					kGraph.Write( pass, resources[ n ], 0x4 );
+				}
+				if ( previous != RenderGraph::uInvalidIndex )
+				{
+					kGraph.Read( pass, previous, 0x1 );
+				}
+				if ( n == 1 )
+				{
+					kGraph.Write( pass, buffer, 0x4 );
+				}
+				if ( n == 2 )
+				{
+					kGraph.Read( pass, buffer, 0x1 );
+				}
+				previous = ( n < 3 ) ? resources[ n ] : RenderGraph::uInvalidIndex;
+				if ( n == 3 )
+				{
+					kGraph.Write( pass, output, 0x4 );
+				}
+			}
+			kGraph.Compile();
+
+			const RenderGraphPlacement& kA = kGraph.GetPlacement( resources[ 0 ] );
+			const RenderGraphPlacement& kB = kGraph.GetPlacement( resources[ 1 ] );
+			const RenderGraphPlacement& kC = kGraph.GetPlacement( resources[ 2 ] );
+			bPassed &= Check( kA.offset == kC.offset && kB.offset != kA.offset && kA.bAliased && kC.bAliased && !kB.bAliased, "lifetimes alias" );
+			bPassed &= Check( kGraph.GetHeapLayout( RenderGraphHeap::Textures ).sizeBytes == 8 * uBlock &&
+							  kGraph.GetHeapLayout( RenderGraphHeap::Buffers ).sizeBytes == 4 * uBlock, "heap sizes" );
+			bPassed &= Check( kGraph.GetStats().transientBytes == 16 * uBlock && kGraph.GetStats().heapBytes == 12 * uBlock &&
+							  kGraph.GetStats().peakLiveBytes == 12 * uBlock, "memory stats" );
+
+			const std::vector< RenderGraphCompiledPass >& passes = kGraph.GetCompiledPasses();
+			bPassed &= Check( !passes[ 0 ].barriersBefore.empty() && !passes[ 2 ].barriersBefore.empty() &&
+							  SameBarrier( passes[ 0 ].barriersBefore[ 0 ], RenderGraphBarrierType::Aliasing, resources[ 0 ], RenderGraph::uInvalidIndex, 0 ) &&
+							  SameBarrier( passes[ 2 ].barriersBefore[ 0 ], RenderGraphBarrierType::Aliasing, resources[ 2 ], resources[ 0 ], 0 ) &&
+							  kGraph.GetStats().aliasingBarriers == 2, "aliasing barriers" );
+		}
+
+		// Alignment is kept, a small resource between two large ones still lands on its boundary.
+		{
+			kGraph.Reset();
+			const uint32_t output = kGraph.Import( "Output", nullptr, uPresent, uPresent );
+			RenderGraphResourceDesc kAligned = MakeDesc( 64 );
+			kAligned.alignment = 64 * uBlock;
+			const uint32_t small = kGraph.Create( "Small", MakeDesc( 1 ) );
+			const uint32_t large = kGraph.Create( "Large", kAligned );
+			const uint32_t pass = kGraph.AddPass( "Pass", nullptr );
+			kGraph.Write( pass, small, 0x4 );
+			kGraph.Write( pass, large, 0x4 );
+			kGraph.Write( pass, output, 0x4 );
+			kGraph.Compile();
+			bPassed &= Check( kGraph.GetPlacement( large ).offset == 0 && kGraph.GetPlacement( small ).offset == 64 * uBlock &&
+							  kGraph.GetHeapLayout( RenderGraphHeap::Textures ).alignment == 64 * uBlock, "alignment" );
+		}
+
+		// A UAV kept in one state gets no transitions, so a UAV barrier goes between a write and any access after it,
+		// and between a read and the write after it. Reads after reads, and render target writes, need none.
+		{
+			kGraph.Reset();
+			const uint32_t uUnorderedAccess = 0x8;
+			const uint32_t output = kGraph.Import( "Output", nullptr, uPresent, uPresent );
+			const uint32_t buffer = kGraph.Create( "Buffer", MakeDesc( 1, RenderGraphHeap::Buffers ) );
+			const uint32_t target = kGraph.Create( "Target", MakeDesc( 1 ) );
+			const uint32_t clear = kGraph.AddPass( "Clear", nullptr );
+			kGraph.Write( clear, buffer, uUnorderedAccess, true );
+			kGraph.Write( clear, target, 0x4 );
+			const uint32_t accumulate = kGraph.AddPass( "Accumulate", nullptr );
+			kGraph.Write( accumulate, buffer, uUnorderedAccess, true );
+			kGraph.Write( accumulate, target, 0x4 );
+			const uint32_t firstRead = kGraph.AddPass( "First read", nullptr, true );
+			kGraph.Read( firstRead, buffer, uUnorderedAccess, true );
+			kGraph.Read( firstRead, target, 0x1 );
+			const uint32_t secondRead = kGraph.AddPass( "Second read", nullptr, true );
+			kGraph.Read( secondRead, buffer, uUnorderedAccess, true );
+			const uint32_t resolve = kGraph.AddPass( "Resolve", nullptr );
+			kGraph.Write( resolve, buffer, uUnorderedAccess, true );
+			kGraph.Write( resolve, output, 0x4 );
+			kGraph.Compile();
+
+			const std::vector< RenderGraphCompiledPass >& passes = kGraph.GetCompiledPasses();
+			bPassed &= Check( passes.size() == 5 && passes[ 0 ].barriersBefore.empty() && passes[ 1 ].barriersBefore.size() == 1 &&
+							  SameBarrier( passes[ 1 ].barriersBefore[ 0 ], RenderGraphBarrierType::Uav, buffer, uUnorderedAccess, uUnorderedAccess ),
+							  "UAV barrier between writes, none between render target writes" );
+			bPassed &= Check( passes.size() == 5 && passes[ 2 ].barriersBefore.size() == 2 &&
+							  SameBarrier( passes[ 2 ].barriersBefore[ 0 ], RenderGraphBarrierType::Uav, buffer, uUnorderedAccess, uUnorderedAccess ) &&
+							  SameBarrier( passes[ 2 ].barriersBefore[ 1 ], RenderGraphBarrierType::Transition, target, 0x4, 0x1 ) &&
+							  passes[ 3 ].barriersBefore.empty(), "UAV barrier before the first read only" );
+			bPassed &= Check( passes.size() == 5 && passes[ 4 ].barriersBefore.size() == 2 &&
+							  SameBarrier( passes[ 4 ].barriersBefore[ 0 ], RenderGraphBarrierType::Uav, buffer, uUnorderedAccess, uUnorderedAccess ) &&
+							  kGraph.GetStats().uavBarriers == 3, "UAV barrier before a write after reads" );
+		}
+
+		// Mistakes are reported, not compiled.
+		{
+			kGraph.Reset();
+			const uint32_t output = kGraph.Import( "Output", nullptr, uPresent, uPresent );
+			const uint32_t target = kGraph.Create( "Target", MakeDesc( 1 ) );
+			const uint32_t pass = kGraph.AddPass( "Reads garbage", nullptr );
+			kGraph.Read( pass, target, 0x1 );
+			kGraph.Write( pass, output, 0x4 );
+			bPassed &= Check( Throws( [ & ]() { kGraph.Compile(); } ), "read before write" );
+
+			kGraph.Reset();
+			const uint32_t mixed = kGraph.AddPass( "Mixed", nullptr );
+			const uint32_t mixedOutput = kGraph.Import( "Output", nullptr, uPresent, uPresent );
+			kGraph.Write( mixed, mixedOutput, 0x4 );
+			kGraph.Read( mixed, mixedOutput, 0x1 );
+			bPassed &= Check( Throws( [ & ]() { kGraph.Compile(); } ), "write mixed with a read" );
+			bPassed &= Check( Throws( [ & ]() { kGraph.Write( mixed, 7, 0x4 ); } ) && Throws( [ & ]() { kGraph.Create( "Empty", RenderGraphResourceDesc() ); } ),
+							  "bad declarations" );
+		}
+		return bPassed;
+	}
+
+	struct DeclaredPass
+	{
+		std::vector< uint32_t > reads;
+		std::vector< uint32_t > readStates;
+		std::vector< uint32_t > writes;
+		std::vector< uint32_t > writeStates;
+		bool bSideEffects = false;
+	};
+
+	struct RandomGraph
+	{
+		std::vector< DeclaredPass > passes;
+		std::vector< uint32_t > outputs;	// imported resources.
+	};
+
+	// Passes mostly use the resources written shortly before them, like a real frame, so lifetimes are short
+	// and varied. A few passes write the outputs and a few have side effects.
+	RandomGraph BuildRandomGraph( RenderGraph& kGraph, uint32_t passCount, uint32_t resourceCount, uint32_t& seed )
+	{
+		auto Random = [ &seed ]( uint32_t range )
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return ( seed >> 8 ) % range;
+		};
+
+		RandomGraph kRandom;
+		kGraph.Reset();
+		kRandom.outputs.push_back( kGraph.Import( "Output", nullptr, uPresent, uPresent ) );
+		kRandom.outputs.push_back( kGraph.Import( "History", nullptr, 0x1, 0x1 ) );
+		std::vector< uint32_t > transients;
+		for ( uint32_t n = 0; n < resourceCount; ++n )
+		{
+			// Render targets from a quarter size buffer to full screen, some larger aligned ones, a few buffers.
+			RenderGraphResourceDesc kDesc = MakeDesc( 1 + Random( 128 ), static_cast< RenderGraphHeap >( Random( 8 ) == 0 ? 0 : 1 + Random( 2 ) ) );
+			if ( Random( 8 ) == 0 )
+			{
+				kDesc.alignment = 64 * uBlock;
+				kDesc.sizeBytes = ( 1 + Random( 4 ) ) * 64 * uBlock;
+			}
+			transients.push_back( kGraph.Create( "Transient", kDesc ) );
+		}
+
+		std::vector< uint32_t > written = { kRandom.outputs[ 1 ] };
+		for ( uint32_t p = 0; p < passCount; ++p )
+		{
+			DeclaredPass kPass;
+			kPass.bSideEffects = Random( 16 ) == 0;
+			const uint32_t pass = kGraph.AddPass( "Pass", nullptr, kPass.bSideEffects );
+
+			const uint32_t window = p * resourceCount / passCount;
+			const uint32_t writeCount = 1 + Random( 2 );
+			for ( uint32_t n = 0; n < writeCount; ++n )
+			{
+				const uint32_t resource = ( Random( 10 ) == 0 ) ? kRandom.outputs[ 0 ] : transients[ std::min( resourceCount - 1, window + Random( 4 ) ) ];
+				if ( std::find( kPass.writes.begin(), kPass.writes.end(), resource ) == kPass.writes.end() )
+				{
+					kPass.writes.push_back( resource );
+					kPass.writeStates.push_back( s_writeStates[ Random( 3 ) ] );
+				}
+			}
+			const uint32_t readCount = Random( 4 );
+			for ( uint32_t n = 0; n < readCount && !written.empty(); ++n )
+			{
+				const uint32_t recent = static_cast< uint32_t >( written.size() ) - 1 - Random( std::min< uint32_t >( 8, static_cast< uint32_t >( written.size() ) ) );
+				const uint32_t resource = written[ recent ];
+				if ( std::find( kPass.writes.begin(), kPass.writes.end(), resource ) == kPass.writes.end() )
+				{
+					kPass.reads.push_back( resource );
+					kPass.readStates.push_back( s_readStates[ Random( 3 ) ] );
+				}
+			}
+
+			for ( size_t n = 0; n < kPass.writes.size(); ++n )
+			{
+				kGraph.Write( pass, kPass.writes[ n ], kPass.writeStates[ n ] );
+				written.push_back( kPass.writes[ n ] );
+			}
+			for ( size_t n = 0; n < kPass.reads.size(); ++n )
+			{
+				kGraph.Read( pass, kPass.reads[ n ], kPass.readStates[ n ] );
+			}
+			kRandom.passes.push_back( kPass );
+		}
+		return kRandom;
+	}
+
+	uint64_t Mix( uint64_t hash, uint64_t value )
+	{
+		return ( hash ^ value ) * 1099511628211ull;
+	}
+
+	// Runs the passes on content hashes: a write mixes in everything the pass reads and what was in the resource,
+	// unless the frame had not written it yet. What a pass writes is also what it sees, like a depth test, so every
+	// write depends on what the pass's other writes held before it. Returns the outputs' contents and what the side
+	// effect passes saw.
+	std::vector< uint64_t > Simulate( const RenderGraph& kGraph, const RandomGraph& kRandom, const std::vector< uint32_t >& passOrder )
+	{
+		std::vector< uint64_t > contents( kGraph.GetResourceCount() );
+		std::vector< bool > bWritten( kGraph.GetResourceCount() );
+		for ( uint32_t output : kRandom.outputs )
+		{
+			contents[ output ] = 1000 + output;
+			bWritten[ output ] = true;
+		}
+
+		std::vector< uint64_t > results;
+		for ( uint32_t pass : passOrder )
+		{
+			const DeclaredPass& kPass = kRandom.passes[ pass ];
+			uint64_t inputs = Mix( 0xcbf29ce484222325ull, pass );
+			for ( uint32_t resource : kPass.reads )
+			{
+				inputs = Mix( inputs, contents[ resource ] );
+			}
+			for ( uint32_t resource : kPass.writes )
+			{
+				inputs = Mix( inputs, bWritten[ resource ] ? contents[ resource ] : 0 );
+			}
+			for ( uint32_t resource : kPass.writes )
+			{
+				contents[ resource ] = inputs;
+				bWritten[ resource ] = true;
+			}
+			if ( kPass.bSideEffects )
+			{
+				results.push_back( inputs );
+			}
+		}
+		for ( uint32_t output : kRandom.outputs )
+		{
+			results.push_back( contents[ output ] );
+		}
+		return results;
+	}
+
+	bool MemoryOverlaps( const RenderGraphPlacement& kFirst, const RenderGraphPlacement& kSecond )
+	{
+		return kFirst.offset < kSecond.offset + kSecond.sizeBytes && kSecond.offset < kFirst.offset + kFirst.sizeBytes;
+	}
+
+	bool SameHeapAndOverlaps( const RenderGraph& kGraph, uint32_t first, uint32_t second )
+	{
+		return !kGraph.IsImported( first ) && !kGraph.IsImported( second ) && kGraph.GetPlacement( first ).bUsed && kGraph.GetPlacement( second ).bUsed &&
+			kGraph.GetResourceDesc( first ).heap == kGraph.GetResourceDesc( second ).heap &&
+			MemoryOverlaps( kGraph.GetPlacement( first ), kGraph.GetPlacement( second ) );
+	}
+
+	// Placement: aligned, inside the heap, and nothing alive at the same time shares memory.
+	bool CheckPlacement( const RenderGraph& kGraph )
+	{
+		bool bValid = true;
+		for ( uint32_t resource = 0; resource < kGraph.GetResourceCount(); ++resource )
+		{
+			if ( kGraph.IsImported( resource ) || !kGraph.GetPlacement( resource ).bUsed )
+			{
+				continue;
+			}
+			const RenderGraphPlacement& kPlacement = kGraph.GetPlacement( resource );
+			const RenderGraphResourceDesc& kDesc = kGraph.GetResourceDesc( resource );
+			bValid &= ( kPlacement.offset % kDesc.alignment ) == 0;
+			bValid &= kPlacement.offset + kPlacement.sizeBytes <= kGraph.GetHeapLayout( kDesc.heap ).sizeBytes;
+			for ( uint32_t other = resource + 1; other < kGraph.GetResourceCount(); ++other )
+			{
+				if ( SameHeapAndOverlaps( kGraph, resource, other ) )
+				{
+					const RenderGraphPlacement& kOther = kGraph.GetPlacement( other );
+					bValid &= kPlacement.lastPass < kOther.firstPass || kOther.lastPass < kPlacement.firstPass;
+				}
+			}
+		}
+		const RenderGraphStats& kStats = kGraph.GetStats();
+		bValid &= kStats.peakLiveBytes <= kStats.heapBytes && kStats.heapBytes <= kStats.transientBytes;
+		return bValid;
+	}
+
+	// Replays the barriers on a simulated device: every transition starts where the resource is, every use sees its
+	// state, aliased memory is only used by the resource that took it over last, and the frame ends where it started.
+	bool CheckBarriers( const RenderGraph& kGraph, const RandomGraph& kRandom )
+	{
+		bool bValid = true;
+		const uint32_t resourceCount = kGraph.GetResourceCount();
+		std::vector< uint32_t > states( resourceCount );
+		std::vector< bool > bActive( resourceCount );
+		for ( uint32_t resource = 0; resource < resourceCount; ++resource )
+		{
+			const RenderGraphPlacement& kPlacement = kGraph.GetPlacement( resource );
+			states[ resource ] = kGraph.IsImported( resource ) ? ( resource == kRandom.outputs[ 0 ] ? uPresent : 0x1 ) : kPlacement.initialState;
+			bActive[ resource ] = kGraph.IsImported( resource ) || !kPlacement.bAliased;
+		}
+
+		auto Apply = [ & ]( const std::vector< RenderGraphBarrier >& barriers )
+		{
+			for ( const RenderGraphBarrier& kBarrier : barriers )
+			{
+				if ( kBarrier.type == RenderGraphBarrierType::Transition )
+				{
+					bValid &= states[ kBarrier.resource ] == kBarrier.before;
+					states[ kBarrier.resource ] = kBarrier.after;
+					continue;
+				}
+				if ( kBarrier.type == RenderGraphBarrierType::Uav )
+				{
+					bValid &= states[ kBarrier.resource ] == kBarrier.before && kBarrier.before == kBarrier.after;
+					continue;
+				}
+				// Naming the resource before is only right when nothing else had any of the memory this frame.
+				uint32_t earlierCount = 0;
+				for ( uint32_t other = 0; other < resourceCount; ++other )
+				{
+					if ( other != kBarrier.resource && SameHeapAndOverlaps( kGraph, other, kBarrier.resource ) )
+					{
+						bActive[ other ] = false;
+						earlierCount += ( kGraph.GetPlacement( other ).lastPass < kGraph.GetPlacement( kBarrier.resource ).firstPass ) ? 1 : 0;
+					}
+				}
+				bValid &= kBarrier.before == RenderGraph::uInvalidIndex ||
+					( earlierCount == 1 && SameHeapAndOverlaps( kGraph, kBarrier.before, kBarrier.resource ) &&
+					  kGraph.GetPlacement( kBarrier.before ).lastPass < kGraph.GetPlacement( kBarrier.resource ).firstPass );
+				bActive[ kBarrier.resource ] = true;
+			}
+		};
+
+		for ( const RenderGraphCompiledPass& kCompiled : kGraph.GetCompiledPasses() )
+		{
+			Apply( kCompiled.barriersBefore );
+			const DeclaredPass& kPass = kRandom.passes[ kCompiled.pass ];
+			for ( size_t n = 0; n < kPass.writes.size(); ++n )
+			{
+				bValid &= states[ kPass.writes[ n ] ] == kPass.writeStates[ n ] && bActive[ kPass.writes[ n ] ];
+			}
+			for ( size_t n = 0; n < kPass.reads.size(); ++n )
+			{
+				bValid &= ( states[ kPass.reads[ n ] ] & kPass.readStates[ n ] ) == kPass.readStates[ n ] && bActive[ kPass.reads[ n ] ];
+			}
+			Apply( kCompiled.barriersAfter );
+		}
+
+		bValid &= states[ kRandom.outputs[ 0 ] ] == uPresent && states[ kRandom.outputs[ 1 ] ] == 0x1;
+		for ( uint32_t resource = 0; resource < resourceCount; ++resource )
+		{
+			bValid &= kGraph.IsImported( resource ) || states[ resource ] == kGraph.GetPlacement( resource ).initialState;
+		}
+		return bValid;
+	}
+
+	struct RandomResult
+	{
+		bool bCulling = true;
+		bool bPlacement = true;
+		bool bBarriers = true;
+		bool bDeterministic = true;
+		uint64_t passes = 0;
+		uint64_t culledPasses = 0;
+		uint64_t transitions = 0;
+		uint64_t aliasingBarriers = 0;
+		uint64_t transientBytes = 0;
+		uint64_t heapBytes = 0;
+		uint64_t peakLiveBytes = 0;
+		double microsecondsPerCompile = 0.0;
+	};
+
+	RandomResult RunRandom( uint32_t graphCount, uint32_t passCount, uint32_t resourceCount )
+	{
+		RandomResult kResult;
+		RenderGraph kGraph;
+		HighResolutionClock kClock;
+		uint64_t compileCounter = 0;
+		uint32_t seed = 12345;
+		for ( uint32_t graph = 0; graph < graphCount; ++graph )
+		{
+			const RandomGraph kRandom = BuildRandomGraph( kGraph, passCount, resourceCount, seed );
+			const uint64_t startCounter = kClock.GetCounter();
+			kGraph.Compile();
+			compileCounter += kClock.GetCounter() - startCounter;
+
+			std::vector< uint32_t > allPasses( passCount );
+			for ( uint32_t n = 0; n < passCount; ++n )
+			{
+				allPasses[ n ] = n;
+			}
+			std::vector< uint32_t > keptPasses;
+			for ( const RenderGraphCompiledPass& kCompiled : kGraph.GetCompiledPasses() )
+			{
+				keptPasses.push_back( kCompiled.pass );
+			}
+			kResult.bCulling &= Simulate( kGraph, kRandom, allPasses ) == Simulate( kGraph, kRandom, keptPasses );
+			kResult.bPlacement &= CheckPlacement( kGraph );
+			kResult.bBarriers &= CheckBarriers( kGraph, kRandom );
+
+			const RenderGraphStats kStats = kGraph.GetStats();
+			kResult.passes += kStats.passes;
+			kResult.culledPasses += kStats.culledPasses;
+			kResult.transitions += kStats.transitions;
+			kResult.aliasingBarriers += kStats.aliasingBarriers;
+			kResult.transientBytes += kStats.transientBytes;
+			kResult.heapBytes += kStats.heapBytes;
+			kResult.peakLiveBytes += kStats.peakLiveBytes;
+
+			// Compiling the same declarations again gives the same frame.
+			std::vector< uint64_t > offsets;
+			for ( uint32_t resource = 0; resource < kGraph.GetResourceCount(); ++resource )
+			{
+				offsets.push_back( kGraph.GetPlacement( resource ).offset );
+			}
+			const std::vector< RenderGraphCompiledPass > compiledPasses = kGraph.GetCompiledPasses();
+			kGraph.Compile();
+			for ( uint32_t resource = 0; resource < kGraph.GetResourceCount(); ++resource )
+			{
+				kResult.bDeterministic &= kGraph.GetPlacement( resource ).offset == offsets[ resource ];
+			}
+			kResult.bDeterministic &= compiledPasses.size() == kGraph.GetCompiledPasses().size();
+			for ( size_t n = 0; n < compiledPasses.size() && kResult.bDeterministic; ++n )
+			{
+				const RenderGraphCompiledPass& kFirst = compiledPasses[ n ];
+				const RenderGraphCompiledPass& kSecond = kGraph.GetCompiledPasses()[ n ];
+				kResult.bDeterministic &= kFirst.pass == kSecond.pass && kFirst.barriersBefore.size() == kSecond.barriersBefore.size() &&
+					kFirst.barriersAfter.size() == kSecond.barriersAfter.size() &&
+					std::equal( kFirst.barriersBefore.begin(), kFirst.barriersBefore.end(), kSecond.barriersBefore.begin(), []( const RenderGraphBarrier& kA, const RenderGraphBarrier& kB )
+					{
+						return SameBarrier( kA, kB.type, kB.resource, kB.before, kB.after );
+					} );
+			}
+		}
+		kResult.microsecondsPerCompile = static_cast< double >( compileCounter ) * 1e6 / kClock.GetFrequency() / std::max( graphCount, 1u );
+		return kResult;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t graphCount = 200;
+	uint32_t passCount = 64;
+	uint32_t resourceCount = 48;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--graphs" ) == 0 && hasValue )
+		{
+			graphCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--passes" ) == 0 && hasValue )
+		{
+			passCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--resources" ) == 0 && hasValue )
+		{
+			resourceCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	int result = CheckFixedCases() ? 0 : 1;
+
+	const RandomResult kResult = RunRandom( graphCount, passCount, resourceCount );
+	const double megabytes = 1.0 / ( 1024.0 * 1024.0 * graphCount );
+	printf( "%u graphs x %u passes, %u transient resources: %.1f passes culled, %.1f transitions, %.1f aliasing barriers per graph\n",
+			graphCount, passCount, resourceCount, static_cast< double >( kResult.culledPasses ) / graphCount,
+			static_cast< double >( kResult.transitions ) / graphCount, static_cast< double >( kResult.aliasingBarriers ) / graphCount );
+	printf( "transient memory per graph: %.1f MB one by one, %.1f MB aliased ( %.1f%% saved ), %.1f MB at the peak, %.1f us per compile\n",
+			kResult.transientBytes * megabytes, kResult.heapBytes * megabytes,
+			100.0 * ( 1.0 - static_cast< double >( kResult.heapBytes ) / std::max< uint64_t >( kResult.transientBytes, 1 ) ),
+			kResult.peakLiveBytes * megabytes, kResult.microsecondsPerCompile );
+
+	result |= Check( kResult.bCulling, "culled passes changed the outputs" ) ? 0 : 1;
+	result |= Check( kResult.bPlacement, "resources alive at the same time share memory" ) ? 0 : 1;
+	result |= Check( kResult.bBarriers, "a barrier started from the wrong state, or a pass saw the wrong one" ) ? 0 : 1;
+	result |= Check( kResult.bDeterministic, "compiling twice gave different results" ) ? 0 : 1;
+	return result;
+}
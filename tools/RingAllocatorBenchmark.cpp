@@ -0,0 +1,248 @@
+// The upload ring's allocator against a simulated fence: fixed cases for wrap-around, a full ring and alignment,
+// then random frames of random allocations while the GPU lags a random number of frames behind. Checks that every
+// offset is aligned and inside the ring, that no live allocation is handed out again before its fence value, and
+// that retiring everything gives the whole ring back, then times Allocate.
+// usage: ringbench [--frames N] [--size N] [--allocations N]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Clock.hpp"
+#include "NullCommandBackend.hpp"
+#include "RingAllocator.hpp"
+
+namespace
+{
+	// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT and D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, what
+	// UploadRingBuffer::Allocate and AllocateConstantBuffer pass.
+	constexpr uint64_t uPlacementAlignment = 512;
+	constexpr uint64_t uConstantBufferAlignment = 256;
+
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: ringbench [--frames N] [--size N] [--allocations N]\n" );
+		return 1;
+	}
+
+	// A frame at the end of the ring retires while the next one is still in flight, the one after has to wrap into
+	// the space the first frame gave back, and a full ring hands out nothing until a frame retires.
+	bool CheckWrapAround()
+	{
+		NullCommandBackend kBackend;
+		RingAllocator kRing( 4096 );
+		bool bPassed = true;
+
+		bPassed &= kRing.Allocate( 1000, uPlacementAlignment ) == 0;
+		kRing.FinishFrame( 1 );
+		bPassed &= kRing.Allocate( 1000, uConstantBufferAlignment ) == 1024;
+		kRing.FinishFrame( 2 );
+
+		// Nothing retired yet, 2072 bytes left at the end and frame 1 still in use at the start.
+		bPassed &= kRing.Allocate( 3000, uPlacementAlignment ) == RingAllocator::uInvalidOffset;
+		kBackend.Complete( 1 );
+		kRing.ReleaseCompletedFrames( kBackend.GetCompletedValue() );
+		bPassed &= kRing.GetUsedSize() == 1024;
+
+		bPassed &= kRing.Allocate( 2000, uPlacementAlignment ) == 2048;
+		// 48 bytes left at the end, the rest of the buffer is wasted and the allocation wraps to where frame 1 was.
+		bPassed &= kRing.Allocate( 1000, uConstantBufferAlignment ) == 0;
+		bPassed &= kRing.IsFull() && kRing.Allocate( 1, 1 ) == RingAllocator::uInvalidOffset;
+		kRing.FinishFrame( 3 );
+
+		// Frame 2 only frees its own range, the wasted end belongs to frame 3.
+		kBackend.Complete( 2 );
+		kRing.ReleaseCompletedFrames( kBackend.GetCompletedValue() );
+		bPassed &= kRing.GetUsedSize() == 3072 && kRing.GetPendingFrameCount() == 1;
+		bPassed &= kRing.Allocate( 1024, uConstantBufferAlignment ) == RingAllocator::uInvalidOffset;
+		bPassed &= kRing.Allocate( 1000, uConstantBufferAlignment ) == 1024;
+		bPassed &= kRing.IsFull() && kRing.Allocate( 1, 1 ) == RingAllocator::uInvalidOffset;
+		kRing.FinishFrame( 4 );
+
+		// Once everything retired the ring starts over at 0, so an allocation of the whole ring fits.
+		kBackend.Complete( 4 );
+		kRing.ReleaseCompletedFrames( kBackend.GetCompletedValue() );
+		bPassed &= kRing.IsEmpty() && kRing.GetPendingFrameCount() == 0;
+		bPassed &= kRing.Allocate( 4096, uPlacementAlignment ) == 0;
+		return bPassed;
+	}
+
+	// Padding before an aligned allocation is counted as used, and the next frame retires it with its own.
+	bool CheckAlignment()
+	{
+		RingAllocator kRing( 64 * 1024 );
+		bool bPassed = true;
+
+		bPassed &= kRing.Allocate( 3, 1 ) == 0;
+		bPassed &= kRing.Allocate( 200, uConstantBufferAlignment ) == 256;
+		bPassed &= kRing.Allocate( 10, uPlacementAlignment ) == 512;
+		bPassed &= kRing.Allocate( 1, 65536 ) == RingAllocator::uInvalidOffset;
+		bPassed &= kRing.GetUsedSize() == 522 && kRing.GetCurrentFrameSize() == 522;
+		kRing.FinishFrame( 1 );
+		bPassed &= kRing.GetCurrentFrameSize() == 0;
+
+		// An empty frame is not queued, and a zero sized or oversized request never succeeds.
+		kRing.FinishFrame( 2 );
+		bPassed &= kRing.GetPendingFrameCount() == 1;
+		bPassed &= kRing.Allocate( 0, 1 ) == RingAllocator::uInvalidOffset;
+		bPassed &= kRing.Allocate( 64 * 1024 + 1, 1 ) == RingAllocator::uInvalidOffset;
+
+		kRing.ReleaseCompletedFrames( 1 );
+		bPassed &= kRing.IsEmpty();
+		return bPassed;
+	}
+
+	struct LiveAllocation
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint64_t fenceValue;	// 0 while the frame is still being built.
+	};
+
+	struct RunResult
+	{
+		bool bPassed = true;
+		uint64_t allocations = 0;
+		uint64_t failures = 0;
+		uint64_t wraps = 0;
+		uint64_t maxUsed = 0;
+		double nanosecondsPerAllocation = 0.0;
+	};
+
+	RunResult Run( uint32_t frameCount, uint64_t ringSize, uint32_t allocationsPerFrame )
+	{
+		NullCommandBackend kBackend;
+		RingAllocator kRing( ringSize );
+
+		uint32_t seed = 12345;
+		auto Random = [ &seed ]( uint32_t range )
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return ( seed >> 8 ) % range;
+		};
+
+		RunResult kResult;
+		std::vector< LiveAllocation > live;
+		uint64_t previousEnd = 0;
+		double seconds = 0.0;
+		HighResolutionClock kClock;
+		const double frequency = static_cast< double >( kClock.GetFrequency() );
+		for ( uint64_t fenceValue = 1; fenceValue <= frameCount; ++fenceValue )
+		{
+			// The GPU is somewhere between 0 and 3 frames behind.
+			const uint64_t lag = Random( 4 );
+			kBackend.Complete( ( fenceValue > lag ) ? fenceValue - lag : 0 );
+			const uint64_t completedValue = kBackend.GetCompletedValue();
+			kRing.ReleaseCompletedFrames( completedValue );
+			live.erase( std::remove_if( live.begin(), live.end(), [ completedValue ]( const LiveAllocation& kLive )
+			{
+				return kLive.fenceValue != 0 && kLive.fenceValue <= completedValue;
+			} ), live.end() );
+
+			// Mostly constants, some texture rows, now and then a big texture.
+			const uint32_t count = Random( allocationsPerFrame + 1 );
+			for ( uint32_t n = 0; n < count; ++n )
+			{
+				const uint32_t kind = Random( 16 );
+				const uint64_t alignment = ( kind < 12 ) ? uConstantBufferAlignment : uPlacementAlignment;
+				const uint64_t size = ( kind < 12 ) ? 1 + Random( 1024 ) : ( kind < 15 ) ? 1 + Random( 64 * 1024 ) : 1 + Random( static_cast< uint32_t >( ringSize / 4 ) );
+
+				const uint64_t begin = kClock.GetCounter();
+				const uint64_t offset = kRing.Allocate( size, alignment );
+				seconds += static_cast< double >( kClock.GetCounter() - begin ) / frequency;
+
+				if ( offset == RingAllocator::uInvalidOffset )
+				{
+					// An empty ring always has room for anything that fits.
+					kResult.bPassed &= !( live.empty() && kRing.IsEmpty() && size <= ringSize );
+					++kResult.failures;
+					continue;
+				}
+
+				kResult.bPassed &= ( offset % alignment ) == 0 && offset + size <= ringSize;
+				kResult.bPassed &= std::none_of( live.begin(), live.end(), [ offset, size ]( const LiveAllocation& kLive )
+				{
+					return offset < kLive.offset + kLive.size && kLive.offset < offset + size;
+				} );
+				kResult.wraps += ( offset < previousEnd ) ? 1 : 0;
+				previousEnd = offset + size;
+				live.push_back( { offset, size, 0 } );
+				++kResult.allocations;
+			}
+
+			for ( LiveAllocation& kLive : live )
+			{
+				kLive.fenceValue = ( kLive.fenceValue == 0 ) ? fenceValue : kLive.fenceValue;
+			}
+			kRing.FinishFrame( fenceValue );
+			kResult.maxUsed = std::max( kResult.maxUsed, kRing.GetUsedSize() );
+
+			// Used space covers at least what is live, padding and the wasted end of a wrap come on top.
+			uint64_t liveBytes = 0;
+			for ( const LiveAllocation& kLive : live )
+			{
+				liveBytes += kLive.size;
+			}
+			kResult.bPassed &= kRing.GetUsedSize() >= liveBytes && kRing.GetUsedSize() <= ringSize;
+			kResult.bPassed &= kRing.GetPendingFrameCount() <= 4;
+		}
+
+		kBackend.Complete( frameCount );
+		kRing.ReleaseCompletedFrames( kBackend.GetCompletedValue() );
+		kResult.bPassed &= kRing.IsEmpty() && kRing.GetPendingFrameCount() == 0;
+		kResult.bPassed &= kRing.Allocate( ringSize, uPlacementAlignment ) == 0;
+		kResult.nanosecondsPerAllocation = ( kResult.allocations + kResult.failures > 0 ) ? seconds * 1e9 / ( kResult.allocations + kResult.failures ) : 0.0;
+		return kResult;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t frameCount = 20000;
+	uint64_t ringSize = 4ull << 20;
+	uint32_t allocationsPerFrame = 32;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--frames" ) == 0 && hasValue )
+		{
+			frameCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--size" ) == 0 && hasValue )
+		{
+			ringSize = std::max< uint64_t >( 64 * 1024, strtoull( argv[ ++i ], nullptr, 10 ) );
+		}
+		else if ( strcmp( argv[ i ], "--allocations" ) == 0 && hasValue )
+		{
+			allocationsPerFrame = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	int result = 0;
+	if ( !CheckWrapAround() )
+	{
+		fprintf( stderr, "wrap-around: wrong offset, or space came back before its frame retired\n" );
+		result = 1;
+	}
+	if ( !CheckAlignment() )
+	{
+		fprintf( stderr, "alignment: wrong offset or padding\n" );
+		result = 1;
+	}
+
+	const RunResult kResult = Run( frameCount, ringSize, allocationsPerFrame );
+	printf( "%u frames on a %llu KB ring: %llu allocations, %llu out of space, %llu wraps, at most %llu KB used, %.1f ns/allocation\n",
+			frameCount, static_cast< unsigned long long >( ringSize >> 10 ), static_cast< unsigned long long >( kResult.allocations ),
+			static_cast< unsigned long long >( kResult.failures ), static_cast< unsigned long long >( kResult.wraps ),
+			static_cast< unsigned long long >( kResult.maxUsed >> 10 ), kResult.nanosecondsPerAllocation );
+	if ( !kResult.bPassed )
+	{
+		fprintf( stderr, "an allocation was misaligned, outside the ring or overlapped one still in flight\n" );
+		result = 1;
+	}
+	return result;
+}
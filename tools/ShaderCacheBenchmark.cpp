@@ -0,0 +1,383 @@
+// Shader cache on a stub compiler: #include and #define are resolved like HLSL's, comments are dropped, and compiling
+// costs time. Shaders share a header that includes another one. Checks cold and warm runs, edits of a nested include
+// that only touch comments and ones that do not, a compiler update, compile errors, damaged cache files and a cache
+// directory that can not be written. Reports how much faster a warm start is.
+// usage: shadercache [--shaders N] [--threads N]
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Clock.hpp"
+#include "Hash.hpp"
+#include "ShaderCache.hpp"
+#include "ThreadPool.hpp"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: shadercache [--shaders N] [--threads N]\n" );
+		return 1;
+	}
+
+	bool Check( bool bCondition, const char* pName )
+	{
+		if ( !bCondition )
+		{
+			fprintf( stderr, "failed: %s\n", pName );
+		}
+		return bCondition;
+	}
+
+	std::string ReadText( const std::filesystem::path& path )
+	{
+		std::ifstream in( path, std::ios::binary );
+		if ( !in )
+		{
+			throw std::runtime_error( "Can not open " + path.string() );
+		}
+		return std::string( std::istreambuf_iterator< char >( in ), std::istreambuf_iterator< char >() );
+	}
+
+	void WriteText( const std::filesystem::path& path, const std::string& text )
+	{
+		std::ofstream out( path, std::ios::binary | std::ios::trunc );
+		out << text;
+	}
+
+	// Quoted includes relative to the including file, // comments, #error. Bytecode is a hash of the source run
+	// over it many times, bindings come from "cbuffer Name : register( bN )" and "Texture2D Name : register( tN )".
+	class StubCompiler : public IShaderCompiler
+	{
+	public:
+		std::atomic< uint64_t > version{ 1 };
+		std::atomic< uint32_t > preprocesses{ 0 };
+		std::atomic< uint32_t > compiles{ 0 };
+		uint32_t compileRounds = 256;
+
+		uint64_t GetVersion() const override { return version; }
+
+		PreprocessedShader Preprocess( const ShaderCompileDesc& kDesc ) override
+		{
+			++preprocesses;
+			PreprocessedShader kResult;
+			for ( const ShaderDefine& kDefine : kDesc.defines )
+			{
+				kResult.source += "#define " + kDefine.name + " " + kDefine.value + "\n";
+			}
+			Include( kDesc.sourcePath, kResult, 0 );
+			return kResult;
+		}
+
+		void Compile( const ShaderCompileDesc& kDesc, const std::string& source, std::vector< uint8_t >& bytecode,
+					  std::vector< ShaderBinding >& bindings ) override
+		{
+			++compiles;
+			if ( source.find( "#error" ) != std::string::npos )
+			{
+				throw std::runtime_error( kDesc.sourcePath.string() + ": #error" );
+			}
+
+			Hasher kHasher;
+			kHasher.AddString( kDesc.entryPoint.c_str() );
+			kHasher.AddString( kDesc.target.c_str() );
+			kHasher.Add( version.load() );
+			for ( uint32_t round = 0; round < compileRounds; ++round )
+			{
+				kHasher.AddBlob( source.data(), source.size() );
+			}
+			bytecode.resize( 64 + source.size() / 2 );
+			uint64_t value = kHasher.GetHash();
+			for ( size_t n = 0; n < bytecode.size(); ++n )
+			{
+				value = value * 6364136223846793005ull + 1442695040888963407ull;
+				bytecode[ n ] = static_cast< uint8_t >( value >> 56 );
+			}
+
+			std::istringstream lines( source );
+			std::string line;
+			while ( std::getline( lines, line ) )
+			{
+				char kind[ 16 ] = {};
+				char name[ 64 ] = {};
+				char registerType = 0;
+				uint32_t bindPoint = 0;
+				if ( sscanf( line.c_str(), "%15s %63s : register( %c%u )", kind, name, &registerType, &bindPoint ) == 4 )
+				{
+					const bool bConstants = strcmp( kind, "cbuffer" ) == 0;
+					bindings.push_back( { name, bConstants ? 0u : 2u, bindPoint, 1, 0, bConstants ? 256u : 0u } );
+				}
+			}
+		}
+
+	private:
+		void Include( const std::filesystem::path& path, PreprocessedShader& kResult, uint32_t depth )
+		{
+			if ( depth > 16 )
+			{
+				throw std::runtime_error( "Includes nested too deep in " + path.string() );
+			}
+			const std::string text = ReadText( path );
+			kResult.files.push_back( { path, text.size(), ShaderCache::HashContents( text.data(), text.size() ) } );
+
+			std::istringstream lines( text );
+			std::string line;
+			while ( std::getline( lines, line ) )
+			{
+				const size_t comment = line.find( "//" );
+				if ( comment != std::string::npos )
+				{
+					line.erase( comment );
+				}
+				char name[ 256 ] = {};
+				if ( sscanf( line.c_str(), " #include \"%255[^\"]\"", name ) == 1 )
+				{
+					Include( path.parent_path() / name, kResult, depth + 1 );
+				}
+				else if ( !line.empty() )
+				{
+					kResult.source += line + "\n";
+				}
+			}
+		}
+
+	};
+
+	std::string MakeShader( uint32_t index )
+	{
+		std::string text = "#include \"common.hlsli\"\n// shader " + std::to_string( index ) + "\n";
+		text += "cbuffer Object : register( b1 )\nTexture2D Albedo : register( t" + std::to_string( index % 4 ) + " )\n";
+		for ( uint32_t n = 0; n < 64; ++n )
+		{
+			text += "float4 Function" + std::to_string( n ) + "( float4 v ) { return v * " + std::to_string( index + n ) + ".0; }\n";
+		}
+		return text + "float4 VSMain( float4 p ) { return Function0( p ); }\nfloat4 PSMain( float4 p ) { return Function1( p ); }\n";
+	}
+
+	struct RunResult
+	{
+		double milliseconds = 0.0;
+		std::vector< std::vector< uint8_t > > bytecode;
+		std::vector< std::vector< ShaderBinding > > bindings;
+		ShaderCacheStats kStats;
+		uint32_t preprocesses = 0;
+		uint32_t compiles = 0;
+		uint32_t failures = 0;
+	};
+
+	// Every description at once on the pool, the way LoadAssets asks for its shaders. Each run gets a fresh cache,
+	// like a new start of the app.
+	RunResult GetAll( const std::filesystem::path& directory, StubCompiler& kCompiler, const std::vector< ShaderCompileDesc >& descs, ThreadPool& kPool )
+	{
+		kCompiler.preprocesses = 0;
+		kCompiler.compiles = 0;
+		ShaderCache kCache( directory, kCompiler );
+
+		HighResolutionClock kClock;
+		const uint64_t startCounter = kClock.GetCounter();
+		std::vector< std::future< std::shared_ptr< const CompiledShader > > > futures;
+		for ( const ShaderCompileDesc& kDesc : descs )
+		{
+			futures.push_back( kCache.GetAsync( kDesc, kPool ) );
+		}
+
+		RunResult kResult;
+		for ( std::future< std::shared_ptr< const CompiledShader > >& future : futures )
+		{
+			try
+			{
+				const std::shared_ptr< const CompiledShader > spShader = future.get();
+				kResult.bytecode.emplace_back( spShader->GetBytecode(), spShader->GetBytecode() + spShader->GetBytecodeSize() );
+				kResult.bindings.push_back( spShader->GetBindings() );
+			}
+			catch ( const std::runtime_error& )
+			{
+				++kResult.failures;
+				kResult.bytecode.emplace_back();
+				kResult.bindings.emplace_back();
+			}
+		}
+		kResult.milliseconds = static_cast< double >( kClock.GetCounter() - startCounter ) * 1000.0 / kClock.GetFrequency();
+		kResult.kStats = kCache.GetStats();
+		kResult.preprocesses = kCompiler.preprocesses;
+		kResult.compiles = kCompiler.compiles;
+		return kResult;
+	}
+
+	bool SameBindings( const RunResult& kFirst, const RunResult& kSecond )
+	{
+		if ( kFirst.bindings.size() != kSecond.bindings.size() )
+		{
+			return false;
+		}
+		for ( size_t n = 0; n < kFirst.bindings.size(); ++n )
+		{
+			const std::vector< ShaderBinding >& first = kFirst.bindings[ n ];
+			const std::vector< ShaderBinding >& second = kSecond.bindings[ n ];
+			if ( first.size() != second.size() || first.empty() )
+			{
+				return false;
+			}
+			for ( size_t binding = 0; binding < first.size(); ++binding )
+			{
+				if ( first[ binding ].name != second[ binding ].name || first[ binding ].type != second[ binding ].type ||
+					 first[ binding ].bindPoint != second[ binding ].bindPoint || first[ binding ].size != second[ binding ].size )
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t shaderCount = 32;
+	uint32_t threadCount = 0;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--shaders" ) == 0 && hasValue )
+		{
+			shaderCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--threads" ) == 0 && hasValue )
+		{
+			threadCount = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	// Every shader includes common.hlsli, which includes lighting.hlsli, each file has a vertex and a pixel shader.
+	const std::filesystem::path root = std::filesystem::temp_directory_path() / "shadercache";
+	const std::filesystem::path sources = root / "shaders";
+	const std::filesystem::path directory = root / "cache";
+	std::filesystem::remove_all( root );
+	std::filesystem::create_directories( sources / "include" );
+	WriteText( sources / "common.hlsli", "#include \"include/lighting.hlsli\"\ncbuffer Scene : register( b0 )\n" );
+	const std::string lighting = "// lighting\nfloat3 Light( float3 n ) { return saturate( n.y ); }\n";
+	WriteText( sources / "include" / "lighting.hlsli", lighting );
+	std::vector< ShaderCompileDesc > descs;
+	for ( uint32_t n = 0; n < shaderCount; ++n )
+	{
+		const std::filesystem::path path = sources / ( "shader" + std::to_string( n ) + ".hlsl" );
+		WriteText( path, MakeShader( n ) );
+		descs.push_back( { path, "VSMain", "vs_5_0", {}, 0 } );
+		descs.push_back( { path, "PSMain", "ps_5_0", { { "ALPHA_TEST", std::to_string( n % 2 ) } }, 0 } );
+	}
+	const uint32_t descCount = static_cast< uint32_t >( descs.size() );
+
+	ThreadPool kPool( threadCount );
+	StubCompiler kCompiler;
+	int result = 0;
+
+	// Nothing cached, everything compiled. The second start only reads the sources and maps the cache files.
+	const RunResult kCold = GetAll( directory, kCompiler, descs, kPool );
+	result |= Check( kCold.compiles == descCount && kCold.kStats.compiles == descCount && kCold.failures == 0, "a cold cache compiles everything" ) ? 0 : 1;
+	const RunResult kWarm = GetAll( directory, kCompiler, descs, kPool );
+	result |= Check( kWarm.kStats.hits == descCount && kWarm.preprocesses == 0 && kWarm.compiles == 0, "a warm cache does not even preprocess" ) ? 0 : 1;
+	result |= Check( kWarm.bytecode == kCold.bytecode && SameBindings( kWarm, kCold ), "cached shaders match the compiled ones" ) ? 0 : 1;
+
+	// A comment in a nested include: every shader is preprocessed again, none compiled.
+	WriteText( sources / "include" / "lighting.hlsli", "// lighting, edited\n" + lighting.substr( lighting.find( '\n' ) + 1 ) );
+	const RunResult kComment = GetAll( directory, kCompiler, descs, kPool );
+	result |= Check( kComment.kStats.preprocessedHits == descCount && kComment.compiles == 0 && kComment.bytecode == kCold.bytecode,
+					 "a comment edit is not compiled" ) ? 0 : 1;
+
+	// Code in the nested include: everything is compiled again, and then cached.
+	WriteText( sources / "include" / "lighting.hlsli", lighting + "float3 Ambient() { return 0.1; }\n" );
+	const RunResult kEdit = GetAll( directory, kCompiler, descs, kPool );
+	bool bAllChanged = true;
+	for ( uint32_t n = 0; n < descCount; ++n )
+	{
+		bAllChanged &= kEdit.bytecode[ n ] != kCold.bytecode[ n ];
+	}
+	result |= Check( kEdit.compiles == descCount && bAllChanged, "an include edit compiles every shader using it" ) ? 0 : 1;
+	const RunResult kAfterEdit = GetAll( directory, kCompiler, descs, kPool );
+	result |= Check( kAfterEdit.kStats.hits == descCount && kAfterEdit.bytecode == kEdit.bytecode, "the edit is cached" ) ? 0 : 1;
+
+	// One shader file: only its two entry points.
+	WriteText( sources / "shader0.hlsl", MakeShader( 0 ) + "float4 Extra( float4 v ) { return v; }\n" );
+	const RunResult kOne = GetAll( directory, kCompiler, descs, kPool );
+	result |= Check( kOne.compiles == 2 && kOne.kStats.hits == descCount - 2, "a shader edit compiles only that shader" ) ? 0 : 1;
+
+	// Another define value is another shader, the first one stays cached.
+	std::vector< ShaderCompileDesc > defineDescs = { descs[ 1 ], descs[ 1 ] };
+	defineDescs[ 1 ].defines[ 0 ].value = "2";
+	const RunResult kDefines = GetAll( directory, kCompiler, defineDescs, kPool );
+	result |= Check( kDefines.kStats.hits == 1 && kDefines.compiles == 1 && kDefines.bytecode[ 0 ] != kDefines.bytecode[ 1 ], "defines are part of the key" ) ? 0 : 1;
+
+	// A compile error is thrown from the future, nothing is cached for it, and the fix compiles.
+	WriteText( sources / "shader1.hlsl", MakeShader( 1 ) + "#error broken\n" );
+	const RunResult kBroken = GetAll( directory, kCompiler, descs, kPool );
+	result |= Check( kBroken.failures == 2 && kBroken.kStats.hits == descCount - 2, "compile errors are thrown" ) ? 0 : 1;
+	WriteText( sources / "shader1.hlsl", MakeShader( 1 ) );
+	const RunResult kFixed = GetAll( directory, kCompiler, descs, kPool );
+	result |= Check( kFixed.failures == 0 && kFixed.kStats.hits + kFixed.kStats.preprocessedHits == descCount &&
+					 kFixed.bytecode[ 2 ] == kEdit.bytecode[ 2 ], "the fix is back to the cached shader" ) ? 0 : 1;
+
+	// Damaged cache files are compiled again, damaged manifests preprocessed again, nothing wrong comes back.
+	const RunResult kBefore = GetAll( directory, kCompiler, descs, kPool );
+	uint32_t damagedShaders = 0;
+	uint32_t damagedManifests = 0;
+	for ( const std::filesystem::directory_entry& kEntry : std::filesystem::directory_iterator( directory ) )
+	{
+		std::string bytes = ReadText( kEntry.path() );
+		const bool bShader = kEntry.path().extension() == ".ldsh";
+		if ( bShader && damagedShaders++ % 2 == 0 )
+		{
+			bytes[ bytes.size() - 1 - ( damagedShaders % 64 ) ] ^= 0x40;
+		}
+		else if ( !bShader && damagedManifests++ % 3 == 0 )
+		{
+			bytes.resize( bytes.size() / 2 );
+		}
+		WriteText( kEntry.path(), bytes );
+	}
+	const RunResult kDamaged = GetAll( directory, kCompiler, descs, kPool );
+	result |= Check( kDamaged.bytecode == kBefore.bytecode && kDamaged.compiles > 0 && kDamaged.kStats.preprocessedHits > 0,
+					 "damaged cache files are replaced" ) ? 0 : 1;
+	const RunResult kRepaired = GetAll( directory, kCompiler, descs, kPool );
+	result |= Check( kRepaired.kStats.hits == descCount, "replaced files are cached again" ) ? 0 : 1;
+
+	// A compiler update compiles everything.
+	kCompiler.version = 2;
+	const RunResult kUpdate = GetAll( directory, kCompiler, descs, kPool );
+	result |= Check( kUpdate.compiles == descCount, "a compiler update compiles everything" ) ? 0 : 1;
+
+	// A cache directory that can not be created: shaders still come back, from memory.
+	WriteText( root / "blocked", "not a directory" );
+	const RunResult kBlocked = GetAll( root / "blocked" / "cache", kCompiler, descs, kPool );
+	result |= Check( kBlocked.kStats.unwritten == descCount && kBlocked.bytecode == kUpdate.bytecode, "shaders work without a cache" ) ? 0 : 1;
+
+	uint64_t cacheBytes = 0;
+	uint32_t cacheFiles = 0;
+	for ( const std::filesystem::directory_entry& kEntry : std::filesystem::directory_iterator( directory ) )
+	{
+		cacheBytes += kEntry.file_size();
+		++cacheFiles;
+		result |= Check( kEntry.path().extension() != ".tmp", "no temporary files are left" ) ? 0 : 1;
+	}
+	std::filesystem::remove_all( root );
+
+	printf( "%u shaders on %u threads: cold %.1f ms ( %u compiled ), warm %.1f ms ( %u from the cache ), %.1fx faster\n",
+			descCount, kPool.GetThreadCount(), kCold.milliseconds, kCold.compiles, kWarm.milliseconds, kWarm.kStats.hits,
+			kCold.milliseconds / std::max( kWarm.milliseconds, 0.001 ) );
+	printf( "comment edit in a nested include: %.1f ms ( %u preprocessed, %u compiled ), cache: %u files, %.1f KB\n",
+			kComment.milliseconds, kComment.preprocesses, kComment.compiles, cacheFiles, cacheBytes / 1024.0 );
+	return result;
+}
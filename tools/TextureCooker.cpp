@@ -0,0 +1,167 @@
+// Offline converter from anything stb_image reads to the .ldxt container.
+// usage: texturecooker <input> <output.ldxt> [--format rgba8|bc1|bc3|bc5|bc7] [--quality fast|high] [--no-mips] [--linear]
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BlockCompressor.hpp"
+#include "MipGenerator.hpp"
+#include "TextureContainer.hpp"
+#include "ThreadPool.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: texturecooker <input> <output.ldxt> [--format rgba8|bc1|bc3|bc5|bc7] [--quality fast|high] [--no-mips] [--linear]\n" );
+		return 1;
+	}
+
+	bool ParseFormat( const char* name, TextureFileFormat& format )
+	{
+		const struct { const char* name; TextureFileFormat format; } kFormats[] =
+		{
+			{ "rgba8", TextureFileFormat::RGBA8 },
+			{ "bc1", TextureFileFormat::BC1 },
+			{ "bc3", TextureFileFormat::BC3 },
+			{ "bc5", TextureFileFormat::BC5 },
+			{ "bc7", TextureFileFormat::BC7 },
+		};
+		for ( const auto& kEntry : kFormats )
+		{
+			if ( strcmp( name, kEntry.name ) == 0 )
+			{
+				format = kEntry.format;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	BlockFormat ToBlockFormat( TextureFileFormat format )
+	{
+		switch ( format )
+		{
+			case TextureFileFormat::BC1: return BlockFormat::BC1;
+			case TextureFileFormat::BC3: return BlockFormat::BC3;
+			case TextureFileFormat::BC5: return BlockFormat::BC5;
+			default: return BlockFormat::BC7;
+		}
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	if ( argc < 3 )
+	{
+		return PrintUsage();
+	}
+
+	// Offline, so default to the slow encoder.
+	TextureFileFormat format = TextureFileFormat::BC7;
+	BlockCompressOptions kCompressOptions;
+	kCompressOptions.quality = BlockQuality::High;
+	MipGenerateOptions kMipOptions;
+	bool bMips = true;
+	for ( int i = 3; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--format" ) == 0 && hasValue )
+		{
+			if ( !ParseFormat( argv[ ++i ], format ) )
+			{
+				return PrintUsage();
+			}
+		}
+		else if ( strcmp( argv[ i ], "--quality" ) == 0 && hasValue )
+		{
+			kCompressOptions.quality = strcmp( argv[ ++i ], "fast" ) == 0 ? BlockQuality::Fast : BlockQuality::High;
+		}
+		else if ( strcmp( argv[ i ], "--no-mips" ) == 0 )
+		{
+			bMips = false;
+		}
+		else if ( strcmp( argv[ i ], "--linear" ) == 0 )
+		{
+			// Data textures (normal maps, masks) are not sRGB encoded.
+			kMipOptions.gammaCorrect = false;
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	try
+	{
+		int width = 0, height = 0, channels = 0;
+		std::unique_ptr< stbi_uc, void( * )( void* ) > spImage( stbi_load( argv[ 1 ], &width, &height, &channels, STBI_rgb_alpha ), stbi_image_free );
+		const stbi_uc* pImage = spImage.get();
+		if ( !pImage )
+		{
+			fprintf( stderr, "failed to load %s: %s\n", argv[ 1 ], stbi_failure_reason() );
+			return 1;
+		}
+
+		const bool bBlocks = TextureContainer::IsBlockCompressed( format );
+		if ( bBlocks && ( width % 4 != 0 || height % 4 != 0 ) )
+		{
+			fprintf( stderr, "%s is %dx%d, block compressed textures need a multiple of 4, writing rgba8\n", argv[ 1 ], width, height );
+			format = TextureFileFormat::RGBA8;
+		}
+
+		ThreadPool kPool;
+
+		std::vector< TextureFileLevel > levels;
+		TextureFileLevel kTop;
+		kTop.width = static_cast< uint32_t >( width );
+		kTop.height = static_cast< uint32_t >( height );
+		kTop.rowPitch = static_cast< size_t >( width ) * 4;
+		kTop.pData = pImage;
+		levels.push_back( kTop );
+
+		std::vector< uint8_t > mipChain;
+		if ( bMips )
+		{
+			for ( const MipLevel& kLevel : MipGenerator::Generate( pImage, kTop.width, kTop.height, kTop.rowPitch, kMipOptions, mipChain, &kPool ) )
+			{
+				TextureFileLevel kMip;
+				kMip.width = kLevel.width;
+				kMip.height = kLevel.height;
+				kMip.rowPitch = kLevel.rowPitch;
+				kMip.pData = mipChain.data() + kLevel.offset;
+				levels.push_back( kMip );
+			}
+		}
+
+		std::vector< std::vector< uint8_t > > blocks;
+		if ( TextureContainer::IsBlockCompressed( format ) )
+		{
+			kCompressOptions.format = ToBlockFormat( format );
+			blocks.resize( levels.size() );
+			for ( size_t n = 0; n < levels.size(); ++n )
+			{
+				TextureFileLevel& kLevel = levels[ n ];
+				const size_t blockRowPitch = BlockCompressor::GetRowPitch( kCompressOptions.format, kLevel.width );
+				blocks[ n ].resize( BlockCompressor::GetCompressedSize( kCompressOptions.format, kLevel.width, kLevel.height ) );
+				BlockCompressor::Compress( kLevel.pData, kLevel.width, kLevel.height, kLevel.rowPitch, kCompressOptions, blocks[ n ].data(), blockRowPitch, &kPool );
+				kLevel.rowPitch = blockRowPitch;
+				kLevel.pData = blocks[ n ].data();
+			}
+		}
+
+		TextureContainer::Write( argv[ 2 ], format, static_cast< uint32_t >( levels.size() ), 1, levels );
+		printf( "%s -> %s (%dx%d, %zu mips)\n", argv[ 1 ], argv[ 2 ], width, height, levels.size() );
+	}
+	catch ( const std::exception& e )
+	{
+		fprintf( stderr, "%s\n", e.what() );
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,235 @@
+// Decode throughput of stb_image over a directory of JPEG and PNG files, on one thread and on the job system with one
+// job per image like TextureManager::CreateTexture2DAsync. The files are read into memory first, so only decoding is
+// timed. Throughput counts the decoded RGBA8 bytes, like the headless report's textureDecode.
+// usage: texturebench <directory> [--threads N] [--repeat N]
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "Clock.hpp"
+#include "ThreadPool.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: texturebench <directory> [--threads N] [--repeat N]\n" );
+		return 1;
+	}
+
+	enum class ImageKind
+	{
+		Jpeg,
+		Png,
+		Count
+	};
+
+	struct ImageFile
+	{
+		std::string path;
+		ImageKind kind;
+		std::vector< uint8_t > contents;
+		uint64_t decodedBytes = 0;	// filled in by the first decode.
+	};
+
+	bool GetImageKind( const std::filesystem::path& path, ImageKind& kind )
+	{
+		std::string extension = path.extension().string();
+		std::transform( extension.begin(), extension.end(), extension.begin(), []( char c ) { return static_cast< char >( tolower( static_cast< unsigned char >( c ) ) ); } );
+		if ( extension == ".jpg" || extension == ".jpeg" )
+		{
+			kind = ImageKind::Jpeg;
+			return true;
+		}
+		if ( extension == ".png" )
+		{
+			kind = ImageKind::Png;
+			return true;
+		}
+		return false;
+	}
+
+	// Returns the number of RGBA8 bytes decoded, 0 when stb_image can not read the file.
+	uint64_t Decode( const ImageFile& kFile )
+	{
+		int width = 0, height = 0, channels = 0;
+		stbi_uc* pPixels = stbi_load_from_memory( kFile.contents.data(), static_cast< int >( kFile.contents.size() ), &width, &height, &channels, STBI_rgb_alpha );
+		if ( !pPixels )
+		{
+			return 0;
+		}
+		stbi_image_free( pPixels );
+		return static_cast< uint64_t >( width ) * height * 4;
+	}
+
+	struct Throughput
+	{
+		uint32_t images = 0;
+		uint64_t bytes = 0;
+		double serialSeconds = 0.0;
+		double poolSeconds = 0.0;
+	};
+
+	void PrintRow( const char* name, const Throughput& kThroughput, uint32_t repeat )
+	{
+		if ( kThroughput.images == 0 )
+		{
+			return;
+		}
+
+		const double megabytes = static_cast< double >( kThroughput.bytes ) * repeat / ( 1024.0 * 1024.0 );
+		const double images = static_cast< double >( kThroughput.images ) * repeat;
+		printf( "%-6s %7u %10.1f %12.1f %12.1f %12.1f %12.1f %8.2f\n", name, kThroughput.images, static_cast< double >( kThroughput.bytes ) / ( 1024.0 * 1024.0 ),
+				megabytes / kThroughput.serialSeconds, images / kThroughput.serialSeconds, megabytes / kThroughput.poolSeconds,
+				images / kThroughput.poolSeconds, kThroughput.serialSeconds / kThroughput.poolSeconds );
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	if ( argc < 2 || argv[ 1 ][ 0 ] == '-' )
+	{
+		return PrintUsage();
+	}
+
+	const std::filesystem::path directory = argv[ 1 ];
+	uint32_t threadCount = 0;
+	uint32_t repeat = 3;
+	for ( int i = 2; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--threads" ) == 0 && hasValue )
+		{
+			threadCount = static_cast< uint32_t >( std::max( 0, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--repeat" ) == 0 && hasValue )
+		{
+			repeat = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	std::vector< ImageFile > files;
+	std::error_code error;
+	for ( std::filesystem::recursive_directory_iterator it( directory, error ), end; !error && it != end; it.increment( error ) )
+	{
+		ImageKind kind = ImageKind::Jpeg;
+		if ( !it->is_regular_file() || !GetImageKind( it->path(), kind ) )
+		{
+			continue;
+		}
+
+		std::ifstream stream( it->path(), std::ios::binary );
+		ImageFile kFile;
+		kFile.path = it->path().string();
+		kFile.kind = kind;
+		kFile.contents.assign( std::istreambuf_iterator< char >( stream ), std::istreambuf_iterator< char >() );
+		if ( stream.bad() || kFile.contents.empty() )
+		{
+			fprintf( stderr, "can not read %s\n", kFile.path.c_str() );
+			continue;
+		}
+		files.push_back( std::move( kFile ) );
+	}
+	if ( error )
+	{
+		fprintf( stderr, "can not list %s: %s\n", directory.string().c_str(), error.message().c_str() );
+		return 1;
+	}
+
+	// One warm-up pass, which also drops what stb_image does not read.
+	for ( ImageFile& kFile : files )
+	{
+		kFile.decodedBytes = Decode( kFile );
+		if ( kFile.decodedBytes == 0 )
+		{
+			fprintf( stderr, "can not decode %s: %s\n", kFile.path.c_str(), stbi_failure_reason() );
+		}
+	}
+	files.erase( std::remove_if( files.begin(), files.end(), []( const ImageFile& kFile ) { return kFile.decodedBytes == 0; } ), files.end() );
+	if ( files.empty() )
+	{
+		fprintf( stderr, "no JPEG or PNG files stb_image can decode in %s\n", directory.string().c_str() );
+		return 1;
+	}
+
+	HighResolutionClock kClock;
+	const double frequency = static_cast< double >( kClock.GetFrequency() );
+	ThreadPool kPool( threadCount );
+
+	// Per kind, then everything mixed, which is what a level load looks like.
+	Throughput kinds[ static_cast< size_t >( ImageKind::Count ) + 1 ];
+	bool bPassed = true;
+	for ( size_t k = 0; k <= static_cast< size_t >( ImageKind::Count ); ++k )
+	{
+		std::vector< const ImageFile* > selected;
+		for ( const ImageFile& kFile : files )
+		{
+			if ( k == static_cast< size_t >( ImageKind::Count ) || kFile.kind == static_cast< ImageKind >( k ) )
+			{
+				selected.push_back( &kFile );
+				kinds[ k ].bytes += kFile.decodedBytes;
+			}
+		}
+		kinds[ k ].images = static_cast< uint32_t >( selected.size() );
+		if ( selected.empty() )
+		{
+			continue;
+		}
+
+		uint64_t begin = kClock.GetCounter();
+		uint64_t serialBytes = 0;
+		for ( uint32_t r = 0; r < repeat; ++r )
+		{
+			for ( const ImageFile* pFile : selected )
+			{
+				serialBytes += Decode( *pFile );
+			}
+		}
+		kinds[ k ].serialSeconds = static_cast< double >( kClock.GetCounter() - begin ) / frequency;
+
+		std::vector< uint64_t > decodedBytes( selected.size() );
+		uint64_t poolBytes = 0;
+		begin = kClock.GetCounter();
+		for ( uint32_t r = 0; r < repeat; ++r )
+		{
+			JobCounter kCounter;
+			for ( size_t n = 0; n < selected.size(); ++n )
+			{
+				kPool.Run( [ pFile = selected[ n ], pBytes = &decodedBytes[ n ] ]() { *pBytes = Decode( *pFile ); }, &kCounter );
+			}
+			kPool.Wait( kCounter );
+			for ( uint64_t bytes : decodedBytes )
+			{
+				poolBytes += bytes;
+			}
+		}
+		kinds[ k ].poolSeconds = static_cast< double >( kClock.GetCounter() - begin ) / frequency;
+
+		bPassed &= serialBytes == kinds[ k ].bytes * repeat && poolBytes == serialBytes;
+	}
+
+	printf( "%u images, %u workers, %u repeats\n", static_cast< uint32_t >( files.size() ), kPool.GetThreadCount(), repeat );
+	printf( "%-6s %7s %10s %12s %12s %12s %12s %8s\n", "kind", "images", "MB", "1 thr MB/s", "1 thr img/s", "pool MB/s", "pool img/s", "speedup" );
+	PrintRow( "jpeg", kinds[ static_cast< size_t >( ImageKind::Jpeg ) ], repeat );
+	PrintRow( "png", kinds[ static_cast< size_t >( ImageKind::Png ) ], repeat );
+	PrintRow( "all", kinds[ static_cast< size_t >( ImageKind::Count ) ], repeat );
+	if ( !bPassed )
+	{
+		fprintf( stderr, "an image decoded to a different size on the pool than on one thread\n" );
+		return 1;
+	}
+	return 0;
+}
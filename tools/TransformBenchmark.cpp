@@ -0,0 +1,161 @@
+// Transform hierarchy update time against node count and the share of nodes changed each frame.
+// usage: transformbench [--nodes N] [--branch N] [--repeat N]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "Clock.hpp"
+#include "ThreadPool.hpp"
+#include "TransformHierarchy.hpp"
+
+using namespace DirectX;
+
+namespace
+{
+	int PrintUsage()
+	{
+		fprintf( stderr, "usage: transformbench [--nodes N] [--branch N] [--repeat N]\n" );
+		return 1;
+	}
+
+	struct LocalTransform
+	{
+		XMFLOAT3 translation;
+		XMFLOAT4 rotation;
+		XMFLOAT3 scale;
+	};
+
+	XMFLOAT4 RandomRotation( std::mt19937& kRandom )
+	{
+		std::uniform_real_distribution< float > kAngle( -XM_PI, XM_PI );
+		XMFLOAT4 rotation;
+		XMStoreFloat4( &rotation, XMQuaternionRotationRollPitchYaw( kAngle( kRandom ), kAngle( kRandom ), kAngle( kRandom ) ) );
+		return rotation;
+	}
+
+	// Node n hangs below ( n - 1 ) / branch, so the nodes come breadth first.
+	uint32_t ParentOf( uint32_t node, uint32_t branch )
+	{
+		return ( node == 0 ) ? TransformHierarchy::uInvalidNode : ( node - 1 ) / branch;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	uint32_t maxNodes = 1u << 20;
+	uint32_t branch = 4;
+	uint32_t repeat = 10;
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( strcmp( argv[ i ], "--nodes" ) == 0 && hasValue )
+		{
+			maxNodes = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--branch" ) == 0 && hasValue )
+		{
+			branch = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else if ( strcmp( argv[ i ], "--repeat" ) == 0 && hasValue )
+		{
+			repeat = static_cast< uint32_t >( std::max( 1, atoi( argv[ ++i ] ) ) );
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	ThreadPool kPool;
+	HighResolutionClock kClock;
+	const double frequency = static_cast< double >( kClock.GetFrequency() );
+	std::mt19937 kRandom( 42 );
+	std::uniform_real_distribution< float > kOffset( -1.0f, 1.0f );
+	std::uniform_real_distribution< float > kScale( 0.9f, 1.1f );
+
+	printf( "%9s %7s %9s %10s %10s %10s\n", "nodes", "dirty", "updated", "serial ms", "pool ms", "+write ms" );
+	int result = 0;
+	for ( uint32_t nodeCount = 1000; nodeCount <= maxNodes; nodeCount *= 10 )
+	{
+		std::vector< LocalTransform > locals( nodeCount );
+		for ( LocalTransform& kLocal : locals )
+		{
+			kLocal.translation = XMFLOAT3( kOffset( kRandom ), kOffset( kRandom ), kOffset( kRandom ) );
+			kLocal.rotation = RandomRotation( kRandom );
+			kLocal.scale = XMFLOAT3( kScale( kRandom ), kScale( kRandom ), kScale( kRandom ) );
+		}
+
+		TransformHierarchy kHierarchy;
+		kHierarchy.Reserve( nodeCount );
+		for ( uint32_t node = 0; node < nodeCount; ++node )
+		{
+			kHierarchy.AddNode( ParentOf( node, branch ), locals[ node ].translation, locals[ node ].rotation, locals[ node ].scale );
+		}
+		kHierarchy.Update();
+
+		// Stand-in for a structured buffer in upload memory.
+		std::vector< XMFLOAT4X4 > gpuMatrices( nodeCount );
+
+		for ( const double dirtyRatio : { 0.0, 0.001, 0.01, 0.1, 1.0 } )
+		{
+			const uint32_t dirtyCount = static_cast< uint32_t >( dirtyRatio * nodeCount );
+			double best[ 3 ] = { 1e30, 1e30, 1e30 };
+			uint32_t updated = 0;
+			for ( uint32_t n = 0; n < repeat; ++n )
+			{
+				for ( uint32_t mode = 0; mode < 3; ++mode )
+				{
+					std::uniform_int_distribution< uint32_t > kNode( 0, nodeCount - 1 );
+					for ( uint32_t d = 0; d < dirtyCount; ++d )
+					{
+						const uint32_t node = ( dirtyCount == nodeCount ) ? d : kNode( kRandom );
+						locals[ node ].rotation = RandomRotation( kRandom );
+						kHierarchy.SetRotation( node, locals[ node ].rotation );
+					}
+
+					const uint64_t begin = kClock.GetCounter();
+					updated = kHierarchy.Update( ( mode == 0 ) ? nullptr : &kPool, ( mode == 2 ) ? gpuMatrices.data() : nullptr );
+					best[ mode ] = std::min( best[ mode ], static_cast< double >( kClock.GetCounter() - begin ) / frequency );
+				}
+			}
+			printf( "%9u %6.1f%% %9u %10.3f %10.3f %10.3f\n", nodeCount, dirtyRatio * 100.0, updated, best[ 0 ] * 1e3, best[ 1 ] * 1e3, best[ 2 ] * 1e3 );
+		}
+
+		// The incremental result has to match a hierarchy built from scratch, added depth first so it gets sorted.
+		TransformHierarchy kReference;
+		std::vector< uint32_t > referenceNode( nodeCount, TransformHierarchy::uInvalidNode );
+		std::vector< uint32_t > stack = { 0 };
+		while ( !stack.empty() )
+		{
+			const uint32_t node = stack.back();
+			stack.pop_back();
+			const uint32_t parent = ParentOf( node, branch );
+			referenceNode[ node ] = kReference.AddNode( ( parent == TransformHierarchy::uInvalidNode ) ? parent : referenceNode[ parent ],
+														locals[ node ].translation, locals[ node ].rotation, locals[ node ].scale );
+			for ( uint64_t child = static_cast< uint64_t >( node ) * branch + branch; child > static_cast< uint64_t >( node ) * branch; --child )
+			{
+				if ( child < nodeCount )
+				{
+					stack.push_back( static_cast< uint32_t >( child ) );
+				}
+			}
+		}
+		kReference.Update( &kPool );
+
+		for ( uint32_t node = 0; node < nodeCount; ++node )
+		{
+			XMFLOAT4X4 transposed;
+			XMStoreFloat4x4( &transposed, XMMatrixTranspose( XMLoadFloat4x4( &kReference.GetWorld( referenceNode[ node ] ) ) ) );
+			if ( memcmp( &kHierarchy.GetWorld( node ), &kReference.GetWorld( referenceNode[ node ] ), sizeof( XMFLOAT4X4 ) ) != 0 ||
+				 memcmp( &gpuMatrices[ node ], &transposed, sizeof( XMFLOAT4X4 ) ) != 0 )
+			{
+				fprintf( stderr, "%u nodes: node %u does not match a full update\n", nodeCount, node );
+				result = 1;
+				break;
+			}
+		}
+	}
+	return result;
+}